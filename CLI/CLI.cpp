@@ -47,6 +47,8 @@
 #include <TMSITable.h>
 #include <RadioResource.h>
 #include <CallControl.h>
+#include <Metrics.h>
+#include <ObjectPool.h>
 
 #include <Globals.h>
 
@@ -652,8 +654,10 @@ void printChanInfo(unsigned transID, const GSM::LogicalChannel* chan, ostream& o
 		100.0*chan->FER(), (int)round(chan->RSSI()),
 		chan->actualMSPower(), chan->actualMSTiming());
 	os << " " << buffer;
-	const GSM::L3MeasurementResults& meas = chan->SACCH()->measurementResults();
-	if (!meas.MEAS_VALID()) {
+	// The SACCH service may be writing a new report, so read a copy from its history.
+	GSM::PhysicalRecord record;
+	const GSM::L3MeasurementResults& meas = record.mResults;
+	if (chan->SACCH()->physical().read(record) && !meas.MEAS_VALID()) {
 		snprintf(buffer,199,"%5d %5.2f",
 			meas.RXLEV_FULL_SERVING_CELL_dBm(),
 			100.0*meas.RXQUAL_FULL_SERVING_CELL_BER());
@@ -795,6 +799,28 @@ int stats(int argc, char** argv, ostream& os)
 	return SUCCESS;
 }
 
+/** Print live metrics, as summaries or in the Prometheus format. */
+int metrics(int argc, char** argv, ostream& os)
+{
+	if (argc>3) return BAD_NUM_ARGS;
+	if (argc>1 && strcmp(argv[1],"-p")==0) {
+		if (argc!=2) return BAD_NUM_ARGS;
+		MetricsRegistry::registry().write(os);
+		return SUCCESS;
+	}
+	if (argc==3) return BAD_NUM_ARGS;
+	MetricsRegistry::registry().summary(os,argc==2 ? argv[1] : NULL);
+	return SUCCESS;
+}
+
+/** Print the occupancy of the frame and burst pools. */
+int pools(int argc, char** argv, ostream& os)
+{
+	if (argc!=1) return BAD_NUM_ARGS;
+	ObjectPool::report(os);
+	return SUCCESS;
+}
+
 int handover(int argc, char** argv, ostream& os)
 {
 	if (argc!=2) return BAD_NUM_ARGS;
@@ -839,6 +865,8 @@ void Parser::addCommands()
 	addCommand("endcall", endcall,"trans# -- terminate the given transaction");
 	addCommand("crashme", crashme, "force crash of OpenBTS for testing purposes");
 	addCommand("stats", stats,"[patt] -- print all, or selected, performance statistics");
+	addCommand("metrics", metrics,"[patt] OR [-p] -- summarize all, or selected, live metrics, or print them all in Prometheus format");
+	addCommand("pools", pools,"-- print occupancy of the L2/L3 frame and uplink burst pools");
 	addCommand("ho", handover,"[IMSI]-- try to perform handover to another timeslot inside the same BTS");
 }
 
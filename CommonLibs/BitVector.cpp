@@ -33,6 +33,46 @@
 using namespace std;
 
 
+/**@name Octet-at-a-time helpers for the one-bit-per-byte BitVector. */
+//@{
+
+/** Collect the low bits of 8 consecutive chars into an MSB-first octet. */
+static inline unsigned gatherOctet(const char *dp)
+{
+	uint64_t w;
+	memcpy(&w,dp,8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	w = __builtin_bswap64(w);
+#endif
+	// Each multiplier term moves one byte's low bit into the top octet.
+	return ((w & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56;
+}
+
+/** Spread an MSB-first octet into 8 consecutive chars of 0 or 1. */
+static inline void spreadOctet(unsigned octet, char *dp)
+{
+	// Replicate the octet, isolate bit 7-k in byte k, then squash to 0/1.
+	uint64_t w = ((octet & 0x0ff) * 0x0101010101010101ULL) & 0x0102040810204080ULL;
+	w = ((w + 0x7f7f7f7f7f7f7f7fULL) >> 7) & 0x0101010101010101ULL;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	w = __builtin_bswap64(w);
+#endif
+	memcpy(dp,&w,8);
+}
+
+//@}
+
+
+/** Reverse the order of bits in a 64-bit word. */
+static inline uint64_t reverseBits64(uint64_t w)
+{
+	w = ((w >> 1) & 0x5555555555555555ULL) | ((w & 0x5555555555555555ULL) << 1);
+	w = ((w >> 2) & 0x3333333333333333ULL) | ((w & 0x3333333333333333ULL) << 2);
+	w = ((w >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((w & 0x0f0f0f0f0f0f0f0fULL) << 4);
+	return __builtin_bswap64(w);
+}
+
+
 /**
   Apply a Galois polymonial to a binary seqeunce.
   @param val The input sequence.
@@ -71,8 +111,14 @@ BitVector::BitVector(const char *valString)
 uint64_t BitVector::peekField(size_t readIndex, unsigned length) const
 {
 	uint64_t accum = 0;
-	char *dp = mStart + readIndex;
+	const char *dp = mStart + readIndex;
 	assert(dp+length <= mEnd);
+	// Whole octets first, then any leftover bits.
+	while (length>=8) {
+		accum = (accum<<8) | gatherOctet(dp);
+		dp += 8;
+		length -= 8;
+	}
 	for (unsigned i=0; i<length; i++) {
 		accum = (accum<<1) | ((*dp++) & 0x01);
 	}
@@ -84,13 +130,8 @@ uint64_t BitVector::peekField(size_t readIndex, unsigned length) const
 
 uint64_t BitVector::peekFieldReversed(size_t readIndex, unsigned length) const
 {
-	uint64_t accum = 0;
-	char *dp = mStart + readIndex + length - 1;
-	assert(dp<mEnd);
-	for (int i=(length-1); i>=0; i--) {
-		accum = (accum<<1) | ((*dp--) & 0x01);
-	}
-	return accum;
+	if (length==0) return 0;
+	return reverseBits64(peekField(readIndex,length)) >> (64-length);
 }
 
 
@@ -117,25 +158,25 @@ uint64_t BitVector::readFieldReversed(size_t& readIndex, unsigned length) const
 
 void BitVector::fillField(size_t writeIndex, uint64_t value, unsigned length)
 {
-	char *dpBase = mStart + writeIndex;
-	char *dp = dpBase + length - 1;
-	assert(dp < mEnd);
-	while (dp>=dpBase) {
-		*dp-- = value & 0x01;
-		value >>= 1;
+	char *dp = mStart + writeIndex;
+	assert(dp+length <= mEnd);
+	// Whole octets first, then any leftover bits.
+	while (length>=8) {
+		length -= 8;
+		spreadOctet(value>>length,dp);
+		dp += 8;
+	}
+	while (length>0) {
+		length--;
+		*dp++ = (value>>length) & 0x01;
 	}
 }
 
 
 void BitVector::fillFieldReversed(size_t writeIndex, uint64_t value, unsigned length)
 {
-	char *dp = mStart + writeIndex;
-	char *dpEnd = dp + length - 1;
-	assert(dpEnd < mEnd);
-	while (dp<=dpEnd) {
-		*dp++ = value & 0x01;
-		value >>= 1;
-	}
+	if (length==0) return;
+	fillField(writeIndex,reverseBits64(value)>>(64-length),length);
 }
 
 
@@ -198,24 +239,6 @@ void BitVector::LSB8MSB()
 
 
 
-uint64_t BitVector::syndrome(Generator& gen) const
-{
-	gen.clear();
-	const char *dp = mStart;
-	while (dp<mEnd) gen.syndromeShift(*dp++);
-	return gen.state();
-}
-
-
-uint64_t BitVector::parity(Generator& gen) const
-{
-	gen.clear();
-	const char *dp = mStart;
-	while (dp<mEnd) gen.encoderShift(*dp++);
-	return gen.state();
-}
-
-
 void BitVector::encode(const ViterbiR2O4& coder, BitVector& target)
 {
 	size_t sz = size();
@@ -244,7 +267,15 @@ void BitVector::encode(const ViterbiR2O4& coder, BitVector& target)
 unsigned BitVector::sum() const
 {
 	unsigned sum = 0;
-	for (size_t i=0; i<size(); i++) sum += mStart[i] & 0x01;
+	const char *dp = mStart;
+	// Count 8 bits per word.
+	while (dp+8<=mEnd) {
+		uint64_t w;
+		memcpy(&w,dp,8);
+		sum += __builtin_popcountll(w & 0x0101010101010101ULL);
+		dp += 8;
+	}
+	while (dp<mEnd) sum += (*dp++) & 0x01;
 	return sum;
 }
 
@@ -271,6 +302,27 @@ void BitVector::unmap(const unsigned *map, size_t mapSize, BitVector& dest) cons
 
 
 
+void BitVector::operator^=(const BitVector& other)
+{
+	assert(other.size()==size());
+	char *dp = mStart;
+	const char *sp = other.mStart;
+	// XOR 8 bits per word.
+	while (dp+8<=mEnd) {
+		uint64_t a, b;
+		memcpy(&a,dp,8);
+		memcpy(&b,sp,8);
+		a ^= b;
+		memcpy(dp,&a,8);
+		dp += 8;
+		sp += 8;
+	}
+	while (dp<mEnd) *dp++ ^= *sp++;
+}
+
+
+
+
 
 
 
@@ -404,15 +456,136 @@ const ViterbiR2O4::vCand& ViterbiR2O4::step(uint32_t inSample, const float *prob
 }
 
 
+Parity::Parity(uint64_t wCoefficients, unsigned wParitySize, unsigned wCodewordSize)
+	:Generator(wCoefficients, wParitySize),
+	mCodewordSize(wCodewordSize)
+{
+	// Work left-justified in 64 bits so the same table code serves any parity size.
+	mAlignedCoeff = (wCoefficients & ((1ULL<<wParitySize)-1)) << (64-wParitySize);
+	for (unsigned octet=0; octet<256; octet++) {
+		uint64_t reg = ((uint64_t)octet) << 56;
+		for (unsigned i=0; i<8; i++) {
+			if (reg>>63) reg = (reg<<1) ^ mAlignedCoeff;
+			else reg <<= 1;
+		}
+		mTable[octet] = reg;
+	}
+}
+
+
+uint64_t Parity::shiftAligned(uint64_t reg, const BitVector& data) const
+{
+	const size_t sz = data.size();
+	size_t i=0;
+	// Octets, pulled from the vector a word at a time.
+	for (; i+64<=sz; i+=64) {
+		const uint64_t w = data.peekField(i,64);
+		for (int s=56; s>=0; s-=8) {
+			reg = (reg<<8) ^ mTable[((reg>>56) ^ (w>>s)) & 0x0ff];
+		}
+	}
+	for (; i+8<=sz; i+=8) {
+		reg = (reg<<8) ^ mTable[((reg>>56) ^ data.peekField(i,8)) & 0x0ff];
+	}
+	// Leftover bits.
+	for (; i<sz; i++) {
+		const bool fb = (reg>>63) ^ data.bit(i);
+		reg <<= 1;
+		if (fb) reg ^= mAlignedCoeff;
+	}
+	return reg;
+}
+
+
+uint64_t Parity::shiftAligned(uint64_t reg, const PackedBitVector& data, size_t span) const
+{
+	size_t i=0;
+	for (; i+64<=span; i+=64) {
+		const uint64_t w = data.peekField(i,64);
+		for (int s=56; s>=0; s-=8) {
+			reg = (reg<<8) ^ mTable[((reg>>56) ^ (w>>s)) & 0x0ff];
+		}
+	}
+	for (; i+8<=span; i+=8) {
+		reg = (reg<<8) ^ mTable[((reg>>56) ^ data.peekField(i,8)) & 0x0ff];
+	}
+	for (; i<span; i++) {
+		const bool fb = (reg>>63) ^ data.bit(i);
+		reg <<= 1;
+		if (fb) reg ^= mAlignedCoeff;
+	}
+	return reg;
+}
+
+
+uint64_t Parity::parity(const BitVector& data) const
+{
+	return shiftAligned(0,data) >> (64-size());
+}
+
+
+uint64_t Parity::parity(const PackedBitVector& data) const
+{
+	return shiftAligned(0,data,data.size()) >> (64-size());
+}
+
+
 uint64_t Parity::syndrome(const BitVector& receivedCodeword)
 {
-	return receivedCodeword.syndrome(*this);
+	// With c(x) = a(x)*x^n + b(x) and deg b < n, c mod g = (a*x^n mod g) + b.
+	// So the syndrome is the parity of the head XOR'd with the tail.
+	const size_t sz = receivedCodeword.size();
+	// A word shorter than the register never reaches the feedback tap.
+	if (sz<size()) return sz ? receivedCodeword.peekField(0,sz) : 0;
+	const size_t headLen = sz - size();
+	return parity(receivedCodeword.head(headLen)) ^ receivedCodeword.peekField(headLen,size());
+}
+
+
+uint64_t Parity::syndrome(const PackedBitVector& receivedCodeword)
+{
+	const size_t sz = receivedCodeword.size();
+	if (sz<size()) return sz ? receivedCodeword.peekField(0,sz) : 0;
+	const size_t headLen = sz - size();
+	const uint64_t head = shiftAligned(0,receivedCodeword,headLen) >> (64-size());
+	return head ^ receivedCodeword.peekField(headLen,size());
+}
+
+
+bool Parity::trapBurst(BitVector& receivedCodeword, unsigned maxBurst)
+{
+	assert(maxBurst<size());
+	uint64_t s = syndrome(receivedCodeword);
+	if (s==0) return true;
+	// The syndrome of a burst x^k*B(x) is x^k*B(x) mod g(x).
+	// Multiply by x^-1 mod g(x) until what is left fits in maxBurst bits;
+	// then the number of steps is k and the syndrome is B(x).
+	// g(0)==1, so division by x is a conditional XOR and a right shift.
+	const uint64_t g = (mAlignedCoeff >> (64-size())) | (1ULL << size());
+	const size_t sz = receivedCodeword.size();
+	for (size_t k=0; k<sz; k++) {
+		if ((s>>maxBurst)==0) {
+			// Make sure the burst lies inside the codeword.
+			for (unsigned t=0; t<maxBurst; t++) {
+				if (((s>>t) & 0x01)==0) continue;
+				if (k+t>=sz) return false;
+			}
+			// Bit index i carries the coefficient of x^(sz-1-i).
+			for (unsigned t=0; t<maxBurst; t++) {
+				if ((s>>t) & 0x01) receivedCodeword[sz-1-k-t] ^= 0x01;
+			}
+			return true;
+		}
+		if (s & 0x01) s ^= g;
+		s >>= 1;
+	}
+	return false;
 }
 
 
 void Parity::writeParityWord(const BitVector& data, BitVector& parityTarget, bool invert)
 {
-	uint64_t pWord = data.parity(*this);
+	uint64_t pWord = parity(data);
 	if (invert) pWord = ~pWord; 
 	parityTarget.fillField(0,pWord,size());
 }
@@ -545,7 +718,7 @@ void BitVector::pack(unsigned char* targ) const
 	// Assumes MSB-first packing.
 	unsigned bytes = size()/8;
 	for (unsigned i=0; i<bytes; i++) {
-		targ[i] = peekField(i*8,8);
+		targ[i] = gatherOctet(mStart+i*8);
 	}
 	unsigned whole = bytes*8;
 	unsigned rem = size() - whole;
@@ -559,7 +732,7 @@ void BitVector::unpack(const unsigned char* src)
 	// Assumes MSB-first packing.
 	unsigned bytes = size()/8;
 	for (unsigned i=0; i<bytes; i++) {
-		fillField(i*8,src[i],8);
+		spreadOctet(src[i],mStart+i*8);
 	}
 	unsigned whole = bytes*8;
 	unsigned rem = size() - whole;
@@ -600,4 +773,276 @@ bool BitVector::unhex(const char* src)
 	return true;
 }
 
+
+
+
+
+PackedBitVector::PackedBitVector(size_t wSize)
+	:mWords(NULL),mSize(0)
+{
+	resize(wSize);
+}
+
+
+PackedBitVector::PackedBitVector(const PackedBitVector& other)
+	:mWords(NULL),mSize(0)
+{
+	*this = other;
+}
+
+
+PackedBitVector::PackedBitVector(const BitVector& source)
+	:mWords(NULL),mSize(0)
+{
+	resize(source.size());
+	size_t i=0;
+	for (; i+64<=mSize; i+=64) mWords[i>>6] = source.peekField(i,64);
+	if (i<mSize) fillField(i,source.peekField(i,mSize-i),mSize-i);
+}
+
+
+PackedBitVector::PackedBitVector(const char* valString)
+	:mWords(NULL),mSize(0)
+{
+	resize(strlen(valString));
+	for (size_t i=0; i<mSize; i++) {
+		if (valString[i]=='1') setBit(i,true);
+	}
+}
+
+
+void PackedBitVector::operator=(const PackedBitVector& other)
+{
+	if (&other==this) return;
+	resize(other.mSize);
+	memcpy(mWords,other.mWords,words()*sizeof(uint64_t));
+}
+
+
+void PackedBitVector::operator=(PackedBitVector&& other)
+{
+	if (&other==this) return;
+	delete[] mWords;
+	mWords = other.mWords;
+	mSize = other.mSize;
+	other.mWords = NULL;
+	other.mSize = 0;
+}
+
+
+void PackedBitVector::resize(size_t newSize)
+{
+	delete[] mWords;
+	mSize = newSize;
+	mWords = NULL;
+	if (newSize==0) return;
+	mWords = new uint64_t[words()];
+	zero();
+}
+
+
+void PackedBitVector::zero()
+{
+	if (mWords) memset(mWords,0,words()*sizeof(uint64_t));
+}
+
+
+void PackedBitVector::invert()
+{
+	const size_t nw = words();
+	for (size_t i=0; i<nw; i++) mWords[i] = ~mWords[i];
+	// Keep the unused tail of the last word clear.
+	const unsigned rem = mSize & 0x3f;
+	if (rem) mWords[nw-1] &= ~0ULL << (64-rem);
+}
+
+
+void PackedBitVector::operator^=(const PackedBitVector& other)
+{
+	assert(other.mSize==mSize);
+	const size_t nw = words();
+	for (size_t i=0; i<nw; i++) mWords[i] ^= other.mWords[i];
+}
+
+
+
+uint64_t PackedBitVector::peekField(size_t readIndex, unsigned length) const
+{
+	assert(length<=64);
+	assert(readIndex+length <= mSize);
+	if (length==0) return 0;
+	const uint64_t *wp = mWords + (readIndex>>6);
+	const unsigned off = readIndex & 0x3f;
+	// Left-justify the field, pulling from the next word if it straddles.
+	uint64_t accum = wp[0] << off;
+	if (off+length > 64) accum |= wp[1] >> (64-off);
+	return accum >> (64-length);
+}
+
+
+uint64_t PackedBitVector::peekFieldReversed(size_t readIndex, unsigned length) const
+{
+	if (length==0) return 0;
+	return reverseBits64(peekField(readIndex,length)) >> (64-length);
+}
+
+
+uint64_t PackedBitVector::readField(size_t& readIndex, unsigned length) const
+{
+	const uint64_t retVal = peekField(readIndex,length);
+	readIndex += length;
+	return retVal;
+}
+
+
+uint64_t PackedBitVector::readFieldReversed(size_t& readIndex, unsigned length) const
+{
+	const uint64_t retVal = peekFieldReversed(readIndex,length);
+	readIndex += length;
+	return retVal;
+}
+
+
+void PackedBitVector::fillField(size_t writeIndex, uint64_t value, unsigned length)
+{
+	assert(length<=64);
+	assert(writeIndex+length <= mSize);
+	if (length==0) return;
+	uint64_t *wp = mWords + (writeIndex>>6);
+	const unsigned off = writeIndex & 0x3f;
+	// Left-justify the field and its mask, then merge into one or two words.
+	const uint64_t mask = ~0ULL << (64-length);
+	const uint64_t field = (value << (64-length)) & mask;
+	wp[0] = (wp[0] & ~(mask>>off)) | (field>>off);
+	if (off+length > 64) {
+		wp[1] = (wp[1] & ~(mask<<(64-off))) | (field<<(64-off));
+	}
+}
+
+
+void PackedBitVector::fillFieldReversed(size_t writeIndex, uint64_t value, unsigned length)
+{
+	if (length==0) return;
+	fillField(writeIndex,reverseBits64(value)>>(64-length),length);
+}
+
+
+void PackedBitVector::writeField(size_t& writeIndex, uint64_t value, unsigned length)
+{
+	fillField(writeIndex,value,length);
+	writeIndex += length;
+}
+
+
+void PackedBitVector::writeFieldReversed(size_t& writeIndex, uint64_t value, unsigned length)
+{
+	fillFieldReversed(writeIndex,value,length);
+	writeIndex += length;
+}
+
+
+
+void PackedBitVector::copyToSegment(PackedBitVector& other, size_t start, size_t span) const
+{
+	assert(span<=mSize);
+	assert(start+span<=other.mSize);
+	size_t i=0;
+	for (; i+64<=span; i+=64) other.fillField(start+i,peekField(i,64),64);
+	if (i<span) other.fillField(start+i,peekField(i,span-i),span-i);
+}
+
+
+void PackedBitVector::copyToSegment(BitVector& other, size_t start, size_t span) const
+{
+	assert(span<=mSize);
+	assert(start+span<=other.size());
+	size_t i=0;
+	for (; i+64<=span; i+=64) other.fillField(start+i,peekField(i,64),64);
+	if (i<span) other.fillField(start+i,peekField(i,span-i),span-i);
+}
+
+
+BitVector PackedBitVector::unpacked() const
+{
+	BitVector retVal(mSize);
+	copyToSegment(retVal,0);
+	return retVal;
+}
+
+
+
+unsigned PackedBitVector::sum() const
+{
+	// The tail of the last word is always clear.
+	unsigned sum = 0;
+	const size_t nw = words();
+	for (size_t i=0; i<nw; i++) sum += __builtin_popcountll(mWords[i]);
+	return sum;
+}
+
+
+void PackedBitVector::map(const unsigned *map, size_t mapSize, PackedBitVector& dest) const
+{
+	for (unsigned i=0; i<mapSize; i++) {
+		dest.setBit(i,bit(map[i]));
+	}
+}
+
+
+void PackedBitVector::unmap(const unsigned *map, size_t mapSize, PackedBitVector& dest) const
+{
+	for (unsigned i=0; i<mapSize; i++) {
+		dest.setBit(map[i],bit(i));
+	}
+}
+
+
+
+void PackedBitVector::pack(unsigned char* targ) const
+{
+	// Assumes MSB-first packing.
+	// A partial last byte comes out left-justified because the word tail is clear.
+	const size_t bytes = (mSize+7)/8;
+	for (size_t i=0; i<bytes; i++) {
+		targ[i] = mWords[i>>3] >> (56 - 8*(i&0x07));
+	}
+}
+
+
+void PackedBitVector::unpack(const unsigned char* src)
+{
+	// Assumes MSB-first packing.
+	const size_t bytes = (mSize+7)/8;
+	zero();
+	for (size_t i=0; i<bytes; i++) {
+		mWords[i>>3] |= ((uint64_t)src[i]) << (56 - 8*(i&0x07));
+	}
+	const unsigned rem = mSize & 0x3f;
+	if (rem) mWords[words()-1] &= ~0ULL << (64-rem);
+}
+
+
+void PackedBitVector::hex(ostream& os) const
+{
+	os << std::hex;
+	unsigned digits = size()/4;
+	size_t wp=0;
+	for (unsigned i=0; i<digits; i++) {
+		os << readField(wp,4);
+	}
+	os << std::dec;
+}
+
+
+ostream& operator<<(ostream& os, const PackedBitVector& pv)
+{
+	for (size_t i=0; i<pv.size(); i++) {
+		if (pv.bit(i)) os << '1';
+		else os << '0';
+	}
+	return os;
+}
+
+
+
 // vim: ts=4 sw=4
@@ -31,6 +31,7 @@
 
 
 class BitVector;
+class PackedBitVector;
 class SoftVector;
 
 
@@ -90,25 +91,52 @@ class Generator {
 
 
 
-/** Parity (CRC-type) generator and checker based on a Generator. */
+/**
+	Parity (CRC-type) generator and checker based on a Generator.
+	The block operations are table-driven, 8 bits per step,
+	and give the same results as shifting the Generator one bit at a time.
+*/
 class Parity : public Generator {
 
 	protected:
 
 	unsigned mCodewordSize;
+	uint64_t mAlignedCoeff;		///< coefficients without the top term, left-justified in 64 bits
+	uint64_t mTable[256];		///< left-justified parity of each octet
+
+	/** Run the left-justified parity register over a block of bits. */
+	uint64_t shiftAligned(uint64_t reg, const BitVector& data) const;
+
+	/** Run the left-justified parity register over a block of packed bits. */
+	uint64_t shiftAligned(uint64_t reg, const PackedBitVector& data, size_t span) const;
 
 	public:
 
-	Parity(uint64_t wCoefficients, unsigned wParitySize, unsigned wCodewordSize)
-		:Generator(wCoefficients, wParitySize),
-		mCodewordSize(wCodewordSize)
-	{ }
+	Parity(uint64_t wCoefficients, unsigned wParitySize, unsigned wCodewordSize);
 
 	/** Compute the parity word and write it into the target segment.  */
 	void writeParityWord(const BitVector& data, BitVector& parityWordTarget, bool invert=true);
 
+	/** Compute the parity word of a data sequence, not inverted. */
+	uint64_t parity(const BitVector& data) const;
+
+	/** Compute the parity word of a packed data sequence, not inverted. */
+	uint64_t parity(const PackedBitVector& data) const;
+
 	/** Compute the syndrome of a received sequence. */
 	uint64_t syndrome(const BitVector& receivedCodeword);
+
+	/** Compute the syndrome of a packed received sequence. */
+	uint64_t syndrome(const PackedBitVector& receivedCodeword);
+
+	/**
+		Correct a single error burst in a received codeword by error trapping.
+		This is the burst-correcting mode of the Fire code, GSM 05.03 4.1.2.
+		@param receivedCodeword The codeword, corrected in place on success.
+		@param maxBurst The longest error burst to correct, in bits.
+		@return true if the codeword is (now) valid.
+	*/
+	bool trapBurst(BitVector& receivedCodeword, unsigned maxBurst);
 };
 
 
@@ -241,6 +269,7 @@ class BitVector : public Vector<char> {
 	BitVector(size_t len=0):Vector<char>(len) {}
 	BitVector(const Vector<char>& source):Vector<char>(source) {}
 	BitVector(Vector<char>& source):Vector<char>(source) {}
+	BitVector(Vector<char>&& source):Vector<char>(std::move(source)) {}
 	BitVector(const Vector<char>& source1, const Vector<char> source2):Vector<char>(source1,source2) {}
 	//@}
 
@@ -284,10 +313,6 @@ class BitVector : public Vector<char> {
 
 	/**@name FEC operations. */
 	//@{
-	/** Calculate the syndrome of the vector with the given Generator. */
-	uint64_t syndrome(Generator& gen) const;
-	/** Calculate the parity word for the vector with the given Generator. */
-	uint64_t parity(Generator& gen) const;
 	/** Encode the signal with the GSM rate 1/2 convolutional encoder. */
 	void encode(const ViterbiR2O4& encoder, BitVector& target);
 	//@}
@@ -325,6 +350,9 @@ class BitVector : public Vector<char> {
 	/** Reorder bits, dest[map[i]] = this[i]. */
 	void unmap(const unsigned *map, size_t mapSize, BitVector& dest) const;
 
+	/** XOR another vector of the same size into this one. */
+	void operator^=(const BitVector& other);
+
 	/** Pack into a char array. */
 	void pack(unsigned char*) const;
 
@@ -347,6 +375,142 @@ std::ostream& operator<<(std::ostream&, const BitVector&);
 
 
 
+/**
+	A bit vector packed 64 bits to a word, MSB-first.
+	This is a companion to BitVector for long-lived buffers and queued frames,
+	where the one-bit-per-byte BitVector is 8x larger than needed.
+	Field, copy, parity and reordering operations work on whole words.
+	Unlike BitVector, this class does not support aliased segments.
+*/
+class PackedBitVector {
+
+	protected:
+
+	uint64_t *mWords;		///< packed data, bit 0 is the MSB of mWords[0]
+	size_t mSize;			///< number of bits
+
+	/** Number of words needed to hold a given number of bits. */
+	static size_t wordsFor(size_t bits) { return (bits+63)/64; }
+
+	public:
+
+	/**@name Constructors. */
+	//@{
+	PackedBitVector(size_t wSize=0);
+
+	PackedBitVector(const PackedBitVector& other);
+
+	/** Take the words of a temporary, leaving it empty. */
+	PackedBitVector(PackedBitVector&& other)
+		:mWords(other.mWords),mSize(other.mSize)
+	{ other.mWords=NULL; other.mSize=0; }
+
+	/** Pack a BitVector. */
+	PackedBitVector(const BitVector& source);
+
+	/** Construct from a string of "0" and "1". */
+	PackedBitVector(const char* valString);
+	//@}
+
+	~PackedBitVector() { delete[] mWords; }
+
+	void operator=(const PackedBitVector& other);
+
+	void operator=(PackedBitVector&& other);
+
+	/** Change the size, discarding content. */
+	void resize(size_t newSize);
+
+	size_t size() const { return mSize; }
+
+	/** Number of words in use. */
+	size_t words() const { return wordsFor(mSize); }
+
+	/** Index a single bit. */
+	bool bit(size_t index) const
+	{
+		// We put this code in .h for fast inlining.
+		assert(index<mSize);
+		return (mWords[index>>6] >> (63-(index&0x3f))) & 0x01;
+	}
+
+	/** Set a single bit. */
+	void setBit(size_t index, bool val)
+	{
+		assert(index<mSize);
+		const uint64_t mask = 1ULL << (63-(index&0x3f));
+		if (val) mWords[index>>6] |= mask;
+		else mWords[index>>6] &= ~mask;
+	}
+
+	void zero();
+
+	/** Invert 0<->1. */
+	void invert();
+
+	/** XOR another vector of the same size into this one. */
+	void operator^=(const PackedBitVector& other);
+
+	/**@name Serialization and deserialization. */
+	//@{
+	uint64_t peekField(size_t readIndex, unsigned length) const;
+	uint64_t peekFieldReversed(size_t readIndex, unsigned length) const;
+	uint64_t readField(size_t& readIndex, unsigned length) const;
+	uint64_t readFieldReversed(size_t& readIndex, unsigned length) const;
+	void fillField(size_t writeIndex, uint64_t value, unsigned length);
+	void fillFieldReversed(size_t writeIndex, uint64_t value, unsigned length);
+	void writeField(size_t& writeIndex, uint64_t value, unsigned length);
+	void writeFieldReversed(size_t& writeIndex, uint64_t value, unsigned length);
+	//@}
+
+	/**
+		Copy part of this vector to a segment of another.
+		@param other The other vector.
+		@param start The start point in the other vector.
+		@param span The number of bits to copy.
+	*/
+	void copyToSegment(PackedBitVector& other, size_t start, size_t span) const;
+
+	/** Copy all of this vector to a segment of another. */
+	void copyToSegment(PackedBitVector& other, size_t start=0) const
+		{ copyToSegment(other,start,size()); }
+
+	/** Unpack a span of this vector into a segment of a BitVector. */
+	void copyToSegment(BitVector& other, size_t start, size_t span) const;
+
+	/** Unpack all of this vector into a segment of a BitVector. */
+	void copyToSegment(BitVector& other, size_t start=0) const
+		{ copyToSegment(other,start,size()); }
+
+	/** Return an unpacked copy. */
+	BitVector unpacked() const;
+
+	/** Sum of bits. */
+	unsigned sum() const;
+
+	/** Reorder bits, dest[i] = this[map[i]]. */
+	void map(const unsigned *map, size_t mapSize, PackedBitVector& dest) const;
+
+	/** Reorder bits, dest[map[i]] = this[i]. */
+	void unmap(const unsigned *map, size_t mapSize, PackedBitVector& dest) const;
+
+	/** Pack into a char array. */
+	void pack(unsigned char*) const;
+
+	/** Unpack from a char array. */
+	void unpack(const unsigned char*);
+
+	/** Make a hexdump string. */
+	void hex(std::ostream&) const;
+
+};
+
+
+std::ostream& operator<<(std::ostream&, const PackedBitVector&);
+
+
+
+
 
 
 /**
@@ -27,12 +27,30 @@
 
 
 #include "BitVector.h"
+#include "Timeval.h"
 #include <iostream>
 #include <cstdlib>
  
 using namespace std;
 
 
+/** Bit-serial reference for the table-driven Parity engine. */
+static uint64_t serialParity(Generator& gen, const BitVector& data)
+{
+	gen.clear();
+	for (size_t i=0; i<data.size(); i++) gen.encoderShift(data.bit(i));
+	return gen.state();
+}
+
+/** Bit-serial reference for Parity::syndrome. */
+static uint64_t serialSyndrome(Generator& gen, const BitVector& data)
+{
+	gen.clear();
+	for (size_t i=0; i<data.size(); i++) gen.syndromeShift(data.bit(i));
+	return gen.state();
+}
+
+
 int main(int argc, char *argv[])
 {
 	BitVector v1("0000111100111100101011110000");
@@ -85,4 +103,47 @@ int main(int argc, char *argv[])
 	cout << "tp=" << tp << endl;
 	tp.pack(ts);
 	cout << "ts=" << ts << endl;
+
+	PackedBitVector pv(mC);
+	cout << "pv=" << pv << endl;
+	cout << "pv matches mC " << (pv.unpacked().peekField(100,64)==mC.peekField(100,64)) << endl;
+	cout << "pv.sum()=" << pv.sum() << " mC.sum()=" << mC.sum() << endl;
+	pv.fillField(61,0x123456789abcdefULL,60);
+	cout << hex << pv.peekField(61,60) << dec << endl;
+	PackedBitVector pt(70);
+	pt.unpack(ts);
+	cout << "pt=" << pt << endl;
+	PackedBitVector pw(pt);
+	pw.invert();
+	pw ^= pt;
+	cout << "pw.sum()=" << pw.sum() << endl;
+
+	// Fire code, GSM 05.03 4.1.2: table-driven vs. bitwise parity.
+	Parity fire(0x10004820009ULL,40,224);
+	BitVector fd(184);
+	for (unsigned i=0; i<fd.size(); i++) fd[i] = random() & 0x01;
+	BitVector fc(224);
+	fd.copyToSegment(fc,0);
+	BitVector fp = fc.tail(184);
+	fire.writeParityWord(fd,fp,false);
+	cout << "fire parity " << hex << fire.parity(fd) << " " << serialParity(fire,fd) << dec << endl;
+	cout << "fire syndrome " << fire.syndrome(fc) << " " << serialSyndrome(fire,fc) << endl;
+	BitVector fs = fd.head(20);
+	PackedBitVector fsp(fs);
+	cout << "fire short syndrome " << fire.syndrome(fs) << " " << fire.syndrome(fsp)
+		<< " " << serialSyndrome(fire,fs) << endl;
+	BitVector fe(fc);
+	for (unsigned i=100; i<112; i++) fe[i] = !fe[i];
+	cout << "fire burst trapped " << fire.trapBurst(fe,12) << " syndrome " << fire.syndrome(fe) << endl;
+
+	const unsigned blocks = 100000;
+	uint64_t accum = 0;
+	Timeval start;
+	for (unsigned i=0; i<blocks; i++) accum ^= serialParity(fire,fd);
+	long bitwise = start.elapsed();
+	start.now();
+	for (unsigned i=0; i<blocks; i++) accum ^= fire.parity(fd);
+	long table = start.elapsed();
+	cout << "fire parity per block: bitwise " << bitwise*1000.0F/blocks
+		<< " us, table " << table*1000.0F/blocks << " us (" << accum << ")" << endl;
 }
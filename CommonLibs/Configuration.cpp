@@ -58,6 +58,7 @@ float ConfigurationRecord::floatNumber() const
 
 
 ConfigurationTable::ConfigurationTable(const char* filename, const char *wCmdName)
+	:mGeneration(1)
 {
 	gLogEarly(LOG_INFO, "opening configuration table from path %s", filename);
 	// Connect to the database.
@@ -320,9 +321,11 @@ bool ConfigurationTable::unset(const string& key)
 	// Clear the cache entry and the database.
 	ConfigurationMap::iterator where = mCache.find(key);
 	if (where!=mCache.end()) mCache.erase(where);
+	bumpGeneration();
 	// Don't delete it; just set VALUESTRING to NULL.
-	string cmd = "UPDATE CONFIG SET VALUESTRING=NULL WHERE KEYSTRING=='"+key+"'";
-	return sqlite3_command(mDB,cmd.c_str());
+	SQLiteQuery update(mDB,"UPDATE CONFIG SET VALUESTRING=NULL WHERE KEYSTRING==?");
+	update.bind(1,key.c_str());
+	return update.run();
 }
 
 bool ConfigurationTable::remove(const string& key)
@@ -334,9 +337,11 @@ bool ConfigurationTable::remove(const string& key)
 	// Clear the cache entry and the database.
 	ConfigurationMap::iterator where = mCache.find(key);
 	if (where!=mCache.end()) mCache.erase(where);
+	bumpGeneration();
 	// Really remove it.
-	string cmd = "DELETE FROM CONFIG WHERE KEYSTRING=='"+key+"'";
-	return sqlite3_command(mDB,cmd.c_str());
+	SQLiteQuery remove(mDB,"DELETE FROM CONFIG WHERE KEYSTRING==?");
+	remove.bind(1,key.c_str());
+	return remove.run();
 }
 
 
@@ -344,19 +349,20 @@ bool ConfigurationTable::remove(const string& key)
 void ConfigurationTable::find(const string& pat, ostream& os) const
 {
 	// Prepare the statement.
-	string cmd = "SELECT KEYSTRING,VALUESTRING FROM CONFIG WHERE KEYSTRING LIKE \"%" + pat + "%\"";
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(mDB,&stmt,cmd.c_str())) return;
+	SQLiteQuery query(mDB,"SELECT KEYSTRING,VALUESTRING FROM CONFIG WHERE KEYSTRING LIKE ?");
+	if (!query.valid()) return;
+	string like = "%" + pat + "%";
+	query.bind(1,like.c_str());
 	// Read the result.
-	int src = sqlite3_run_query(mDB,stmt);
+	sqlite3_stmt *stmt = query.stmt();
+	int src = query.step();
 	while (src==SQLITE_ROW) {
 		const char* value = (const char*)sqlite3_column_text(stmt,1);
 		os << sqlite3_column_text(stmt,0) << " ";
 		if (value) os << value << endl;
 		else os << "(null)" << endl;
-		src = sqlite3_run_query(mDB,stmt);
+		src = query.step();
 	}
-	sqlite3_finalize(stmt);
 }
 
 
@@ -364,10 +370,13 @@ bool ConfigurationTable::set(const string& key, const string& value)
 {
 	assert(mDB);
 	ScopedLock lock(mLock);
-	string cmd = "INSERT OR REPLACE INTO CONFIG (KEYSTRING,VALUESTRING,OPTIONAL) VALUES (\"" + key + "\",\"" + value + "\",1)";
-	bool success = sqlite3_command(mDB,cmd.c_str());
+	SQLiteQuery insert(mDB,"INSERT OR REPLACE INTO CONFIG (KEYSTRING,VALUESTRING,OPTIONAL) VALUES (?,?,1)");
+	insert.bind(1,key.c_str());
+	insert.bind(2,value.c_str());
+	bool success = insert.run();
 	// Cache the result.
 	if (success) mCache[key] = ConfigurationRecord(value);
+	bumpGeneration();
 	return success;
 }
 
@@ -383,9 +392,11 @@ bool ConfigurationTable::set(const string& key)
 {
 	assert(mDB);
 	ScopedLock lock(mLock);
-	string cmd = "INSERT OR REPLACE INTO CONFIG (KEYSTRING,VALUESTRING,OPTIONAL) VALUES (\"" + key + "\",NULL,1)";
-	bool success = sqlite3_command(mDB,cmd.c_str());
+	SQLiteQuery insert(mDB,"INSERT OR REPLACE INTO CONFIG (KEYSTRING,VALUESTRING,OPTIONAL) VALUES (?,NULL,1)");
+	insert.bind(1,key.c_str());
+	bool success = insert.run();
 	if (success) mCache[key] = ConfigurationRecord(true);
+	bumpGeneration();
 	return success;
 }
 
@@ -406,6 +417,7 @@ void ConfigurationTable::checkCacheAge()
 		mp++;
 		mCache.erase(prev);
 	}
+	bumpGeneration();
 }
 
 
@@ -418,6 +430,15 @@ void ConfigurationTable::purge()
 		mp++;
 		mCache.erase(prev);
 	}
+	bumpGeneration();
+}
+
+
+void ConfigurationTable::bumpGeneration()
+{
+	// Skip 0, which clients can use to mean "nothing cached".
+	if (__atomic_add_fetch(&mGeneration,1,__ATOMIC_RELEASE)==0)
+		__atomic_add_fetch(&mGeneration,1,__ATOMIC_RELEASE);
 }
 
 
@@ -441,6 +462,41 @@ void HashString::computeHash()
 }
 
 
+template<> bool ConfigKey<long>::fetch(long& value)
+{
+	if (!mTable.defines(mKey)) return false;
+	try {
+		value = mTable.getNum(mKey);
+		return true;
+	} catch (ConfigurationTableKeyNotFound) {
+		// unset between the two calls
+		return false;
+	}
+}
+
+
+template<> bool ConfigKey<bool>::fetch(bool& value)
+{
+	if (!mTable.defines(mKey)) return false;
+	// getBool already treats an unset race as false.
+	value = mTable.getBool(mKey);
+	return true;
+}
+
+
+template<> bool ConfigKey<std::string>::fetch(std::string& value)
+{
+	if (!mTable.defines(mKey)) return false;
+	try {
+		value = mTable.getStr(mKey);
+		return true;
+	} catch (ConfigurationTableKeyNotFound) {
+		return false;
+	}
+}
+
+
+
 void SimpleKeyValue::addItem(const char* pair_orig)
 {
 	char *pair = strdup(pair_orig);
@@ -40,6 +40,7 @@
 #include <iostream>
 
 #include <Threads.h>
+#include <Timeval.h>
 #include <stdint.h>
 
 
@@ -180,12 +181,21 @@ class ConfigurationTable {
 	sqlite3* mDB;				///< database connection
 	ConfigurationMap mCache;	///< cache of recently access configuration values
 	mutable Mutex mLock;		///< control for multithreaded access to the cache
+	volatile unsigned mGeneration;	///< bumped whenever a cached value may have gone stale
 
 	public:
 
 
 	ConfigurationTable(const char* filename = ":memory:", const char *wCmdName = 0);
 
+	/**
+		Return the cache generation.
+		It changes on every set, unset or cache purge, so clients can cache
+		values derived from the table and check them with a single load.
+		Never 0 for a constructed table.
+	*/
+	unsigned generation() const { return __atomic_load_n(&mGeneration,__ATOMIC_ACQUIRE); }
+
 	/** Return true if the key is used in the table.  */
 	bool defines(const std::string& key);
 
@@ -299,9 +309,148 @@ class ConfigurationTable {
 	*/
 	const ConfigurationRecord& lookup(const std::string& key);
 
+	/** Invalidate values cached by clients; see generation(). */
+	void bumpGeneration();
+
 };
 
 
+/**
+	A typed, precompiled handle to one configuration key.
+	The value is fetched once per table generation into an immutable snapshot,
+	so the fast path is two loads and a compare with no lock and no map lookup.
+	Snapshots are published RCU-style: readers never block, and a replaced snapshot
+	is freed by a later refresh once it has been retired for sGraceSeconds.
+	So a reference from value() is good until then; keep a copy to hold it longer.
+	Reading a handle never defines a missing key; it yields the default and defined() is false.
+	Specialized for long, bool (nonzero is true, as getBool) and std::string.
+*/
+template <class T> class ConfigKey {
+
+	private:
+
+	/** How long a replaced snapshot stays readable before it is freed. */
+	static const unsigned sGraceSeconds = 10;
+
+	struct Snapshot {
+		T mValue;
+		bool mDefined;
+		unsigned mVersion;		///< 0 for the initial default, then counts changes
+		Snapshot* mRetired;		///< the snapshot this one replaced, until freed
+		Timeval mPublished;		///< when this snapshot replaced mRetired
+		Snapshot(const T& wValue, bool wDefined, Snapshot* wRetired)
+			:mValue(wValue),mDefined(wDefined),
+			mVersion(wRetired ? wRetired->mVersion+1 : 0),
+			mRetired(wRetired)
+		{ }
+	};
+
+	ConfigurationTable& mTable;
+	const std::string mKey;
+	const T mDefault;
+	Snapshot* volatile mSnapshot;		///< current snapshot, never NULL
+	volatile unsigned mGeneration;		///< table generation of mSnapshot, 0 if never fetched
+	Mutex mRefreshLock;					///< serializes refreshes, not readers
+
+	/** Fetch the current value from the table; return false if the key is not defined. */
+	bool fetch(T& value);
+
+	/** Re-read the table and publish a new snapshot if the value changed. */
+	void refresh()
+	{
+		ScopedLock lock(mRefreshLock);
+		// Read the generation before the value, so a racing change forces another refresh.
+		unsigned gen = mTable.generation();
+		if (gen==mGeneration) return;
+		T value = mDefault;
+		bool defined = fetch(value);
+		Snapshot* current = mSnapshot;
+		if (defined!=current->mDefined || !(value==current->mValue)) {
+			current = new Snapshot(value,defined,current);
+			__atomic_store_n(&mSnapshot,current,__ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&mGeneration,gen,__ATOMIC_RELEASE);
+		reclaim(current);
+	}
+
+	/**
+		Free the retired snapshots that no reader can still hold.
+		A snapshot's successor records when it was retired; everything past
+		the first one retired more than sGraceSeconds ago is older still.
+		Caller must hold mRefreshLock.
+	*/
+	void reclaim(Snapshot* current)
+	{
+		Snapshot* successor = current;
+		while (successor->mRetired) {
+			if (successor->mPublished.elapsed() < 1000*(long)sGraceSeconds) {
+				successor = successor->mRetired;
+				continue;
+			}
+			freeChain(successor->mRetired);
+			successor->mRetired = NULL;
+			break;
+		}
+	}
+
+	/** Delete a snapshot and everything it replaced. */
+	static void freeChain(Snapshot* snap)
+	{
+		while (snap) {
+			Snapshot* next = snap->mRetired;
+			delete snap;
+			snap = next;
+		}
+	}
+
+	/** Return the current snapshot, refreshing it first if the table changed. */
+	const Snapshot* snapshot()
+	{
+		if (mTable.generation()!=__atomic_load_n(&mGeneration,__ATOMIC_ACQUIRE)) refresh();
+		return __atomic_load_n(&mSnapshot,__ATOMIC_ACQUIRE);
+	}
+
+	public:
+
+	ConfigKey(ConfigurationTable& wTable, const char* wKey, const T& wDefault)
+		:mTable(wTable),mKey(wKey),mDefault(wDefault),
+		mSnapshot(new Snapshot(wDefault,false,NULL)),
+		mGeneration(0)
+	{ }
+
+	~ConfigKey() { freeChain(mSnapshot); }
+
+	const std::string& key() const { return mKey; }
+
+	/** The current value, or the default if the key is not defined. */
+	const T& value() { return snapshot()->mValue; }
+
+	operator const T&() { return value(); }
+
+	/** Return true if the key is defined in the table. */
+	bool defined() { return snapshot()->mDefined; }
+
+	/**
+		Return true if the value changed since the caller's last version, and update that version.
+		Lets a caller redo work derived from the value only when needed.
+		Start lastVersion at 0, which matches the default.
+	*/
+	bool changed(unsigned& lastVersion)
+	{
+		unsigned version = snapshot()->mVersion;
+		if (version==lastVersion) return false;
+		lastVersion = version;
+		return true;
+	}
+
+};
+
+template<> bool ConfigKey<long>::fetch(long& value);
+template<> bool ConfigKey<bool>::fetch(bool& value);
+template<> bool ConfigKey<std::string>::fetch(std::string& value);
+
+
+
 typedef std::map<HashString, std::string> HashStringMap;
 
 class SimpleKeyValue {
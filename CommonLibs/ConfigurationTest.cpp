@@ -101,6 +101,18 @@ int main(int argc, char *argv[])
 	cout << "search fkey:" << endl;
 	gConfig.find("fkey",cout);
 
+	ConfigKey<long> handle(gConfig,"handlekey",7);
+	unsigned version = 0;
+	cout << "handle " << handle.value() << " defined " << handle.defined() << endl;
+	gConfig.set("handlekey",8);
+	cout << "handle " << handle.value() << " defined " << handle.defined() << " changed " << handle.changed(version) << endl;
+	gConfig.set("key2",20);
+	cout << "handle " << handle.value() << " changed " << handle.changed(version) << endl;
+	gConfig.unset("handlekey");
+	cout << "handle " << handle.value() << " defined " << handle.defined() << endl;
+	ConfigKey<string> shandle(gConfig,"newstring","");
+	cout << "string handle " << shandle.value() << endl;
+
 	try {
 		gConfig.getNum("supposedtoabort");
 	} catch (ConfigurationTableKeyNotFound) {
@@ -132,6 +132,124 @@ template <class T> class InterthreadQueue {
 
 
 
+/**
+	Lock-free pointer FIFO for interthread operations.
+	Same API as InterthreadQueue, but readers only block (on a futex) when the FIFO is empty.
+	FIFO is SPSCPointerFIFO or MPSCPointerFIFO; either way there is one reader thread,
+	and clear() and flushNoDelete() belong to it.
+*/
+template <class T, class FIFO> class LockFreeInterthreadQueue {
+
+	protected:
+
+	FIFO mQ;
+	mutable FutexSignal mWriteSignal;
+
+	/**
+		Poll the FIFO briefly before parking, since a wakeup costs a system call on each side.
+		Polling only helps when the writer can run at the same time.
+	*/
+	T* spin()
+	{
+		static const unsigned spins = (sysconf(_SC_NPROCESSORS_ONLN)>1) ? 1000 : 1;
+		for (unsigned i=0; i<spins; i++) {
+			T* retVal = (T*)mQ.get();
+			if (retVal!=NULL) return retVal;
+		}
+		return NULL;
+	}
+
+	public:
+
+	/** Delete contents. */
+	void clear()
+	{
+		while (T* val = (T*)mQ.get()) delete val;
+	}
+
+	/** Empty the queue, but don't delete. */
+	void flushNoDelete()
+	{
+		while (mQ.get()) {}
+	}
+
+
+	~LockFreeInterthreadQueue()
+		{ clear(); }
+
+
+	size_t size() const { return mQ.size(); }
+
+	/**
+		Blocking read.
+		@return Pointer to object (will not be NULL).
+	*/
+	T* read()
+	{
+		T* retVal = spin();
+		while (retVal==NULL) {
+			int seq = mWriteSignal.prepareWait();
+			retVal = (T*)mQ.get();
+			if (retVal!=NULL) {
+				mWriteSignal.cancelWait();
+				break;
+			}
+			mWriteSignal.wait(seq);
+			retVal = (T*)mQ.get();
+		}
+		return retVal;
+	}
+
+	/**
+		Blocking read with a timeout.
+		@param timeout The read timeout in ms.
+		@return Pointer to object or NULL on timeout.
+	*/
+	T* read(unsigned timeout)
+	{
+		if (timeout==0) return readNoBlock();
+		Timeval waitTime(timeout);
+		T* retVal = (T*)mQ.get();
+		while ((retVal==NULL) && (!waitTime.passed())) {
+			int seq = mWriteSignal.prepareWait();
+			retVal = (T*)mQ.get();
+			if (retVal!=NULL) {
+				mWriteSignal.cancelWait();
+				break;
+			}
+			mWriteSignal.wait(seq,waitTime.remaining());
+			retVal = (T*)mQ.get();
+		}
+		return retVal;
+	}
+
+	/**
+		Non-blocking read.
+		@return Pointer to object or NULL if FIFO is empty.
+	*/
+	T* readNoBlock()
+	{
+		return (T*)mQ.get();
+	}
+
+	/** Non-blocking write. */
+	void write(T* val)
+	{
+		mQ.put(val);
+		mWriteSignal.signal();
+	}
+
+};
+
+
+/** Lock-free interthread queue for one writer thread and one reader thread. */
+template <class T> class SPSCInterthreadQueue : public LockFreeInterthreadQueue<T,SPSCPointerFIFO> {};
+
+/** Lock-free interthread queue for any number of writer threads and one reader thread. */
+template <class T> class MPSCInterthreadQueue : public LockFreeInterthreadQueue<T,MPSCPointerFIFO> {};
+
+
+
 /** Pointer FIFO for interthread operations.  */
 template <class T> class InterthreadQueueWithWait {
 
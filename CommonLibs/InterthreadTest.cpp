@@ -80,7 +80,7 @@ void* mapWriter(void*)
 void* mapReader(void*)
 {
 	for (int i=0; i<20; i++) {
-		int *p = gMap.read(i);
+		int *p = gMap.get(i);
 		COUT("map read " << *p);
 		delete p;
 	}
@@ -90,6 +90,118 @@ void* mapReader(void*)
 
 
 
+// Throughput and wake latency benchmarks for the queue variants.
+
+static const unsigned gBenchCount = 200000;
+static const unsigned gPingCount = 10000;
+static int gBenchItem = 0;
+static int gBenchStop = -1;
+
+template <class Q> struct BenchQueues {
+	Q mQ;
+	Q mReply;
+	unsigned mWriters;
+};
+
+template <class Q> void* benchWriter(void* arg)
+{
+	BenchQueues<Q>* qs = (BenchQueues<Q>*)arg;
+	for (unsigned i=0; i<gBenchCount/qs->mWriters; i++) qs->mQ.write(&gBenchItem);
+	qs->mQ.write(&gBenchStop);
+	return NULL;
+}
+
+template <class Q> void* benchEcho(void* arg)
+{
+	BenchQueues<Q>* qs = (BenchQueues<Q>*)arg;
+	for (unsigned i=0; i<gPingCount; i++) qs->mReply.write(qs->mQ.read());
+	return NULL;
+}
+
+template <class Q> void benchmark(const char* name, unsigned writers)
+{
+	BenchQueues<Q> qs;
+	qs.mWriters = writers;
+
+	// Throughput: writers stream into the queue, one reader drains it.
+	Timeval start;
+	// Thread must be started before it is destroyed.
+	Thread *writerThreads = new Thread[writers];
+	for (unsigned i=0; i<writers; i++) writerThreads[i].start(benchWriter<Q>,&qs);
+	unsigned stops = 0;
+	unsigned count = 0;
+	while (stops<writers) {
+		if (qs.mQ.read()==&gBenchStop) stops++;
+		else count++;
+	}
+	long elapsed = start.elapsed();
+	for (unsigned i=0; i<writers; i++) writerThreads[i].join();
+	delete[] writerThreads;
+
+	// Wake latency: ping-pong through a blocked reader, half the round trip.
+	Thread echoThread;
+	echoThread.start(benchEcho<Q>,&qs);
+	Timeval pingStart;
+	for (unsigned i=0; i<gPingCount; i++) {
+		qs.mQ.write(&gBenchItem);
+		qs.mReply.read();
+	}
+	long pingElapsed = pingStart.elapsed();
+	echoThread.join();
+
+	COUT(name << " writers=" << writers << " items=" << count
+		<< " ms=" << elapsed << " items/ms=" << (elapsed ? count/elapsed : count)
+		<< " wake us=" << pingElapsed*1000.0F/(2*gPingCount) << endl);
+}
+
+
+
+
+// size() of the lock-free FIFOs while writers and the reader race.
+
+static const unsigned gSizeCount = 1000000;
+static volatile unsigned gSizeStarted = 0;	///< puts begun, counted before each put
+
+template <class FIFO> struct SizeTest {
+	FIFO mQ;
+	unsigned mWriters;
+};
+
+template <class FIFO> void* sizeWriter(void* arg)
+{
+	SizeTest<FIFO>* test = (SizeTest<FIFO>*)arg;
+	for (unsigned i=0; i<gSizeCount/test->mWriters; i++) {
+		__atomic_add_fetch(&gSizeStarted,1,__ATOMIC_SEQ_CST);
+		test->mQ.put(&gBenchItem);
+	}
+	return NULL;
+}
+
+/** Drain the FIFO, checking that size() never counts more than the items in flight. */
+template <class FIFO> unsigned sizeCheck(const char* name, unsigned writers)
+{
+	SizeTest<FIFO> test;
+	test.mWriters = writers;
+	gSizeStarted = 0;
+	Thread *writerThreads = new Thread[writers];
+	for (unsigned i=0; i<writers; i++) writerThreads[i].start(sizeWriter<FIFO>,&test);
+	unsigned taken = 0;
+	unsigned errors = 0;
+	unsigned total = writers*(gSizeCount/writers);
+	while (taken<total) {
+		if (test.mQ.get()) taken++;
+		unsigned size = test.mQ.size();
+		unsigned inFlight = __atomic_load_n(&gSizeStarted,__ATOMIC_SEQ_CST) - taken;
+		if (size>inFlight) errors++;
+	}
+	for (unsigned i=0; i<writers; i++) writerThreads[i].join();
+	delete[] writerThreads;
+	if (test.mQ.size()!=0) errors++;
+	COUT(name << " writers=" << writers << " size errors=" << errors);
+	return errors;
+}
+
+
 
 
 int main(int argc, char *argv[])
@@ -108,6 +220,16 @@ int main(int argc, char *argv[])
 	qWriterThread.join();
 	mapReaderThread.join();
 	mapWriterThread.join();
+
+	benchmark< InterthreadQueue<int> >("InterthreadQueue",1);
+	benchmark< SPSCInterthreadQueue<int> >("SPSCInterthreadQueue",1);
+	benchmark< InterthreadQueue<int> >("InterthreadQueue",4);
+	benchmark< MPSCInterthreadQueue<int> >("MPSCInterthreadQueue",4);
+
+	unsigned errors = 0;
+	errors += sizeCheck<SPSCPointerFIFO>("SPSCPointerFIFO",1);
+	errors += sizeCheck<MPSCPointerFIFO>("MPSCPointerFIFO",4);
+	return errors ? 1 : 0;
 }
 
 
@@ -75,3 +75,109 @@ void PointerFIFO::release(ListNode* wNode)
 
 
 
+
+SPSCPointerFIFO::SPSCPointerFIFO()
+	:mGets(0),mPuts(0)
+{
+	Node* dummy = new Node;
+	dummy->mNext = NULL;
+	dummy->mData = NULL;
+	mHead = mTail = mFirst = mHeadCopy = dummy;
+}
+
+SPSCPointerFIFO::~SPSCPointerFIFO()
+{
+	// Every node, consumed or not, is on the chain from mFirst.
+	while (mFirst!=NULL) {
+		Node* next = mFirst->mNext;
+		delete mFirst;
+		mFirst = next;
+	}
+}
+
+SPSCPointerFIFO::Node* SPSCPointerFIFO::allocate()
+{
+	// Nodes before the reader's dummy have been consumed.
+	if (mFirst!=mHeadCopy) {
+		Node* retVal = mFirst;
+		mFirst = mFirst->mNext;
+		return retVal;
+	}
+	mHeadCopy = __atomic_load_n(&mHead,__ATOMIC_ACQUIRE);
+	if (mFirst!=mHeadCopy) {
+		Node* retVal = mFirst;
+		mFirst = mFirst->mNext;
+		return retVal;
+	}
+	return new Node;
+}
+
+void SPSCPointerFIFO::put(void* val)
+{
+	Node* node = allocate();
+	node->mData = val;
+	node->mNext = NULL;
+	// Count the item before the reader can take it, so size() cannot underflow.
+	__atomic_store_n(&mPuts,mPuts+1,__ATOMIC_RELAXED);
+	__atomic_store_n(&mTail->mNext,node,__ATOMIC_RELEASE);
+	mTail = node;
+}
+
+void* SPSCPointerFIFO::get()
+{
+	Node* next = __atomic_load_n(&mHead->mNext,__ATOMIC_ACQUIRE);
+	if (next==NULL) return NULL;
+	void* retVal = next->mData;
+	// The item's node becomes the new dummy; the old one goes back to the writer.
+	__atomic_store_n(&mHead,next,__ATOMIC_RELEASE);
+	__atomic_store_n(&mGets,mGets+1,__ATOMIC_RELEASE);
+	return retVal;
+}
+
+
+
+
+MPSCPointerFIFO::MPSCPointerFIFO()
+	:mPuts(0),mGets(0)
+{
+	Node* dummy = new Node;
+	dummy->mNext = NULL;
+	dummy->mData = NULL;
+	mHead = mTail = dummy;
+}
+
+MPSCPointerFIFO::~MPSCPointerFIFO()
+{
+	while (mTail!=NULL) {
+		Node* next = mTail->mNext;
+		delete mTail;
+		mTail = next;
+	}
+}
+
+void MPSCPointerFIFO::put(void* val)
+{
+	Node* node = new Node;
+	node->mData = val;
+	node->mNext = NULL;
+	// Count the item before the reader can take it, so size() cannot underflow.
+	__atomic_add_fetch(&mPuts,1,__ATOMIC_RELAXED);
+	// Claim the end of the list, then link the previous end to it.
+	Node* prev = __atomic_exchange_n(&mHead,node,__ATOMIC_ACQ_REL);
+	__atomic_store_n(&prev->mNext,node,__ATOMIC_RELEASE);
+}
+
+void* MPSCPointerFIFO::get()
+{
+	Node* tail = mTail;
+	Node* next = __atomic_load_n(&tail->mNext,__ATOMIC_ACQUIRE);
+	if (next==NULL) return NULL;
+	void* retVal = next->mData;
+	mTail = next;
+	delete tail;
+	__atomic_store_n(&mGets,mGets+1,__ATOMIC_RELEASE);
+	return retVal;
+}
+
+
+
@@ -94,5 +94,115 @@ class PointerFIFO {
 
 
 
+/**
+	A lock-free FIFO for pointer-based storage, one writer thread and one reader thread.
+	Only the writer may call put() and only the reader may call get().
+	Nodes consumed by the reader are recycled by the writer,
+	so there is no allocation once the FIFO has reached its working depth.
+*/
+class SPSCPointerFIFO {
+
+	private:
+
+	struct Node {
+		Node* mNext;
+		void* mData;
+	};
+
+	// Reader side.
+	Node* mHead;			///< dummy node; the next item out follows it
+	volatile unsigned mGets;	///< number of items taken out
+	char mPad0[64];
+	// Writer side.
+	Node* mTail;			///< last item in
+	Node* mFirst;			///< oldest node, start of the recycle list
+	Node* mHeadCopy;		///< writer's last view of mHead
+	volatile unsigned mPuts;	///< number of items put in
+	char mPad1[64];
+
+	public:
+
+	SPSCPointerFIFO();
+
+	~SPSCPointerFIFO();
+
+	/**
+		Number of items in the FIFO, approximate while it is in motion.
+		The puts are counted before the item is visible and read after the gets, so this never goes negative.
+	*/
+	unsigned size() const
+	{
+		unsigned gets = __atomic_load_n(&mGets,__ATOMIC_ACQUIRE);
+		int retVal = __atomic_load_n(&mPuts,__ATOMIC_RELAXED) - gets;
+		return (retVal>0) ? retVal : 0;
+	}
+
+	/** Put an item into the FIFO; writer only. */
+	void put(void* val);
+
+	/**
+		Take an item from the FIFO; reader only.
+		Returns NULL for empty list.
+	*/
+	void* get();
+
+	private:
+
+	/** Get a node for the writer, recycling a consumed one if possible. */
+	Node* allocate();
+};
+
+
+
+/**
+	A lock-free FIFO for pointer-based storage, any number of writer threads and one reader thread.
+	Only the reader may call get().
+	A put() in progress may not be visible to get() until it completes.
+*/
+class MPSCPointerFIFO {
+
+	private:
+
+	struct Node {
+		Node* mNext;
+		void* mData;
+	};
+
+	Node* mHead;			///< last item in, swapped in by the writers
+	volatile unsigned mPuts;	///< number of items put in
+	char mPad0[64];
+	Node* mTail;			///< dummy node owned by the reader; the next item out follows it
+	volatile unsigned mGets;	///< number of items taken out
+	char mPad1[64];
+
+	public:
+
+	MPSCPointerFIFO();
+
+	~MPSCPointerFIFO();
+
+	/**
+		Number of items in the FIFO, approximate while it is in motion.
+		The puts are counted before the item is visible and read after the gets, so this never goes negative.
+	*/
+	unsigned size() const
+	{
+		unsigned gets = __atomic_load_n(&mGets,__ATOMIC_ACQUIRE);
+		int retVal = __atomic_load_n(&mPuts,__ATOMIC_RELAXED) - gets;
+		return (retVal>0) ? retVal : 0;
+	}
+
+	/** Put an item into the FIFO; any thread. */
+	void put(void* val);
+
+	/**
+		Take an item from the FIFO; reader only.
+		Returns NULL for empty list.
+	*/
+	void* get();
+};
+
+
+
 #endif
 // vim: ts=4 sw=4
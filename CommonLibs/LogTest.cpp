@@ -26,9 +26,11 @@
 
 #include <iostream>
 #include <iterator>
+#include <fstream>
 
 #include "Logger.h"
 #include "Configuration.h"
+#include "Timeval.h"
 
 ConfigurationTable gConfig;
 //ConfigurationTable gConfig("example.config");
@@ -64,6 +66,27 @@ int main(int argc, char *argv[])
     }
     std::cout << "you should see ten lines with the numbers 10..19:" << std::endl;
     printAlarms();
+    std::cout << "----------- timing disabled log statements ----------" << std::endl;
+    Timeval start;
+    for (int i = 0 ; i < 1000000 ; ++i) {
+        LOG(INFO) << i;
+    }
+    std::cout << "1000000 disabled LOG(INFO) took " << start.elapsed() << " ms" << std::endl;
+    std::cout << "----------- asynchronous logging to a file ----------" << std::endl;
+    const char *logFile = "/tmp/LogTest.log";
+    unlink(logFile);
+    gConfig.set("Log.File",logFile);
+    gConfig.set("Log.Async");
+    for (int i = 0 ; i < 10 ; ++i) {
+        LOG(NOTICE) << "async " << i;
+    }
+    sleep(1);
+    std::ifstream in(logFile);
+    std::string line;
+    int lines = 0;
+    while (std::getline(in,line)) lines++;
+    std::cout << "you should see 10 lines in " << logFile << ": " << lines
+        << ", dropped " << gLogDropped() << std::endl;
 }
 
 
@@ -29,6 +29,9 @@
 #include <fstream>
 #include <string>
 #include <stdarg.h>
+#include <algorithm>
+#include <vector>
+#include <sys/time.h>
 
 #include "Configuration.h"
 #include "Logger.h"
@@ -36,10 +39,6 @@
 
 using namespace std;
 
-// Reference to a global config table, used all over the system.
-extern ConfigurationTable gConfig;
-
-
 /**@ The global alarms table. */
 //@{
 Mutex           alarmsLock;
@@ -85,12 +84,10 @@ int getLoggingLevel(const char* filename)
 
 int gGetLoggingLevel(const char* filename)
 {
-	// This is called a lot and needs to be efficient.
-
+	// LOG() call sites cache the result, so this is only hit when the config changes.
 	static Mutex sLogCacheLock;
 	static map<uint64_t,int>  sLogCache;
-	static unsigned sCacheCount;
-	static const unsigned sCacheRefreshCount = 1000;
+	static unsigned sCacheGeneration;
 
 	if (filename==NULL) return gGetLoggingLevel("");
 
@@ -99,13 +96,13 @@ int gGetLoggingLevel(const char* filename)
 
 	sLogCacheLock.lock();
 	// Time for a cache flush?
-	if (sCacheCount>sCacheRefreshCount) {
+	const unsigned generation = gConfig.generation();
+	if (sCacheGeneration!=generation) {
 		sLogCache.clear();
-		sCacheCount=0;
+		sCacheGeneration=generation;
 	}
 	// Is it cached already?
 	map<uint64_t,int>::const_iterator where = sLogCache.find(key);
-	sCacheCount++;
 	if (where!=sLogCache.end()) {
 		int retVal = where->second;
 		sLogCacheLock.unlock();
@@ -149,6 +146,263 @@ void addAlarm(const string& s)
 }
 
 
+
+
+
+/**@name Asynchronous logging backend. */
+//@{
+
+/**
+	A per-thread ring of variable-length log records.
+	One writer (the owning thread) and one reader (the log writer thread), no locks.
+	Records are 16-byte aligned; a record that would straddle the end of the buffer
+	is preceded by a padding record that skips to the start.
+*/
+class LogRing {
+
+	public:
+
+	static const unsigned sBytes = 16384;
+	static const unsigned sMaxText = 1024;	///< longer records are truncated
+
+	struct Header {
+		uint16_t mLength;		///< text length in bytes
+		uint8_t mPriority;
+		uint8_t mPadding;		///< nonzero for a padding record
+		uint32_t mSequence;		///< global order of the record
+		uint32_t mSeconds;		///< capture time
+		uint32_t mMicroseconds;
+	};
+
+	private:
+
+	char mBuffer[sBytes];
+	volatile uint32_t mHead;	///< read position, advanced by the reader
+	volatile uint32_t mTail;	///< write position, advanced by the writer
+
+	public:
+
+	volatile bool mOrphaned;	///< the owning thread has exited
+	LogRing* mNext;				///< registry link, under sLogRingLock
+
+	LogRing()
+		:mHead(0),mTail(0),mOrphaned(false),mNext(NULL)
+	{ }
+
+	bool empty() const
+		{ return __atomic_load_n(&mHead,__ATOMIC_ACQUIRE)==__atomic_load_n(&mTail,__ATOMIC_ACQUIRE); }
+
+	/** Add a record; return false if there is no room. */
+	bool put(int priority, uint32_t sequence, const struct timeval& when, const char* text, size_t length)
+	{
+		if (length>sMaxText) length = sMaxText;
+		const uint32_t recordSize = (sizeof(Header) + length + 15) & ~15U;
+		const uint32_t tail = mTail;
+		const uint32_t pos = tail % sBytes;
+		const uint32_t contiguous = sBytes - pos;
+		const uint32_t total = (contiguous<recordSize) ? contiguous+recordSize : recordSize;
+		const uint32_t used = tail - __atomic_load_n(&mHead,__ATOMIC_ACQUIRE);
+		if (total > sBytes-used) return false;
+		uint32_t wp = pos;
+		if (contiguous<recordSize) {
+			Header* pad = (Header*)(mBuffer+pos);
+			pad->mPadding = 1;
+			wp = 0;
+		}
+		Header* hdr = (Header*)(mBuffer+wp);
+		hdr->mLength = length;
+		hdr->mPriority = priority;
+		hdr->mPadding = 0;
+		hdr->mSequence = sequence;
+		hdr->mSeconds = when.tv_sec;
+		hdr->mMicroseconds = when.tv_usec;
+		memcpy(mBuffer+wp+sizeof(Header),text,length);
+		__atomic_store_n(&mTail,tail+total,__ATOMIC_RELEASE);
+		return true;
+	}
+
+	/** Take the next record, if any; the text is copied into the string. */
+	bool get(Header& header, string& text)
+	{
+		uint32_t head = mHead;
+		while (head!=__atomic_load_n(&mTail,__ATOMIC_ACQUIRE)) {
+			const uint32_t pos = head % sBytes;
+			const Header* hdr = (const Header*)(mBuffer+pos);
+			if (hdr->mPadding) {
+				head += sBytes - pos;
+				continue;
+			}
+			header = *hdr;
+			text.assign(mBuffer+pos+sizeof(Header),hdr->mLength);
+			head += (sizeof(Header) + hdr->mLength + 15) & ~15U;
+			__atomic_store_n(&mHead,head,__ATOMIC_RELEASE);
+			return true;
+		}
+		__atomic_store_n(&mHead,head,__ATOMIC_RELEASE);
+		return false;
+	}
+};
+
+
+/** A record pulled from a ring, for ordering across threads. */
+struct LogRecord {
+	LogRing::Header mHeader;
+	string mText;
+	bool operator<(const LogRecord& other) const
+		{ return (int32_t)(mHeader.mSequence - other.mHeader.mSequence) < 0; }
+};
+
+
+// The writer thread outlives static destructors, so its lock is never destroyed.
+static Mutex& sLogRingLock = *new Mutex;	///< protects the ring registry
+static LogRing* sLogRings = NULL;		///< every ring not yet freed
+static pthread_key_t sLogRingKey;		///< the calling thread's ring
+static pthread_once_t sLogAsyncOnce = PTHREAD_ONCE_INIT;
+static FutexSignal sLogWriterSignal;	///< wakes the writer thread
+static volatile uint32_t sLogSequence = 0;
+static volatile unsigned sLogDropped = 0;
+static char sLogName[32];				///< program name, for log files
+
+
+/** Thread exit; the ring is freed by the writer once drained. */
+static void orphanLogRing(void* ring)
+{
+	__atomic_store_n(&((LogRing*)ring)->mOrphaned,true,__ATOMIC_RELEASE);
+}
+
+
+/** Append to the log file, rotating it to name.1 when it passes Log.File.MaxSize. */
+static void writeLogFile(FILE*& file, const string& path, long maxSize, const LogRecord& record)
+{
+	static string openPath;
+	if (file && path!=openPath) {
+		fclose(file);
+		file = NULL;
+	}
+	if (!file) {
+		file = fopen(path.c_str(),"a");
+		if (!file) return;
+		openPath = path;
+	}
+	time_t seconds = record.mHeader.mSeconds;
+	struct tm tm;
+	localtime_r(&seconds,&tm);
+	char stamp[32];
+	strftime(stamp,sizeof(stamp),"%Y-%m-%d %H:%M:%S",&tm);
+	fprintf(file,"%s.%03u %s: %s\n", stamp, record.mHeader.mMicroseconds/1000,
+		sLogName, record.mText.c_str());
+	if (ftell(file)>maxSize) {
+		fclose(file);
+		file = NULL;
+		rename(path.c_str(),(path+".1").c_str());
+	}
+}
+
+
+/** The writer thread; drains the rings to syslog or to Log.File. */
+static void* logWriterLoop(void*)
+{
+	static ConfigKey<string> sLogFile(gConfig,"Log.File","");
+	static ConfigKey<long> sLogFileMaxSize(gConfig,"Log.File.MaxSize",10000000);
+	FILE* file = NULL;
+	unsigned reportedDrops = 0;
+	vector<LogRecord> batch;
+	while (true) {
+		int seq = sLogWriterSignal.prepareWait();
+		// Collect everything queued, freeing the rings of exited threads.
+		batch.clear();
+		sLogRingLock.lock();
+		LogRing** link = &sLogRings;
+		while (LogRing* ring = *link) {
+			bool orphaned = __atomic_load_n(&ring->mOrphaned,__ATOMIC_ACQUIRE);
+			LogRecord record;
+			while (ring->get(record.mHeader,record.mText)) batch.push_back(record);
+			if (orphaned) {
+				*link = ring->mNext;
+				delete ring;
+			} else {
+				link = &ring->mNext;
+			}
+		}
+		sLogRingLock.unlock();
+		if (batch.size()==0) {
+			sLogWriterSignal.wait(seq,100);
+			continue;
+		}
+		sLogWriterSignal.cancelWait();
+		sort(batch.begin(),batch.end());
+		const string path = sLogFile.value();
+		const long maxSize = sLogFileMaxSize.value();
+		for (unsigned i=0; i<batch.size(); i++) {
+			if (path.size()) writeLogFile(file,path,maxSize,batch[i]);
+			else syslog(batch[i].mHeader.mPriority, "%s", batch[i].mText.c_str());
+		}
+		unsigned drops = __atomic_load_n(&sLogDropped,__ATOMIC_RELAXED);
+		if (drops!=reportedDrops) {
+			syslog(LOG_WARNING, "async logging dropped %u records, %u total", drops-reportedDrops, drops);
+			reportedDrops = drops;
+		}
+		if (file) fflush(file);
+	}
+	return NULL;
+}
+
+
+static void startLogWriter()
+{
+	pthread_key_create(&sLogRingKey,orphanLogRing);
+	static Thread writer;
+	writer.start(logWriterLoop,NULL);
+}
+
+
+/** True if Log.Async is defined; cached against the config generation. */
+static bool logAsync()
+{
+	static uint64_t cache = 0;
+	const uint64_t generation = gConfig.generation();
+	const uint64_t cached = __atomic_load_n(&cache,__ATOMIC_RELAXED);
+	if ((cached>>8)==generation) return cached & 0x01;
+	const bool async = gConfig.defines("Log.Async");
+	__atomic_store_n(&cache,(generation<<8) | async,__ATOMIC_RELAXED);
+	return async;
+}
+
+
+/** Queue a record on the calling thread's ring; return false if it must be logged directly. */
+static bool logAsyncRecord(int priority, const string& text)
+{
+	if (!logAsync()) return false;
+	pthread_once(&sLogAsyncOnce,startLogWriter);
+	LogRing* ring = (LogRing*)pthread_getspecific(sLogRingKey);
+	if (!ring) {
+		ring = new LogRing;
+		pthread_setspecific(sLogRingKey,ring);
+		ScopedLock lock(sLogRingLock);
+		ring->mNext = sLogRings;
+		sLogRings = ring;
+	}
+	struct timeval now;
+	gettimeofday(&now,NULL);
+	uint32_t sequence = __atomic_fetch_add(&sLogSequence,1,__ATOMIC_RELAXED);
+	if (!ring->put(priority,sequence,now,text.data(),text.size())) {
+		__atomic_add_fetch(&sLogDropped,1,__ATOMIC_RELAXED);
+	}
+	sLogWriterSignal.signal();
+	return true;
+}
+
+
+unsigned gLogDropped()
+{
+	return __atomic_load_n(&sLogDropped,__ATOMIC_RELAXED);
+}
+
+//@}
+
+
+
+
 Log::~Log()
 {
 	if (mDummyInit) return;
@@ -159,8 +413,10 @@ Log::~Log()
 		cerr << mStream.str() << endl;
 	}
 	// Current logging level was already checked by the macro.
-	// So just log.
-	syslog(mPriority, "%s", mStream.str().c_str());
+	// So just log, through the writer thread if Log.Async is set.
+	const string text = mStream.str();
+	if (logAsyncRecord(mPriority,text)) return;
+	syslog(mPriority, "%s", text.c_str());
 }
 
 
@@ -197,6 +453,7 @@ void gLogInit(const char* name, const char* level, int facility)
 	}
 
 	// Open the log connection.
+	snprintf(sLogName,sizeof(sLogName),"%s",name);
 	openlog(name,0,facility);
 }
 
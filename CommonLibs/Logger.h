@@ -35,18 +35,23 @@
 #include <map>
 #include <string>
 #include "Threads.h"
+#include "Configuration.h"
 
 
 #define _LOG(level) \
 	Log(LOG_##level).get() << pthread_self() \
 	<< " " __FILE__  ":"  << __LINE__ << ":" << __FUNCTION__ << ": "
 
+/** The logging level for this call site, cached in a static at the call site. */
+#define _LOG_LEVEL \
+	({ static uint64_t sLogLevelCache = 0; gCachedLoggingLevel(sLogLevelCache,__FILE__); })
+
 #ifdef NDEBUG
 #define LOG(wLevel) \
-	if (LOG_##wLevel!=LOG_DEBUG && gGetLoggingLevel(__FILE__)>=LOG_##wLevel) _LOG(wLevel)
+	if (LOG_##wLevel!=LOG_DEBUG && _LOG_LEVEL>=LOG_##wLevel) _LOG(wLevel)
 #else
 #define LOG(wLevel) \
-	if (gGetLoggingLevel(__FILE__)>=LOG_##wLevel) _LOG(wLevel)
+	if (_LOG_LEVEL>=LOG_##wLevel) _LOG(wLevel)
 #endif
 
 
@@ -104,9 +109,32 @@ void gLogInit(const char* name, const char* level=NULL, int facility=LOG_USER);
 int gGetLoggingLevel(const char *filename=NULL);
 /** Allow early logging when still in constructors */
 void gLogEarly(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+/** Number of records dropped by asynchronous logging (Log.Async) because a ring was full. */
+unsigned gLogDropped();
 //@}
 
 
+extern ConfigurationTable gConfig;
+
+/**
+	Get the logging level for a LOG() call site.
+	The cache holds the config generation in the upper bits and the level in the low byte.
+	While the generation is unchanged this is one load and compare, with no lock.
+	@param cache The call site's static cache word, initially 0.
+	@param filename The call site's source file.
+*/
+inline int gCachedLoggingLevel(uint64_t& cache, const char* filename)
+{
+	const uint64_t generation = gConfig.generation();
+	const uint64_t cached = __atomic_load_n(&cache,__ATOMIC_RELAXED);
+	if ((cached>>8)==generation) return cached & 0x0ff;
+	// The generation was read first, so a change during the lookup forces another one.
+	const int level = gGetLoggingLevel(filename);
+	__atomic_store_n(&cache,(generation<<8) | level,__ATOMIC_RELAXED);
+	return level;
+}
+
+
 #endif
 
 // vim: ts=4 sw=4
@@ -0,0 +1,357 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Metrics.h"
+#include "Logger.h"
+
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+
+uint64_t metricsClock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec*1000000ULL + now.tv_nsec/1000;
+}
+
+
+
+
+Metric::Metric(const char* wName, const char* wLabels, const char* wHelp)
+	:mName(wName),mLabels(wLabels ? wLabels : ""),mHelp(wHelp)
+{
+	MetricsRegistry::registry().add(this);
+}
+
+
+Metric::~Metric()
+{
+	MetricsRegistry::registry().remove(this);
+}
+
+
+void Metric::writeName(ostream& os, const char* suffix, const char* extraLabel) const
+{
+	os << mName << suffix;
+	if (mLabels.size()==0 && extraLabel==NULL) return;
+	os << '{' << mLabels;
+	if (extraLabel) {
+		if (mLabels.size()) os << ',';
+		os << extraLabel;
+	}
+	os << '}';
+}
+
+
+
+
+void MetricCounter::write(ostream& os) const
+{
+	writeName(os);
+	os << ' ' << value() << '\n';
+}
+
+
+void MetricCounter::summary(ostream& os) const
+{
+	writeName(os);
+	os << " " << value() << endl;
+}
+
+
+void MetricGauge::write(ostream& os) const
+{
+	writeName(os);
+	os << ' ' << value() << '\n';
+}
+
+
+void MetricGauge::summary(ostream& os) const
+{
+	writeName(os);
+	os << " " << value() << endl;
+}
+
+
+
+
+MetricHistogram::MetricHistogram(const char* wName, const char* wLabels, const char* wHelp)
+	:Metric(wName,wLabels,wHelp),mCount(0),mSum(0)
+{
+	for (unsigned i=0; i<sNumBuckets; i++) mBuckets[i]=0;
+}
+
+
+unsigned MetricHistogram::bucket(uint64_t value)
+{
+	// Values below sSubBuckets get a bucket each.
+	if (value<sSubBuckets) return value;
+	// Otherwise the octave is the position of the top bit,
+	// and the next sSubBucketBits bits pick the linear bucket in it.
+	unsigned octave = 63 - __builtin_clzll(value);
+	unsigned sub = (value >> (octave-sSubBucketBits)) & (sSubBuckets-1);
+	return (octave-sSubBucketBits+1)*sSubBuckets + sub;
+}
+
+
+uint64_t MetricHistogram::bucketLow(unsigned index)
+{
+	if (index<sSubBuckets) return index;
+	unsigned octave = index/sSubBuckets + sSubBucketBits - 1;
+	unsigned sub = index % sSubBuckets;
+	return (uint64_t)(sSubBuckets+sub) << (octave-sSubBucketBits);
+}
+
+
+uint64_t MetricHistogram::bucketHigh(unsigned index)
+{
+	if (index<sSubBuckets) return index+1;
+	unsigned octave = index/sSubBuckets + sSubBucketBits - 1;
+	return bucketLow(index) + (1ULL << (octave-sSubBucketBits));
+}
+
+
+uint64_t MetricHistogram::quantile(double q) const
+{
+	uint64_t total = count();
+	if (total==0) return 0;
+	uint64_t rank = (uint64_t)(q*total + 0.5);
+	if (rank<1) rank = 1;
+	if (rank>total) rank = total;
+	uint64_t seen = 0;
+	for (unsigned i=0; i<sNumBuckets; i++) {
+		seen += __atomic_load_n(&mBuckets[i],__ATOMIC_RELAXED);
+		if (seen>=rank) return (bucketLow(i) + bucketHigh(i) - 1) / 2;
+	}
+	// Counts raced ahead of the buckets.
+	return bucketLow(sNumBuckets-1);
+}
+
+
+void MetricHistogram::write(ostream& os) const
+{
+	// Prometheus buckets are cumulative, one per power of two.
+	// Samples are integers, so "< 2^e" is "<= 2^e-1".
+	uint64_t cumulative = 0;
+	unsigned index = 0;
+	for (unsigned e=0; e<=sExportOctaves; e++) {
+		uint64_t limit = 1ULL << e;
+		while (index<sNumBuckets && bucketHigh(index)<=limit) {
+			cumulative += __atomic_load_n(&mBuckets[index],__ATOMIC_RELAXED);
+			index++;
+		}
+		char le[32];
+		sprintf(le,"le=\"%llu\"",(unsigned long long)(limit-1));
+		writeName(os,"_bucket",le);
+		os << ' ' << cumulative << '\n';
+	}
+	// Take the count after the buckets so +Inf is never below a finite bucket.
+	uint64_t total = count();
+	writeName(os,"_bucket","le=\"+Inf\"");
+	os << ' ' << total << '\n';
+	writeName(os,"_sum");
+	os << ' ' << sum() << '\n';
+	writeName(os,"_count");
+	os << ' ' << total << '\n';
+}
+
+
+void MetricHistogram::summary(ostream& os) const
+{
+	uint64_t total = count();
+	writeName(os);
+	os << " count=" << total;
+	if (total) {
+		os << " mean=" << sum()/total
+			<< " p50=" << quantile(0.5)
+			<< " p90=" << quantile(0.9)
+			<< " p99=" << quantile(0.99)
+			<< " max=" << quantile(1.0);
+	}
+	os << endl;
+}
+
+
+
+
+MetricsRegistry& MetricsRegistry::registry()
+{
+	// Never destroyed, so metrics can unregister during static destruction.
+	static MetricsRegistry* sRegistry = new MetricsRegistry;
+	return *sRegistry;
+}
+
+
+void MetricsRegistry::add(const Metric* metric)
+{
+	ScopedLock lock(mLock);
+	list<const Metric*>::iterator where = mMetrics.begin();
+	while (where!=mMetrics.end()) {
+		int cmp = (*where)->name().compare(metric->name());
+		if (cmp>0) break;
+		if (cmp==0 && (*where)->labels().compare(metric->labels())>0) break;
+		where++;
+	}
+	mMetrics.insert(where,metric);
+}
+
+
+void MetricsRegistry::remove(const Metric* metric)
+{
+	ScopedLock lock(mLock);
+	mMetrics.remove(metric);
+}
+
+
+void MetricsRegistry::write(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	const string* lastName = NULL;
+	list<const Metric*>::const_iterator metric = mMetrics.begin();
+	for (; metric!=mMetrics.end(); metric++) {
+		const Metric& m = **metric;
+		if (lastName==NULL || *lastName!=m.name()) {
+			os << "# HELP " << m.name() << ' ' << m.help() << '\n';
+			os << "# TYPE " << m.name() << ' ' << m.type() << '\n';
+			lastName = &m.name();
+		}
+		m.write(os);
+	}
+}
+
+
+void MetricsRegistry::summary(ostream& os, const char* pattern) const
+{
+	ScopedLock lock(mLock);
+	list<const Metric*>::const_iterator metric = mMetrics.begin();
+	for (; metric!=mMetrics.end(); metric++) {
+		if (pattern && (*metric)->name().find(pattern)==string::npos) continue;
+		(*metric)->summary(os);
+	}
+}
+
+
+
+
+bool MetricsServer::start(const char* ip, unsigned port)
+{
+	assert(mThread==NULL);
+	struct sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	if (inet_aton(ip,&address.sin_addr)==0) {
+		LOG(ALERT) << "bad metrics address " << ip;
+		return false;
+	}
+	mSocketFD = socket(AF_INET,SOCK_STREAM,0);
+	if (mSocketFD<0) {
+		LOG(ALERT) << "cannot create metrics socket: " << strerror(errno);
+		return false;
+	}
+	int on = 1;
+	setsockopt(mSocketFD,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+	if (bind(mSocketFD,(struct sockaddr*)&address,sizeof(address)) || listen(mSocketFD,4)) {
+		LOG(ALERT) << "cannot listen for metrics on " << ip << ":" << port << ": " << strerror(errno);
+		close(mSocketFD);
+		mSocketFD = -1;
+		return false;
+	}
+	LOG(INFO) << "serving metrics on " << ip << ":" << port;
+	mThread = new Thread;
+	mThread->start((void*(*)(void*))MetricsServerServiceLoopAdapter,this);
+	return true;
+}
+
+
+void* MetricsServerServiceLoopAdapter(MetricsServer* server)
+{
+	server->serviceLoop();
+	return NULL;
+}
+
+
+void MetricsServer::serviceLoop()
+{
+	while (1) {
+		int fd = accept(mSocketFD,NULL,NULL);
+		if (fd<0) {
+			if (errno==EINTR) continue;
+			LOG(ERR) << "metrics accept failed: " << strerror(errno);
+			sleep(1);
+			continue;
+		}
+		serve(fd);
+		close(fd);
+	}
+}
+
+
+void MetricsServer::serve(int fd)
+{
+	// Don't let a stuck client block the next scrape for long.
+	struct timeval timeout = {1,0};
+	setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+	setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout));
+
+	// Read the request header; only its end matters.
+	char request[2048];
+	size_t len = 0;
+	while (len<sizeof(request)-1) {
+		ssize_t n = recv(fd,request+len,sizeof(request)-1-len,0);
+		if (n<=0) return;
+		len += n;
+		request[len] = '\0';
+		if (strstr(request,"\r\n\r\n") || strstr(request,"\n\n")) break;
+	}
+
+	ostringstream body;
+	MetricsRegistry::registry().write(body);
+	const string content = body.str();
+	ostringstream header;
+	header << "HTTP/1.0 200 OK\r\n"
+		<< "Content-Type: text/plain; version=0.0.4\r\n"
+		<< "Content-Length: " << content.size() << "\r\n"
+		<< "Connection: close\r\n\r\n";
+	const string response = header.str() + content;
+	size_t sent = 0;
+	while (sent<response.size()) {
+		ssize_t n = send(fd,response.data()+sent,response.size()-sent,MSG_NOSIGNAL);
+		if (n<=0) return;
+		sent += n;
+	}
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,258 @@
+/**@file Live counters, gauges and histograms, exported in Prometheus text format. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Threads.h>
+#include <ostream>
+#include <string>
+#include <list>
+#include <stdint.h>
+
+
+/** Microseconds on the monotonic clock, for latency measurements. */
+uint64_t metricsClock();
+
+
+/**
+	Base class for an exported metric.
+	A metric registers itself on construction and unregisters on destruction,
+	so metrics can be static objects anywhere in the program.
+	Metrics sharing a name must have the same type and differ in their labels.
+*/
+class Metric {
+
+	protected:
+
+	std::string mName;		///< Prometheus metric name
+	std::string mLabels;	///< Prometheus label set, like "channel=\"TCH\"", or empty
+	std::string mHelp;		///< one-line description
+
+	/** Write name{labels} with an optional suffix and extra label. */
+	void writeName(std::ostream& os, const char* suffix="", const char* extraLabel=NULL) const;
+
+	public:
+
+	Metric(const char* wName, const char* wLabels, const char* wHelp);
+
+	virtual ~Metric();
+
+	const std::string& name() const { return mName; }
+	const std::string& labels() const { return mLabels; }
+	const std::string& help() const { return mHelp; }
+
+	/** The Prometheus type name. */
+	virtual const char* type() const = 0;
+
+	/** Write the samples in Prometheus text format, without HELP or TYPE. */
+	virtual void write(std::ostream& os) const = 0;
+
+	/** Write a one-line human-readable summary. */
+	virtual void summary(std::ostream& os) const = 0;
+};
+
+
+/** A monotonically increasing count. */
+class MetricCounter : public Metric {
+
+	volatile uint64_t mValue;
+
+	public:
+
+	MetricCounter(const char* wName, const char* wLabels, const char* wHelp)
+		:Metric(wName,wLabels,wHelp),mValue(0)
+	{ }
+
+	void incr(uint64_t n=1) { __atomic_add_fetch(&mValue,n,__ATOMIC_RELAXED); }
+
+	uint64_t value() const { return __atomic_load_n(&mValue,__ATOMIC_RELAXED); }
+
+	const char* type() const { return "counter"; }
+	void write(std::ostream& os) const;
+	void summary(std::ostream& os) const;
+};
+
+
+/**
+	An instantaneous value, either set by the owner or sampled when exported.
+	Sampling is the way to export queue depths without touching the queue's hot path.
+*/
+class MetricGauge : public Metric {
+
+	public:
+
+	typedef long (*Sampler)(void* context);
+
+	private:
+
+	volatile long mValue;
+	Sampler mSampler;
+	void* mContext;
+
+	public:
+
+	MetricGauge(const char* wName, const char* wLabels, const char* wHelp)
+		:Metric(wName,wLabels,wHelp),mValue(0),mSampler(NULL),mContext(NULL)
+	{ }
+
+	/** A gauge whose value is sampler(context) at the time of export. */
+	MetricGauge(const char* wName, const char* wLabels, const char* wHelp, Sampler wSampler, void* wContext)
+		:Metric(wName,wLabels,wHelp),mValue(0),mSampler(wSampler),mContext(wContext)
+	{ }
+
+	void set(long value) { __atomic_store_n(&mValue,value,__ATOMIC_RELAXED); }
+
+	long value() const
+		{ return mSampler ? mSampler(mContext) : __atomic_load_n(&mValue,__ATOMIC_RELAXED); }
+
+	const char* type() const { return "gauge"; }
+	void write(std::ostream& os) const;
+	void summary(std::ostream& os) const;
+};
+
+
+/**
+	A histogram of non-negative integer samples, usually microseconds.
+	Buckets are log-linear, HDR style: each power of two is split into
+	sSubBuckets linear buckets, so any recorded value is known to within 25%.
+	Recording is a few instructions and three relaxed atomic adds, with no lock.
+	The export uses one Prometheus bucket per power of two, up to 2^sExportOctaves.
+*/
+class MetricHistogram : public Metric {
+
+	public:
+
+	static const unsigned sSubBucketBits = 2;
+	static const unsigned sSubBuckets = 1<<sSubBucketBits;
+	static const unsigned sNumBuckets = (65-sSubBucketBits)*sSubBuckets;	///< enough for any uint64_t
+	static const unsigned sExportOctaves = 32;
+
+	private:
+
+	volatile uint64_t mBuckets[sNumBuckets];
+	volatile uint64_t mCount;
+	volatile uint64_t mSum;
+
+	public:
+
+	MetricHistogram(const char* wName, const char* wLabels, const char* wHelp);
+
+	/** The bucket holding a value. */
+	static unsigned bucket(uint64_t value);
+
+	/** The smallest value in a bucket. */
+	static uint64_t bucketLow(unsigned index);
+
+	/** One more than the largest value in a bucket. */
+	static uint64_t bucketHigh(unsigned index);
+
+	void record(uint64_t value)
+	{
+		__atomic_add_fetch(&mBuckets[bucket(value)],1,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&mCount,1,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&mSum,value,__ATOMIC_RELAXED);
+	}
+
+	uint64_t count() const { return __atomic_load_n(&mCount,__ATOMIC_RELAXED); }
+	uint64_t sum() const { return __atomic_load_n(&mSum,__ATOMIC_RELAXED); }
+
+	/** Estimate a quantile, 0<=q<=1, from the bucket midpoints; 0 if empty. */
+	uint64_t quantile(double q) const;
+
+	const char* type() const { return "histogram"; }
+	void write(std::ostream& os) const;
+	void summary(std::ostream& os) const;
+};
+
+
+/** Record the lifetime of the object, in microseconds, into a histogram. */
+class MetricTimer {
+
+	MetricHistogram& mHistogram;
+	uint64_t mStart;
+
+	public:
+
+	MetricTimer(MetricHistogram& wHistogram)
+		:mHistogram(wHistogram),mStart(metricsClock())
+	{ }
+
+	~MetricTimer() { mHistogram.record(metricsClock()-mStart); }
+};
+
+
+/** The set of all live metrics. */
+class MetricsRegistry {
+
+	std::list<const Metric*> mMetrics;	///< sorted by name, then labels
+	mutable Mutex mLock;
+
+	public:
+
+	/** The registry, created on first use so metrics can register during static initialization. */
+	static MetricsRegistry& registry();
+
+	void add(const Metric* metric);
+	void remove(const Metric* metric);
+
+	/** Write every metric in Prometheus text exposition format. */
+	void write(std::ostream& os) const;
+
+	/** Write human-readable summaries of metrics whose names contain the pattern. */
+	void summary(std::ostream& os, const char* pattern=NULL) const;
+};
+
+
+/**
+	Serve the metrics registry over HTTP to scrapers such as Prometheus.
+	Every request gets the full text exposition; the path is ignored.
+	Requests are served one at a time by a single thread.
+*/
+class MetricsServer {
+
+	int mSocketFD;
+	Thread* mThread;
+
+	void serviceLoop();
+	void serve(int fd);
+
+	friend void* MetricsServerServiceLoopAdapter(MetricsServer*);
+
+	public:
+
+	MetricsServer():mSocketFD(-1),mThread(NULL) {}
+
+	/** Listen on a local TCP address and start serving; return false on failure. */
+	bool start(const char* ip, unsigned port);
+};
+
+
+void* MetricsServerServiceLoopAdapter(MetricsServer*);
+
+
+#endif
+
+// vim: ts=4 sw=4
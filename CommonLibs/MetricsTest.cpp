@@ -0,0 +1,77 @@
+/*
+* Copyright 2008 Free Software Foundation, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "Metrics.h"
+#include "Configuration.h"
+#include "Timeval.h"
+#include <iostream>
+
+using namespace std;
+
+ConfigurationTable gConfig;
+
+
+static long sampleDepth(void* context)
+{
+	return *(int*)context;
+}
+
+
+int main(int argc, char *argv[])
+{
+	MetricCounter frames("test_frames_total","result=\"good\"","Frames decoded.");
+	MetricCounter badFrames("test_frames_total","result=\"bad\"","Frames decoded.");
+	int depth = 7;
+	MetricGauge queue("test_queue_depth",NULL,"Queue depth.",sampleDepth,&depth);
+	MetricHistogram latency("test_latency_microseconds",NULL,"Latency.");
+
+	for (unsigned i=0; i<20; i++) cout << i << ":" << MetricHistogram::bucket(i) << " ";
+	cout << endl;
+	for (unsigned i=0; i<MetricHistogram::sNumBuckets; i++) {
+		uint64_t low = MetricHistogram::bucketLow(i);
+		uint64_t high = MetricHistogram::bucketHigh(i);
+		if (MetricHistogram::bucket(low)!=i || MetricHistogram::bucket(high-1)!=i)
+			cout << "bucket " << i << " bounds wrong" << endl;
+	}
+
+	frames.incr(99);
+	badFrames.incr();
+	for (unsigned i=1; i<=1000; i++) latency.record(i);
+	{
+		MetricTimer timer(latency);
+		usleep(2000);
+	}
+
+	MetricsRegistry::registry().write(cout);
+	MetricsRegistry::registry().summary(cout);
+	depth = 3;
+	MetricsRegistry::registry().summary(cout,"queue");
+
+	Timeval start;
+	for (unsigned i=0; i<10000000; i++) latency.record(i&1023);
+	cout << "10M histogram records in " << start.elapsed() << " ms" << endl;
+}
@@ -0,0 +1,180 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "ObjectPool.h"
+#include <new>
+#include <iomanip>
+#include <assert.h>
+
+using namespace std;
+
+
+
+/**@name The registry of pools, for reports; never destroyed. */
+//@{
+static Mutex& poolRegistryLock()
+{
+	static Mutex* sLock = new Mutex;
+	return *sLock;
+}
+
+static ObjectPool* sPools = NULL;
+//@}
+
+
+
+ObjectPool::ObjectPool(const char* wName, size_t wBlockSize, unsigned wMaxBlocks)
+	:mName(wName),mBlockSize(wBlockSize),
+	mSlabCount(0),mFree(0),
+	mInUse(0),mPeak(0),mHeapInUse(0),mAllocations(0)
+{
+	assert(sizeof(Header)==16);
+	mStride = (sizeof(Header) + mBlockSize + 15) & ~(size_t)15;
+	mMaxSlabs = (wMaxBlocks + sSlabBlocks - 1) / sSlabBlocks;
+	if (mMaxSlabs>sMaxSlabs) mMaxSlabs = sMaxSlabs;
+	for (unsigned i=0; i<sMaxSlabs; i++) mSlabs[i]=NULL;
+
+	ScopedLock lock(poolRegistryLock());
+	mNextPool = sPools;
+	sPools = this;
+}
+
+
+void ObjectPool::push(Header* first, Header* last)
+{
+	uint64_t head = __atomic_load_n(&mFree,__ATOMIC_RELAXED);
+	uint64_t newHead;
+	do {
+		last->mNext = (uint32_t)head;
+		newHead = (((head>>32)+1)<<32) | (first->mIndex+1);
+	} while (!__atomic_compare_exchange_n(&mFree,&head,newHead,true,__ATOMIC_RELEASE,__ATOMIC_RELAXED));
+}
+
+
+ObjectPool::Header* ObjectPool::grow()
+{
+	ScopedLock lock(mGrowLock);
+	// Another thread may have grown the pool while this one waited.
+	if (((uint32_t)__atomic_load_n(&mFree,__ATOMIC_ACQUIRE))!=0) return NULL;
+	unsigned slab = mSlabCount;
+	if (slab>=mMaxSlabs) return NULL;
+	mSlabs[slab] = new char[sSlabBlocks*mStride];
+	for (unsigned i=0; i<sSlabBlocks; i++) {
+		Header* block = header((slab<<sSlabBits)+i);
+		block->mPool = this;
+		block->mIndex = (slab<<sSlabBits)+i;
+		block->mNext = block->mIndex+2;
+	}
+	__atomic_store_n(&mSlabCount,slab+1,__ATOMIC_RELEASE);
+	// Keep the first block for the caller, free the rest.
+	push(header((slab<<sSlabBits)+1),header((slab<<sSlabBits)+sSlabBlocks-1));
+	return header(slab<<sSlabBits);
+}
+
+
+void ObjectPool::count(bool fromHeap)
+{
+	unsigned inUse = __atomic_add_fetch(&mInUse,1,__ATOMIC_RELAXED);
+	if (fromHeap) __atomic_add_fetch(&mHeapInUse,1,__ATOMIC_RELAXED);
+	__atomic_add_fetch(&mAllocations,1,__ATOMIC_RELAXED);
+	unsigned peak = __atomic_load_n(&mPeak,__ATOMIC_RELAXED);
+	while (inUse>peak) {
+		if (__atomic_compare_exchange_n(&mPeak,&peak,inUse,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) break;
+	}
+}
+
+
+void* ObjectPool::allocate(size_t size)
+{
+	Header* block = NULL;
+	if (size<=mBlockSize) {
+		while (!block) {
+			uint64_t head = __atomic_load_n(&mFree,__ATOMIC_ACQUIRE);
+			while ((uint32_t)head) {
+				Header* candidate = header((uint32_t)head-1);
+				// The candidate may be taken and reused meanwhile, but its slab stays mapped
+				// and the tag makes the exchange fail if so.
+				uint32_t next = __atomic_load_n(&candidate->mNext,__ATOMIC_RELAXED);
+				uint64_t newHead = (((head>>32)+1)<<32) | next;
+				if (__atomic_compare_exchange_n(&mFree,&head,newHead,true,__ATOMIC_ACQUIRE,__ATOMIC_ACQUIRE)) {
+					block = candidate;
+					break;
+				}
+			}
+			if (block) break;
+			block = grow();
+			if (block) break;
+			// Either the pool is full, or another thread just grew it or freed a block.
+			if ((uint32_t)__atomic_load_n(&mFree,__ATOMIC_ACQUIRE)==0) break;
+		}
+	}
+	if (block) {
+		count(false);
+		return block+1;
+	}
+
+	block = (Header*)::operator new(sizeof(Header)+size);
+	block->mPool = this;
+	block->mIndex = sHeapIndex;
+	count(true);
+	return block+1;
+}
+
+
+void ObjectPool::release(void* wBlock)
+{
+	if (!wBlock) return;
+	Header* block = (Header*)wBlock - 1;
+	ObjectPool* pool = block->mPool;
+	__atomic_sub_fetch(&pool->mInUse,1,__ATOMIC_RELAXED);
+	if (block->mIndex==sHeapIndex) {
+		__atomic_sub_fetch(&pool->mHeapInUse,1,__ATOMIC_RELAXED);
+		::operator delete(block);
+		return;
+	}
+	pool->push(block,block);
+}
+
+
+void ObjectPool::report(ostream& os)
+{
+	ScopedLock lock(poolRegistryLock());
+	os << setw(12) << left << "pool" << right
+		<< setw(7) << "size" << setw(10) << "capacity" << setw(10) << "in use"
+		<< setw(10) << "peak" << setw(10) << "on heap" << setw(14) << "allocations" << endl;
+	for (const ObjectPool* pool = sPools; pool; pool = pool->mNextPool) {
+		os << setw(12) << left << pool->name() << right
+			<< setw(7) << pool->blockSize()
+			<< setw(10) << pool->capacity()
+			<< setw(10) << pool->inUse()
+			<< setw(10) << pool->peak()
+			<< setw(10) << pool->heapInUse()
+			<< setw(14) << pool->allocations() << endl;
+	}
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,134 @@
+/**@file Lock-free free-list pools for frequently allocated fixed-size objects. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include "Threads.h"
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+	A pool of fixed-size memory blocks for one class, meant to back its operator new and delete.
+	Blocks are carved from slabs that are never returned to the heap,
+	so allocation and release are a single compare-and-swap on a tagged free-list head
+	and any thread may free a block allocated by any other.
+	Requests larger than the block size, as from a derived class,
+	and requests made once the pool is at its limit, go to the heap.
+*/
+class ObjectPool {
+
+	public:
+
+	static const unsigned sSlabBits = 8;
+	static const unsigned sSlabBlocks = 1<<sSlabBits;	///< blocks carved per slab
+	static const unsigned sMaxSlabs = 1024;
+
+	private:
+
+	/** Precedes every block handed out; sized to keep the block 16-byte aligned. */
+	struct Header {
+		ObjectPool* mPool;
+		uint32_t mIndex;		///< slab and block number, or sHeapIndex
+		uint32_t mNext;			///< free-list link, index+1, 0 at the end
+	};
+
+	static const uint32_t sHeapIndex = 0xffffffff;
+
+	const char* mName;
+	size_t mBlockSize;			///< usable bytes per block
+	size_t mStride;				///< header plus block, rounded up
+	unsigned mMaxSlabs;
+
+	char* mSlabs[sMaxSlabs];
+	volatile unsigned mSlabCount;
+	Mutex mGrowLock;			///< serializes slab allocation only
+
+	volatile uint64_t mFree;	///< free-list head; ABA tag in the high word, index+1 in the low
+
+	/**@name Statistics, updated without locks. */
+	//@{
+	volatile unsigned mInUse;		///< blocks handed out, from slabs or the heap
+	volatile unsigned mPeak;		///< most blocks handed out at once
+	volatile unsigned mHeapInUse;	///< of those, blocks that came from the heap
+	volatile uint64_t mAllocations;	///< total allocations
+	//@}
+
+	ObjectPool* mNextPool;			///< registry link
+
+	Header* header(uint32_t index) const
+		{ return (Header*)(mSlabs[index>>sSlabBits] + (index&(sSlabBlocks-1))*mStride); }
+
+	/** Push a chain of linked blocks, first to last, onto the free list. */
+	void push(Header* first, Header* last);
+
+	/** Add a slab, returning one of its blocks; NULL if the pool is at its limit. */
+	Header* grow();
+
+	/** Account for a block handed out. */
+	void count(bool fromHeap);
+
+	ObjectPool(const ObjectPool&);
+	void operator=(const ObjectPool&);
+
+	public:
+
+	/**
+		Create a pool and add it to the registry.
+		Pools are meant to live forever, since their blocks may be freed during static destruction.
+		@param wName The name shown in reports; the string is not copied.
+		@param wBlockSize The object size.
+		@param wMaxBlocks Limit of pooled blocks, rounded up to whole slabs.
+	*/
+	ObjectPool(const char* wName, size_t wBlockSize, unsigned wMaxBlocks=sSlabBlocks*64);
+
+	/** Get a block of at least the given size. */
+	void* allocate(size_t size);
+
+	/** Return a block from allocate() of any pool to its owner.  NULL is ignored. */
+	static void release(void* block);
+
+	const char* name() const { return mName; }
+	size_t blockSize() const { return mBlockSize; }
+
+	/** Blocks carved from slabs so far. */
+	unsigned capacity() const { return __atomic_load_n(&mSlabCount,__ATOMIC_RELAXED)*sSlabBlocks; }
+
+	unsigned inUse() const { return __atomic_load_n(&mInUse,__ATOMIC_RELAXED); }
+	unsigned peak() const { return __atomic_load_n(&mPeak,__ATOMIC_RELAXED); }
+	unsigned heapInUse() const { return __atomic_load_n(&mHeapInUse,__ATOMIC_RELAXED); }
+	uint64_t allocations() const { return __atomic_load_n(&mAllocations,__ATOMIC_RELAXED); }
+
+	/** Write one line of occupancy figures for each pool created so far. */
+	static void report(std::ostream& os);
+};
+
+
+#endif
+
+// vim: ts=4 sw=4
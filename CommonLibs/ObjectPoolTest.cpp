@@ -0,0 +1,140 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "ObjectPool.h"
+#include "Interthread.h"
+#include "Timeval.h"
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+
+/** A pooled test object. */
+class Thing {
+
+	public:
+
+	unsigned mSerial;
+	char mFill[60];
+
+	Thing(unsigned wSerial):mSerial(wSerial) { memset(mFill,wSerial&0xff,sizeof(mFill)); }
+
+	bool intact() const
+	{
+		for (unsigned i=0; i<sizeof(mFill); i++) if ((unsigned char)mFill[i]!=(mSerial&0xff)) return false;
+		return true;
+	}
+
+	static ObjectPool& pool()
+	{
+		static ObjectPool* sPool = new ObjectPool("Thing",sizeof(Thing),2048);
+		return *sPool;
+	}
+
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block) { ObjectPool::release(block); }
+};
+
+
+/** A derived class too big for the pool's blocks. */
+class BigThing : public Thing {
+	public:
+	char mMore[100];
+	BigThing():Thing(0) {}
+};
+
+
+static const unsigned sThreads = 4;
+static const unsigned sRounds = 200000;
+static volatile unsigned sCorrupt = 0;
+
+/** Ping-pong objects between threads through a shared FIFO. */
+static InterthreadQueue<Thing> sQ;
+
+static void* producer(void* arg)
+{
+	unsigned base = (unsigned)(long)arg * sRounds;
+	for (unsigned i=0; i<sRounds; i++) {
+		sQ.write(new Thing(base+i));
+		// Free some in place too, so every thread both allocates and releases.
+		Thing* local = new Thing(base+i);
+		if (!local->intact()) __atomic_add_fetch(&sCorrupt,1,__ATOMIC_RELAXED);
+		delete local;
+	}
+	return NULL;
+}
+
+static void* consumer(void*)
+{
+	for (unsigned i=0; i<sThreads*sRounds; i++) {
+		Thing* thing = sQ.read();
+		if (!thing->intact()) __atomic_add_fetch(&sCorrupt,1,__ATOMIC_RELAXED);
+		delete thing;
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	ObjectPool& pool = Thing::pool();
+
+	// Blocks are reused.
+	Thing* a = new Thing(1);
+	delete a;
+	Thing* b = new Thing(2);
+	cout << "reused " << (a==b) << ", in use " << pool.inUse() << ", capacity " << pool.capacity() << endl;
+	delete b;
+
+	// Oversized requests go to the heap and still free correctly.
+	Thing* big = new BigThing;
+	cout << "big on heap " << pool.heapInUse() << endl;
+	delete big;
+
+	// Past the limit, allocations spill to the heap.
+	Thing* many[3000];
+	for (unsigned i=0; i<3000; i++) many[i] = new Thing(i);
+	cout << "3000 live: capacity " << pool.capacity() << ", on heap " << pool.heapInUse() << endl;
+	for (unsigned i=0; i<3000; i++) delete many[i];
+	cout << "after free: in use " << pool.inUse() << ", peak " << pool.peak() << endl;
+
+	// Allocation and release from many threads.
+	Timeval start;
+	Thread threads[sThreads+1];
+	threads[0].start(consumer,NULL);
+	for (unsigned i=0; i<sThreads; i++) threads[i+1].start(producer,(void*)(long)i);
+	for (unsigned i=0; i<=sThreads; i++) threads[i].join();
+	long ms = start.elapsed();
+	cout << 2*sThreads*sRounds << " objects in " << ms << " ms, corrupt " << sCorrupt
+		<< ", in use " << pool.inUse() << endl;
+
+	ObjectPool::report(cout);
+	return (sCorrupt==0 && pool.inUse()==0) ? 0 : 1;
+}
+
+// vim: ts=4 sw=4
@@ -27,6 +27,7 @@
 #include "Logger.h"
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 static const char* createReportingTable = {
 	"CREATE TABLE IF NOT EXISTS REPORTING ("
@@ -39,6 +40,9 @@ static const char* createReportingTable = {
 
 
 ReportingTable::ReportingTable(const char* filename)
+	:mCounters(new ReportingCounter[sNumCounters]()),
+	mFlushThread(NULL),
+	mStopping(false)
 {
 	gLogEarly(LOG_INFO | mFacility, "opening reporting table from path %s", filename);
 	// Connect to the database.
@@ -56,11 +60,83 @@ ReportingTable::ReportingTable(const char* filename)
 }
 
 
+ReportingTable::~ReportingTable()
+{
+	// Stop the flush thread first, so the last flush has the counters and mDB to itself.
+	if (mFlushThread) {
+		mStopLock.lock();
+		mStopping = true;
+		mStopSignal.signal();
+		mStopLock.unlock();
+		mFlushThread->join();
+		delete mFlushThread;
+		mFlushThread = NULL;
+	}
+	flush();
+}
+
+
+/** FNV-1a; names are short and the table is small. */
+static unsigned hashName(const char* name)
+{
+	uint32_t hash = 2166136261U;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+
+ReportingCounter* ReportingTable::find(const char* paramName) const
+{
+	const unsigned mask = sNumCounters-1;
+	unsigned i = hashName(paramName) & mask;
+	for (unsigned probe=0; probe<sNumCounters; probe++) {
+		const char* name = __atomic_load_n(&mCounters[i].mName,__ATOMIC_ACQUIRE);
+		if (!name) return NULL;
+		if (strcmp(name,paramName)==0) return &mCounters[i];
+		i = (i+1) & mask;
+	}
+	return NULL;
+}
+
+
+ReportingCounter* ReportingTable::counter(const char* paramName)
+{
+	if (ReportingCounter* found = find(paramName)) return found;
+	// Not there, so register it.
+	// Names are only ever added, so readers probing without the lock see either NULL or a complete name.
+	ScopedLock lock(mRegistryLock);
+	const unsigned mask = sNumCounters-1;
+	unsigned i = hashName(paramName) & mask;
+	for (unsigned probe=0; probe<sNumCounters; probe++) {
+		const char* name = mCounters[i].mName;
+		if (!name) {
+			__atomic_store_n(&mCounters[i].mName,strdup(paramName),__ATOMIC_RELEASE);
+			if (!mFlushThread) {
+				mFlushThread = new Thread;
+				mFlushThread->start((void*(*)(void*))ReportingFlushLoopAdapter,this);
+			}
+			return &mCounters[i];
+		}
+		// Another thread may have just registered it.
+		if (strcmp(name,paramName)==0) return &mCounters[i];
+		i = (i+1) & mask;
+	}
+	gLogEarly(LOG_CRIT|mFacility, "reporting table full, cannot add parameter %s", paramName);
+	return NULL;
+}
+
+
 bool ReportingTable::create(const char* paramName)
 {
-	char cmd[200];
-	sprintf(cmd,"INSERT OR IGNORE INTO REPORTING (NAME,CLEAREDTIME) VALUES (\"%s\",%ld)", paramName, time(NULL));
-	if (!sqlite3_command(mDB,cmd)) {
+	if (!counter(paramName)) return false;
+	ScopedLock lock(mDBLock);
+	SQLiteQuery insert(mDB,"INSERT OR IGNORE INTO REPORTING (NAME,CLEAREDTIME) VALUES (?,?)");
+	insert.bind(1,paramName);
+	insert.bind(2,(long)time(NULL));
+	if (!insert.run()) {
 		gLogEarly(LOG_CRIT|mFacility, "cannot create reporting parameter %s, error message: %s", paramName, sqlite3_errmsg(mDB));
 		return false;
 	}
@@ -71,12 +147,16 @@ bool ReportingTable::create(const char* paramName)
 
 bool ReportingTable::incr(const char* paramName)
 {
-	char cmd[200];
-	sprintf(cmd,"UPDATE REPORTING SET VALUE=VALUE+1, UPDATETIME=%ld WHERE NAME=\"%s\"", time(NULL), paramName);
-	if (!sqlite3_command(mDB,cmd)) {
-		gLogEarly(LOG_CRIT|mFacility, "cannot increment reporting parameter %s, error message: %s", paramName, sqlite3_errmsg(mDB));
-		return false;
+	ReportingCounter* ctr = counter(paramName);
+	if (!ctr) return false;
+	// Delta first, then time; flushCounter takes them in the other order so nothing is lost.
+	__atomic_add_fetch(&ctr->mDelta,1,__ATOMIC_RELAXED);
+	// A pending max came before this increment, so it moves up with it.
+	uint64_t oldMax = __atomic_load_n(&ctr->mMax,__ATOMIC_RELAXED);
+	while (oldMax) {
+		if (__atomic_compare_exchange_n(&ctr->mMax,&oldMax,oldMax+1,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) break;
 	}
+	__atomic_store_n(&ctr->mUpdateTime,time(NULL),__ATOMIC_RELEASE);
 	return true;
 }
 
@@ -84,21 +164,30 @@ bool ReportingTable::incr(const char* paramName)
 
 bool ReportingTable::max(const char* paramName, unsigned newVal)
 {
-	char cmd[200];
-	sprintf(cmd,"UPDATE REPORTING SET VALUE=MAX(VALUE,%u), UPDATETIME=%ld WHERE NAME=\"%s\"", newVal, time(NULL), paramName);
-	if (!sqlite3_command(mDB,cmd)) {
-		gLogEarly(LOG_CRIT|mFacility, "cannot maximize reporting parameter %s, error message: %s", paramName, sqlite3_errmsg(mDB));
-		return false;
+	ReportingCounter* ctr = counter(paramName);
+	if (!ctr) return false;
+	uint64_t oldVal = __atomic_load_n(&ctr->mMax,__ATOMIC_RELAXED);
+	while (newVal>oldVal) {
+		if (__atomic_compare_exchange_n(&ctr->mMax,&oldVal,(uint64_t)newVal,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) break;
 	}
+	__atomic_store_n(&ctr->mUpdateTime,time(NULL),__ATOMIC_RELEASE);
 	return true;
 }
 
 
 bool ReportingTable::clear(const char* paramName)
 {
-	char cmd[200];
-	sprintf(cmd,"UPDATE REPORTING SET VALUE=0, UPDATETIME=0, CLEAREDTIME=%ld WHERE NAME=\"%s\"", time(NULL), paramName);
-	if (!sqlite3_command(mDB,cmd)) {
+	ReportingCounter* ctr = counter(paramName);
+	if (!ctr) return false;
+	// Hold the lock so a concurrent flush cannot write pending changes after the clear.
+	ScopedLock lock(mDBLock);
+	SQLiteQuery update(mDB,"UPDATE REPORTING SET VALUE=0, UPDATETIME=0, CLEAREDTIME=? WHERE NAME=?");
+	update.bind(1,(long)time(NULL));
+	update.bind(2,paramName);
+	__atomic_store_n(&ctr->mUpdateTime,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&ctr->mDelta,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&ctr->mMax,0,__ATOMIC_RELAXED);
+	if (!update.run()) {
 		gLogEarly(LOG_CRIT|mFacility, "cannot clear reporting parameter %s, error message: %s", paramName, sqlite3_errmsg(mDB));
 		return false;
 	}
@@ -106,6 +195,93 @@ bool ReportingTable::clear(const char* paramName)
 }
 
 
+/** Run one of the flush updates, which take a value, a time and a name. */
+static bool runUpdate(sqlite3* DB, sqlite3_stmt* stmt, int64_t value, time_t when, const char* name)
+{
+	sqlite3_reset(stmt);
+	sqlite3_bind_int64(stmt,1,value);
+	sqlite3_bind_int64(stmt,2,when);
+	sqlite3_bind_text(stmt,3,name,-1,SQLITE_STATIC);
+	return sqlite3_run_query(DB,stmt)==SQLITE_DONE;
+}
+
+
+bool ReportingTable::flushCounter(ReportingCounter& counter, sqlite3_stmt* incrStmt, sqlite3_stmt* maxStmt) const
+{
+	time_t when = __atomic_exchange_n(&counter.mUpdateTime,0,__ATOMIC_ACQUIRE);
+	if (!when) return true;
+	int64_t delta = __atomic_exchange_n(&counter.mDelta,0,__ATOMIC_RELAXED);
+	uint64_t maxVal = __atomic_exchange_n(&counter.mMax,0,__ATOMIC_RELAXED);
+	// Values are never negative, so max(0) changes nothing but the time.
+	// A pending max already includes the increments after it, so increments go first.
+	bool ok = true;
+	if (delta || !maxVal) ok = runUpdate(mDB,incrStmt,delta,when,counter.mName);
+	if (ok && maxVal) ok = runUpdate(mDB,maxStmt,maxVal,when,counter.mName);
+	if (!ok) {
+		gLogEarly(LOG_CRIT|mFacility, "cannot update reporting parameter %s, error message: %s", counter.mName, sqlite3_errmsg(mDB));
+	}
+	return ok;
+}
+
+
+void ReportingTable::flush() const
+{
+	if (!mDB) return;
+	ScopedLock lock(mDBLock);
+	SQLiteQuery incr(mDB,"UPDATE REPORTING SET VALUE=VALUE+?, UPDATETIME=? WHERE NAME=?");
+	SQLiteQuery max(mDB,"UPDATE REPORTING SET VALUE=MAX(VALUE,?), UPDATETIME=? WHERE NAME=?");
+	if (!incr.valid() || !max.valid()) return;
+	bool inTransaction = false;
+	for (unsigned i=0; i<sNumCounters; i++) {
+		ReportingCounter& ctr = mCounters[i];
+		if (!__atomic_load_n(&ctr.mName,__ATOMIC_ACQUIRE)) continue;
+		if (!__atomic_load_n(&ctr.mUpdateTime,__ATOMIC_ACQUIRE)) continue;
+		if (!inTransaction) {
+			sqlite3_command(mDB,"BEGIN TRANSACTION");
+			inTransaction = true;
+		}
+		flushCounter(ctr,incr.stmt(),max.stmt());
+	}
+	if (!inTransaction) return;
+	sqlite3_command(mDB,"COMMIT");
+}
+
+
+void* ReportingFlushLoopAdapter(ReportingTable* table)
+{
+	table->flushLoop();
+	return NULL;
+}
+
+
+void ReportingTable::flushLoop()
+{
+	ScopedLock lock(mStopLock);
+	while (!mStopping) {
+		mStopSignal.wait(mStopLock,1000*sFlushSeconds);
+		if (mStopping) break;
+		flush();
+	}
+}
+
+
+void ReportingTable::dump(std::ostream& os) const
+{
+	flush();
+	ScopedLock lock(mDBLock);
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(mDB,&stmt,"SELECT NAME,VALUE,CLEAREDTIME,UPDATETIME FROM REPORTING ORDER BY NAME")) return;
+	int src = sqlite3_run_query(mDB,stmt);
+	while (src==SQLITE_ROW) {
+		os << sqlite3_column_text(stmt,0) << " " << sqlite3_column_int64(stmt,1)
+			<< " cleared " << sqlite3_column_int64(stmt,2)
+			<< " updated " << sqlite3_column_int64(stmt,3) << std::endl;
+		src = sqlite3_run_query(mDB,stmt);
+	}
+	sqlite3_finalize(stmt);
+}
+
+
 bool ReportingTable::create(const char* baseName, unsigned minIndex, unsigned maxIndex)
 {
 	size_t sz = strlen(baseName);
@@ -27,12 +27,27 @@
 #define REPORTING_H
 
 #include <sqlite3util.h>
+#include <Threads.h>
 #include <ostream>
+#include <stdint.h>
+#include <time.h>
+
+
+/** One in-memory reporting parameter, updated atomically and flushed in batches. */
+struct ReportingCounter {
+	const char* volatile mName;		///< NULL until registered, then fixed
+	volatile int64_t mDelta;		///< increments since the last flush
+	volatile uint64_t mMax;			///< largest max() value since the last flush, plus later increments; 0 if none
+	volatile time_t mUpdateTime;	///< time of the last change, 0 if none since the last flush
+};
 
 
 /**
 	Collect performance statistics into a database.
 	Parameters are counters or max/min trackers, all integer.
+	incr() and max() only touch an in-memory counter;
+	a background thread writes the accumulated changes to the database
+	every few seconds in a single transaction.
 */
 class ReportingTable {
 
@@ -41,7 +56,29 @@ class ReportingTable {
 	sqlite3* mDB;				///< database connection
 	int mFacility;				///< rsyslogd facility
 
+	static const unsigned sNumCounters = 1024;	///< capacity of mCounters, a power of 2
+	static const unsigned sFlushSeconds = 5;	///< period of the flush thread
+
+	ReportingCounter* mCounters;	///< open-addressed hash table of counters, never freed
+	Mutex mRegistryLock;			///< control for registering new counters
+	mutable Mutex mDBLock;			///< serializes database access, including flushes
+	Thread* mFlushThread;			///< started with the first counter
+	volatile bool mStopping;		///< set by the destructor to stop the flush thread
+	Mutex mStopLock;
+	Signal mStopSignal;				///< wakes the flush thread to stop
+
+	/** Find a registered counter, or return NULL.  Lock-free. */
+	ReportingCounter* find(const char* paramName) const;
+
+	/** Find or register a counter; NULL if the table is full. */
+	ReportingCounter* counter(const char* paramName);
 
+	/** Write one counter's pending changes; caller holds mDBLock. */
+	bool flushCounter(ReportingCounter& counter, sqlite3_stmt* incrStmt, sqlite3_stmt* maxStmt) const;
+
+	void flushLoop();
+
+	friend void* ReportingFlushLoopAdapter(ReportingTable*);
 
 	public:
 
@@ -51,6 +88,9 @@ class ReportingTable {
 	*/
 	ReportingTable(const char* filename);
 
+	/** Stop the flush thread and flush pending changes. */
+	~ReportingTable();
+
 	/** Create a new parameter. */
 	bool create(const char* paramName);
 
@@ -75,11 +115,17 @@ class ReportingTable {
 	/** Clear an indexed value.  */
 	bool clear(const char* paramName, unsigned index);
 
-	/** Dump the database to a stream. */
+	/** Dump the database to a stream, after flushing. */
 	void dump(std::ostream&) const;
 
+	/** Write all pending counter changes to the database now, in one transaction. */
+	void flush() const;
+
 };
 
+
+void* ReportingFlushLoopAdapter(ReportingTable*);
+
 #endif
 
 
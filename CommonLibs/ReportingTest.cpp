@@ -0,0 +1,137 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "Reporting.h"
+#include "Configuration.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+ConfigurationTable gConfig;
+
+static const char* gPath = "/tmp/ReportingTest.db";
+static int failures = 0;
+
+
+/** Read a value back through dump(), which flushes first; -1 if the parameter is missing. */
+static long value(const ReportingTable& table, const char* name)
+{
+	ostringstream os;
+	table.dump(os);
+	istringstream is(os.str());
+	string line;
+	while (getline(is,line)) {
+		istringstream fields(line);
+		string key;
+		long val;
+		fields >> key >> val;
+		if (key==name) return val;
+	}
+	return -1;
+}
+
+static void expect(const ReportingTable& table, const char* name, long wanted, const char* what)
+{
+	long got = value(table,name);
+	cout << what << ": " << name << "=" << got << endl;
+	if (got!=wanted) {
+		failures++;
+		cout << "  expected " << wanted << endl;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	unlink(gPath);
+	{
+		ReportingTable table(gPath);
+		table.create("count");
+		table.create("peak");
+		table.create("mixed");
+		table.create("indexed",0,3);
+
+		// Increments accumulate in memory until the flush.
+		for (int i=0; i<5; i++) table.incr("count");
+		expect(table,"count",5,"incr");
+		table.incr("count");
+		table.flush();
+		expect(table,"count",6,"incr after flush");
+
+		// Max keeps the largest value.
+		table.max("peak",3);
+		table.max("peak",9);
+		table.max("peak",4);
+		expect(table,"peak",9,"max");
+		table.max("peak",2);
+		expect(table,"peak",9,"smaller max");
+
+		// Increments and maxes pending together land as if applied in order.
+		table.max("mixed",10);
+		table.incr("mixed");
+		expect(table,"mixed",11,"max then incr");
+		table.incr("mixed");
+		table.max("mixed",5);
+		expect(table,"mixed",12,"incr then smaller max");
+		table.incr("mixed");
+		table.max("mixed",20);
+		expect(table,"mixed",20,"incr then larger max");
+
+		// Clear discards pending changes too.
+		table.incr("count");
+		table.max("peak",100);
+		table.clear("count");
+		table.clear("peak");
+		expect(table,"count",0,"clear");
+		expect(table,"peak",0,"clear");
+
+		// Indexed parameters.
+		table.incr("indexed",2);
+		table.incr("indexed",2);
+		table.max("indexed",3,7);
+		expect(table,"indexed.2",2,"indexed incr");
+		expect(table,"indexed.3",7,"indexed max");
+		expect(table,"indexed.0",0,"indexed untouched");
+
+		// Left pending for the destructor.
+		table.incr("count");
+		table.incr("count");
+	}
+
+	// The destructor stopped the flush thread and flushed.
+	ReportingTable reopened(gPath);
+	expect(reopened,"count",2,"flushed by destructor");
+	expect(reopened,"mixed",20,"persisted");
+
+	cout << "failures " << failures << endl;
+	return failures ? 1 : 0;
+}
+
+// vim: ts=4 sw=4
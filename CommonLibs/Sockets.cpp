@@ -30,6 +30,7 @@
 #include <fcntl.h>
 #include <cstdio>
 #include <sys/select.h>
+#include <sys/epoll.h>
 
 #include "Threads.h"
 #include "Sockets.h"
@@ -223,6 +224,67 @@ int DatagramSocket::read(char* buffer, unsigned timeout)
 
 
 
+int DatagramSocket::readBatch(char buffers[][MAX_UDP_LENGTH], int lengths[], unsigned count, SocketAddress sources[])
+{
+	assert(count<=MAX_UDP_BATCH);
+	struct mmsghdr msgs[MAX_UDP_BATCH];
+	struct iovec iovs[MAX_UDP_BATCH];
+	memset(msgs,0,count*sizeof(struct mmsghdr));
+	for (unsigned i=0; i<count; i++) {
+		iovs[i].iov_base = buffers[i];
+		iovs[i].iov_len = MAX_UDP_LENGTH;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		// Without a sources array, the last packet's address is the one left in mSource.
+		msgs[i].msg_hdr.msg_name = sources ? sources[i] : mSource;
+		msgs[i].msg_hdr.msg_namelen = sizeof(SocketAddress);
+	}
+	int numRead = recvmmsg(mSocketFD,msgs,count,MSG_DONTWAIT,NULL);
+	if (numRead<0) {
+		if (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR) return 0;
+		perror("DatagramSocket::readBatch() failed");
+		throw SocketError();
+	}
+	for (int i=0; i<numRead; i++) lengths[i] = msgs[i].msg_len;
+	if (sources && numRead>0) memcpy(mSource,sources[numRead-1],sizeof(SocketAddress));
+	return numRead;
+}
+
+
+int DatagramSocket::writeBatch(const char* const buffers[], const size_t lengths[], unsigned count)
+{
+	assert(count<=MAX_UDP_BATCH);
+	struct mmsghdr msgs[MAX_UDP_BATCH];
+	struct iovec iovs[MAX_UDP_BATCH];
+	memset(msgs,0,count*sizeof(struct mmsghdr));
+	for (unsigned i=0; i<count; i++) {
+		assert(lengths[i]<=MAX_UDP_LENGTH);
+		iovs[i].iov_base = (void*)buffers[i];
+		iovs[i].iov_len = lengths[i];
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = mDestination;
+		msgs[i].msg_hdr.msg_namelen = addressSize();
+	}
+	// sendmmsg can stop short, so keep going until everything is sent.
+	unsigned sent = 0;
+	while (sent<count) {
+		int retVal = sendmmsg(mSocketFD,msgs+sent,count-sent,0);
+		if (retVal<0) {
+			if (errno==EINTR) continue;
+			perror("DatagramSocket::writeBatch() failed");
+			return -1;
+		}
+		sent += retVal;
+	}
+	return sent;
+}
+
+
+
+
+
+
 UDPSocket::UDPSocket(unsigned short wSrcPort)
 	:DatagramSocket()
 {
@@ -325,4 +387,149 @@ void UDDSocket::destination(const char* remotePath)
 
 
 
+
+
+
+SocketReactor::SocketReactor()
+	:mNextID(0)
+{
+	mEpollFD = epoll_create(16);
+	if (mEpollFD<0) {
+		perror("epoll_create() failed");
+		throw SocketError();
+	}
+}
+
+
+void SocketReactor::start(unsigned numThreads)
+{
+	assert(numThreads>0);
+	assert(mThreads.size()==0);
+	for (unsigned i=0; i<numThreads; i++) {
+		Thread* thread = new Thread;
+		thread->start((void*(*)(void*))SocketReactorServiceLoopAdapter,this);
+		mThreads.push_back(thread);
+	}
+}
+
+
+void SocketReactor::add(DatagramSocket& socket, DatagramHandler handler, void* context)
+{
+	assert(handler);
+	Registration* registration = new Registration;
+	registration->mSocket = &socket;
+	registration->mHandler = handler;
+	registration->mContext = context;
+	registration->mBusy = false;
+	ScopedLock lock(mLock);
+	uint64_t ID = mNextID++;
+	// One-shot, so only one thread services a socket at a time.
+	struct epoll_event event;
+	memset(&event,0,sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.u64 = ID;
+	if (epoll_ctl(mEpollFD,EPOLL_CTL_ADD,socket.mSocketFD,&event)<0) {
+		perror("SocketReactor::add() failed");
+		delete registration;
+		throw SocketError();
+	}
+	mRegistrations[ID] = registration;
+}
+
+
+void SocketReactor::remove(DatagramSocket& socket)
+{
+	ScopedLock lock(mLock);
+	RegistrationMap::iterator itr = mRegistrations.begin();
+	while (itr!=mRegistrations.end() && itr->second->mSocket!=&socket) ++itr;
+	if (itr==mRegistrations.end()) return;
+	Registration* registration = itr->second;
+	mRegistrations.erase(itr);
+	epoll_ctl(mEpollFD,EPOLL_CTL_DEL,socket.mSocketFD,NULL);
+	while (registration->mBusy) mIdle.wait(mLock);
+	delete registration;
+}
+
+
+size_t SocketReactor::size() const
+{
+	ScopedLock lock(mLock);
+	return mRegistrations.size();
+}
+
+
+void* SocketReactorServiceLoopAdapter(SocketReactor* reactor)
+{
+	reactor->serviceLoop();
+	return NULL;
+}
+
+
+void SocketReactor::serviceLoop()
+{
+	struct epoll_event events[sBatchSize];
+	while (1) {
+		int numEvents = epoll_wait(mEpollFD,events,sBatchSize,-1);
+		if (numEvents<0) {
+			if (errno==EINTR) continue;
+			perror("SocketReactor epoll_wait() failed");
+			throw SocketError();
+		}
+		for (int i=0; i<numEvents; i++) {
+			uint64_t ID = events[i].data.u64;
+			// The socket may have been removed since the event was queued.
+			Registration* registration;
+			{
+				ScopedLock lock(mLock);
+				RegistrationMap::iterator itr = mRegistrations.find(ID);
+				if (itr==mRegistrations.end()) continue;
+				registration = itr->second;
+				registration->mBusy = true;
+			}
+			bool ok = service(*registration);
+			ScopedLock lock(mLock);
+			registration->mBusy = false;
+			if (ok && mRegistrations.count(ID)) {
+				struct epoll_event event;
+				memset(&event,0,sizeof(event));
+				event.events = EPOLLIN | EPOLLONESHOT;
+				event.data.u64 = ID;
+				if (epoll_ctl(mEpollFD,EPOLL_CTL_MOD,registration->mSocket->mSocketFD,&event)<0) {
+					perror("SocketReactor re-arm failed");
+				}
+			}
+			mIdle.broadcast();
+		}
+	}
+}
+
+
+bool SocketReactor::service(Registration& registration)
+{
+	char buffers[sBatchSize][MAX_UDP_LENGTH];
+	int lengths[sBatchSize];
+	SocketAddress sources[sBatchSize];
+	DatagramSocket& socket = *registration.mSocket;
+	// Bound the work per wakeup so one busy socket cannot starve the others.
+	for (unsigned batch=0; batch<sMaxBatches; batch++) {
+		int numRead;
+		try {
+			numRead = socket.readBatch(buffers,lengths,sBatchSize,sources);
+		}
+		catch (SocketError) {
+			CERR("WARNING -- SocketReactor dropping failed socket " << socket.mSocketFD << std::endl);
+			return false;
+		}
+		for (int i=0; i<numRead; i++) {
+			memcpy(socket.mSource,sources[i],sizeof(SocketAddress));
+			registration.mHandler(socket,buffers[i],lengths[i],registration.mContext);
+		}
+		if (numRead<(int)sBatchSize) break;
+	}
+	return true;
+}
+
+
+
+
 // vim:ts=4:sw=4
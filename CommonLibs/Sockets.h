@@ -33,16 +33,26 @@
 #include <sys/un.h>
 #include <errno.h>
 #include <list>
+#include <map>
+#include <vector>
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "Threads.h"
+
 
 
 
 
 #define MAX_UDP_LENGTH 1500
 
+/** Largest number of packets moved by one batched read or write. */
+#define MAX_UDP_BATCH 64
+
+/** Storage for any socket address used by the DatagramSocket classes. */
+typedef char SocketAddress[256];
+
 /** A function to resolve IP host names. */
 bool resolveAddress(struct sockaddr_in *address, const char *host, unsigned short port);
 
@@ -59,8 +69,10 @@ class DatagramSocket {
 protected:
 
 	int mSocketFD;				///< underlying file descriptor
-	char mDestination[256];		///< address to which packets are sent
-	char mSource[256];		///< return address of most recent received packet
+	SocketAddress mDestination;		///< address to which packets are sent
+	SocketAddress mSource;		///< return address of most recent received packet
+
+	friend class SocketReactor;
 
 public:
 
@@ -118,6 +130,26 @@ public:
 	*/
 	int read(char* buffer, unsigned timeout);
 
+	/**
+		Receive up to count waiting packets with one system call, without blocking.
+		mSource is left as the return address of the last packet.
+		@param buffers count char[MAX_UDP_LENGTH] procured by the caller.
+		@param lengths Receives the length of each packet.
+		@param count Number of buffers, at most MAX_UDP_BATCH.
+		@param sources If not NULL, receives the return address of each packet.
+		@return The number of packets received, 0 if none were waiting.
+	*/
+	int readBatch(char buffers[][MAX_UDP_LENGTH], int lengths[], unsigned count, SocketAddress sources[]=NULL);
+
+	/**
+		Send count packets to mDestination with one system call.
+		@param buffers The packets.
+		@param lengths Length of each packet.
+		@param count Number of packets, at most MAX_UDP_BATCH.
+		@return The number of packets sent, or -1 on error.
+	*/
+	int writeBatch(const char* const buffers[], const size_t lengths[], unsigned count);
+
 
 	/** Send a packet to a given destination, other than the default. */
 	int send(const struct sockaddr *dest, const char * buffer, size_t length);
@@ -134,6 +166,9 @@ public:
 	/** Close the socket. */
 	void close();
 
+	/** The underlying file descriptor. */
+	int fd() const { return mSocketFD; }
+
 };
 
 
@@ -186,6 +221,83 @@ public:
 };
 
 
+
+
+/** Called by a SocketReactor for each packet received on a registered socket. */
+typedef void (*DatagramHandler)(DatagramSocket& socket, char* buffer, int length, void* context);
+
+
+/**
+	Service many datagram sockets from a small pool of threads.
+	Sockets are watched with epoll and drained with batched reads,
+	so the number of threads does not grow with the number of sockets.
+	Each socket is serviced by at most one thread at a time,
+	so its handler sees its packets in order and need not be reentrant,
+	and the socket's source() is the return address of the packet being handled.
+	A registered socket should not also be read directly.
+	The service threads run forever, so a started reactor must never be destroyed.
+*/
+class SocketReactor {
+
+	public:
+
+	static const unsigned sBatchSize = 16;		///< packets read per system call
+	static const unsigned sMaxBatches = 4;		///< batches read from one socket before servicing others
+
+	private:
+
+	/** One registered socket. */
+	class Registration {
+		public:
+		DatagramSocket* mSocket;
+		DatagramHandler mHandler;
+		void* mContext;
+		bool mBusy;			///< true while a service thread is reading this socket
+	};
+
+	typedef std::map<uint64_t,Registration*> RegistrationMap;
+
+	int mEpollFD;
+	RegistrationMap mRegistrations;	///< indexed by registration ID, which is never reused
+	uint64_t mNextID;
+	mutable Mutex mLock;
+	Signal mIdle;					///< signaled when a registration stops being busy
+	std::vector<Thread*> mThreads;
+
+	void serviceLoop();
+
+	/** Drain a socket and re-arm it; return false if it failed. */
+	bool service(Registration& registration);
+
+	friend void* SocketReactorServiceLoopAdapter(SocketReactor*);
+
+	public:
+
+	SocketReactor();
+
+	/** Start the service threads. */
+	void start(unsigned numThreads=1);
+
+	/** Register a socket; the handler is called for each packet received. */
+	void add(DatagramSocket& socket, DatagramHandler handler, void* context=NULL);
+
+	/**
+		Unregister a socket, waiting for any handler in progress on it to finish.
+		Do not call this from the socket's own handler.
+	*/
+	void remove(DatagramSocket& socket);
+
+	/** Number of registered sockets. */
+	size_t size() const;
+
+	/** Number of service threads. */
+	size_t threads() const { return mThreads.size(); }
+};
+
+
+void* SocketReactorServiceLoopAdapter(SocketReactor*);
+
+
 #endif
 
 
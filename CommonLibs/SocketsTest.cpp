@@ -30,6 +30,7 @@
 #include "Threads.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 static const int gNumToSend = 10;
@@ -74,8 +75,45 @@ void *testReaderUnix(void *)
 }
 
 
+static volatile int gReactorCount = 0;
+
+void reactorHandler(DatagramSocket& socket, char* buffer, int length, void* context)
+{
+	COUT("reactor " << (const char*)context << " read: " << buffer << std::endl);
+	gReactorCount++;
+}
+
+
+void testReactor()
+{
+	// Two sockets serviced by one reactor thread, fed with batched writes.
+	// The reactor's thread runs forever, so the reactor is never deleted.
+	SocketReactor& reactor = *new SocketReactor;
+	UDPSocket reactorSocketA(5935);
+	UDPSocket reactorSocketB(5936);
+	reactor.add(reactorSocketA,reactorHandler,(void*)"A");
+	reactor.add(reactorSocketB,reactorHandler,(void*)"B");
+	reactor.start(1);
+	UDPSocket batchSocketA(0,"127.0.0.1",5935);
+	UDPSocket batchSocketB(0,"127.0.0.1",5936);
+	const char* batch[gNumToSend];
+	size_t lengths[gNumToSend];
+	for (int i=0; i<gNumToSend; i++) {
+		batch[i] = "Hello reactor";
+		lengths[i] = strlen(batch[i])+1;
+	}
+	batchSocketA.writeBatch(batch,lengths,gNumToSend);
+	batchSocketB.writeBatch(batch,lengths,gNumToSend);
+	sleep(1);
+	COUT("reactor packets: " << gReactorCount << " of " << 2*gNumToSend << std::endl);
+	reactor.remove(reactorSocketA);
+	reactor.remove(reactorSocketB);
+}
+
+
 int main(int argc, char * argv[] )
 {
+  testReactor();
 
   Thread readerThreadIP;
   readerThreadIP.start(testReaderIP,NULL);
@@ -30,6 +30,10 @@
 #include "Threads.h"
 #include "Timeval.h"
 
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
 
 using namespace std;
 
@@ -103,6 +107,30 @@ void Signal::wait(Mutex& wMutex, unsigned timeout) const
 }
 
 
+void FutexSignal::wait(int wSequence)
+{
+	syscall(SYS_futex,&mSequence,FUTEX_WAIT_PRIVATE,wSequence,NULL,NULL,0);
+}
+
+
+void FutexSignal::wait(int wSequence, long timeout)
+{
+	if (timeout>0) {
+		// FUTEX_WAIT takes a relative timeout.
+		struct timespec waitTime;
+		waitTime.tv_sec = timeout / 1000;
+		waitTime.tv_nsec = (timeout % 1000) * 1000000;
+		syscall(SYS_futex,&mSequence,FUTEX_WAIT_PRIVATE,wSequence,&waitTime,NULL,0);
+	}
+}
+
+
+void FutexSignal::wake()
+{
+	syscall(SYS_futex,&mSequence,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+}
+
+
 void Thread::start(void *(*task)(void*), void *arg)
 {
 	assert(mThread==((pthread_t)0));
@@ -138,6 +138,57 @@ class Signal {
 
 
 
+/**
+	A wakeup for lock-free structures, using a Linux futex to park waiters.
+	A waiter calls prepareWait(), re-checks its condition, then calls wait() or cancelWait().
+	A signal() between prepareWait() and wait() is not lost.
+	signal() makes no system call unless someone has prepared to wait since the last one.
+*/
+class FutexSignal {
+
+	private:
+
+	volatile int mSequence;		///< bumped by each signal that has waiters
+	volatile int mWaiting;		///< set by waiters, cleared by the signal that wakes them
+
+	public:
+
+	FutexSignal() :mSequence(0),mWaiting(0) {}
+
+	/** Register as a waiter; return the sequence number to pass to wait(). */
+	int prepareWait()
+	{
+		__atomic_store_n(&mWaiting,1,__ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		return __atomic_load_n(&mSequence,__ATOMIC_SEQ_CST);
+	}
+
+	/** Withdraw from prepareWait() without blocking. At worst, the next signal() makes a spare wake call. */
+	void cancelWait() {}
+
+	/** Block until signalled after prepareWait() returned wSequence. Spurious returns are possible. */
+	void wait(int wSequence);
+
+	/** Block until signalled or the timeout in ms. Spurious returns are possible. */
+	void wait(int wSequence, long timeout);
+
+	/** Wake all waiters. */
+	void signal()
+	{
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&mWaiting,__ATOMIC_SEQ_CST)==0) return;
+		if (__atomic_exchange_n(&mWaiting,0,__ATOMIC_SEQ_CST)==0) return;
+		__atomic_add_fetch(&mSequence,1,__ATOMIC_SEQ_CST);
+		wake();
+	}
+
+	private:
+
+	void wake();
+};
+
+
+
 #define START_THREAD(thread,function,argument) \
 	thread.start((void *(*)(void*))function, (void*)argument);
 
@@ -170,6 +221,9 @@ class Thread {
 	/** Join a thread that will stop on its own. */
 	void join() { int s = pthread_join(mThread,NULL); assert(!s); }
 
+	/** Release a thread that will stop on its own without joining it. */
+	void detach() { int s = pthread_detach(mThread); assert(!s); }
+
 };
 
 
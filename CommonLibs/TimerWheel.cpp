@@ -0,0 +1,273 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "TimerWheel.h"
+#include <time.h>
+#include <assert.h>
+
+
+
+TimerWheel::TimerWheel()
+	:mWakeTick(0),mArmedCount(0),
+	mRunning(NULL),mThread(NULL)
+{
+	for (unsigned level=0; level<sLevels; level++) mOccupied[level]=0;
+	mNow = ticks();
+}
+
+
+TimerWheel& TimerWheel::wheel()
+{
+	// Never destroyed, so timers can be cancelled from static destructors.
+	static TimerWheel* sWheel = new TimerWheel;
+	return *sWheel;
+}
+
+
+uint64_t TimerWheel::ticks()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec*1000 + now.tv_nsec/1000000;
+}
+
+
+void TimerWheel::file(TimerWheelEntry& entry, uint64_t earliest)
+{
+	uint64_t expiry = entry.mExpiry;
+	if (expiry<earliest) expiry = earliest;
+	uint64_t delta = expiry - mNow;
+	// Find the lowest level whose span covers the delay.
+	unsigned level = 0;
+	while (level<sLevels-1 && delta>=(1ULL<<(sSlotBits*(level+1)))) level++;
+	// Beyond the last level, park at the horizon and re-file on the cascade.
+	uint64_t horizon = 1ULL<<(sSlotBits*sLevels);
+	if (delta>=horizon) expiry = mNow + horizon - 1;
+	unsigned index = (expiry>>(sSlotBits*level)) & (sSlots-1);
+
+	TimerWheelEntry& head = mSlots[level][index];
+	entry.mNext = &head;
+	entry.mPrev = head.mPrev;
+	head.mPrev->mNext = &entry;
+	head.mPrev = &entry;
+	entry.mLevel = level;
+	entry.mIndex = index;
+	mOccupied[level] |= 1ULL<<index;
+}
+
+
+void TimerWheel::unfile(TimerWheelEntry& entry)
+{
+	entry.mPrev->mNext = entry.mNext;
+	entry.mNext->mPrev = entry.mPrev;
+	entry.mNext = &entry;
+	entry.mPrev = &entry;
+	if (entry.mLevel<sLevels) {
+		const TimerWheelEntry& head = mSlots[entry.mLevel][entry.mIndex];
+		if (head.mNext==&head) mOccupied[entry.mLevel] &= ~(1ULL<<entry.mIndex);
+	}
+}
+
+
+void TimerWheel::cascade(unsigned level, unsigned index)
+{
+	TimerWheelEntry& head = mSlots[level][index];
+	while (head.mNext!=&head) {
+		TimerWheelEntry& entry = *head.mNext;
+		unfile(entry);
+		// Anything due now lands in the level 0 slot about to be processed.
+		file(entry,mNow);
+	}
+}
+
+
+void TimerWheel::advance(uint64_t now)
+{
+	if (mArmedCount==0) {
+		mNow = now;
+		return;
+	}
+	while (mNow<now) {
+		// Skip the rest of an empty level 0 revolution.
+		if (mOccupied[0]==0) {
+			uint64_t last = mNow | (sSlots-1);
+			if (last>=now) {
+				mNow = now;
+				return;
+			}
+			mNow = last;
+		}
+		mNow++;
+		unsigned index = mNow & (sSlots-1);
+		if (index==0) {
+			// Pull down the next slot of each higher level that wrapped.
+			for (unsigned level=1; level<sLevels; level++) {
+				unsigned upper = (mNow>>(sSlotBits*level)) & (sSlots-1);
+				cascade(level,upper);
+				if (upper!=0) break;
+			}
+		}
+		TimerWheelEntry& head = mSlots[0][index];
+		while (head.mNext!=&head) {
+			TimerWheelEntry& entry = *head.mNext;
+			unfile(entry);
+			entry.mNext = &mDue;
+			entry.mPrev = mDue.mPrev;
+			mDue.mPrev->mNext = &entry;
+			mDue.mPrev = &entry;
+			entry.mLevel = sLevels;
+		}
+	}
+}
+
+
+uint64_t TimerWheel::nextTick() const
+{
+	if (mArmedCount==0) return 0;
+	// The next occupied level 0 slot in this revolution,
+	// otherwise the start of the next revolution, where cascades happen.
+	unsigned index = mNow & (sSlots-1);
+	if (index<sSlots-1) {
+		uint64_t later = mOccupied[0] >> (index+1);
+		if (later) return mNow + 1 + __builtin_ctzll(later);
+	}
+	return (mNow | (sSlots-1)) + 1;
+}
+
+
+void* TimerWheelServiceLoopAdapter(TimerWheel* wheel)
+{
+	wheel->serviceLoop();
+	return NULL;
+}
+
+
+void TimerWheel::serviceLoop()
+{
+	ScopedLock lock(mLock);
+	mServiceThreadID = pthread_self();
+	while (true) {
+		advance(ticks());
+
+		// Deliver expirations one at a time, so that an entry
+		// cancelled during another's callback is never touched again.
+		bool fired = false;
+		while (mDue.mNext!=&mDue) {
+			TimerWheelEntry& entry = *mDue.mNext;
+			unfile(entry);
+			entry.mArmed = false;
+			mArmedCount--;
+			__atomic_store_n(&entry.mFired,true,__ATOMIC_RELEASE);
+			fired = true;
+			if (!entry.mCallback) continue;
+			mRunning = &entry;
+			TimerCallback callback = entry.mCallback;
+			void* context = entry.mContext;
+			mLock.unlock();
+			callback(context);
+			mLock.lock();
+			mRunning = NULL;
+			mCallbackDone.broadcast();
+		}
+		if (fired) mFiredSignal.broadcast();
+
+		// Sleep until the next possible expiration.
+		mWakeTick = nextTick();
+		if (mWakeTick==0) {
+			mServiceSignal.wait(mLock);
+			continue;
+		}
+		uint64_t now = ticks();
+		if (mWakeTick>now) mServiceSignal.wait(mLock,mWakeTick-now);
+	}
+}
+
+
+void TimerWheel::arm(TimerWheelEntry& entry, long ms)
+{
+	if (ms<0) ms=0;
+	ScopedLock lock(mLock);
+	if (entry.mArmed) unfile(entry);
+	else mArmedCount++;
+	// Round up a partial tick so that a timer never fires early.
+	entry.mExpiry = ticks() + ms + 1;
+	entry.mArmed = true;
+	__atomic_store_n(&entry.mFired,false,__ATOMIC_RELEASE);
+	// The current tick's slot was already processed.
+	file(entry,mNow+1);
+	if (!mThread) {
+		mThread = new Thread;
+		mThread->start((void*(*)(void*))TimerWheelServiceLoopAdapter,this);
+		return;
+	}
+	if (mWakeTick==0 || entry.mExpiry<mWakeTick) mServiceSignal.signal();
+}
+
+
+void TimerWheel::cancel(TimerWheelEntry& entry)
+{
+	ScopedLock lock(mLock);
+	if (entry.mArmed) {
+		unfile(entry);
+		entry.mArmed = false;
+		mArmedCount--;
+		mFiredSignal.broadcast();
+	}
+	// A callback may cancel its own entry.
+	while (mRunning==&entry && !pthread_equal(pthread_self(),mServiceThreadID)) {
+		mCallbackDone.wait(mLock);
+	}
+}
+
+
+void TimerWheel::expire(TimerWheelEntry& entry)
+{
+	ScopedLock lock(mLock);
+	if (entry.mArmed) {
+		unfile(entry);
+		entry.mArmed = false;
+		mArmedCount--;
+	}
+	__atomic_store_n(&entry.mFired,true,__ATOMIC_RELEASE);
+	mFiredSignal.broadcast();
+}
+
+
+void TimerWheel::wait(const TimerWheelEntry& entry) const
+{
+	ScopedLock lock(mLock);
+	while (entry.mArmed && !entry.fired()) mFiredSignal.wait(mLock);
+}
+
+
+unsigned TimerWheel::size() const
+{
+	ScopedLock lock(mLock);
+	return mArmedCount;
+}
+
+
+// vim: ts=4 sw=4
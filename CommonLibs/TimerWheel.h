@@ -0,0 +1,165 @@
+/**@file Hierarchical timer wheel for millisecond protocol timers. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "Threads.h"
+#include <stdint.h>
+
+
+/** A callback for an expired timer, run on the wheel's thread. */
+typedef void (*TimerCallback)(void* context);
+
+
+/**
+	One timer in the TimerWheel, embedded in its owner.
+	An entry must be cancelled or expired before it is destroyed.
+*/
+class TimerWheelEntry {
+
+	private:
+
+	friend class TimerWheel;
+
+	/**@name Wheel linkage, protected by the wheel's lock. */
+	//@{
+	TimerWheelEntry* mNext;
+	TimerWheelEntry* mPrev;
+	uint64_t mExpiry;			///< expiration tick, in wheel milliseconds
+	unsigned mLevel;			///< wheel level of the entry's slot, or sLevels if due
+	unsigned mIndex;			///< slot index in the level
+	volatile bool mArmed;
+	//@}
+
+	volatile bool mFired;		///< set by the wheel on expiration, cleared by arm()
+
+	TimerCallback mCallback;	///< optional, run without the wheel's lock
+	void* mContext;
+
+	public:
+
+	TimerWheelEntry(TimerCallback wCallback=NULL, void* wContext=NULL)
+		:mNext(this),mPrev(this),mExpiry(0),mLevel(0),mIndex(0),mArmed(false),mFired(false),
+		mCallback(wCallback),mContext(wContext)
+	{ }
+
+	/** True if the entry has expired since it was last armed. */
+	bool fired() const { return __atomic_load_n(&mFired,__ATOMIC_ACQUIRE); }
+
+	/** True if the entry is waiting to expire. */
+	bool armed() const { return mArmed; }
+};
+
+
+/**
+	A hierarchical timing wheel with millisecond ticks.
+	Arming and cancelling are O(1), expiration costs nothing until an entry is due,
+	and the service thread sleeps when no timers are armed.
+	Expiration is delivered by setting the entry's fired flag,
+	by running its callback, and by waking threads blocked in wait().
+*/
+class TimerWheel {
+
+	public:
+
+	static const unsigned sSlotBits = 6;
+	static const unsigned sSlots = 1<<sSlotBits;		///< slots per level
+	static const unsigned sLevels = 5;					///< covers about 12 days; longer timers are re-filed
+
+	private:
+
+	/** Slot list heads; each is a circular list through a dummy entry. */
+	TimerWheelEntry mSlots[sLevels][sSlots];
+	TimerWheelEntry mDue;			///< expired entries not yet delivered
+	uint64_t mOccupied[sLevels];	///< bitmap of non-empty slots at each level
+	uint64_t mNow;					///< last tick processed
+	uint64_t mWakeTick;				///< tick the service thread will next wake for
+	unsigned mArmedCount;
+
+	mutable Mutex mLock;
+	Signal mServiceSignal;			///< wakes the service thread for an earlier expiration
+	Signal mFiredSignal;			///< broadcast after each batch of expirations
+	Signal mCallbackDone;			///< signals the end of a callback
+	const TimerWheelEntry* mRunning;	///< entry whose callback is running, if any
+	pthread_t mServiceThreadID;
+	Thread* mThread;
+
+	/** The wheel's clock, in milliseconds. */
+	static uint64_t ticks();
+
+	/** Put an armed entry into its slot, no earlier than the given tick; caller holds mLock. */
+	void file(TimerWheelEntry& entry, uint64_t earliest);
+
+	/** Take an entry out of its slot; caller holds mLock. */
+	void unfile(TimerWheelEntry& entry);
+
+	/** Re-file the entries of a higher-level slot; caller holds mLock. */
+	void cascade(unsigned level, unsigned index);
+
+	/** Process ticks up to now, moving expired entries to mDue; caller holds mLock. */
+	void advance(uint64_t now);
+
+	/** The next tick with possible work, or 0 if the wheel is empty; caller holds mLock. */
+	uint64_t nextTick() const;
+
+	void serviceLoop();
+
+	friend void* TimerWheelServiceLoopAdapter(TimerWheel*);
+
+	public:
+
+	TimerWheel();
+
+	/** The wheel shared by all Z100Timers, created on first use. */
+	static TimerWheel& wheel();
+
+	/** Arm or re-arm an entry to expire after a number of milliseconds. */
+	void arm(TimerWheelEntry& entry, long ms);
+
+	/**
+		Disarm an entry.
+		If its callback is running on another thread, wait for it to finish.
+	*/
+	void cancel(TimerWheelEntry& entry);
+
+	/** Mark an entry expired now, without running its callback. */
+	void expire(TimerWheelEntry& entry);
+
+	/** Block until an entry fires or is cancelled. */
+	void wait(const TimerWheelEntry& entry) const;
+
+	/** Number of armed entries. */
+	unsigned size() const;
+};
+
+
+void* TimerWheelServiceLoopAdapter(TimerWheel*);
+
+
+#endif
+
+// vim: ts=4 sw=4
@@ -0,0 +1,113 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "TimerWheel.h"
+#include "Timeval.h"
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+
+static volatile int sCallbacks = 0;
+
+static void countCallback(void*)
+{
+	__atomic_add_fetch(&sCallbacks,1,__ATOMIC_RELAXED);
+}
+
+
+int main(int argc, char *argv[])
+{
+	TimerWheel& wheel = TimerWheel::wheel();
+
+	// Timers spread over several wheel levels, none may fire early.
+	const unsigned count = 1000;
+	TimerWheelEntry* entries = new TimerWheelEntry[count];
+	long* limits = new long[count];
+	Timeval start;
+	for (unsigned i=0; i<count; i++) {
+		limits[i] = (i*37)%5000;
+		wheel.arm(entries[i],limits[i]);
+	}
+	cout << wheel.size() << " timers armed" << endl;
+
+	long worst = 0;
+	unsigned early = 0;
+	unsigned done = 0;
+	bool* seen = new bool[count];
+	for (unsigned i=0; i<count; i++) seen[i]=false;
+	while (done<count) {
+		usleep(500);
+		long now = start.elapsed();
+		for (unsigned i=0; i<count; i++) {
+			if (seen[i] || !entries[i].fired()) continue;
+			seen[i] = true;
+			done++;
+			if (now<limits[i]) early++;
+			long late = now - limits[i];
+			if (late>worst) worst = late;
+		}
+	}
+	cout << "fired " << done << ", early " << early << ", worst late " << worst << " ms" << endl;
+
+	// Cancelled timers never fire.
+	for (unsigned i=0; i<count; i++) wheel.arm(entries[i],100);
+	for (unsigned i=0; i<count; i+=2) wheel.cancel(entries[i]);
+	usleep(200000);
+	unsigned fired = 0;
+	for (unsigned i=0; i<count; i++) if (entries[i].fired()) fired++;
+	cout << "fired after cancel " << fired << " of " << count << endl;
+
+	// Blocking wait.
+	TimerWheelEntry single;
+	Timeval waitStart;
+	wheel.arm(single,250);
+	wheel.wait(single);
+	cout << "waited " << waitStart.elapsed() << " ms for a 250 ms timer" << endl;
+
+	// Forced expiration.
+	wheel.arm(single,100000);
+	wheel.expire(single);
+	cout << "expired " << single.fired() << " armed " << single.armed() << endl;
+
+	// Callbacks.
+	for (unsigned i=0; i<10; i++) {
+		TimerWheelEntry* callback = new TimerWheelEntry(countCallback,NULL);
+		wheel.arm(*callback,10*i);
+	}
+	usleep(200000);
+	cout << sCallbacks << " callbacks, " << wheel.size() << " timers armed" << endl;
+
+	// Arming cost.
+	Timeval armStart;
+	for (unsigned j=0; j<1000; j++)
+		for (unsigned i=0; i<count; i++) wheel.arm(entries[i],(i*7919+j)%60000);
+	cout << "1M arms in " << armStart.elapsed() << " ms" << endl;
+	for (unsigned i=0; i<count; i++) wheel.cancel(entries[i]);
+	cout << wheel.size() << " timers armed" << endl;
+}
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <iostream>
 #include <assert.h>
+#include <utility>
 
 
 /**
@@ -91,6 +92,21 @@ template <class T> class Vector {
 		memcpy(mData,other.mStart,other.bytes());
 	}
 
+	protected:
+
+	/** Take the data block of another Vector, which is left empty; caller has cleared this one. */
+	void take(Vector<T>& other)
+	{
+		mData=other.mData;
+		mStart=other.mStart;
+		mEnd=other.mEnd;
+		other.mData=NULL;
+		other.mStart=NULL;
+		other.mEnd=NULL;
+	}
+
+	public:
+
 
 
 
@@ -107,6 +123,16 @@ template <class T> class Vector {
 	/** Build a Vector by copying another. */
 	Vector(const Vector<T>& other):mData(NULL) { clone(other); }
 
+	/**
+		Build a Vector from a temporary, taking its data block.
+		An alias owns nothing to take, so it is copied, as it was before moves.
+	*/
+	Vector(Vector<T>&& other):mData(NULL)
+	{
+		if (other.mData==NULL) clone(other);
+		else take(other);
+	}
+
 	/** Build a Vector with explicit values. */
 	Vector(T* wData, T* wStart, T* wEnd)
 		:mData(wData),mStart(wStart),mEnd(wEnd)
@@ -149,6 +175,46 @@ template <class T> class Vector {
 	/** Assign from another Vector, copying. */
 	void operator=(const Vector<T>& other) { clone(other); }
 
+	/** Assign from a temporary, taking its data block; aliases are copied. */
+	void operator=(Vector<T>&& other)
+	{
+		if (&other==this) return;
+		if (other.mData==NULL) clone(other);
+		else {
+			clear();
+			take(other);
+		}
+	}
+
+	//@}
+
+
+	/**@name Ownership. */
+	//@{
+
+	/** True if this Vector owns its data block and will delete it. */
+	bool owner() const { return mData!=NULL; }
+
+	/** Return a non-owning alias of this whole Vector. */
+	Vector<T> alias() { return segment(0,size()); }
+
+	/** Exchange data blocks with another Vector. */
+	void swap(Vector<T>& other)
+	{
+		std::swap(mData,other.mData);
+		std::swap(mStart,other.mStart);
+		std::swap(mEnd,other.mEnd);
+	}
+
+	/** Narrow this Vector to one of its segments, in place, keeping ownership of the block. */
+	void narrow(size_t start, size_t span)
+	{
+		T* wStart = mStart + start;
+		assert(wStart+span<=mEnd);
+		mStart = wStart;
+		mEnd = wStart + span;
+	}
+
 	//@}
 
 
@@ -59,5 +59,21 @@ int main(int argc, char *argv[])
 		cout << testD << endl;
 	}
 
+	{
+		// Moving an owner takes its block; moving an alias copies.
+		TestVector testE(test1,test2);
+		const int* block = testE.begin();
+		TestVector testF(std::move(testE));
+		cout << "moved owner " << (testF.begin()==block) << " " << testE.size() << " " << testF << endl;
+		TestVector testG(std::move(testF.segment(2,4)));
+		cout << "moved alias " << testG.owner() << " " << (testG.begin()!=testF.begin()+2) << " " << testG << endl;
+		testF.narrow(5,3);
+		cout << "narrowed " << testF.owner() << " " << testF << endl;
+		testG.swap(testF);
+		cout << "swapped " << testF << " / " << testG << endl;
+		testG = TestVector(test2);
+		cout << "assigned " << testG << endl;
+	}
+
 	return 0;
 }
@@ -6,10 +6,14 @@
 
 #include "sqlite3.h"
 #include "sqlite3util.h"
+#include "Threads.h"
 
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
 
 
 // Wrappers to sqlite operations.
@@ -47,20 +51,94 @@ int sqlite3_run_query(sqlite3* DB, sqlite3_stmt *stmt)
 }
 
 
+// The statement cache.
+// Each SQL text maps to a list of idle statements, so that
+// two threads can run the same query on one connection at once.
+
+typedef std::map<std::string,std::vector<sqlite3_stmt*> > StatementCache;
+typedef std::map<sqlite3*,StatementCache> StatementCacheTable;
+
+/** Most idle statements kept per connection; extras are finalized on release. */
+static const unsigned sMaxCachedStatements = 128;
+
+// Constructed on first use, since configuration lookups can happen during static initialization.
+static Mutex& statementCacheLock()
+{
+	static Mutex* sLock = new Mutex;
+	return *sLock;
+}
+
+static StatementCacheTable& statementCaches()
+{
+	static StatementCacheTable* sCaches = new StatementCacheTable;
+	return *sCaches;
+}
+
+
+sqlite3_stmt* sqlite3_cached_statement(sqlite3* DB, const char* query)
+{
+	{
+		ScopedLock lock(statementCacheLock());
+		StatementCache& cache = statementCaches()[DB];
+		StatementCache::iterator where = cache.find(query);
+		if (where!=cache.end() && where->second.size()) {
+			sqlite3_stmt* stmt = where->second.back();
+			where->second.pop_back();
+			return stmt;
+		}
+	}
+	// Prepare without the lock; this is the expensive part.
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(DB,&stmt,query)) return NULL;
+	return stmt;
+}
+
+
+void sqlite3_release_statement(sqlite3* DB, sqlite3_stmt* stmt)
+{
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	ScopedLock lock(statementCacheLock());
+	StatementCache& cache = statementCaches()[DB];
+	unsigned count = 0;
+	for (StatementCache::const_iterator i=cache.begin(); i!=cache.end(); ++i) count += i->second.size();
+	if (count>=sMaxCachedStatements) {
+		sqlite3_finalize(stmt);
+		return;
+	}
+	cache[sqlite3_sql(stmt)].push_back(stmt);
+}
+
+
+void sqlite3_finalize_cached(sqlite3* DB)
+{
+	ScopedLock lock(statementCacheLock());
+	StatementCacheTable::iterator where = statementCaches().find(DB);
+	if (where==statementCaches().end()) return;
+	StatementCache& cache = where->second;
+	for (StatementCache::iterator i=cache.begin(); i!=cache.end(); ++i) {
+		for (unsigned j=0; j<i->second.size(); j++) sqlite3_finalize(i->second[j]);
+	}
+	statementCaches().erase(where);
+}
+
+
+
+
+// The lookup helpers build their templates from table and column names only.
+// Key values are bound as parameters.
+
 bool sqlite3_exists(sqlite3* DB, const char *tableName,
 		const char* keyName, const char* keyData)
 {
-	size_t stringSize = 100 + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT * FROM %s WHERE %s == \"%s\"",tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
-	// Read the result.
-	int src = sqlite3_run_query(DB,stmt);
-	sqlite3_finalize(stmt);
+	sprintf(query,"SELECT 1 FROM %s WHERE %s == ?",tableName,keyName);
+	SQLiteQuery lookup(DB,query);
+	if (!lookup.valid()) return false;
+	lookup.bind(1,keyData);
 	// Anything there?
-	return (src == SQLITE_ROW);
+	return (lookup.step() == SQLITE_ROW);
 }
 
 
@@ -69,21 +147,16 @@ bool sqlite3_single_lookup(sqlite3* DB, const char *tableName,
 		const char* keyName, const char* keyData,
 		const char* valueName, unsigned &valueData)
 {
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == \"%s\"",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	SQLiteQuery lookup(DB,query);
+	if (!lookup.valid()) return false;
+	lookup.bind(1,keyData);
 	// Read the result.
-	int src = sqlite3_run_query(DB,stmt);
-	bool retVal = false;
-	if (src == SQLITE_ROW) {
-		valueData = (unsigned)sqlite3_column_int64(stmt,0);
-		retVal = true;
-	}
-	sqlite3_finalize(stmt);
-	return retVal;
+	if (lookup.step() != SQLITE_ROW) return false;
+	valueData = (unsigned)sqlite3_column_int64(lookup.stmt(),0);
+	return true;
 }
 
 
@@ -93,22 +166,17 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		const char* valueName, char* &valueData)
 {
 	valueData=NULL;
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == \"%s\"",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	SQLiteQuery lookup(DB,query);
+	if (!lookup.valid()) return false;
+	lookup.bind(1,keyData);
 	// Read the result.
-	int src = sqlite3_run_query(DB,stmt);
-	bool retVal = false;
-	if (src == SQLITE_ROW) {
-		const char* ptr = (const char*)sqlite3_column_text(stmt,0);
-		if (ptr) valueData = strdup(ptr);
-		retVal = true;
-	}
-	sqlite3_finalize(stmt);
-	return retVal;
+	if (lookup.step() != SQLITE_ROW) return false;
+	const char* ptr = (const char*)sqlite3_column_text(lookup.stmt(),0);
+	if (ptr) valueData = strdup(ptr);
+	return true;
 }
 
 
@@ -118,22 +186,17 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		const char* valueName, char* &valueData)
 {
 	valueData=NULL;
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + 20;
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == %u",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	SQLiteQuery lookup(DB,query);
+	if (!lookup.valid()) return false;
+	lookup.bind(1,keyData);
 	// Read the result.
-	int src = sqlite3_run_query(DB,stmt);
-	bool retVal = false;
-	if (src == SQLITE_ROW) {
-		const char* ptr = (const char*)sqlite3_column_text(stmt,0);
-		if (ptr) valueData = strdup(ptr);
-		retVal = true;
-	}
-	sqlite3_finalize(stmt);
-	return retVal;
+	if (lookup.step() != SQLITE_ROW) return false;
+	const char* ptr = (const char*)sqlite3_column_text(lookup.stmt(),0);
+	if (ptr) valueData = strdup(ptr);
+	return true;
 }
 
 
@@ -2,6 +2,7 @@
 #define SQLITE3UTIL_H
 
 #include <sqlite3.h>
+#include <stddef.h>
 
 int sqlite3_prepare_statement(sqlite3* DB, sqlite3_stmt **stmt, const char* query);
 
@@ -26,4 +27,69 @@ bool sqlite3_exists(sqlite3* DB, const char* tableName,
 /** Run a query, ignoring the result; return true on success. */
 bool sqlite3_command(sqlite3* DB, const char* query);
 
+
+// Prepared statements are cached per connection, keyed by their SQL text.
+// Values go in "?" parameters, never into the SQL text, so each template is parsed once.
+
+/**
+	Get a prepared statement for a query from the connection's cache, preparing it if needed.
+	The caller has exclusive use of it until sqlite3_release_statement().
+	Returns NULL if the query cannot be prepared.
+*/
+sqlite3_stmt* sqlite3_cached_statement(sqlite3* DB, const char* query);
+
+/** Reset a cached statement, clear its bindings, and return it to the cache. */
+void sqlite3_release_statement(sqlite3* DB, sqlite3_stmt* stmt);
+
+/** Finalize all cached statements of a connection.  Call this before sqlite3_close(). */
+void sqlite3_finalize_cached(sqlite3* DB);
+
+
+/**
+	One use of a cached prepared statement.
+	Parameters are numbered from 1, as in sqlite3_bind_*().
+	The statement goes back to the cache when this object is destroyed.
+*/
+class SQLiteQuery {
+
+	private:
+
+	sqlite3* mDB;
+	sqlite3_stmt* mStmt;
+
+	SQLiteQuery(const SQLiteQuery&);
+	void operator=(const SQLiteQuery&);
+
+	public:
+
+	SQLiteQuery(sqlite3* wDB, const char* query)
+		:mDB(wDB),mStmt(sqlite3_cached_statement(wDB,query))
+	{ }
+
+	~SQLiteQuery() { if (mStmt) sqlite3_release_statement(mDB,mStmt); }
+
+	/** True if the statement was prepared. */
+	bool valid() const { return mStmt!=NULL; }
+
+	/**@name Parameter binding; strings are copied. */
+	//@{
+	void bind(int index, const char* value) { sqlite3_bind_text(mStmt,index,value,-1,SQLITE_TRANSIENT); }
+	void bind(int index, int value) { sqlite3_bind_int(mStmt,index,value); }
+	void bind(int index, unsigned value) { sqlite3_bind_int64(mStmt,index,value); }
+	void bind(int index, long value) { sqlite3_bind_int64(mStmt,index,value); }
+	void bind(int index, long long value) { sqlite3_bind_int64(mStmt,index,value); }
+	void bind(int index, double value) { sqlite3_bind_double(mStmt,index,value); }
+	//@}
+
+	/** Step the statement; returns SQLITE_ROW, SQLITE_DONE or an error code. */
+	int step() { return sqlite3_run_query(mDB,mStmt); }
+
+	/** Run a statement that returns no rows; return true on success. */
+	bool run() { return step()==SQLITE_DONE; }
+
+	/** The statement, for reading columns after step(). */
+	sqlite3_stmt* stmt() { return mStmt; }
+};
+
+
 #endif
@@ -61,6 +61,7 @@
 #include <Logger.h>
 
 #include <Reporting.h>
+#include <Metrics.h>
 
 #include <osipparser2/osip_message.h>
 
@@ -71,6 +72,10 @@ using namespace Control;
 using namespace GSM;
 
 
+static MetricCounter gTCHUplinkDropped("openbts_tch_frames_total","direction=\"uplink\",result=\"dropped\"",
+	"Speech frames on traffic channels, by outcome.");
+
+
 
 // Forward refs.
 
@@ -581,8 +586,12 @@ bool updateCallTraffic(TransactionEntry *transaction, GSM::TCHFACCHLogicalChanne
 
 	// Transfer in the uplink direction (GSM->RTP).
 	// Flush FIFO to limit latency.
-	unsigned maxQ = gConfig.getNum("GSM.MaxSpeechLatency");
-	while (TCH->queueSize()>maxQ) delete[] TCH->recvTCH();
+	static ConfigKey<long> sMaxSpeechLatency(gConfig,"GSM.MaxSpeechLatency",2);
+	unsigned maxQ = sMaxSpeechLatency.value();
+	while (TCH->queueSize()>maxQ) {
+		delete[] TCH->recvTCH();
+		gTCHUplinkDropped.incr();
+	}
 	if (unsigned char *txFrame = TCH->recvTCH()) {
 		activity = true;
 		// Send on RTP.
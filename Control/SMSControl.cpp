@@ -93,6 +93,81 @@ GSM::L3Frame* getFrameSMS(GSM::LogicalChannel *LCH, GSM::Primitive primitive=GSM
 }
 
 
+/**
+	An SMS CP message handed to L2 with LogicalChannel::sendData, and the L2 report on it.
+	If the sender gives up waiting, the L2 completion deletes the record instead.
+*/
+class SMSDelivery {
+
+	private:
+
+	Mutex mLock;
+	Signal mSignal;
+	bool mDone;				///< L2 has reported
+	bool mDelivered;		///< L2 reported the frame acknowledged
+	bool mAbandoned;		///< the sender stopped waiting
+
+	public:
+
+	SMSDelivery()
+		:mDone(false),mDelivered(false),mAbandoned(false)
+	{ }
+
+	/** The L2Completion, run on the L2 thread. */
+	static void complete(void* context, bool delivered)
+	{
+		SMSDelivery* delivery = (SMSDelivery*)context;
+		delivery->mLock.lock();
+		if (delivery->mAbandoned) {
+			delivery->mLock.unlock();
+			delete delivery;
+			return;
+		}
+		delivery->mDone = true;
+		delivery->mDelivered = delivered;
+		delivery->mSignal.signal();
+		delivery->mLock.unlock();
+	}
+
+	/**
+		Wait for the L2 report and release the record.
+		@return true if the peer acknowledged the frame.
+	*/
+	bool wait(unsigned timeout_ms)
+	{
+		Timeval deadline(timeout_ms);
+		mLock.lock();
+		while (!mDone && !deadline.passed()) mSignal.wait(mLock,deadline.remaining());
+		if (!mDone) {
+			mAbandoned = true;
+			mLock.unlock();
+			return false;
+		}
+		bool delivered = mDelivered;
+		mLock.unlock();
+		delete this;
+		return delivered;
+	}
+};
+
+
+/**
+	Send a CP message on SAP3 and block until the MS acknowledges it in L2.
+	Throw ChannelReadTimeout if L2 gives up on it.
+*/
+void sendSMSAcknowledged(GSM::LogicalChannel *LCH, const CPMessage& msg)
+{
+	LOG(INFO) << "sending " << msg;
+	SMSDelivery *delivery = new SMSDelivery;
+	LCH->sendData(GSM::L3Frame(msg),SMSDelivery::complete,delivery,3);
+	// L2 itself gives up after N200 retransmissions; allow for frames queued ahead of this one.
+	if (!delivery->wait(2*LCH->N200()*LCH->T200())) {
+		LOG(NOTICE) << "no L2 acknowledgment on " << *LCH << " SAP3 for " << msg;
+		throw ChannelReadTimeout();
+	}
+}
+
+
 bool sendSIP(TransactionEntry *transaction, const char* address, const char* body, const char* contentType)
 {
 	// Steps:
@@ -386,8 +461,9 @@ bool Control::deliverSMSToMS(const char *callingPartyDigits, const char* message
 	// This won't return NULL.  It will throw an exception if it fails.
 	//delete getFrameSMS(LCH,GSM::ESTABLISH);
 
-	LOG(INFO) << "sending " << deliver;
-	LCH->send(deliver,3);
+	// The CP-ACK read timeout starts once the MS has the CP-DATA,
+	// so a slow link doesn't eat into it and a failed one is reported at once.
+	sendSMSAcknowledged(LCH,deliver);
 
 	// Step 2
 	// Get the CP-ACK.
@@ -85,7 +85,9 @@ int TMSITable::open(const char* wPath)
 
 TMSITable::~TMSITable()
 {
-	if (mDB) sqlite3_close(mDB);
+	if (!mDB) return;
+	sqlite3_finalize_cached(mDB);
+	sqlite3_close(mDB);
 }
 
 
@@ -110,29 +112,35 @@ unsigned TMSITable::assign(const char* IMSI, const GSM::L3LocationUpdatingReques
 
 	// Create a new record.
 	LOG(NOTICE) << "new entry for IMSI " << IMSI;
-	char query[1000];
 	unsigned now = (unsigned)time(NULL);
+	bool created;
 	if (!lur) {
-		sprintf(query,
+		SQLiteQuery insert(mDB,
 				"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED) "
-				"VALUES ('%s',%u,%u)",
-				IMSI,now,now);
+				"VALUES (?,?,?)");
+		insert.bind(1,IMSI); insert.bind(2,now); insert.bind(3,now);
+		created = insert.run();
 	} else {
 		const GSM::L3LocationAreaIdentity &lai = lur->LAI();
 		const GSM::L3MobileIdentity &mid = lur->mobileID();
 		if (mid.type()==GSM::TMSIType) {
-			sprintf(query,
+			SQLiteQuery insert(mDB,
 					"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED,PREV_MCC,PREV_MNC,PREV_LAC,OLD_TMSI) "
-					"VALUES ('%s',%u,%u,%u,%u,%u,%u)",
-					IMSI,now,now,lai.MCC(),lai.MNC(),lai.LAC(),mid.TMSI());
+					"VALUES (?,?,?,?,?,?,?)");
+			insert.bind(1,IMSI); insert.bind(2,now); insert.bind(3,now);
+			insert.bind(4,lai.MCC()); insert.bind(5,lai.MNC()); insert.bind(6,lai.LAC());
+			insert.bind(7,mid.TMSI());
+			created = insert.run();
 		} else {
-			sprintf(query,
+			SQLiteQuery insert(mDB,
 					"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED,PREV_MCC,PREV_MNC,PREV_LAC) "
-					"VALUES ('%s',%u,%u,%u,%u,%u)",
-					IMSI,now,now,lai.MCC(),lai.MNC(),lai.LAC());
+					"VALUES (?,?,?,?,?,?)");
+			insert.bind(1,IMSI); insert.bind(2,now); insert.bind(3,now);
+			insert.bind(4,lai.MCC()); insert.bind(5,lai.MNC()); insert.bind(6,lai.LAC());
+			created = insert.run();
 		}
 	}
-	if (!sqlite3_command(mDB,query)) {
+	if (!created) {
 		LOG(ALERT) << "TMSI creation failed";
 		return 0;
 	}
@@ -148,10 +156,10 @@ unsigned TMSITable::assign(const char* IMSI, const GSM::L3LocationUpdatingReques
 void TMSITable::touch(unsigned TMSI) const
 {
 	// Update timestamp.
-	char query[100];
-	sprintf(query,"UPDATE TMSI_TABLE SET ACCESSED = %u WHERE TMSI == %u",
-		(unsigned)time(NULL),TMSI);
-	sqlite3_command(mDB,query);
+	SQLiteQuery update(mDB,"UPDATE TMSI_TABLE SET ACCESSED = ? WHERE TMSI == ?");
+	update.bind(1,(unsigned)time(NULL));
+	update.bind(2,TMSI);
+	update.run();
 }
 
 
@@ -224,10 +232,11 @@ void TMSITable::clear()
 
 bool TMSITable::IMEI(const char* IMSI, const char *IMEI)
 {
-	char query[100];
-	sprintf(query,"UPDATE TMSI_TABLE SET IMEI=\"%s\",ACCESSED=%u WHERE IMSI=\"%s\"",
-		IMEI,(unsigned)time(NULL),IMSI);
-	return sqlite3_command(mDB,query);
+	SQLiteQuery update(mDB,"UPDATE TMSI_TABLE SET IMEI=?,ACCESSED=? WHERE IMSI=?");
+	update.bind(1,IMEI);
+	update.bind(2,(unsigned)time(NULL));
+	update.bind(3,IMSI);
+	return update.run();
 }
 
 
@@ -235,12 +244,14 @@ bool TMSITable::IMEI(const char* IMSI, const char *IMEI)
 bool TMSITable::classmark(const char* IMSI, const GSM::L3MobileStationClassmark2& classmark)
 {
 	int A5Bits = (classmark.A5_1()<<2) + (classmark.A5_2()<<1) + classmark.A5_3();
-	char query[100];
-	sprintf(query,
-		"UPDATE TMSI_TABLE SET A5_SUPPORT=%u,ACCESSED=%u,POWER_CLASS=%u "
-		" WHERE IMSI=\"%s\"",
-		A5Bits,(unsigned)time(NULL),classmark.powerClass(),IMSI);
-	return sqlite3_command(mDB,query);
+	SQLiteQuery update(mDB,
+		"UPDATE TMSI_TABLE SET A5_SUPPORT=?,ACCESSED=?,POWER_CLASS=? "
+		" WHERE IMSI=?");
+	update.bind(1,A5Bits);
+	update.bind(2,(unsigned)time(NULL));
+	update.bind(3,classmark.powerClass());
+	update.bind(4,IMSI);
+	return update.run();
 }
 
 
@@ -255,10 +266,11 @@ unsigned TMSITable::nextL3TI(const char* IMSI)
 	}
 	// Note that TI=7 is a reserved value, so value values are 0-6.  See GSM 04.07 11.2.3.1.3.
 	unsigned next = (l3ti+1) % 7;
-	char query[200];
-	sprintf(query,"UPDATE TMSI_TABLE SET L3TI=%u,ACCESSED=%u WHERE IMSI='%s'",
-		next, (unsigned)time(NULL),IMSI);
-	if (!sqlite3_command(mDB,query)) {
+	SQLiteQuery update(mDB,"UPDATE TMSI_TABLE SET L3TI=?,ACCESSED=? WHERE IMSI=?");
+	update.bind(1,next);
+	update.bind(2,(unsigned)time(NULL));
+	update.bind(3,IMSI);
+	if (!update.run()) {
 		LOG(ALERT) << "cannot write L3TI to TMSI_TABLE";
 	}
 	return next;
@@ -238,8 +238,8 @@ TransactionEntry::~TransactionEntry()
 	gSIPInterface.removeCall(mSIP.callID());
 
 	// Delete the SQL table entry.
-	char query[100];
-	sprintf(query,"DELETE FROM TRANSACTION_TABLE WHERE ID=%u",mID);
+	SQLiteQuery query(gTransactionTable.DB(),"DELETE FROM TRANSACTION_TABLE WHERE ID=?");
+	query.bind(1,mID);
 	runQuery(query);
 
 }
@@ -420,13 +420,15 @@ void TransactionEntry::messageType(const char *wContentType)
 
 
 
-void TransactionEntry::runQuery(const char* query) const
+void TransactionEntry::runQuery(SQLiteQuery& query) const
 {
 	// Caller should hold mLock and should have already checked mRemoved..
+	if (!query.valid()) return;
 	for (unsigned i=0; i<mNumSQLTries; i++) {
-		if (sqlite3_command(gTransactionTable.DB(),query)) return;
+		if (query.run()) return;
+		sqlite3_reset(query.stmt());
 	}
-	LOG(ALERT) << "transaction table access failed after " << mNumSQLTries << "attempts. query:" << query << " error: " << sqlite3_errmsg(gTransactionTable.DB());
+	LOG(ALERT) << "transaction table access failed after " << mNumSQLTries << "attempts. query:" << sqlite3_sql(query.stmt()) << " error: " << sqlite3_errmsg(gTransactionTable.DB());
 }
 
 
@@ -458,29 +460,29 @@ void TransactionEntry::insertIntoDatabase()
 
 	// FIXME -- This should be done in a single SQL transaction.
 
-	char query[500];
 	unsigned now = (unsigned)time(NULL);
-	sprintf(query,"INSERT INTO TRANSACTION_TABLE "
-		        "(ID,CREATED,CHANGED,TYPE,SUBSCRIBER,L3TI,CALLED,CALLING,GSMSTATE,SIPSTATE,SIP_CALLID,SIP_PROXY) "
-		"VALUES  (%u,%u,     %u,     '%s','%s',      %u,'%s',  '%s',   '%s',    '%s',      '%s',      '%s')",
-		mID,now,now,
-		serviceTypeSS.str().c_str(),
-		subscriber,
-		mL3TI,
-		mCalled.digits(),
-		mCalling.digits(),
-		stateString,
-		sipStateSS.str().c_str(),
-		mSIP.callID().c_str(),
-		mSIP.proxyIP().c_str()
-	);
-
-	runQuery(query);
+	SQLiteQuery insert(gTransactionTable.DB(),"INSERT INTO TRANSACTION_TABLE "
+		"(ID,CREATED,CHANGED,TYPE,SUBSCRIBER,L3TI,CALLED,CALLING,GSMSTATE,SIPSTATE,SIP_CALLID,SIP_PROXY) "
+		"VALUES (?,?,?,?,?,?,?,?,?,?,?,?)");
+	insert.bind(1,mID);
+	insert.bind(2,now);
+	insert.bind(3,now);
+	insert.bind(4,serviceTypeSS.str().c_str());
+	insert.bind(5,subscriber);
+	insert.bind(6,mL3TI);
+	insert.bind(7,mCalled.digits());
+	insert.bind(8,mCalling.digits());
+	insert.bind(9,stateString);
+	insert.bind(10,sipStateSS.str().c_str());
+	insert.bind(11,mSIP.callID().c_str());
+	insert.bind(12,mSIP.proxyIP().c_str());
+	runQuery(insert);
 
 	if (!mChannel) return;
-	sprintf(query,"UPDATE TRANSACTION_TABLE SET CHANNEL='%s' WHERE ID=%u",
-			mChannel->descriptiveString(), mID);
-	runQuery(query);
+	SQLiteQuery update(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET CHANNEL=? WHERE ID=?");
+	update.bind(1,mChannel->descriptiveString());
+	update.bind(2,mID);
+	runQuery(update);
 }
 
 
@@ -491,15 +493,11 @@ void TransactionEntry::channel(GSM::LogicalChannel* wChannel)
 	ScopedLock lock(mLock);
 	mChannel = wChannel;
 
-	char query[500];
-	if (mChannel) {
-		sprintf(query,"UPDATE TRANSACTION_TABLE SET CHANGED=%u,CHANNEL='%s' WHERE ID=%u",
-				(unsigned)time(NULL), mChannel->descriptiveString(), mID);
-	} else {
-		sprintf(query,"UPDATE TRANSACTION_TABLE SET CHANGED=%u,CHANNEL=NULL WHERE ID=%u",
-				(unsigned)time(NULL), mID);
-	}
-
+	// An unbound parameter is NULL.
+	SQLiteQuery query(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET CHANGED=?,CHANNEL=? WHERE ID=?");
+	query.bind(1,(unsigned)time(NULL));
+	if (mChannel) query.bind(2,mChannel->descriptiveString());
+	query.bind(3,mID);
 	runQuery(query);
 }
 
@@ -549,10 +547,10 @@ void TransactionEntry::GSMState(GSM::CallState wState)
 	const char* stateString = GSM::CallStateString(wState);
 	assert(stateString);
 
-	char query[150];
-	sprintf(query,
-		"UPDATE TRANSACTION_TABLE SET GSMSTATE='%s',CHANGED=%u WHERE ID=%u",
-		stateString,now, mID);
+	SQLiteQuery query(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET GSMSTATE=?,CHANGED=? WHERE ID=?");
+	query.bind(1,stateString);
+	query.bind(2,now);
+	query.bind(3,mID);
 	runQuery(query);
 }
 
@@ -568,10 +566,10 @@ SIP::SIPState TransactionEntry::echoSIPState(SIP::SIPState state) const
 
 	unsigned now = time(NULL);
 
-	char query[150];
-	sprintf(query,
-		"UPDATE TRANSACTION_TABLE SET SIPSTATE='%s',CHANGED=%u WHERE ID=%u",
-		stateString,now,mID);
+	SQLiteQuery query(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET SIPSTATE=?,CHANGED=? WHERE ID=?");
+	query.bind(1,stateString);
+	query.bind(2,now);
+	query.bind(3,mID);
 	runQuery(query);
 
 	return state;
@@ -900,10 +898,9 @@ void TransactionEntry::called(const L3CalledPartyBCDNumber& wCalled)
 	ScopedLock lock(mLock);
 	mCalled = wCalled;
 
-	char query[151];
-	snprintf(query,150,
-		"UPDATE TRANSACTION_TABLE SET CALLED='%s' WHERE ID=%u",
-		mCalled.digits(), mID);
+	SQLiteQuery query(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET CALLED=? WHERE ID=?");
+	query.bind(1,mCalled.digits());
+	query.bind(2,mID);
 	runQuery(query);
 }
 
@@ -914,10 +911,9 @@ void TransactionEntry::L3TI(unsigned wL3TI)
 	ScopedLock lock(mLock);
 	mL3TI = wL3TI;
 
-	char query[151];
-	snprintf(query,150,
-		"UPDATE TRANSACTION_TABLE SET L3TI=%u WHERE ID=%u",
-		mL3TI, mID);
+	SQLiteQuery query(gTransactionTable.DB(),"UPDATE TRANSACTION_TABLE SET L3TI=? WHERE ID=?");
+	query.bind(1,mL3TI);
+	query.bind(2,mID);
 	runQuery(query);
 }
 
@@ -1105,7 +1101,9 @@ TransactionTable::~TransactionTable()
 {
 	// Don't bother disposing of the memory,
 	// since this is only invoked when the application exits.
-	if (mDB) sqlite3_close(mDB);
+	if (!mDB) return;
+	sqlite3_finalize_cached(mDB);
+	sqlite3_close(mDB);
 }
 
 
@@ -46,6 +46,7 @@ class SACCHLogicalChannel;
 
 
 struct sqlite3;
+class SQLiteQuery;
 
 
 /**@namespace Control This namepace is for use by the control layer. */
@@ -403,8 +404,8 @@ class TransactionEntry {
 	/** Set up a new entry in gTransactionTable's sqlite3 database. */
 	void insertIntoDatabase();
 
-	/** Run a database query. */
-	void runQuery(const char* query) const;
+	/** Run a database query with its parameters bound, retrying on failure. */
+	void runQuery(SQLiteQuery& query) const;
 
 	/** Echo latest SIPSTATE to the database. */
 	SIP::SIPState echoSIPState(SIP::SIPState state) const;
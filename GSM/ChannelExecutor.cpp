@@ -0,0 +1,166 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "ChannelExecutor.h"
+#include <Logger.h>
+#include <unistd.h>
+
+
+using namespace GSM;
+
+
+
+void ChannelExecutor::startWorkers()
+{
+	// Caller holds mLock.
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores<2) cores = 2;
+	LOG(INFO) << "starting " << cores << " channel executor threads";
+	for (long i=0; i<cores; i++) {
+		Worker* worker = new Worker;
+		worker->mExecutor = this;
+		mWorkers.push_back(worker);
+		worker->mThread.start((void*(*)(void*))serviceLoopAdapter,worker);
+	}
+}
+
+
+void ChannelExecutor::add(ChannelTask* task, const Time& when)
+{
+	Worker* worker;
+	{
+		ScopedLock lock(mLock);
+		if (mWorkers.size()==0) startWorkers();
+		task->mWorker = mNextWorker;
+		mNextWorker = (mNextWorker+1) % mWorkers.size();
+		worker = mWorkers[task->mWorker];
+	}
+	ScopedLock lock(worker->mLock);
+	assert(task->mState==ChannelTask::Idle);
+	schedule(*worker,task,when);
+}
+
+
+void ChannelExecutor::post(ChannelTask* task)
+{
+	assert(task->mWorker<mWorkers.size());
+	Worker& worker = *mWorkers[task->mWorker];
+	ScopedLock lock(worker.mLock);
+	switch (task->mState) {
+		case ChannelTask::Ready:
+			return;
+		case ChannelTask::Running:
+			task->mRepost = true;
+			return;
+		case ChannelTask::Waiting:
+			// Orphan the timer entry.
+			task->mSequence++;
+			// fall through
+		case ChannelTask::Idle:
+			task->mState = ChannelTask::Ready;
+			worker.mReady.push_back(task);
+			worker.mSignal.signal();
+			return;
+	}
+}
+
+
+void ChannelExecutor::schedule(Worker& worker, ChannelTask* task, const Time& when)
+{
+	// Caller holds worker.mLock.
+	// Like Clock::wait, don't wait too long in case the clock was reset.
+	Time now = mClock.get();
+	Time target = when;
+	if ((target-now)>sMaxWaitFrames) target = now + sMaxWaitFrames;
+	task->mState = ChannelTask::Waiting;
+	worker.mTimers.push(TimerEntry(target,task));
+	worker.mSignal.signal();
+}
+
+
+void* ChannelExecutor::serviceLoopAdapter(Worker* worker)
+{
+	worker->mExecutor->serviceLoop(*worker);
+	return NULL;
+}
+
+
+void ChannelExecutor::serviceLoop(Worker& worker)
+{
+	ScopedLock lock(worker.mLock);
+	while (true) {
+		// Move due timers onto the ready queue.
+		// Compare frame numbers only, as Clock::wait does.
+		int32_t nowFN = mClock.FN();
+		int waitFrames = -1;
+		while (worker.mTimers.size()>0) {
+			const TimerEntry& top = worker.mTimers.top();
+			ChannelTask* task = top.mTask;
+			if (top.mSequence!=task->mSequence) {
+				worker.mTimers.pop();
+				continue;
+			}
+			int delta = FNDelta(top.mWhen.FN(),nowFN);
+			if (delta>0) {
+				waitFrames = delta;
+				break;
+			}
+			worker.mTimers.pop();
+			task->mSequence++;
+			task->mState = ChannelTask::Ready;
+			worker.mReady.push_back(task);
+		}
+
+		if (worker.mReady.size()==0) {
+			if (waitFrames<0) worker.mSignal.wait(worker.mLock);
+			else worker.mSignal.wait(worker.mLock,(waitFrames*gFrameMicroseconds+999)/1000);
+			continue;
+		}
+
+		// Run one step without the lock.
+		ChannelTask* task = worker.mReady.front();
+		worker.mReady.pop_front();
+		task->mState = ChannelTask::Running;
+		task->mRepost = false;
+		worker.mLock.unlock();
+		Time next;
+		bool again = task->step(next);
+		worker.mLock.lock();
+
+		if (task->mRepost) {
+			task->mState = ChannelTask::Ready;
+			worker.mReady.push_back(task);
+		} else if (again) {
+			schedule(worker,task,next);
+		} else {
+			task->mState = ChannelTask::Idle;
+		}
+	}
+}
+
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,158 @@
+/**@file Frame-clock-driven executor for channel service loops. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef CHANNELEXECUTOR_H
+#define CHANNELEXECUTOR_H
+
+#include "GSMCommon.h"
+#include <Threads.h>
+#include <deque>
+#include <queue>
+#include <vector>
+
+
+namespace GSM {
+
+
+class ChannelExecutor;
+
+
+/**
+	A channel state machine run as a series of steps by a ChannelExecutor,
+	in place of a service thread that sleeps on the frame clock.
+	A step must not block; where a thread would have slept until a frame,
+	the step returns that frame instead.
+	A task never runs on two threads at once.
+*/
+class ChannelTask {
+
+	private:
+
+	friend class ChannelExecutor;
+
+	/**@name Executor bookkeeping, protected by the lock of the task's worker. */
+	//@{
+	enum State { Idle, Waiting, Ready, Running };
+	unsigned mWorker;		///< index of the worker that runs this task
+	State mState;
+	bool mRepost;			///< posted while running
+	unsigned mSequence;		///< bumped when the task leaves Waiting, to invalidate its timer entry
+	//@}
+
+	public:
+
+	ChannelTask()
+		:mWorker(0),mState(Idle),mRepost(false),mSequence(0)
+	{ }
+
+	virtual ~ChannelTask() {}
+
+	/**
+		Do one step of work without blocking.
+		@param next Set to the time the next step should run.
+		@return true to run again at next, false to wait for a post().
+	*/
+	virtual bool step(Time& next) =0;
+};
+
+
+/**
+	Run ChannelTasks from a small pool of threads, one per core.
+	Each task is pinned to one worker, with its own ready queue and timer heap,
+	so the thread count no longer grows with the number of channels.
+*/
+class ChannelExecutor {
+
+	private:
+
+	/** A pending timed step. */
+	class TimerEntry {
+		public:
+		Time mWhen;
+		ChannelTask* mTask;
+		unsigned mSequence;
+		TimerEntry(const Time& wWhen, ChannelTask* wTask)
+			:mWhen(wWhen),mTask(wTask),mSequence(wTask->mSequence)
+		{ }
+		/** Heap ordering, earliest on top. */
+		bool operator<(const TimerEntry& other) const { return other.mWhen < mWhen; }
+	};
+
+	/** One worker thread and its queues. */
+	class Worker {
+		public:
+		Mutex mLock;
+		Signal mSignal;
+		std::deque<ChannelTask*> mReady;
+		std::priority_queue<TimerEntry> mTimers;
+		Thread mThread;
+		ChannelExecutor* mExecutor;
+	};
+
+	const Clock& mClock;
+	std::vector<Worker*> mWorkers;	///< created on the first add()
+	unsigned mNextWorker;			///< round-robin assignment of new tasks
+	Mutex mLock;					///< protects mWorkers and mNextWorker
+
+	/** Longest wait for a timer, in frames, matching Clock::wait. */
+	static const int sMaxWaitFrames = 51*26;
+
+	/** Create and start the workers. */
+	void startWorkers();
+
+	/** Queue a task to run at a given time; caller holds the worker's lock. */
+	void schedule(Worker& worker, ChannelTask* task, const Time& when);
+
+	void serviceLoop(Worker& worker);
+
+	/** Thread entry point for a worker. */
+	static void* serviceLoopAdapter(Worker*);
+
+	public:
+
+	ChannelExecutor(const Clock& wClock)
+		:mClock(wClock),mNextWorker(0)
+	{ }
+
+	/** Start running a task at a given time.  Never destroy a task once added. */
+	void add(ChannelTask* task, const Time& when);
+
+	/** Run a task's next step as soon as possible, even if it is waiting on a timer. */
+	void post(ChannelTask* task);
+
+	/** Number of worker threads, 0 until the first task is added. */
+	size_t threads() const { return mWorkers.size(); }
+};
+
+
+
+}	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
@@ -353,12 +353,35 @@ ostream& GSM::operator<<(ostream& os, ChannelType val)
 
 
 
-bool Z100Timer::expired() const
+Z100Timer::Z100Timer(const Z100Timer& other)
+	:mEndTime(other.mEndTime),
+	mLimitTime(other.mLimitTime),
+	mActive(other.mActive)
 {
-	assert(mLimitTime!=0);
-	// A non-active timer does not expire.
-	if (!mActive) return false;
-	return mEndTime.passed();
+	copyState(other);
+}
+
+Z100Timer& Z100Timer::operator=(const Z100Timer& other)
+{
+	if (this==&other) return *this;
+	if (mEntry.armed()) TimerWheel::wheel().cancel(mEntry);
+	mEndTime = other.mEndTime;
+	mLimitTime = other.mLimitTime;
+	mActive = other.mActive;
+	copyState(other);
+	return *this;
+}
+
+Z100Timer::~Z100Timer()
+{
+	if (mEntry.armed()) TimerWheel::wheel().cancel(mEntry);
+}
+
+void Z100Timer::copyState(const Z100Timer& other)
+{
+	if (!other.mActive) return;
+	if (other.mEntry.fired()) TimerWheel::wheel().expire(mEntry);
+	else TimerWheel::wheel().arm(mEntry,other.remaining());
 }
 
 void Z100Timer::set()
@@ -366,12 +389,14 @@ void Z100Timer::set()
 	assert(mLimitTime!=0);
 	mEndTime = Timeval(mLimitTime);
 	mActive=true;
+	TimerWheel::wheel().arm(mEntry,mLimitTime);
 } 
 
 void Z100Timer::expire()
 {
 	mEndTime = Timeval(0);
 	mActive=true;
+	TimerWheel::wheel().expire(mEntry);
 } 
 
 
@@ -382,9 +407,18 @@ void Z100Timer::set(long wLimitTime)
 } 
 
 
+void Z100Timer::reset()
+{
+	assert(mLimitTime!=0);
+	mActive = false;
+	if (mEntry.armed()) TimerWheel::wheel().cancel(mEntry);
+}
+
+
 long Z100Timer::remaining() const
 {
 	if (!mActive) return 0;
+	if (mEntry.fired()) return 0;
 	long rem = mEndTime.remaining();
 	if (rem<0) rem=0;
 	return rem;
@@ -392,7 +426,8 @@ long Z100Timer::remaining() const
 
 void Z100Timer::wait() const
 {
-	while (!expired()) msleep(remaining());
+	if (!mActive) return;
+	TimerWheel::wheel().wait(mEntry);
 }
 
 // vim: ts=4 sw=4
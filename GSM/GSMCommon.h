@@ -35,6 +35,7 @@
 
 #include <Threads.h>
 #include <Timeval.h>
+#include <TimerWheel.h>
 #include <BitVector.h>
 
 
@@ -568,6 +569,10 @@ class Z100Timer {
 	Timeval mEndTime;		///< the time at which this timer will expire
 	long mLimitTime;		///< timeout in milliseconds
 	bool mActive;			///< true if timer is active
+	TimerWheelEntry mEntry;	///< expiration flag, set by the shared TimerWheel
+
+	/** Arm our wheel entry to match another timer's state. */
+	void copyState(const Z100Timer& other);
 
 	public:
 
@@ -577,11 +582,31 @@ class Z100Timer {
 		mActive(false)
 	{}
 
+	/** Create a timer that also runs a callback on the TimerWheel's thread when it expires. */
+	Z100Timer(long wLimitTime, TimerCallback wCallback, void* wContext)
+		:mLimitTime(wLimitTime),
+		mActive(false),
+		mEntry(wCallback,wContext)
+	{}
+
 	/** Blank constructor; if you use this object, it will assert. */
 	Z100Timer():mLimitTime(0),mActive(false) {}
 
-	/** True if the timer is active and expired. */
-	bool expired() const;
+	/** Copy a timer, including a running expiration. */
+	Z100Timer(const Z100Timer& other);
+
+	Z100Timer& operator=(const Z100Timer& other);
+
+	~Z100Timer();
+
+	/** True if the timer is active and expired.  This is only a flag check. */
+	bool expired() const
+	{
+		assert(mLimitTime!=0);
+		// A non-active timer does not expire.
+		if (!mActive) return false;
+		return mEntry.fired();
+	}
 
 	/** Force the timer into an expired state. */
 	void expire();
@@ -593,7 +618,7 @@ class Z100Timer {
 	void set(long wLimitTime);
 
 	/** Stop the timer. */
-	void reset() { assert(mLimitTime!=0); mActive = false; }
+	void reset();
 
 	/** Returns true if the timer is active. */
 	bool active() const { return mActive; }
@@ -39,11 +39,54 @@ using namespace GSM;
 
 GSMConfig::GSMConfig()
 	:
+	mExecutor(mClock),
+	mBeaconVersion(0),
 	mSI5Frame(UNIT_DATA),mSI6Frame(UNIT_DATA),
-	mStartTime(::time(NULL))
+	mStartTime(::time(NULL)),
+	mChannelRequestDepth("openbts_queue_depth","queue=\"channel_request\"",
+		"Entries waiting in an interthread queue.",sampleChannelRequestDepth,this),
+	mTCHActiveGauge("openbts_channels","type=\"TCH\",state=\"active\"",
+		"Logical channels, by type and state.",sampleTCHActive,this),
+	mTCHTotalGauge("openbts_channels","type=\"TCH\",state=\"total\"",
+		"Logical channels, by type and state.",sampleTCHTotal,this),
+	mSDCCHActiveGauge("openbts_channels","type=\"SDCCH\",state=\"active\"",
+		"Logical channels, by type and state.",sampleSDCCHActive,this),
+	mSDCCHTotalGauge("openbts_channels","type=\"SDCCH\",state=\"total\"",
+		"Logical channels, by type and state.",sampleSDCCHTotal,this),
+	mL3UplinkDepth("openbts_queue_depth","queue=\"l3_uplink\"",
+		"Entries waiting in an interthread queue.",sampleL3UplinkDepth,this),
+	mL2DownlinkDepth("openbts_queue_depth","queue=\"l2_downlink\"",
+		"Entries waiting in an interthread queue.",sampleL2DownlinkDepth,this),
+	mFACCHDepth("openbts_queue_depth","queue=\"facch_downlink\"",
+		"Entries waiting in an interthread queue.",sampleFACCHDepth,this)
 {
 }
 
+
+long GSMConfig::sampleChannelRequestDepth(void* bts)
+	{ return ((GSMConfig*)bts)->mChannelRequestQueue.size(); }
+
+long GSMConfig::sampleTCHActive(void* bts)
+	{ return ((GSMConfig*)bts)->TCHActive(); }
+
+long GSMConfig::sampleTCHTotal(void* bts)
+	{ return ((GSMConfig*)bts)->TCHTotal(); }
+
+long GSMConfig::sampleSDCCHActive(void* bts)
+	{ return ((GSMConfig*)bts)->SDCCHActive(); }
+
+long GSMConfig::sampleSDCCHTotal(void* bts)
+	{ return ((GSMConfig*)bts)->SDCCHTotal(); }
+
+long GSMConfig::sampleL3UplinkDepth(void* bts)
+	{ return ((GSMConfig*)bts)->L3UplinkBacklog(); }
+
+long GSMConfig::sampleL2DownlinkDepth(void* bts)
+	{ return ((GSMConfig*)bts)->L2DownlinkBacklog(); }
+
+long GSMConfig::sampleFACCHDepth(void* bts)
+	{ return ((GSMConfig*)bts)->FACCHBacklog(); }
+
 void GSMConfig::init() 
 {
 	mBand = (GSMBand)gConfig.getNum("GSM.Radio.Band");
@@ -54,6 +97,7 @@ void GSMConfig::init()
 void GSMConfig::start()
 {
 	mPowerManager.start();
+	mTimeslotManager.start();
 	// Do not call this until the paging channels are installed.
 	mPager.start();
 	// Do not call this until AGCHs are installed.
@@ -131,6 +175,8 @@ void GSMConfig::regenerateBeacon()
 	SI6.write(mSI6Frame);
 	LOG(DEBUG) "mSI6Frame " << mSI6Frame;
 
+	// Tell the BCCH encoder to drop its cached bursts.
+	__atomic_add_fetch(&mBeaconVersion,1,__ATOMIC_RELEASE);
 }
 
 
@@ -170,7 +216,7 @@ template <class ChanType> ChanType* getChan(vector<ChanType*>& chanList)
 	for (unsigned i=0; i<sz; i++) {
 		ChanType *chan = chanList[i];
 		//ChanType *chan = chanList[pos];
-		if (chan->recyclable()) return chan;
+		if (chan->inService() && chan->recyclable()) return chan;
 		//pos = (pos+1) % sz;
 	}
 	return NULL;
@@ -206,7 +252,7 @@ template <class ChanType> size_t chanAvailable(const vector<ChanType*>& chanList
 {
 	size_t count = 0;
 	for (unsigned i=0; i<chanList.size(); i++) {
-		if (chanList[i]->recyclable()) count++;
+		if (chanList[i]->inService() && chanList[i]->recyclable()) count++;
 	}
 	return count;
 }
@@ -260,6 +306,84 @@ unsigned GSMConfig::TCHActive() const
 }
 
 
+
+template <class ChanType> unsigned uplinkBacklog(const vector<ChanType*>& chanList)
+{
+	unsigned count = 0;
+	for (unsigned i=0; i<chanList.size(); i++) count += chanList[i]->uplinkBacklog();
+	return count;
+}
+
+template <class ChanType> unsigned downlinkBacklog(const vector<ChanType*>& chanList)
+{
+	unsigned count = 0;
+	for (unsigned i=0; i<chanList.size(); i++) count += chanList[i]->downlinkBacklog();
+	return count;
+}
+
+
+unsigned GSMConfig::L3UplinkBacklog() const
+{
+	return uplinkBacklog(mSDCCHPool) + uplinkBacklog(mTCHPool);
+}
+
+unsigned GSMConfig::L2DownlinkBacklog() const
+{
+	return downlinkBacklog(mSDCCHPool) + downlinkBacklog(mTCHPool);
+}
+
+unsigned GSMConfig::FACCHBacklog() const
+{
+	unsigned count = 0;
+	for (unsigned i=0; i<mTCHPool.size(); i++) count += mTCHPool[i]->FACCHBacklog();
+	return count;
+}
+
+
+
+template <class ChanType> unsigned countInService(const vector<ChanType*>& chanList)
+{
+	unsigned count = 0;
+	for (unsigned i=0; i<chanList.size(); i++) {
+		if (chanList[i]->inService()) count++;
+	}
+	return count;
+}
+
+
+unsigned GSMConfig::SDCCHTotal() const
+{
+	ScopedLock lock(mLock);
+	return countInService(mSDCCHPool);
+}
+
+unsigned GSMConfig::TCHTotal() const
+{
+	ScopedLock lock(mLock);
+	return countInService(mTCHPool);
+}
+
+
+bool GSMConfig::removeFromService(LogicalChannel* const* chans, unsigned count)
+{
+	// getSDCCH and getTCH allocate under this same lock, so nothing can be opened
+	// between the check and the change.
+	ScopedLock lock(mLock);
+	for (unsigned i=0; i<count; i++) {
+		if (!chans[i]->inService() || !chans[i]->recyclable()) return false;
+	}
+	for (unsigned i=0; i<count; i++) chans[i]->inService(false);
+	return true;
+}
+
+
+void GSMConfig::returnToService(LogicalChannel* const* chans, unsigned count)
+{
+	ScopedLock lock(mLock);
+	for (unsigned i=0; i<count; i++) chans[i]->inService(true);
+}
+
+
 unsigned GSMConfig::T3122() const
 {
 	ScopedLock lock(mLock);
@@ -300,36 +424,61 @@ void GSMConfig::createCombination0(TransceiverManager& TRX, unsigned TN)
 }
 
 
-void GSMConfig::createCombinationI(TransceiverManager& TRX, unsigned CN, unsigned TN)
+/** Thread entry for a DCCH dispatcher, which is declared to return void. */
+static void* DCCHDispatcherAdapter(void* DCCH)
+{
+	Control::DCCHDispatcher((LogicalChannel*)DCCH);
+	return NULL;
+}
+
+
+TCHFACCHLogicalChannel* GSMConfig::createTCHF(ARFCNManager* radio, unsigned CN, unsigned TN)
 {
-	LOG_ASSERT((CN!=0)||(TN!=0));
-	LOG(NOTICE) << "Configuring combination I on C" << CN << "T" << TN;
-	ARFCNManager *radio = TRX.ARFCN(CN);
-	radio->setSlot(TN,1);
 	TCHFACCHLogicalChannel* chan = new TCHFACCHLogicalChannel(CN,TN,gTCHF_T[TN]);
 	chan->downstream(radio);
 	Thread* thread = new Thread;
-	thread->start((void*(*)(void*))Control::DCCHDispatcher,chan);
+	thread->start(DCCHDispatcherAdapter,chan);
 	chan->open();
-	gBTS.addTCH(chan);
+	return chan;
+}
+
+
+SDCCHLogicalChannel* GSMConfig::createSDCCH8(ARFCNManager* radio, unsigned CN, unsigned TN, unsigned sub)
+{
+	SDCCHLogicalChannel* chan = new SDCCHLogicalChannel(CN,TN,gSDCCH8[sub]);
+	chan->downstream(radio);
+	Thread* thread = new Thread;
+	thread->start(DCCHDispatcherAdapter,chan);
+	chan->open();
+	return chan;
+}
+
 
+void GSMConfig::createCombinationI(TransceiverManager& TRX, unsigned CN, unsigned TN)
+{
+	LOG_ASSERT((CN!=0)||(TN!=0));
+	ARFCNManager *radio = TRX.ARFCN(CN);
+	if (TimeslotManager::enabled()) {
+		mTimeslotManager.addSlot(radio,CN,TN,1);
+		return;
+	}
+	LOG(NOTICE) << "Configuring combination I on C" << CN << "T" << TN;
+	radio->setSlot(TN,1);
+	gBTS.addTCH(createTCHF(radio,CN,TN));
 }
 
 
 void GSMConfig::createCombinationVII(TransceiverManager& TRX, unsigned CN, unsigned TN)
 {
 	LOG_ASSERT((CN!=0)||(TN!=0));
-	LOG(NOTICE) << "Configuring combination VII on C" << CN << "T" << TN;
 	ARFCNManager *radio = TRX.ARFCN(CN);
-	radio->setSlot(TN,7);
-	for (int i=0; i<8; i++) {
-		SDCCHLogicalChannel* chan = new SDCCHLogicalChannel(CN,TN,gSDCCH8[i]);
-		chan->downstream(radio);
-		Thread* thread = new Thread;
-		thread->start((void*(*)(void*))Control::DCCHDispatcher,chan);
-		chan->open();
-		gBTS.addSDCCH(chan);
+	if (TimeslotManager::enabled()) {
+		mTimeslotManager.addSlot(radio,CN,TN,7);
+		return;
 	}
+	LOG(NOTICE) << "Configuring combination VII on C" << CN << "T" << TN;
+	radio->setSlot(TN,7);
+	for (int i=0; i<8; i++) gBTS.addSDCCH(createSDCCH8(radio,CN,TN,i));
 }
 
 
@@ -349,7 +498,7 @@ TCHFACCHLogicalChannel* GSMConfig::getTCHByTN(unsigned TN){
 	TCHList::const_iterator tChanItr = TCHPool().begin();
 	while (tChanItr != TCHPool().end()) {
 		TCHFACCHLogicalChannel* tChan = *tChanItr;
-		if (tChan->TN() == TN) return tChan;
+		if (tChan->TN() == TN && tChan->inService()) return tChan;
 		++tChanItr;
 	}
 	return NULL;
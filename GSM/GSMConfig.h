@@ -29,21 +29,25 @@
 
 #include <vector>
 #include <Interthread.h>
+#include <Metrics.h>
 
 //#include <ControlCommon.h>
 #include <RadioResource.h>
 #include <PowerManager.h>
+#include "TimeslotManager.h"
 
 #include "GSML3RRElements.h"
 #include "GSML3CommonElements.h"
 #include "GSML3RRMessages.h"
 
 #include "TRXManager.h"
+#include "ChannelExecutor.h"
 
 
 namespace GSM {
 
 
+class LogicalChannel;
 class CCCHLogicalChannel;
 class SDCCHLogicalChannel;
 class TCHFACCHLogicalChannel;
@@ -67,6 +71,8 @@ class GSMConfig {
 
 	PowerManager mPowerManager;
 
+	TimeslotManager mTimeslotManager;
+
 	mutable Mutex mLock;						///< multithread access control
 
 	/**@name Groups of CCCH subchannels -- may intersect. */
@@ -76,7 +82,7 @@ class GSMConfig {
 	//@}
 
 
-	/**@name Allocatable channel pools. */
+	/**@name Allocatable channel pools; channels out of service are never allocated or counted. */
 	//@{
 	SDCCHList mSDCCHPool;
 	TCHList mTCHPool;
@@ -92,12 +98,15 @@ class GSMConfig {
 
 	Clock mClock;		///< local copy of BTS master clock
 
+	ChannelExecutor mExecutor;	///< runs the clock-driven channel service loops
+
 	/**@name Encoded L2 frames to be sent on the BCCH. */
 	//@{
 	L2Frame mSI1Frame;
 	L2Frame mSI2Frame;
 	L2Frame mSI3Frame;
 	L2Frame mSI4Frame;
+	volatile unsigned mBeaconVersion;	///< bumped after the SI frames are regenerated
 	//@}
 
 	/**@name Encoded L3 frames to be sent on the SACCH. */
@@ -114,9 +123,29 @@ class GSMConfig {
 
 	bool mHold;		///< If true, do not respond to RACH bursts.
 
-	InterthreadQueue<Control::ChannelRequestRecord> mChannelRequestQueue;
+	MPSCInterthreadQueue<Control::ChannelRequestRecord> mChannelRequestQueue;	///< written by RACH decoders, read by the access grant loop
 	Thread mAccessGrantThread;
 
+	/**@name Load gauges, sampled when metrics are exported. */
+	//@{
+	MetricGauge mChannelRequestDepth;
+	MetricGauge mTCHActiveGauge;
+	MetricGauge mTCHTotalGauge;
+	MetricGauge mSDCCHActiveGauge;
+	MetricGauge mSDCCHTotalGauge;
+	MetricGauge mL3UplinkDepth;
+	MetricGauge mL2DownlinkDepth;
+	MetricGauge mFACCHDepth;
+	static long sampleChannelRequestDepth(void*);
+	static long sampleTCHActive(void*);
+	static long sampleTCHTotal(void*);
+	static long sampleSDCCHActive(void*);
+	static long sampleSDCCHTotal(void*);
+	static long sampleL3UplinkDepth(void*);
+	static long sampleL2DownlinkDepth(void*);
+	static long sampleFACCHDepth(void*);
+	//@}
+
 	public:
 
 
@@ -135,6 +164,8 @@ class GSMConfig {
 	const L2Frame& SI2Frame() const { return mSI2Frame; }
 	const L2Frame& SI3Frame() const { return mSI3Frame; }
 	const L2Frame& SI4Frame() const { return mSI4Frame; }
+	/** Read before the frames, so a change made while reading them is seen on the next read. */
+	unsigned beaconVersion() const { return __atomic_load_n(&mBeaconVersion,__ATOMIC_ACQUIRE); }
 	//@}
 	/**@name Get references to L3 frames for SACCH SI messages. */
 	//@{
@@ -153,6 +184,7 @@ class GSMConfig {
 	unsigned BCC() const { return mBCC; }
 	unsigned NCC() const { return mNCC; }
 	GSM::Clock& clock() { return mClock; }
+	ChannelExecutor& executor() { return mExecutor; }
 	const L3LocationAreaIdentity& LAI() const { return mLAI; }
 	//@}
 
@@ -224,6 +256,10 @@ class GSMConfig {
 	void flushChannelRequests()
 		{ mChannelRequestQueue.clear(); }
 
+	/** Number of RACH channel requests waiting for the access grant loop. */
+	size_t channelRequestBacklog() const
+		{ return mChannelRequestQueue.size(); }
+
 	//@}
 
 
@@ -235,8 +271,8 @@ class GSMConfig {
 	SDCCHLogicalChannel *getSDCCH();
 	/** Return true if an SDCCH is available, but do not allocate it. */
 	size_t SDCCHAvailable() const;
-	/** Return number of total SDCCH. */
-	unsigned SDCCHTotal() const { return mSDCCHPool.size(); }
+	/** Return number of SDCCH in service. */
+	unsigned SDCCHTotal() const;
 	/** Return number of active SDCCH. */
 	unsigned SDCCHActive() const;
 	/** Just a reference to the SDCCH pool. */
@@ -251,14 +287,32 @@ class GSMConfig {
 	TCHFACCHLogicalChannel *getTCH();
 	/** Return true if an TCH is available, but do not allocate it. */
 	size_t TCHAvailable() const;
-	/** Return number of total TCH. */
-	unsigned TCHTotal() const { return mTCHPool.size(); }
+	/** Return number of TCH in service. */
+	unsigned TCHTotal() const;
 	/** Return number of active TCH. */
 	unsigned TCHActive() const;
 	/** Just a reference to the TCH pool. */
 	const TCHList& TCHPool() const { return mTCHPool; }
 	//@}
 
+	/**@name Frames queued in the dedicated channels, summed over both pools. */
+	//@{
+	/** L3 frames from L2 waiting for the control layer. */
+	unsigned L3UplinkBacklog() const;
+	/** Downlink L3 frames waiting in L2 for the link. */
+	unsigned L2DownlinkBacklog() const;
+	/** L2 frames waiting for FACCH. */
+	unsigned FACCHBacklog() const;
+	//@}
+
+	/**@name Timeslot reconfiguration, used by the TimeslotManager. */
+	//@{
+	/** Take a group of channels out of service if none of them is allocated; return false otherwise. */
+	bool removeFromService(LogicalChannel* const* chans, unsigned count);
+	/** Put a group of channels back into service. */
+	void returnToService(LogicalChannel* const* chans, unsigned count);
+	//@}
+
 	/**@name T3122 management */
 	//@{
 	unsigned T3122() const;
@@ -274,6 +328,10 @@ class GSMConfig {
 	void createCombinationI(TransceiverManager &TRX, unsigned CN, unsigned TN);
 	/** Combination VII is 8 SDCCHs. */
 	void createCombinationVII(TransceiverManager &TRX, unsigned CN, unsigned TN);
+	/** Create and open a TCH/F with its dispatcher thread; the caller adds it to a pool. */
+	TCHFACCHLogicalChannel* createTCHF(ARFCNManager* radio, unsigned CN, unsigned TN);
+	/** Create and open one SDCCH/8 subchannel with its dispatcher thread; the caller adds it to a pool. */
+	SDCCHLogicalChannel* createSDCCH8(ARFCNManager* radio, unsigned CN, unsigned TN, unsigned sub);
 	//@}
 
 	/** Return number of seconds since starting. */
@@ -282,6 +340,9 @@ class GSMConfig {
 	/** Get a handle to the power manager. */
 	PowerManager& powerManager() { return mPowerManager; }
 
+	/** Get a handle to the dynamic timeslot manager. */
+	TimeslotManager& timeslotManager() { return mTimeslotManager; }
+
 	TCHFACCHLogicalChannel* getTCHByTN(unsigned TN);
 };
 
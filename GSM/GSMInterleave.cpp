@@ -0,0 +1,126 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "GSMInterleave.h"
+#include <assert.h>
+#include <stdint.h>
+
+
+using namespace GSM;
+
+
+
+/** The interleaver gather tables, built once from the GSM 05.03 formulas. */
+class InterleaveTables {
+
+	public:
+
+	/** c[] index of each bit of each xCCH burst, GSM 05.03 4.1.4. */
+	uint16_t mXCCH[4][114];
+
+	/**
+		c[] index of each bit of the block's half of a TCH burst, GSM 05.03 3.1.3.
+		Indexed by the burst relative to the block's first, and by j/2.
+	*/
+	uint16_t mTCH[8][57];
+
+	InterleaveTables()
+	{
+		for (int k=0; k<456; k++) {
+			int j = 2*((49*k) % 57) + ((k%8)/4);
+			mXCCH[k%4][j] = k;
+			// In a TCH burst, the block's bits are all even or all odd, set by k%8.
+			mTCH[k%8][j/2] = k;
+		}
+	}
+};
+
+static const InterleaveTables gTables;
+
+
+
+void GSM::interleaveXCCH(const BitVector& c, BitVector i[4])
+{
+	assert(c.size()==456);
+	const char* cp = c.begin();
+	for (int B=0; B<4; B++) {
+		assert(i[B].size()==114);
+		char* ip = i[B].begin();
+		const uint16_t* table = gTables.mXCCH[B];
+		for (int j=0; j<114; j++) ip[j] = cp[table[j]];
+	}
+}
+
+
+void GSM::deinterleaveXCCH(SoftVector i[4], SoftVector& c)
+{
+	assert(c.size()==456);
+	float* cp = c.begin();
+	for (int B=0; B<4; B++) {
+		assert(i[B].size()==114);
+		float* ip = i[B].begin();
+		const uint16_t* table = gTables.mXCCH[B];
+		for (int j=0; j<114; j++) cp[table[j]] = ip[j];
+		// Every bit of the burst belongs to this block.
+		for (int j=0; j<114; j++) ip[j] = 0.5F;
+	}
+}
+
+
+void GSM::interleaveTCH(const BitVector& c, BitVector i[8], int blockOffset)
+{
+	assert(c.size()==456);
+	const char* cp = c.begin();
+	for (int r=0; r<8; r++) {
+		BitVector& burst = i[(r+blockOffset)%8];
+		assert(burst.size()==114);
+		// The first four bursts of a block take the even bits, the last four the odd.
+		char* ip = burst.begin() + r/4;
+		const uint16_t* table = gTables.mTCH[r];
+		for (int q=0; q<57; q++) ip[2*q] = cp[table[q]];
+	}
+}
+
+
+void GSM::deinterleaveTCH(SoftVector i[8], SoftVector& c, int blockOffset)
+{
+	assert(c.size()==456);
+	float* cp = c.begin();
+	for (int r=0; r<8; r++) {
+		SoftVector& burst = i[(r+blockOffset)%8];
+		assert(burst.size()==114);
+		float* ip = burst.begin() + r/4;
+		const uint16_t* table = gTables.mTCH[r];
+		for (int q=0; q<57; q++) {
+			cp[table[q]] = ip[2*q];
+			ip[2*q] = 0.5F;
+		}
+	}
+}
+
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,73 @@
+/**@file Interleaver permutations for the GSM 05.03 channel codings, as precomputed tables. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef GSMINTERLEAVE_H
+#define GSMINTERLEAVE_H
+
+#include <BitVector.h>
+
+
+namespace GSM {
+
+
+/**@name
+	Interleaving of a 456-bit coded block, GSM 05.03 3.1.3 and 4.1.4.
+	The index formulas are evaluated once, into gather tables,
+	so each burst is filled in order from a table of c[] indexes.
+	Deinterleaving marks the bits it consumes as unknown (0.5),
+	so that the soft decoder can work around a missing burst.
+*/
+//@{
+
+/** Interleave c[] into 4 bursts of 114 bits, GSM 05.03 4.1.4, for the xCCHs. */
+void interleaveXCCH(const BitVector& c, BitVector i[4]);
+
+/** Deinterleave 4 bursts of 114 soft bits into c[], GSM 05.03 4.1.4, for the xCCHs. */
+void deinterleaveXCCH(SoftVector i[4], SoftVector& c);
+
+/**
+	Interleave c[] diagonally into 8 bursts of 114 bits, GSM 05.03 3.1.3, for TCH/F and FACCH/F.
+	Only the half of each burst belonging to this block is written.
+	@param blockOffset 0 or 4, the burst where the block starts.
+*/
+void interleaveTCH(const BitVector& c, BitVector i[8], int blockOffset);
+
+/**
+	Deinterleave c[] from 8 bursts of 114 soft bits, GSM 05.03 3.1.3, for TCH/F and FACCH/F.
+	@param blockOffset 0 or 4, the burst where the block starts.
+*/
+void deinterleaveTCH(SoftVector i[8], SoftVector& c, int blockOffset);
+
+//@}
+
+
+}	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
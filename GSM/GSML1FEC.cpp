@@ -27,6 +27,7 @@
 
 
 #include "GSML1FEC.h"
+#include "GSMInterleave.h"
 #include "GSMCommon.h"
 #include "GSMSAPMux.h"
 #include "GSMConfig.h"
@@ -37,6 +38,7 @@
 #include <Globals.h>
 #include <TRXManager.h>
 #include <Logger.h>
+#include <Metrics.h>
 #include <assert.h>
 #include <math.h>
 
@@ -47,6 +49,25 @@ using namespace GSM;
 
 extern TransceiverManager gTRX;
 
+
+/**@name Live metrics for L1 decoding and speech traffic. */
+//@{
+static MetricHistogram gXCCHDecodeTime("openbts_l1_decode_microseconds","channel=\"XCCH\"",
+	"Time to deinterleave and decode one uplink block.");
+static MetricHistogram gTCHDecodeTime("openbts_l1_decode_microseconds","channel=\"TCH\"",
+	"Time to deinterleave and decode one uplink block.");
+static MetricCounter gTCHUplinkGood("openbts_tch_frames_total","direction=\"uplink\",result=\"good\"",
+	"Speech frames on traffic channels, by outcome.");
+static MetricCounter gTCHUplinkBad("openbts_tch_frames_total","direction=\"uplink\",result=\"bad\"",
+	"Speech frames on traffic channels, by outcome.");
+static MetricCounter gTCHDownlinkSent("openbts_tch_frames_total","direction=\"downlink\",result=\"sent\"",
+	"Speech frames on traffic channels, by outcome.");
+static MetricCounter gTCHDownlinkDropped("openbts_tch_frames_total","direction=\"downlink\",result=\"dropped\"",
+	"Speech frames on traffic channels, by outcome.");
+static MetricCounter gTCHDownlinkFiller("openbts_tch_frames_total","direction=\"downlink\",result=\"filler\"",
+	"Speech frames on traffic channels, by outcome.");
+//@}
+
 /*
 
 	Notes on reading the GSM specifications.
@@ -194,7 +215,7 @@ bool L1Decoder::decodeRACHBurst(const RxBurst &burst, Parity &wParity, BitVector
 	// Check the parity.
 	// The parity word is XOR'd with the BSIC. (GSM 05.03 4.6.)
 	unsigned sentParity = ~wU.peekField(8,6);
-	unsigned checkParity = wD.parity(wParity);
+	unsigned checkParity = wParity.parity(wD);
 	unsigned encodedBSIC = (sentParity ^ checkParity) & 0x03f;
 	if (encodedBSIC != gBTS.BSIC()) {
 		OBJLOG(ERR) << "RACH decode wrong parity: "<< sentParity << ", "<< checkParity <<", " << encodedBSIC << ", BSCI" << gBTS.BSIC();
@@ -307,11 +328,19 @@ const L1Decoder* L1Encoder::sibling() const
 }
 
 
+unsigned L1Encoder::downlinkLead() const
+{
+	if (!mDownstream) return 0;
+	return mDownstream->downlinkLead();
+}
+
+
 void L1Encoder::resync()
 {
 	// If the encoder's clock is far from the current BTS clock,
 	// get it caught up to something reasonable.
-	Time now = gBTS.time();
+	// Frames up to the downlink lead ahead of the clock may already be sent.
+	Time now = gBTS.time() + (downlinkLead()+1);
 	int32_t delta = mNextWriteTime-now;
 	OBJLOG(DEBUG) << "L1Encoder next=" << mNextWriteTime << " now=" << now << " delta=" << delta;
 	if ((delta<0) || (delta>(51*26))) {
@@ -326,8 +355,19 @@ void L1Encoder::resync()
 void L1Encoder::waitToSend() const
 {
 	// Block until the BTS clock catches up to the
-	// mostly recently transmitted burst.
-	gBTS.clock().wait(mPrevWriteTime);
+	// mostly recently transmitted burst, less the downlink lead,
+	// so the next burst is buffered before the scheduler sends its frame.
+	gBTS.clock().wait(mPrevWriteTime - downlinkLead());
+}
+
+
+bool L1Encoder::readyToSend(Time& when) const
+{
+	// Same test as Clock::wait.
+	Time target = mPrevWriteTime - downlinkLead();
+	if (FNDelta(target.FN(),gBTS.clock().FN())<1) return true;
+	when = target;
+	return false;
 }
 
 
@@ -447,6 +487,18 @@ void L1FEC::downstream(ARFCNManager* radio)
 }
 
 
+void L1FEC::detach(ARFCNManager* radio)
+{
+	if (mDecoder) radio->removeDecoder(mDecoder);
+}
+
+
+void L1FEC::reattach(ARFCNManager* radio)
+{
+	if (mDecoder) radio->installDecoder(mDecoder);
+}
+
+
 void L1FEC::open()
 {
 	if (mEncoder) mEncoder->open();
@@ -562,8 +614,11 @@ void XCCHL1Decoder::writeLowSide(const RxBurst& inBurst)
 	// Accept the burst into the deinterleaving buffer.
 	// Return true if we are ready to interleave.
 	if (!processBurst(inBurst)) return;
+	uint64_t start = metricsClock();
 	deinterleave();
-	if (decode()) {
+	bool good = decode();
+	gXCCHDecodeTime.record(metricsClock()-start);
+	if (good) {
 		countGoodFrame();
 		mD.LSB8MSB();
 		handleGoodFrame();
@@ -614,17 +669,10 @@ bool XCCHL1Decoder::processBurst(const RxBurst& inBurst)
 
 void XCCHL1Decoder::deinterleave()
 {
-	// Deinterleave i[][] to c[].
-	// This comes directly from GSM 05.03, 4.1.4.
-	for (int k=0; k<456; k++) {
-		int B = k%4;
-		int j = 2*((49*k) % 57) + ((k%8)/4);
-		mC[k] = mI[B][j];
-		// Mark this i[][] bit as unknown now.
-		// This makes it possible for the soft decoder to work around
-		// a missing burst.
-		mI[B][j] = 0.5F;
-	}
+	// Deinterleave i[][] to c[], GSM 05.03, 4.1.4.
+	// This also marks the i[][] bits as unknown,
+	// so the soft decoder can work around a missing burst.
+	deinterleaveXCCH(mI,mC);
 }
 
 
@@ -648,7 +696,14 @@ bool XCCHL1Decoder::decode()
 	OBJLOG(DEBUG) <<"XCCHL1Decoder d[]:p[]=" << mDP;
 	unsigned syndrome = mBlockCoder.syndrome(mDP);
 	OBJLOG(DEBUG) <<"XCCHL1Decoder syndrome=" << hex << syndrome << dec;
-	return (syndrome==0);
+	if (syndrome==0) return true;
+	// Optionally use the burst-correcting power of the Fire code.
+	// GSM 05.03 4.1.2 guarantees correction of bursts up to 12 bits.
+	static ConfigKey<bool> sFireCorrection(gConfig,"GSM.Radio.FireCorrection",false);
+	if (!sFireCorrection.defined()) return false;
+	if (!mBlockCoder.trapBurst(mDP,12)) return false;
+	OBJLOG(INFO) <<"XCCHL1Decoder corrected burst, syndrome=" << hex << syndrome << dec;
+	return true;
 }
 
 
@@ -680,7 +735,10 @@ void XCCHL1Decoder::handleGoodFrame()
 		// Build an L2 frame and pass it up.
 		const BitVector L2Part(mD.tail(headerOffset()));
 		OBJLOG(DEBUG) <<"XCCHL1Decoder L2=" << L2Part;
-		mUpstream->writeLowSide(L2Frame(L2Part,DATA));
+		L2Frame frame(L2Part,DATA);
+		frame.receiveTime(metricsClock());
+		// Hand the frame's buffer to L2; L2 and L3 reuse it without copying.
+		mUpstream->writeLowSide(std::move(frame));
 	} else {
 		OBJLOG(ERR) << "XCCHL1Decoder with no uplink connected.";
 	}
@@ -864,12 +922,8 @@ void XCCHL1Encoder::encode()
 
 void XCCHL1Encoder::interleave()
 {
-	// GSM 05.03, 4.1.4.  Verbatim.
-	for (int k=0; k<456; k++) {
-		int B = k%4;
-		int j = 2*((49*k) % 57) + ((k%8)/4);
-		mI[B][j] = mC[k];
-	}
+	// GSM 05.03, 4.1.4.
+	interleaveXCCH(mC,mI);
 }
 
 
@@ -906,25 +960,18 @@ void XCCHL1Encoder::transmit()
 void GeneratorL1Encoder::start()
 {
 	L1Encoder::start();
-	mSendThread.start((void*(*)(void*))GeneratorL1EncoderServiceLoopAdapter,(void*)this);
+	gBTS.executor().add(this,mNextWriteTime);
 }
 
 
-
-void *GSM::GeneratorL1EncoderServiceLoopAdapter(GeneratorL1Encoder* gen)
-{
-	gen->serviceLoop();
-	// DONTREACH
-	return NULL;
-}
-
-void GeneratorL1Encoder::serviceLoop()
+bool GeneratorL1Encoder::step(Time& next)
 {
-	while (mRunning) {
-		resync();
-		waitToSend();
-		generate();
-	}
+	if (!mRunning) return false;
+	resync();
+	if (!readyToSend(next)) return true;
+	generate();
+	next = mPrevWriteTime - downlinkLead();
+	return true;
 }
 
 
@@ -998,46 +1045,89 @@ void FCCHL1Encoder::generate()
 
 
 
+NDCCHL1Encoder::NDCCHL1Encoder(
+		unsigned wCN,
+		unsigned wTN,
+		const TDMAMapping& wMapping,
+		L1FEC *wParent)
+	:XCCHL1Encoder(wCN, wTN, wMapping, wParent),
+	mCacheVersion(0)
+{
+	for (unsigned i=0; i<sMaxCached; i++) {
+		mCachedU[i] = BitVector(mU.size());
+		mCachedU[i].zero();
+		for (int B=0; B<4; B++) mCachedI[i][B] = BitVector(114);
+		mCached[i] = false;
+	}
+}
+
+
 void NDCCHL1Encoder::start()
 {
 	L1Encoder::start();
-	mSendThread.start((void*(*)(void*))NDCCHL1EncoderServiceLoopAdapter,(void*)this);
+	gBTS.executor().add(this,mNextWriteTime);
 }
 
 
-
-void *GSM::NDCCHL1EncoderServiceLoopAdapter(NDCCHL1Encoder* gen)
+bool NDCCHL1Encoder::step(Time& next)
 {
-	gen->serviceLoop();
-	// DONTREACH
-	return NULL;
+	if (!mRunning) return false;
+	// Check the clock here so that generate() does not block in waitToSend().
+	resync();
+	if (!readyToSend(next)) return true;
+	generate();
+	next = mPrevWriteTime - downlinkLead();
+	return true;
 }
 
-void NDCCHL1Encoder::serviceLoop()
+
+
+
+
+void NDCCHL1Encoder::sendCached(unsigned index, const L2Frame& frame, unsigned version)
 {
-	while (mRunning) {
-		generate();
+	assert(index<sMaxCached);
+	if (version!=mCacheVersion) {
+		OBJLOG(DEBUG) << "NDCCHL1Encoder cache flush, version " << version;
+		for (unsigned i=0; i<sMaxCached; i++) mCached[i] = false;
+		mCacheVersion = version;
 	}
-}
 
+	if (!mCached[index]) {
+		// Encode and send as usual, then keep the results.
+		frame.copyToSegment(mCachedU[index],headerOffset());
+		writeHighSide(frame);
+		for (int B=0; B<4; B++) mI[B].copyTo(mCachedI[index][B]);
+		mCached[index] = true;
+		return;
+	}
 
+	// Skip straight to transmit().
+	resync();
+	gWriteGSMTAP(ARFCN(),TN(),mNextWriteTime.FN(),
+	             typeAndOffset(),mMapping.repeatLength()>51,false,mCachedU[index]);
+	for (int B=0; B<4; B++) mCachedI[index][B].copyTo(mI[B]);
+	transmit();
+}
 
 
 
 void BCCHL1Encoder::generate()
 {
 	OBJLOG(DEBUG) << "BCCHL1Encoder " << mNextWriteTime;
+	unsigned version = gBTS.beaconVersion();
 	// BCCH mapping, GSM 05.02 6.3.1.3
 	// Since we're not doing GPRS or VGCS, it's just SI1-4 over and over.
+	// The cache index is the SI type less 1.
 	switch (mNextWriteTime.TC()) {
-		case 0: writeHighSide(gBTS.SI1Frame()); return;
-		case 1: writeHighSide(gBTS.SI2Frame()); return;
-		case 2: writeHighSide(gBTS.SI3Frame()); return;
-		case 3: writeHighSide(gBTS.SI4Frame()); return;
-		case 4: writeHighSide(gBTS.SI3Frame()); return;
-		case 5: writeHighSide(gBTS.SI2Frame()); return;
-		case 6: writeHighSide(gBTS.SI3Frame()); return;
-		case 7: writeHighSide(gBTS.SI4Frame()); return;
+		case 0: sendCached(0,gBTS.SI1Frame(),version); return;
+		case 1: sendCached(1,gBTS.SI2Frame(),version); return;
+		case 2: sendCached(2,gBTS.SI3Frame(),version); return;
+		case 3: sendCached(3,gBTS.SI4Frame(),version); return;
+		case 4: sendCached(2,gBTS.SI3Frame(),version); return;
+		case 5: sendCached(1,gBTS.SI2Frame(),version); return;
+		case 6: sendCached(2,gBTS.SI3Frame(),version); return;
+		case 7: sendCached(3,gBTS.SI4Frame(),version); return;
 		default: assert(0);
 	}
 }
@@ -1130,6 +1220,7 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	// Every 4th frame is the start of a new block.
 	// So if this isn't a "4th" frame, return now.
 	if (B%4!=3) return false;
+	uint64_t start = metricsClock();
 
 	// Deinterleave according to the diagonal "phase" of B.
 	// See GSM 05.03 3.1.3.
@@ -1155,14 +1246,18 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	// Always feed the traffic channel, even on a stolen frame.
 	// decodeTCH will handle the GSM 06.11 bad frmae processing.
 	bool traffic = decodeTCH(stolen);
+	gTCHDecodeTime.record(metricsClock()-start);
 	if (traffic) {
+		gTCHUplinkGood.incr();
 		OBJLOG(DEBUG) <<"TCHFACCHL1Decoder good TCH frame";
 		countGoodFrame();
 		// Don't let the channel timeout.
 		ScopedLock lock(mLock);
 		mT3109.set();
+	} else {
+		gTCHUplinkBad.incr();
+		countBadFrame();
 	}
-	else countBadFrame();
 
 	return true;
 }
@@ -1173,12 +1268,7 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 void TCHFACCHL1Decoder::deinterleave(int blockOffset )
 {
 	OBJLOG(DEBUG) <<"TCHFACCHL1Decoder blockOffset=" << blockOffset;
-	for (int k=0; k<456; k++) {
-		int B = ( k + blockOffset ) % 8;
-		int j = 2*((49*k) % 57) + ((k%8)/4);
-		mC[k] = mI[B][j];
-		mI[B][j] = 0.5F;
-	}
+	deinterleaveTCH(mI,mC,blockOffset);
 }
 
 
@@ -1216,7 +1306,7 @@ bool TCHFACCHL1Decoder::decodeTCH(bool stolen)
 		// 3.1.2.1
 		// check parity of class 1A
 		unsigned sentParity = (~mTCHU.peekField(91,3)) & 0x07;
-		unsigned calcParity = mClass1A_d.parity(mTCHParity) & 0x07;
+		unsigned calcParity = mTCHParity.parity(mClass1A_d) & 0x07;
 
 		// 3.1.2.2
 		// Check the tail bits, too.
@@ -1231,8 +1321,7 @@ bool TCHFACCHL1Decoder::decodeTCH(bool stolen)
 		if (good) {
 			// Undo Um's importance-sorted bit ordering.
 			// See GSM 05.03 3.1 and Table 2.
-			BitVector payload = mVFrame.payload();
-			mTCHD.unmap(g610BitOrder,260,payload);
+			mVFrame.unmapPayload(mTCHD,g610BitOrder,260);
 			mVFrame.pack(newFrame);
 			// Save a copy for bad frame processing.
 			memcpy(mPrevGoodFrame,newFrame,33);
@@ -1267,16 +1356,6 @@ bool TCHFACCHL1Decoder::decodeTCH(bool stolen)
 
 
 
-void GSM::TCHFACCHL1EncoderRoutine( TCHFACCHL1Encoder * encoder )
-{
-	while (1) {
-		encoder->dispatch();
-	}
-}
-
-
-
-
 TCHFACCHL1Encoder::TCHFACCHL1Encoder(
 	unsigned wCN,
 	unsigned wTN,
@@ -1302,7 +1381,7 @@ void TCHFACCHL1Encoder::start()
 {
 	L1Encoder::start();
 	OBJLOG(DEBUG) <<"TCHFACCHL1Encoder";
-	mEncoderThread.start((void*(*)(void*))TCHFACCHL1EncoderRoutine,(void*)this);
+	gBTS.executor().add(this,mNextWriteTime);
 }
 
 
@@ -1323,7 +1402,7 @@ void TCHFACCHL1Encoder::encodeTCH(const VocoderFrame& vFrame)
 
 	// Reorder bits by importance.
 	// See GSM 05.03 3.1 and Table 2.
-	vFrame.payload().map(g610BitOrder,260,mTCHD);
+	vFrame.mapPayload(g610BitOrder,260,mTCHD);
 
 	// 3.1.2.1 -- parity bits
 	BitVector p = mTCHU.segment(91,3);
@@ -1361,7 +1440,7 @@ void TCHFACCHL1Encoder::sendFrame( const L2Frame& frame )
 
 
 
-void TCHFACCHL1Encoder::dispatch()
+bool TCHFACCHL1Encoder::step(Time& next)
 {
 
 	// No downstream?  That's a problem.
@@ -1375,13 +1454,13 @@ void TCHFACCHL1Encoder::dispatch()
 	// from above.  TCH/FACCH, however, must feed the interleaver on time.
 	if (!active()) {
 		mNextWriteTime += 26;
-		gBTS.clock().wait(mNextWriteTime);
-		return;
+		next = mNextWriteTime;
+		return true;
 	}
 
 	// Let previous data get transmitted.
 	resync();
-	waitToSend();
+	if (!readyToSend(next)) return true;
 	
 	// flag to control stealing bits
 	bool currentFACCH = false; 
@@ -1389,8 +1468,12 @@ void TCHFACCHL1Encoder::dispatch()
 	// Speech latency control.
 	// Since Asterisk is local, latency should be small.
 	OBJLOG(DEBUG) <<"TCHFACCHL1Encoder speechQ.size=" << mSpeechQ.size();
-	int maxQ = gConfig.getNum("GSM.MaxSpeechLatency");
-	while (mSpeechQ.size() > maxQ) delete mSpeechQ.read();
+	static ConfigKey<long> sMaxSpeechLatency(gConfig,"GSM.MaxSpeechLatency",2);
+	int maxQ = sMaxSpeechLatency.value();
+	while (mSpeechQ.size() > maxQ) {
+		delete mSpeechQ.read();
+		gTCHDownlinkDropped.incr();
+	}
 
 	// Send, by priority: (1) FACCH, (2) TCH, (3) filler.
 	if (L2Frame *fFrame = mL2Q.readNoBlock()) {
@@ -1405,18 +1488,23 @@ void TCHFACCHL1Encoder::dispatch()
 		delete fFrame;
 		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder FACCH c[]=" << mC;
 		// Flush the vocoder FIFO to limit latency.
-		while (mSpeechQ.size()>0) delete mSpeechQ.read();
+		while (mSpeechQ.size()>0) {
+			delete mSpeechQ.read();
+			gTCHDownlinkDropped.incr();
+		}
 	} else if (VocoderFrame *tFrame = mSpeechQ.readNoBlock()) {
 		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH " << *tFrame;
 		// Encode the speech frame into c[] as per GSM 05.03 3.1.2.
 		encodeTCH(*tFrame);
 		delete tFrame;
+		gTCHDownlinkSent.incr();
 		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH c[]=" << mC;
 	} else {
 		// We have no ready data but must send SOMETHING.
 		// This filler pattern was captured from a Nokia 3310, BTW.
 		static const BitVector fillerC("110100001000111100000000111001111101011100111101001111000000000000110111101111111110100110101010101010101010101010101010101010101010010000110000000000000000000000000000000000000000001101001111000000000000000000000000000000000000000000000000111010011010101010101010101010101010101010101010101001000011000000000000000000110100111100000000111001111101101000001100001101001111000000000000000000011001100000000000000000000000000000000000000000000000000000000001");
 		fillerC.copyTo(mC);
+		gTCHDownlinkFiller.incr();
 		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder filler FACCH=" << currentFACCH << " c[]=" << mC;
 	}
 
@@ -1447,6 +1535,9 @@ void TCHFACCHL1Encoder::dispatch()
 
 	// Save the stealing flag.
 	mPreviousFACCH = currentFACCH;
+
+	next = mPrevWriteTime - downlinkLead();
+	return true;
 }
 
 
@@ -1454,11 +1545,7 @@ void TCHFACCHL1Encoder::dispatch()
 void TCHFACCHL1Encoder::interleave(int blockOffset)
 {
 	// GSM 05.03, 3.1.3
-	for (int k=0; k<456; k++) {
-		int B = ( k + blockOffset ) % 8;
-		int j = 2*((49*k) % 57) + ((k%8)/4);
-		mI[B][j] = mC[k];
-	}
+	interleaveTCH(mC,mI,blockOffset);
 }
 
 
@@ -1520,6 +1607,16 @@ void SACCHL1Decoder::setPhy(const SACCHL1Decoder& other)
 
 
 
+// The closed-loop power and timing parameters, read every SACCH frame, so use precompiled handles.
+static ConfigKey<long> gRSSITarget(gConfig,"GSM.Radio.RSSITarget",-50);
+static ConfigKey<long> gMSPowerDamping(gConfig,"GSM.MS.Power.Damping",50);
+static ConfigKey<long> gMSPowerMax(gConfig,"GSM.MS.Power.Max",33);
+static ConfigKey<long> gMSPowerMin(gConfig,"GSM.MS.Power.Min",5);
+static ConfigKey<long> gMSTADamping(gConfig,"GSM.MS.TA.Damping",50);
+static ConfigKey<long> gMSTAMax(gConfig,"GSM.MS.TA.Max",5);
+
+
+
 void SACCHL1Encoder::setPhy(float wRSSI, float wTimingError)
 {
 	// Used to initialize L1 phy parameters.
@@ -1528,12 +1625,12 @@ void SACCHL1Encoder::setPhy(float wRSSI, float wTimingError)
 	SACCHL1Decoder &sib = *SACCHSibling();
 	// RSSI
 	float RSSI = sib.RSSI();
-	float RSSITarget = gConfig.getNum("GSM.Radio.RSSITarget");
+	float RSSITarget = gRSSITarget.value();
 	float deltaP = RSSI - RSSITarget;
 	float actualPower = sib.actualMSPower();
 	mOrderedMSPower = actualPower - deltaP;
-	float maxPower = gConfig.getNum("GSM.MS.Power.Max");
-	float minPower = gConfig.getNum("GSM.MS.Power.Min");
+	float maxPower = gMSPowerMax.value();
+	float minPower = gMSPowerMin.value();
 	if (mOrderedMSPower>maxPower) mOrderedMSPower=maxPower;
 	else if (mOrderedMSPower<minPower) mOrderedMSPower=minPower;
 	OBJLOG(INFO) <<"SACCHL1Encoder RSSI=" << RSSI << " target=" << RSSITarget
@@ -1542,7 +1639,7 @@ void SACCHL1Encoder::setPhy(float wRSSI, float wTimingError)
 	float timingError = sib.timingError();
 	float actualTiming = sib.actualMSTiming();
 	mOrderedMSTiming = actualTiming + timingError;
-	float maxTiming = gConfig.getNum("GSM.MS.TA.Max");
+	float maxTiming = gMSTAMax.value();
 	if (mOrderedMSTiming<0.0F) mOrderedMSTiming=0.0F;
 	else if (mOrderedMSTiming>maxTiming) mOrderedMSTiming=maxTiming;
 	OBJLOG(INFO) << "SACCHL1Encoder timingError=" << timingError  <<
@@ -1604,14 +1701,14 @@ void SACCHL1Encoder::sendFrame(const L2Frame& frame)
 		// Power.  GSM 05.08 4.
 		// Power expressed in dBm, RSSI in dB wrt max.
 		float RSSI = sib.RSSI();
-		float RSSITarget = gConfig.getNum("GSM.Radio.RSSITarget");
+		float RSSITarget = gRSSITarget.value();
 		float deltaP = RSSI - RSSITarget;
 		float actualPower = sib.actualMSPower();
 		float targetMSPower = actualPower - deltaP;
-		float powerDamping = gConfig.getNum("GSM.MS.Power.Damping")*0.01F;
+		float powerDamping = gMSPowerDamping.value()*0.01F;
 		mOrderedMSPower = powerDamping*mOrderedMSPower + (1.0F-powerDamping)*targetMSPower;
-		float maxPower = gConfig.getNum("GSM.MS.Power.Max");
-		float minPower = gConfig.getNum("GSM.MS.Power.Min");
+		float maxPower = gMSPowerMax.value();
+		float minPower = gMSPowerMin.value();
 		if (mOrderedMSPower>maxPower) mOrderedMSPower=maxPower;
 		else if (mOrderedMSPower<minPower) mOrderedMSPower=minPower;
 		OBJLOG(DEBUG) <<"SACCHL1Encoder RSSI=" << RSSI << " target=" << RSSITarget
@@ -1621,9 +1718,9 @@ void SACCHL1Encoder::sendFrame(const L2Frame& frame)
 		float timingError = sib.timingError();
 		float actualTiming = sib.actualMSTiming();
 		float targetMSTiming = actualTiming + timingError;
-		float TADamping = gConfig.getNum("GSM.MS.TA.Damping")*0.01F;
+		float TADamping = gMSTADamping.value()*0.01F;
 		mOrderedMSTiming = TADamping*mOrderedMSTiming + (1.0F-TADamping)*targetMSTiming;
-		float maxTiming = gConfig.getNum("GSM.MS.TA.Max");
+		float maxTiming = gMSTAMax.value();
 		if (mOrderedMSTiming<0.0F) mOrderedMSTiming=0.0F;
 		else if (mOrderedMSTiming>maxTiming) mOrderedMSTiming=maxTiming;
 		OBJLOG(DEBUG) << "SACCHL1Encoder timingError=" << timingError
@@ -37,6 +37,7 @@
 #include "GSMTDMA.h"
 
 #include "GSM610Tables.h"
+#include "ChannelExecutor.h"
 
 #include <Globals.h>
 
@@ -162,6 +163,13 @@ class L1Encoder {
 	*/
 	virtual bool active() const;
 
+	/**
+		The non-blocking form of waitToSend(), for ChannelTask steps.
+		@param when Set to the time waitToSend() would wait for if the clock has not caught up.
+		@return true if waitToSend() would not block.
+	*/
+	bool readyToSend(Time& when) const;
+
 	/**
 	  Process pending L2 frames and/or generate filler and enqueue the resulting timeslots.
 	  This method may block briefly, up to about 1/2 second.
@@ -185,10 +193,13 @@ class L1Encoder {
 	/** Return pointer to paired L1 decoder, if any. */
 	virtual const L1Decoder* sibling() const;
 
+	/** Frames ahead of the clock that the downlink scheduler sends bursts, 0 with no radio. */
+	unsigned downlinkLead() const;
+
 	/** Make sure we're consistent with the current clock.  */
 	void resync();
 
-	/** Block until the BTS clock catches up to mPrevWriteTime.  */
+	/** Block until the BTS clock catches up to mPrevWriteTime, less the downlink lead.  */
 	void waitToSend() const;
 
 	/**
@@ -370,6 +381,12 @@ class L1FEC {
 	/** Attach L1 to a downstream radio. */
 	void downstream(ARFCNManager*);
 
+	/**@name Take the uplink off and back onto a radio already attached with downstream(). */
+	//@{
+	void detach(ARFCNManager*);
+	void reattach(ARFCNManager*);
+	//@}
+
 	/** Attach L1 to an upstream SAPI mux and L2. */
 	void upstream(SAPMux* mux)
 		{ if (mDecoder) mDecoder->upstream(mux); }
@@ -705,7 +722,7 @@ class XCCHL1Encoder : public L1Encoder {
 
 
 /** L1 encoder used for full rate TCH and FACCH -- mostry from GSM 05.03 3.1 and 4.2 */
-class TCHFACCHL1Encoder : public XCCHL1Encoder {
+class TCHFACCHL1Encoder : public XCCHL1Encoder, public ChannelTask {
 
 private:
 
@@ -727,9 +744,6 @@ private:
 
 	L2FrameFIFO mL2Q;				///< input queue for L2 FACCH frames
 
-	Thread mEncoderThread;
-	friend void TCHFACCHL1EncoderRoutine( TCHFACCHL1Encoder * encoder );	
-
 public:
 
 	TCHFACCHL1Encoder(unsigned wCN, unsigned wTN, 
@@ -743,6 +757,9 @@ public:
 	/** Extend open() to set up semaphores. */
 	void open();
 
+	/** Return count of queued FACCH frames. */
+	unsigned FACCHBacklog() const { return mL2Q.size(); }
+
 protected:
 
 	/** Interleave c[] to i[].  GSM 05.03 4.1.4. */
@@ -752,13 +769,13 @@ protected:
 	void sendFrame(const L2Frame&);
 
 	/**
-		dispatch called in a while loop.
+		Executor step, once per 4-frame block:
 		process reading transcoder and fifo to 
 		interleave and send.
 	*/
-	void dispatch();
+	bool step(Time& next);
 
-	/** Will start the dispatch thread. */
+	/** Will start the dispatch task. */
 	void start();
 
 	/** Encode a vocoder frame into c[]. */
@@ -767,9 +784,6 @@ protected:
 };
 
 
-/** The C adapter for pthreads. */
-void TCHFACCHL1EncoderRoutine( TCHFACCHL1Encoder * encoder );
-
 /** L1 decoder used for full rate TCH and FACCH -- mostly from GSM 05.03 3.1 and 4.2 */
 class TCHFACCHL1Decoder : public XCCHL1Decoder {
 
@@ -791,7 +805,7 @@ class TCHFACCHL1Decoder : public XCCHL1Decoder {
 
 	Parity mTCHParity;
 
-	InterthreadQueue<unsigned char> mSpeechQ;					///< output queue for speech frames
+	SPSCInterthreadQueue<unsigned char> mSpeechQ;					///< output queue for speech frames
 
 
 	public:
@@ -843,11 +857,7 @@ class TCHFACCHL1Decoder : public XCCHL1Decoder {
 	This is base class for output-only encoders.
 	These all have very thin L2/L3 and are driven by a clock instead of a FIFO.
 */
-class GeneratorL1Encoder : public L1Encoder {
-
-	private:
-
-	Thread mSendThread;
+class GeneratorL1Encoder : public L1Encoder, public ChannelTask {
 
 	public:
 
@@ -866,18 +876,12 @@ class GeneratorL1Encoder : public L1Encoder {
 	/** The generate method actually produces output bursts. */
 	virtual void generate() =0;
 
-	/** The core service loop calls generate repeatedly. */
-	void serviceLoop();
-
-	/** Provide a C interface for pthreads. */
-	friend void *GeneratorL1EncoderServiceLoopAdapter(GeneratorL1Encoder*);
+	/** The executor step calls generate once the clock allows. */
+	bool step(Time& next);
 
 };
 
 
-void *GeneratorL1EncoderServiceLoopAdapter(GeneratorL1Encoder*);
-
-
 /**
 	The L1 encoder for the sync channel (SCH).
 	The SCH sends out an encoding of the current BTS clock.
@@ -930,12 +934,20 @@ class FCCHL1Encoder : public GeneratorL1Encoder {
 /**
 	L1 encoder for repeating non-dedicated control channels (BCCH).
 	This have generator-like drive loops, but xCCH-like FEC.
+	Since the same few frames repeat, their interleaved bursts are cached.
 */
-class NDCCHL1Encoder : public XCCHL1Encoder {
+class NDCCHL1Encoder : public XCCHL1Encoder, public ChannelTask {
 
-	protected:
+	private:
 
-	Thread mSendThread;
+	/**@name The cache of encoded repeating frames, indexed by the subclass. */
+	//@{
+	static const unsigned sMaxCached = 4;
+	BitVector mCachedU[sMaxCached];		///< u[] before encoding, for GSMTAP
+	BitVector mCachedI[sMaxCached][4];	///< i[][], ready for transmit()
+	bool mCached[sMaxCached];
+	unsigned mCacheVersion;				///< the version the cached entries were encoded from
+	//@}
 
 	public:
 
@@ -944,9 +956,7 @@ class NDCCHL1Encoder : public XCCHL1Encoder {
 		unsigned wCN,
 		unsigned wTN,
 		const TDMAMapping& wMapping,
-		L1FEC *wParent)
-		:XCCHL1Encoder(wCN, wTN, wMapping, wParent)
-	{ }
+		L1FEC *wParent);
 
 	void start();
 
@@ -954,14 +964,19 @@ class NDCCHL1Encoder : public XCCHL1Encoder {
 
 	virtual void generate() =0;
 
-	/** The core service loop. */
-	void serviceLoop();
+	/**
+		Send a repeating frame, encoding it only if it is not cached.
+		@param index The frame's cache slot, below sMaxCached.
+		@param frame The frame to send.
+		@param version A version that changes whenever any frame's content does;
+			read it before reading the frame.
+	*/
+	void sendCached(unsigned index, const L2Frame& frame, unsigned version);
 
-	friend void *NDCCHL1EncoderServiceLoopAdapter(NDCCHL1Encoder*);
+	/** The executor step calls generate once the clock allows. */
+	bool step(Time& next);
 };
 
-void *NDCCHL1EncoderServiceLoopAdapter(NDCCHL1Encoder*);
-
 
 
 /**
@@ -1143,6 +1158,9 @@ public:
 	unsigned queueSize() const
 		{ assert(mTCHDecoder); return mTCHDecoder->queueSize(); }
 
+	unsigned FACCHBacklog() const
+		{ assert(mTCHEncoder); return mTCHEncoder->FACCHBacklog(); }
+
 	bool radioFailure() const
 		{ assert(mTCHDecoder); return mTCHDecoder->uplinkLost(); }
 };
@@ -43,6 +43,7 @@ implementation, although no code is copied directly.
 #include "GSML2LAPDm.h"
 #include "GSMSAPMux.h"
 #include <Logger.h>
+#include <Globals.h>
 
 using namespace std;
 using namespace GSM;
@@ -79,15 +80,19 @@ void CCCHL2::writeHighSide(const GSM::L3Frame& l3)
 
 L2LAPDm::L2LAPDm(unsigned wC, unsigned wSAPI)
 	:mRunning(false),
+	mT200Event(false),mReleasePosted(0),mGeneration(0),
 	mC(wC),mR(1-wC),mSAPI(wSAPI),
 	mMaster(NULL),
-	mT200(T200ms),
+	mReleaseTaken(0),mReleaseDone(0),
+	mT200(T200ms,T200Fired,this),
 	mIdleFrame(DATA)
 {
 	// sanity checks
 	assert(mC<2);
 	assert(mSAPI<4);
 
+	for (unsigned i=0; i<8; i++) mSentIFrames[i].mCallback = NULL;
+	mPendingRelease.mFrame = NULL;
 	clearState();
 
 	// Set the idle frame as per GSM 04.06 5.4.2.3.
@@ -128,32 +133,37 @@ void L2LAPDm::writeL1Ack(const L2Frame& frame)
 
 
 
-void L2LAPDm::waitForAck()
-{
-	// Block until any pending ack is received.
-	// Caller should hold mLock.
-	OBJLOG(DEBUG) <<"L2LAPDm::waitForAck state=" << mState << " VS=" << mVS << " VA=" << mVA;
-	while (true) {
-		if (mState==LinkReleased) break;
-		if ((mState==ContentionResolution) && (mVS==mVA)) break;
-		if ((mState==LinkEstablished) && (mVS==mVA)) break;
-		// HACK -- We should not need a timeout here.
-		mAckSignal.wait(mLock,N200()*T200ms);
-		OBJLOG(DEBUG) <<"L2LAPDm::waitForAck state=" << mState << " VS=" << mVS << " VA=" << mVA;
-	}
-}
-
-
-
 void L2LAPDm::releaseLink(Primitive releaseType)
 {
 	OBJLOG(DEBUG) << "mState=" << mState;
 	// Caller should hold mLock.
 	mState = LinkReleased;
 	mEstablishmentInProgress = false;
-	mAckSignal.signal();
 	if (mSAPI==0) writeL1(releaseType);
 	mL3Out.write(new L3Frame(releaseType));
+	// However the link came down, that completes any release L3 asked for.
+	if (mPendingRelease.mFrame) {
+		delete mPendingRelease.mFrame;
+		mPendingRelease.mFrame = NULL;
+	}
+	mReleaseDone = mReleaseTaken;
+	mReleaseSignal.broadcast();
+}
+
+
+void L2LAPDm::discardIQueue()
+{
+	// Caller should hold mLock.
+	for (unsigned NS=0; NS<8; NS++) {
+		SentIFrame& sent = mSentIFrames[NS];
+		L2Completion callback = sent.mCallback;
+		sent.mCallback = NULL;
+		complete(callback,sent.mContext,false);
+	}
+	while (mIQueue.size()>0) {
+		complete(mIQueue.front().mCallback,mIQueue.front().mContext,false);
+		mIQueue.pop_front();
+	}
 }
 
 
@@ -162,14 +172,15 @@ void L2LAPDm::clearCounters()
 	OBJLOG(DEBUG) << "mState=" << mState;
 	// Caller should hold mLock.
 	// This is called upon establishment or re-establihment of ABM.
+	discardIQueue();
 	mT200.reset();
 	mVS = 0;
 	mVA = 0;
 	mVR = 0;
 	mRC = 0;
+	mRejectSent = false;
 	mIdleCount=0;
 	mRecvBuffer.clear();
-	discardIQueue();
 }
 
 
@@ -192,17 +203,32 @@ void L2LAPDm::processAck(unsigned NR)
 	// but much simpler for LAPDm.
 	// Caller should hold mLock.
 	OBJLOG(DEBUG) << "NR=" << NR << " VA=" << mVA << " VS=" << mVS;
-	mVA=NR;
+	// N(R) can only acknowledge frames that were sent, V(A)<=N(R)<=V(S).
+	unsigned outstanding = (mVS+8-mVA)%8;
+	unsigned acked = (NR+8-mVA)%8;
+	if (acked>outstanding) {
+		OBJLOG(NOTICE) << "N(R) out of range, NR=" << NR << " VA=" << mVA << " VS=" << mVS;
+		return;
+	}
+	while (mVA!=NR) {
+		SentIFrame& sent = mSentIFrames[mVA];
+		L2Completion callback = sent.mCallback;
+		sent.mCallback = NULL;
+		complete(callback,sent.mContext,true);
+		mVA = (mVA+1)%8;
+	}
 	if (mVA==mVS) {
 		mRC=0;
 		mT200.reset();
+	} else if (acked>0) {
+		// Restart T200 for the frames still outstanding.
+		mT200.set(T200());
 	}
-	mAckSignal.signal();
 }
 
 
 
-void L2LAPDm::bufferIFrameData(const L2Frame& frame)
+void L2LAPDm::bufferIFrameData(L2Frame& frame)
 {
 	// Concatenate I-frames to form the L3 frame.
 	/*
@@ -223,14 +249,16 @@ void L2LAPDm::bufferIFrameData(const L2Frame& frame)
 	if (!frame.M()) {
 		// The last or only frame.
 		if (mRecvBuffer.size()==0) {
-			// The only frame -- just send it up.
+			// The only frame -- just send it up, in its own buffer.
 			OBJLOG(DEBUG) << "single frame message";
-			mL3Out.write(new L3Frame(frame));
+			mL3Out.write(new L3Frame(std::move(frame)));
 			return;
 		}
 		// The last of several -- concat and send it up.
 		OBJLOG(DEBUG) << "last frame of message";
-		mL3Out.write(new L3Frame(mRecvBuffer,frame.L3Part()));
+		L3Frame *message = new L3Frame(mRecvBuffer,frame.L3Part());
+		message->receiveTime(frame.receiveTime());
+		mL3Out.write(message);
 		mRecvBuffer.clear();
 		return;
 	}
@@ -275,9 +303,25 @@ void L2LAPDm::retransmissionProcedure()
 	// GSM 04.08 5.5.7, bullet point (a)
 	OBJLOG(DEBUG) << "VS=" << mVS << " VA=" << mVA << " RC=" << mRC;
 	mRC++;
-	writeL1(mSentFrame);
+	if (mState==AwaitingEstablish) {
+		writeL1(mSentFrame);
+		mT200.set(T200());
+	}
+	else resendIFrames();
+}
+
+
+void L2LAPDm::resendIFrames()
+{
+	// Caller should hold mLock.
+	// Go back to the oldest unacknowledged I-frame.
+	// N(R) may have moved since the frames were first sent.
+	for (unsigned NS=mVA; NS!=mVS; NS=(NS+1)%8) {
+		L2Frame& frame = mSentIFrames[NS].mFrame;
+		frame.fillField(8*1+0,mVR,3);
+		writeL1(frame);
+	}
 	mT200.set(T200());
-	mAckSignal.signal();
 }
 
 
@@ -296,10 +340,9 @@ void L2LAPDm::open()
 			mUpstreamThread.start((void *(*)(void*))LAPDmServiceLoopAdapter,this);
 		}
 		mL3Out.clear();
-		mL1In.clear();
+		flushEvents();
 		clearCounters();
 		mState = LinkReleased;
-		mAckSignal.signal();
 	}
 
 	if (mSAPI==0) sendIdle();
@@ -323,10 +366,8 @@ void L2LAPDm::writeHighSide(const L3Frame& frame)
 			sendUFrameUI(frame);
 			break;
 		case DATA:
-			// Send the data as a series of I-Frames.
-			mLock.lock();
-			sendMultiframeData(frame);
-			mLock.unlock();
+			// Queue the data for the service thread to send as I-Frames.
+			writeData(frame,NULL,NULL);
 			break;
 		case ESTABLISH:
 			// GSM 04.06 5.4.1.2
@@ -342,32 +383,23 @@ void L2LAPDm::writeHighSide(const L3Frame& frame)
 			sendUFrameSABM();
 			break;
 		case RELEASE:
-			// GSM 04.06 5.4.4.2
-			// vISDN datalink.c:lapd_dl_release_request
 			if (mState==LinkReleased) break;
-			mLock.lock();
-			if (mState==LinkEstablished) waitForAck();
-			clearCounters();
-			mEstablishmentInProgress=false;
-			mState=AwaitingRelease;
-			mT200.set(T200());	// HACK?
-			// Send DISC and wait for UA.
-			// Don't return until released.
-			sendUFrameDISC();
-			waitForAck();
-			mLock.unlock();
-			break;
+			// fall through
 		case ERROR:
-			// Forced release.
-			mLock.lock();
-			abnormalRelease();
-			mLock.unlock();
-			break;
-		case HARDRELEASE:
-			mLock.lock();
-			clearState(HARDRELEASE);
-			mLock.unlock();
+		case HARDRELEASE: {
+			if (!mRunning) {
+				// Never opened, so there is no service thread and nothing queued.
+				ScopedLock lock(mLock);
+				applyRelease(frame.primitive());
+				break;
+			}
+			// These go behind any queued DATA; see serviceL3.
+			// Don't return until released.
+			unsigned sequence = postL3(new L3Frame(frame.primitive()),NULL,NULL);
+			ScopedLock lock(mLock);
+			while ((int)(mReleaseDone-sequence)<0) mReleaseSignal.wait(mLock);
 			break;
+		}
 		default:
 			OBJLOG(ERR) << "unhandled primitive in L3->L2 " << frame;
 			assert(0);
@@ -375,48 +407,230 @@ void L2LAPDm::writeHighSide(const L3Frame& frame)
 }
 
 
+void L2LAPDm::writeData(const L3Frame& frame, L2Completion callback, void* context)
+{
+	OBJLOG(DEBUG) << frame;
+	assert(frame.primitive()==DATA);
+	postL3(new L3Frame(frame),callback,context);
+	// HACK -- Sleep before returning to prevent fast spinning
+	// in SACCH L3 during release.
+	if (mState==LinkReleased) sleepFrames(51);
+}
+
+
+unsigned L2LAPDm::downlinkBacklog() const
+{
+	mEventLock.lock();
+	unsigned count = mL3In.size();
+	mEventLock.unlock();
+	ScopedLock lock(mLock);
+	return count + mL3Backlog.size() + mIQueue.size();
+}
+
+
+unsigned L2LAPDm::postL3(L3Frame* frame, L2Completion callback, void* context)
+{
+	ScopedLock lock(mEventLock);
+	L3Request request;
+	request.mFrame = frame;
+	request.mCallback = callback;
+	request.mContext = context;
+	request.mSequence = 0;
+	if (frame->primitive()!=DATA) request.mSequence = ++mReleasePosted;
+	mL3In.push_back(request);
+	mEventSignal.signal();
+	return request.mSequence;
+}
+
 
 
 
 void L2LAPDm::writeLowSide(const L2Frame& frame)
 {
 	OBJLOG(DEBUG) << frame;
-	mL1In.write(new L2Frame(frame));
+	L2Frame* copy = new L2Frame(frame);
+	ScopedLock lock(mEventLock);
+	mL1In.push_back(copy);
+	mEventSignal.signal();
+}
+
+
+void L2LAPDm::writeLowSide(L2Frame&& frame)
+{
+	OBJLOG(DEBUG) << frame;
+	L2Frame* copy = new L2Frame(std::move(frame));
+	ScopedLock lock(mEventLock);
+	mL1In.push_back(copy);
+	mEventSignal.signal();
+}
+
+
+void L2LAPDm::T200Fired(void* context)
+{
+	// This runs on the TimerWheel's thread, so just wake the service thread.
+	L2LAPDm* lapdm = (L2LAPDm*)context;
+	ScopedLock lock(lapdm->mEventLock);
+	lapdm->mT200Event = true;
+	lapdm->mEventSignal.signal();
+}
+
+
+void L2LAPDm::flushEvents()
+{
+	// Caller holds mLock.
+	std::deque<L3Request> requests;
+	{
+		ScopedLock lock(mEventLock);
+		while (mL1In.size()>0) {
+			delete mL1In.front();
+			mL1In.pop_front();
+		}
+		requests.swap(mL3In);
+		mT200Event = false;
+		mReleaseTaken = mReleasePosted;
+		mGeneration++;
+	}
+	requests.insert(requests.end(),mL3Backlog.begin(),mL3Backlog.end());
+	mL3Backlog.clear();
+	if (mPendingRelease.mFrame) {
+		delete mPendingRelease.mFrame;
+		mPendingRelease.mFrame = NULL;
+	}
+	for (unsigned i=0; i<requests.size(); i++) {
+		complete(requests[i].mCallback,requests[i].mContext,false);
+		delete requests[i].mFrame;
+	}
+	mReleaseDone = mReleaseTaken;
+	mReleaseSignal.broadcast();
 }
 
 
 
 void L2LAPDm::serviceLoop()
 {
-	mLock.lock();
 	while (mRunning) {
-		// Block for up to T200 expiration, then check T200.
-		// Allow other threads to modify state while blocked.
-		// Add 2 ms to prevent race condition due to roundoff error.
-		unsigned timeout = mT200.remaining() + 2;
+		// Sleep until there is something to do.
+		std::deque<L2Frame*> frames;
+		std::deque<L3Request> requests;
+		mEventLock.lock();
+		while (mL1In.size()==0 && mL3In.size()==0 && !mT200Event) mEventSignal.wait(mEventLock);
+		frames.swap(mL1In);
+		requests.swap(mL3In);
+		bool T200Event = mT200Event;
+		mT200Event = false;
+		unsigned generation = mGeneration;
+		mEventLock.unlock();
+
+		ScopedLock lock(mLock);
+		if (generation!=mGeneration) {
+			// The channel was reopened since these were taken.
+			for (unsigned i=0; i<frames.size(); i++) delete frames[i];
+			for (unsigned i=0; i<requests.size(); i++) {
+				complete(requests[i].mCallback,requests[i].mContext,false);
+				delete requests[i].mFrame;
+			}
+			continue;
+		}
 		// If SAP0 is released, other SAPs need to release also.
 		if (mMaster) {
 			if (mMaster->mState==LinkReleased) mState=LinkReleased;
 		}
-		if (!mT200.active()) {
-			if (mState==LinkReleased) timeout=3600000;
-			else timeout = T200();
+		mL3Backlog.insert(mL3Backlog.end(),requests.begin(),requests.end());
+		for (unsigned i=0; i<frames.size(); i++) {
+			OBJLOG(DEBUG) << "state=" << mState << " received " << *frames[i];
+			receiveFrame(*frames[i]);
+			delete frames[i];
+		}
+		if (T200Event && mT200.expired()) T200Expiration();
+		serviceL3();
+	}
+}
+
+
+
+void L2LAPDm::serviceL3()
+{
+	// Caller holds mLock.
+	while (true) {
+		sendIFrames();
+		if (mPendingRelease.mFrame) {
+			// A release waits until the queued DATA is handed to L1,
+			// and a normal release until it is acknowledged, GSM 04.06 5.4.4.2.
+			bool established = (mState==LinkEstablished) || (mState==ContentionResolution);
+			if (established && mIQueue.size()>0) return;
+			Primitive prim = mPendingRelease.mFrame->primitive();
+			if (prim==RELEASE && mState==LinkEstablished && mVA!=mVS) return;
+			delete mPendingRelease.mFrame;
+			mPendingRelease.mFrame = NULL;
+			applyRelease(prim);
+			continue;
 		}
-		OBJLOG(DEBUG) << "read blocking up to " << timeout << " ms, state=" << mState;
-		mLock.unlock();
-		// FIXME -- If the link is released, there should be no timeout at all.
-		L2Frame* frame = mL1In.read(timeout);
-		mLock.lock();
-		if (frame!=NULL) {
-			OBJLOG(DEBUG) << "state=" << mState << " received " << *frame;
-			receiveFrame(*frame);
-			delete frame;
+		if (mL3Backlog.size()==0) return;
+		L3Request request = mL3Backlog.front();
+		mL3Backlog.pop_front();
+		if (request.mFrame->primitive()==DATA) {
+			sendMultiframeData(*request.mFrame,request.mCallback,request.mContext);
+			delete request.mFrame;
+		} else {
+			mReleaseTaken = request.mSequence;
+			mPendingRelease = request;
 		}
-		if (mT200.expired()) T200Expiration();
 	}
-	mLock.unlock();
 }
-	
+
+
+void L2LAPDm::applyRelease(Primitive prim)
+{
+	// Caller holds mLock.
+	OBJLOG(DEBUG) << prim << " state=" << mState;
+	switch (prim) {
+		case RELEASE:
+			// GSM 04.06 5.4.4.2
+			// vISDN datalink.c:lapd_dl_release_request
+			if (mState==LinkReleased) {
+				mReleaseDone = mReleaseTaken;
+				mReleaseSignal.broadcast();
+				break;
+			}
+			clearCounters();
+			mEstablishmentInProgress=false;
+			mState=AwaitingRelease;
+			mT200.set(T200());	// HACK?
+			// Send DISC and wait for UA or T200.
+			sendUFrameDISC();
+			break;
+		case ERROR:
+			// Forced release.
+			abnormalRelease();
+			break;
+		case HARDRELEASE:
+			clearState(HARDRELEASE);
+			break;
+		default:
+			assert(0);
+	}
+}
+
+
+
+bool L2LAPDm::multiframeMode() const
+{
+	// Other SAPs go down with SAP0, even before their service threads notice.
+	if (mMaster && !mMaster->multiframeMode()) return false;
+	ScopedLock lock(mLock);
+	return mState==LinkEstablished;
+}
+
+
+unsigned L2LAPDm::K() const
+{
+	static ConfigKey<long> sK(gConfig,"GSM.LAPDm.WindowSize",1);
+	long k = sK.value();
+	if (k<1) return 1;
+	if (k>7) return 7;
+	return k;
+}
+
 
 
 
@@ -433,6 +647,9 @@ void L2LAPDm::T200Expiration()
 			break;
 		case ContentionResolution:
 		case LinkEstablished:
+			// Nothing outstanding, so nothing to retransmit.
+			if (mVA==mVS) break;
+			// fall through
 		case AwaitingEstablish:
 			if (mRC>N200()) abnormalRelease();
 			else retransmissionProcedure();
@@ -450,7 +667,7 @@ void L2LAPDm::T200Expiration()
 
 
 
-void L2LAPDm::receiveFrame(const GSM::L2Frame& frame)
+void L2LAPDm::receiveFrame(GSM::L2Frame& frame)
 {
 	OBJLOG(DEBUG) << frame;
 
@@ -491,7 +708,7 @@ void L2LAPDm::receiveFrame(const GSM::L2Frame& frame)
 }
 
 
-void L2LAPDm::receiveUFrame(const L2Frame& frame)
+void L2LAPDm::receiveUFrame(L2Frame& frame)
 {
 	// Also see vISDN datalink.c:lapd_socket_handle_uframe
 	OBJLOG(DEBUG) << frame;
@@ -536,7 +753,9 @@ void L2LAPDm::receiveUFrameSABM(const L2Frame& frame)
 				// GSM 04.06 5.4.1.4.
 				mState=ContentionResolution;
 				mContentionCheck = frame.sum();
-				mL3Out.write(new L3Frame(frame.L3Part(),DATA));
+				L3Frame *message = new L3Frame(frame.L3Part(),DATA);
+				message->receiveTime(frame.receiveTime());
+				mL3Out.write(message);
 				// Echo back payload.
 				sendUFrameUA(frame);
 			} else {
@@ -640,7 +859,6 @@ void L2LAPDm::receiveUFrameUA(const L2Frame& frame)
 			// We sent SABM and the peer responded.
 			clearCounters();
 			mState = LinkEstablished;
-			mAckSignal.signal();
 			mL3Out.write(new L3Frame(ESTABLISH));
 			break;
 		case AwaitingRelease:
@@ -678,12 +896,18 @@ void L2LAPDm::receiveUFrameDM(const L2Frame& frame)
 
 
 
-void L2LAPDm::receiveUFrameUI(const L2Frame& frame)
+void L2LAPDm::receiveUFrameUI(L2Frame& frame)
 {
 	// The zero-length frame is the idle frame.
 	if (frame.L()==0) return;
 	OBJLOG(INFO) << "state=" << mState << " " << frame;
-	mL3Out.write(new L3Frame(frame.tail(24),UNIT_DATA));
+	uint64_t receiveTime = frame.receiveTime();
+	// Take the frame's buffer and narrow it to the payload.
+	BitVector payload(std::move((BitVector&)frame));
+	payload.narrow(24,payload.size()-24);
+	L3Frame *message = new L3Frame(std::move(payload),UNIT_DATA);
+	message->receiveTime(receiveTime);
+	mL3Out.write(message);
 }
 
 
@@ -711,8 +935,7 @@ void L2LAPDm::receiveSFrameRR(const L2Frame& frame)
 	// GSM 04.06 3.8.5.
 	// Q.921 3.6.6.
 	// vISDN datalink.c:lapd_handle_sframe_rr
-	// Again, since LAPDm allows only one outstanding frame
-	// (k=1), this is a lot simpler than in LAPD.
+	// processAck handles any number of outstanding frames.
 	switch (mState) {
 		case ContentionResolution:
 			mState = LinkEstablished;
@@ -743,8 +966,6 @@ void L2LAPDm::receiveSFrameREJ(const L2Frame& frame)
 			mState = LinkEstablished;
 			// continue to next case...
 		case LinkEstablished:
-			// FIXME -- The spec says to do this but it breaks multiframe transmission.
-			//mVS = mVA = frame.NR();
 			processAck(frame.NR());
 			if (frame.PF()) {
 				if (frame.CR()!=mC) sendSFrameRR(true);
@@ -753,9 +974,9 @@ void L2LAPDm::receiveSFrameREJ(const L2Frame& frame)
 					return;
 				}
 			}
-			// Since k=1, there's really nothing to retransmit,
-			// other than what was just rejected, so kust stop sending it.
-			sendIdle();
+			// Go back to N(R), which processAck just made V(A), and resend from there.
+			// The frames are kept in mSentIFrames, so V(S) need not be rewound.
+			if (mVA!=mVS) resendIFrames();
 			break;
 		default:
 			// ignore
@@ -767,7 +988,7 @@ void L2LAPDm::receiveSFrameREJ(const L2Frame& frame)
 
 
 
-void L2LAPDm::receiveIFrame(const L2Frame& frame)
+void L2LAPDm::receiveIFrame(L2Frame& frame)
 {
 	// Caller should hold mLock.
 	// See GSM 04.06 5.4.1.4.
@@ -784,12 +1005,20 @@ void L2LAPDm::receiveIFrame(const L2Frame& frame)
 			processAck(frame.NR());
 			if (frame.NS()==mVR) {
 				mVR = (mVR+1)%8;
+				mRejectSent = false;
+				// bufferIFrameData may take the frame's buffer.
+				bool PF = frame.PF();
 				bufferIFrameData(frame);
-				sendSFrameRR(frame.PF());
-			} else {
+				sendSFrameRR(PF);
+			} else if (!mRejectSent) {
 				// GSM 04.06 5.7.1.
 				// Q.921 5.8.1.
+				// The peer goes back to V(R) on the first REJ,
+				// so the rest of its window is discarded without another.
+				mRejectSent = true;
 				sendSFrameREJ(frame.PF());
+			} else if (frame.PF()) {
+				sendSFrameRR(true);
 			}
 		case LinkReleased:
 			// GSM 04.06 5.4.5
@@ -914,7 +1143,7 @@ void L2LAPDm::sendUFrameUI(const L3Frame& l3)
 
 
 
-void L2LAPDm::sendMultiframeData(const L3Frame& l3)
+void L2LAPDm::sendMultiframeData(const L3Frame& l3, L2Completion callback, void* context)
 {
 	// See GSM 04.06 5.8.5
 	assert(l3.length()<=251);
@@ -922,53 +1151,58 @@ void L2LAPDm::sendMultiframeData(const L3Frame& l3)
 	// Implements GSM 04.06 5.4.2
 	// Caller holds mLock.
 	OBJLOG(INFO) << "state=" << mState << " payload=" << l3;
-	// HACK -- Sleep before returning to prevent fast spinning
-	// in SACCH L3 during release.
 	if (mState==LinkReleased) {
 		OBJLOG(ERR) << "attempt to send DATA on released LAPm channel";
 		abnormalRelease();
-		sleepFrames(51);
+		complete(callback,context,false);
 		return;
 	}
-	mDiscardIQueue = false;
+	// Segment the frame; sendIFrames sends the segments as the window opens.
 	size_t bitsRemaining = l3.size();
 	size_t sendIndex = 0;
 	OBJLOG(DEBUG) << "sendIndex=" << sendIndex<< " bitsRemaining=" << bitsRemaining;
+	if (bitsRemaining==0) complete(callback,context,true);
 	while (bitsRemaining>0) {
 		size_t thisChunkSize = bitsRemaining;
 		bool MBit = false;
-		if (thisChunkSize==0) break;
 		if (thisChunkSize>mMaxIPayloadBits) {
 			thisChunkSize = mMaxIPayloadBits;
 			MBit = true;
 		}
-		// This is the point where we block and allow
-		// the upstream thread to modify the LAPDm state.
-		waitForAck();
-		// Did we abort multiframe mode while waiting?
-		if (mDiscardIQueue) {
-			OBJLOG(DEBUG) <<"aborting (discard)";
-			break;
-		}
-		if ((mState!=LinkEstablished) && (mState!=ContentionResolution)) {
-			OBJLOG(DEBUG) << "aborting, state=" << mState;
-			break;
-		}
 		OBJLOG(DEBUG) << "state=" << mState
 				<< " sendIndex=" << sendIndex << " thisChunkSize=" << thisChunkSize
 				<< " bitsRemaining=" << bitsRemaining << " MBit=" << MBit;
-		sendIFrame(l3.segment(sendIndex,thisChunkSize),MBit);
+		mIQueue.push_back(IFrameSegment());
+		IFrameSegment& segment = mIQueue.back();
+		segment.mPayload = BitVector(l3.segment(sendIndex,thisChunkSize));
+		segment.mM = MBit;
+		segment.mCallback = MBit ? NULL : callback;
+		segment.mContext = context;
 		sendIndex += thisChunkSize;
 		bitsRemaining -= thisChunkSize;
 	}
 }
 
 
+void L2LAPDm::sendIFrames()
+{
+	// Caller holds mLock.
+	if ((mState!=LinkEstablished) && (mState!=ContentionResolution)) return;
+	unsigned k = K();
+	while (mIQueue.size()>0 && ((mVS+8-mVA)%8)<k) {
+		sendIFrame(mIQueue.front());
+		mIQueue.pop_front();
+	}
+}
+
+
 
-void L2LAPDm::sendIFrame(const BitVector& payload, bool MBit)
+void L2LAPDm::sendIFrame(const IFrameSegment& segment)
 {
 	// Caller should hold mLock.
 	// GSM 04.06 5.5.1
+	const BitVector& payload = segment.mPayload;
+	bool MBit = segment.mM;
 	OBJLOG(INFO) << "M=" << MBit << " VS=" << mVS  << " payload=" << payload;
 	// Lots of sanity checking.
 	assert(mState!=LinkReleased);
@@ -980,8 +1214,14 @@ void L2LAPDm::sendIFrame(const BitVector& payload, bool MBit)
 	L2Control control(mVR,mVS,0);
 	L2Length length(payload.size()/8,MBit);
 	L2Header header(address,control,length);
+	// Keep it for retransmission until it is acknowledged.
+	SentIFrame& sent = mSentIFrames[mVS];
+	sent.mFrame = L2Frame(header,payload);
+	sent.mCallback = segment.mCallback;
+	sent.mContext = segment.mContext;
 	mVS = (mVS+1)%8;
-	writeL1Ack(L2Frame(header,payload));
+	writeL1(sent.mFrame);
+	if (!mT200.active()) mT200.set(T200());
 }
 
 
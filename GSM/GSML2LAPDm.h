@@ -34,6 +34,7 @@ implementation, although no code is copied directly.
 
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include <deque>
 
 
 namespace GSM {
@@ -53,6 +54,14 @@ class L2WriteError : public GSMError { };
 //@}
 
 
+/**
+	Completion of an L3 DATA frame queued with L2DL::writeData.
+	@param context The context given with the frame.
+	@param delivered True if the peer acknowledged the whole frame, false if it was discarded.
+*/
+typedef void (*L2Completion)(void* context, bool delivered);
+
+
 
 /**
 	Skeleton for data link layer (L2) entities.
@@ -96,20 +105,40 @@ class L2DL {
 
 	/**
 		The L3->L2 interface.
-		This is a blocking call and does not return until
-		all of the corresponding radio bursts have been
-		enqueued for transmission.
-		That can take up to 1/2 second.
+		In LAPDm, DATA is queued and this returns at once;
+		the release primitives block until the link is released.
 	*/
 	virtual void writeHighSide(const GSM::L3Frame&) = 0;
 
+	/**
+		The L3->L2 interface for DATA, with notice of delivery.
+		The callback, if not NULL, runs on the L2's thread and must not call back into the L2.
+		The default sends the frame with writeHighSide and reports it delivered.
+	*/
+	virtual void writeData(const GSM::L3Frame& frame, L2Completion callback, void* context)
+	{
+		writeHighSide(frame);
+		if (callback) callback(context,true);
+	}
+
 
 	/** The L1->L2 interface */
 	virtual void writeLowSide(const GSM::L2Frame&) = 0;
 
+	/** The L1->L2 interface for a frame L1 no longer needs; an L2 may take its buffer. */
+	virtual void writeLowSide(GSM::L2Frame&& frame) { writeLowSide((const GSM::L2Frame&)frame); }
+
 	/** The L2->L3 interface. */
 	virtual L3Frame* readHighSide(unsigned timeout=3600000) = 0;
 
+	/**@name Queue depths, for metrics. */
+	//@{
+	/** L3 frames waiting for readHighSide. */
+	virtual unsigned uplinkBacklog() const { return 0; }
+	/** L3 requests and I-frame segments not yet sent on the link. */
+	virtual unsigned downlinkBacklog() const { return 0; }
+	//@}
+
 };
 
 
@@ -151,7 +180,8 @@ class CCCHL2 : public L2DL {
 
 	LAPDm is best be thought of as lightweight HDLC.
     The main differences between LAPDm and HDLC are: 
-		- LAPDm allows no more than one outstanding unacknowledged I-frame (k=1, GSM 04.06 5.8.4).
+		- LAPDm allows no more than one outstanding unacknowledged I-frame (k=1, GSM 04.06 5.8.4),
+			although we support a larger window for peers that accept one.
 		- LAPDm does not support extended header formats (GSM 04.06 3).
 		- LAPDm supports only the SABM, DISC, DM, UI and UA U-Frames (GSM 04.06 3.4, 3.8.1).
 		- LAPDm supports the RR and REJ S-Frames (GSM 04.06 3.4, 3.8.1), but not RNR (GSM 04.06 3.8.7, see Note).
@@ -166,6 +196,11 @@ class CCCHL2 : public L2DL {
 		- using the Bbis format for L3 messages that use the L2 pseudolength element
 		- just using independent L2s for each active SAP
 		- just using independent L2s on each dedicated channel, which works with k=1
+
+	L3 DATA is queued and sent from the service thread as the window opens,
+	so the L3 caller does not wait for acknowledgements.
+	The service thread sleeps until an uplink frame, an L3 request or a T200 expiration arrives;
+	T200 runs on the shared TimerWheel.
 */
 class L2LAPDm : public L2DL {
 
@@ -186,10 +221,43 @@ class L2LAPDm : public L2DL {
 
 	protected:
 
-	Thread mUpstreamThread;		///< a thread for upstream traffic and T200 timeouts
+	/** An L3 request waiting for the service thread. */
+	struct L3Request {
+		L3Frame* mFrame;
+		L2Completion mCallback;		///< for DATA
+		void* mContext;
+		unsigned mSequence;			///< for the release primitives, see mReleaseDone
+	};
+
+	/** One I-frame's worth of an L3 frame. */
+	struct IFrameSegment {
+		BitVector mPayload;
+		bool mM;					///< the "M" (more) bit
+		L2Completion mCallback;		///< set on the last segment of the L3 frame
+		void* mContext;
+	};
+
+	/** An I-frame sent and not yet acknowledged. */
+	struct SentIFrame {
+		L2Frame mFrame;
+		L2Completion mCallback;
+		void* mContext;
+	};
+
+	Thread mUpstreamThread;		///< a thread for upstream traffic, downstream I-frames and T200 timeouts
 	bool mRunning;				///< true once the service loop starts
 	L3FrameFIFO mL3Out;			///< we connect L2->L3 through a FIFO
-	L2FrameFIFO mL1In;			///< we connect L1->L2 through a FIFO
+
+	/**@name Events for the service thread, protected by mEventLock. */
+	//@{
+	mutable Mutex mEventLock;
+	Signal mEventSignal;
+	std::deque<L2Frame*> mL1In;		///< uplink frames from L1
+	std::deque<L3Request> mL3In;	///< DATA and release requests from L3, in order
+	bool mT200Event;				///< T200 fired
+	unsigned mReleasePosted;		///< sequence of the last release request
+	unsigned mGeneration;			///< bumped by open(), to drop events of the previous transaction
+	//@}
 
 	unsigned mC;			///< the "C" bit for commands, 1 for BTS, 0 for MS
 	unsigned mR;			///< this "R" bit for commands, 0 for BTS, 1 for MS
@@ -209,14 +277,20 @@ class L2LAPDm : public L2DL {
 	unsigned mVA;			///< GSM 3.5.2.3, Q.921 3.5.2.3, ack counter, NR+1 of last acked I-frame
 	unsigned mVR;			///< GSM 3.5.2.5, Q.921 3.5.2.5, recv counter, NR+1 of last recvd I-frame
 	LAPDState mState;		///< current protocol state
-	Signal mAckSignal;		///< signal used to wake a thread waiting for an ack
+	Signal mReleaseSignal;	///< broadcast when mReleaseDone advances
 	//@}
 	bool mEstablishmentInProgress;	///< flag described in GSM 04.06 5.4.1.4
+	bool mRejectSent;		///< REJ exception condition, Q.921 5.8.1; one REJ per sequence error
 	/**@name Segmentation and retransmission. */
 	//@{
 	BitVector mRecvBuffer;	///< buffer to concatenate received I-frames, same role as sk_rcvbuf in vISDN
-	L2Frame mSentFrame;		///< previous ack-able kept for retransmission, same role as sk_write_queue in vISDN
-	bool mDiscardIQueue;		///< a flag used to abort I-frame sending
+	L2Frame mSentFrame;		///< previous ack-able U-frame kept for retransmission
+	SentIFrame mSentIFrames[8];	///< unacknowledged I-frames by N(S), same role as sk_write_queue in vISDN
+	std::deque<IFrameSegment> mIQueue;	///< I-frames waiting for the window
+	std::deque<L3Request> mL3Backlog;	///< L3 requests taken from mL3In, held behind a release
+	L3Request mPendingRelease;	///< release request waiting for mIQueue to drain; mFrame is NULL if none
+	unsigned mReleaseTaken;		///< sequence of the last release request taken from mL3In
+	unsigned mReleaseDone;		///< sequence of the last release request completed
 	unsigned mContentionCheck;	///< checksum used for contention resolution, GSM 04.06 5.4.1.4.
 	unsigned mRC;				///< retransmission counter, GSM 04.06 5.4.1-5.4.4
 	Z100Timer mT200;			///< retransmission timer, GSM 04.06 5.8.1
@@ -253,6 +327,9 @@ class L2LAPDm : public L2DL {
 	/** Process an uplink L2 frame. */
 	void writeLowSide(const GSM::L2Frame&);
 
+	/** Process an uplink L2 frame, queueing its buffer without a copy. */
+	void writeLowSide(GSM::L2Frame&&);
+
 	/**
 		Read the L3 output, with a timeout.
 		Caller is responsible for deleting returned object.
@@ -260,15 +337,21 @@ class L2LAPDm : public L2DL {
 	L3Frame* readHighSide(unsigned timeout=3600000)
 		{ return mL3Out.read(timeout); }
 
+	unsigned uplinkBacklog() const { return mL3Out.size(); }
+
+	unsigned downlinkBacklog() const;
+
 	/**
 		Process a downlink L3 frame.
-		This is a blocking call and does not return until
-		all of the corresponding radio bursts have been
-		enqueued for transmission.
-		That can take up to 1/2 second.
+		DATA is queued for the service thread.
+		RELEASE, ERROR and HARDRELEASE are applied after any queued DATA
+		has been sent, and block until the link is released.
 	*/
 	void writeHighSide(const GSM::L3Frame&);
 
+	/** Queue a DATA frame, with a callback for its acknowledgement. */
+	void writeData(const GSM::L3Frame& frame, L2Completion callback, void* context);
+
 
 	/** Prepare the channel for a new transaction. */
 	virtual void open();
@@ -278,14 +361,35 @@ class L2LAPDm : public L2DL {
 		{ assert(!mMaster); mMaster=wMaster; }
 
 	/** Return true if in multiframe mode. */
-	bool multiframeMode() const
-		{ ScopedLock lock(mLock); return mState==LinkEstablished; }
+	bool multiframeMode() const;
+
+	/** k, the maximum number of unacknowledged I-frames, GSM 04.06 5.8.4. */
+	virtual unsigned K() const;
 
 
 	protected:
 
-	/** Block until we receive any pending ack. */
-	void waitForAck();
+	/** Pass an L3 request to the service thread; return its sequence if it is a release. */
+	unsigned postL3(L3Frame* frame, L2Completion callback, void* context);
+
+	/** Run a callback for a DATA frame; caller holds mLock. */
+	static void complete(L2Completion callback, void* context, bool delivered)
+		{ if (callback) callback(context,delivered); }
+
+	/** Timer wheel callback for T200. */
+	static void T200Fired(void* context);
+
+	/** Segment queued L3 DATA, send I-frames as the window allows and apply a pending release; caller holds mLock. */
+	void serviceL3();
+
+	/** Send I-frames from mIQueue while the window is open; caller holds mLock. */
+	void sendIFrames();
+
+	/** Apply a release primitive from L3; caller holds mLock. */
+	void applyRelease(Primitive);
+
+	/** Discard queued uplink frames and L3 requests, completing them as undelivered; caller holds mLock. */
+	void flushEvents();
 
 	/** Send an L2Frame on the L2->L1 interface. */
 	void writeL1(const L2Frame&);
@@ -317,29 +421,35 @@ class L2LAPDm : public L2DL {
 	/** Retransmit last ackable frame. */
 	void retransmissionProcedure();
 
-	/** Clear any outgoing L3 frame. */
-	void discardIQueue() { mDiscardIQueue=true; }
+	/** Resend the I-frames from V(A) up to V(S), with the current N(R), and restart T200. */
+	void resendIFrames();
+
+	/** Clear any outgoing L3 frames, queued or unacknowledged. */
+	void discardIQueue();
 
 	/**
 		Accept and concatenate an I-frame data payload.
 		GSM 04.06 5.5.2 (first 2 bullet points)
 	*/
-	void bufferIFrameData(const L2Frame&);
+	void bufferIFrameData(L2Frame&);
 
-	/**@name Receive-handlers for the various frame types. */
+	/**
+		@name Receive-handlers for the various frame types.
+		Handlers that pass a payload up to L3 may take the frame's buffer.
+	*/
 	//@{
-	void receiveFrame(const L2Frame&);			///< Top-level frame handler.
+	void receiveFrame(L2Frame&);				///< Top-level frame handler.
 	/* 
 		We will postpone support for suspension/resumption of multiframe mode (GSM 04.06 5.4.3).
 		This will greatly simplify the L2 state machine.
 	*/
-	void receiveIFrame(const L2Frame&);			///< GSM 04.06 3.8.1, 5.5.2
+	void receiveIFrame(L2Frame&);				///< GSM 04.06 3.8.1, 5.5.2
 	/**@name U-Frame handlers */
 	//@{
-	void receiveUFrame(const L2Frame&);			///< sub-dispatch for all U-Frames
+	void receiveUFrame(L2Frame&);				///< sub-dispatch for all U-Frames
 	void receiveUFrameSABM(const L2Frame&);		///< GMS 04.06 3.8.2, 5.4.1
 	void receiveUFrameDISC(const L2Frame&);		///< GSM 04.06 3.8.3, 5.4.4.2
-	void receiveUFrameUI(const L2Frame&);		///< GSM 04.06 3.8.4, 5.2.1
+	void receiveUFrameUI(L2Frame&);			///< GSM 04.06 3.8.4, 5.2.1
 	void receiveUFrameUA(const L2Frame&);		///< GSM 04.06 3.8.8
 	void receiveUFrameDM(const L2Frame&);		///< GSM 04.06 3.8.9, 5.4.4.2
 	//@}
@@ -362,8 +472,8 @@ class L2LAPDm : public L2DL {
 		lapd_send_uframe with arguments that specify the DISC frame.
 		In OpenBTS, you just call sendUFrameDISC.
 	*/
-	void sendMultiframeData(const L3Frame&);	///< send an L3 frame in one or more I-frames
-	void sendIFrame(const BitVector&, bool);	///< GSM 04.06 3.8.1, 5.5.1, with payload and "M" flag
+	void sendMultiframeData(const L3Frame&, L2Completion, void*);	///< queue an L3 frame as one or more I-frames
+	void sendIFrame(const IFrameSegment&);		///< GSM 04.06 3.8.1, 5.5.1
 	void sendUFrameSABM();						///< GMS 04.06 3.8.2, 5.4.1
 	void sendUFrameDISC();						///< GSM 04.06 3.8.3, 5.4.4.2
 	void sendUFrameUI(const L3Frame&);			///< GSM 04.06 3.8.4, 5.2.1
@@ -402,7 +512,7 @@ class L2LAPDm : public L2DL {
 	bool stuckChannel(const L2Frame&);
 
 	/**
-		The upstream service loop handles incoming L2 frames and T200 timeouts.
+		The service loop handles incoming L2 frames, L3 requests and T200 timeouts.
 	*/
 	void serviceLoop();
 
@@ -475,6 +585,9 @@ class SACCHL2 : public L2LAPDm {
 	/** SACCH does not use idle frames. */
 	void sendIdle() {};
 
+	/** One block per multiframe goes out anyway, so a window gains nothing. */
+	unsigned K() const { return 1; }
+
 	public:
 
 	/**
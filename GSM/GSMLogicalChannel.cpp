@@ -39,12 +39,17 @@
 #include <ControlCommon.h>
 
 #include <Logger.h>
+#include <Metrics.h>
 #undef WARNING
 
 using namespace std;
 using namespace GSM;
 
 
+static MetricHistogram gL1L3Latency("openbts_l1_l3_latency_microseconds",NULL,
+	"Time from decoding the last uplink block of an L3 message in L1 to its delivery to L3.");
+
+
 
 void LogicalChannel::open()
 {
@@ -83,6 +88,52 @@ void LogicalChannel::downstream(ARFCNManager* radio)
 }
 
 
+void LogicalChannel::detach(ARFCNManager* radio)
+{
+	assert(mL1);
+	mL1->detach(radio);
+	if (mSACCH) mSACCH->detach(radio);
+}
+
+
+void LogicalChannel::reattach(ARFCNManager* radio)
+{
+	assert(mL1);
+	mL1->reattach(radio);
+	if (mSACCH) mSACCH->reattach(radio);
+}
+
+
+
+unsigned LogicalChannel::uplinkBacklog() const
+{
+	unsigned count = mSACCH ? mSACCH->uplinkBacklog() : 0;
+	for (int s=0; s<4; s++) {
+		if (mL2[s]) count += mL2[s]->uplinkBacklog();
+	}
+	return count;
+}
+
+
+unsigned LogicalChannel::downlinkBacklog() const
+{
+	unsigned count = mSACCH ? mSACCH->downlinkBacklog() : 0;
+	for (int s=0; s<4; s++) {
+		if (mL2[s]) count += mL2[s]->downlinkBacklog();
+	}
+	return count;
+}
+
+
+
+L3Frame* LogicalChannel::recv(unsigned timeout_ms, unsigned SAPI)
+{
+	assert(mL2[SAPI]);
+	L3Frame *frame = mL2[SAPI]->readHighSide(timeout_ms);
+	if (frame && frame->receiveTime()) gL1L3Latency.record(metricsClock()-frame->receiveTime());
+	return frame;
+}
+
 
 // Serialize and send an L3Message with a given primitive.
 void LogicalChannel::send(const L3Message& msg,
@@ -110,38 +161,32 @@ void CCCHLogicalChannel::open()
 	LogicalChannel::open();
 	if (!mRunning) {
 		mRunning=true;
-		mServiceThread.start((void*(*)(void*))CCCHLogicalChannelServiceLoopAdapter,this);
+		gBTS.executor().add(this,gBTS.time());
 	}
 }
 
 
-void CCCHLogicalChannel::serviceLoop() 
+bool CCCHLogicalChannel::step(Time& next)
 {
 	// build the idle frame
 	static const L3PagingRequestType1 filler;
 	static const L3Frame idleFrame(filler,UNIT_DATA);
-	// prime the first idle frame
-	LogicalChannel::send(idleFrame);
-	// run the loop
-	while (true) {
-		L3Frame* frame = mQ.readNoBlock();
-		if (frame) {
-			LogicalChannel::send(*frame);
-			OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending " << *frame;
-			delete frame;
-		}
-		else {
-			LogicalChannel::send(idleFrame);
-			OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending idle frame";
-		}
+	// Wait for the previous block to go out, rather than blocking in the encoder.
+	L1Encoder* encoder = mL1->encoder();
+	if (!encoder->readyToSend(next)) return true;
+	L3Frame* frame = mQ.readNoBlock();
+	if (frame) {
+		LogicalChannel::send(*frame);
+		OBJLOG(DEBUG) << "CCCHLogicalChannel::step sending " << *frame;
+		delete frame;
 	}
-}
-
-
-void *GSM::CCCHLogicalChannelServiceLoopAdapter(CCCHLogicalChannel* chan)
-{
-	chan->serviceLoop();
-	return NULL;
+	else {
+		LogicalChannel::send(idleFrame);
+		OBJLOG(DEBUG) << "CCCHLogicalChannel::step sending idle frame";
+	}
+	// Come back when the clock reaches this block.
+	if (encoder->readyToSend(next)) next = gBTS.time();
+	return true;
 }
 
 
@@ -189,7 +234,8 @@ SACCHLogicalChannel::SACCHLogicalChannel(
 		unsigned wCN,
 		unsigned wTN,
 		const MappingPair& wMapping)
-		: mRunning(false)
+		: mRunning(false),mSICount(0),
+		mPendingSMS(NULL),mPendingTransaction(NULL),mSMSThread(NULL)
 {
 	mSACCHL1 = new SACCHL1FEC(wCN,wTN,wMapping);
 	mL1 = mSACCHL1;
@@ -207,7 +253,7 @@ void SACCHLogicalChannel::open()
 	LogicalChannel::open();
 	if (!mRunning) {
 		mRunning=true;
-		mServiceThread.start((void*(*)(void*))SACCHLogicalChannelServiceLoopAdapter,this);
+		gBTS.executor().add(this,gBTS.time());
 	}
 }
 
@@ -232,124 +278,160 @@ L3Message* processSACCHMessage(L3Frame *l3frame)
 }
 
 
-void SACCHLogicalChannel::serviceLoop()
+bool SACCHLogicalChannel::step(Time& next)
 {
-	// run the loop
-	unsigned count = 0;
-	while (true) {
+	// Throttle back if not active.
+	if (!active()) {
+		OBJLOG(DEBUG) << "SACCH sleeping";
+		next = gBTS.time() + 51;
+		return true;
+	}
 
-		// Throttle back if not active.
-		if (!active()) {
-			OBJLOG(DEBUG) << "SACCH sleeping";
-			sleepFrames(51);
-			continue;
-		}
+	// Wait for the previous SI5/6 to go out, rather than blocking in the encoder.
+	L1Encoder* encoder = mL1->encoder();
+	if (!encoder->readyToSend(next)) return true;
 
-		// TODO SMS -- Check to see if the tx queues are empty.  If so, send SI5/6,
-		// otherwise sleep and continue;
-
-		// Send alternating SI5/SI6.
-		OBJLOG(DEBUG) << "sending SI5/6 on SACCH";
-		if (count%2) LogicalChannel::send(gBTS.SI5Frame());
-		else LogicalChannel::send(gBTS.SI6Frame());
-		count++;
-
-		// Receive inbound messages.
-		// This read loop flushes stray reports quickly.
-		while (true) {
-
-			OBJLOG(DEBUG) << "polling SACCH for inbound messages";
-			bool nothing = true;
-
-			// Process SAP0 -- RR Measurement reports
-			L3Frame *rrFrame = LogicalChannel::recv(0,0);
-			if (rrFrame) nothing=false;
-			L3Message* rrMessage = processSACCHMessage(rrFrame);
-			delete rrFrame;
-			if (rrMessage) {
-				L3MeasurementReport* measurement = dynamic_cast<L3MeasurementReport*>(rrMessage);
-				if (measurement) {
-					mMeasurementResults = measurement->results();
-					
-					// ATTENTION: 1 means "invalid"
-					// FIXME: it might be useful to change decoding
-					if(mMeasurementResults.MEAS_VALID()){
-						LOG(ERR) << "invalid measurement report" << mMeasurementResults;
-						delete rrMessage;
-						continue;
-					}
-					OBJLOG(DEBUG) << "SACCH measurement report " << mMeasurementResults;
-					// Add the measurement results to the table
-					// Note that the typeAndOffset of a SACCH match the host channel.
+	// TODO SMS -- Check to see if the tx queues are empty.  If so, send SI5/6,
+	// otherwise sleep and continue;
+
+	// Send alternating SI5/SI6.
+	OBJLOG(DEBUG) << "sending SI5/6 on SACCH";
+	if (mSICount%2) LogicalChannel::send(gBTS.SI5Frame());
+	else LogicalChannel::send(gBTS.SI6Frame());
+	mSICount++;
+
+	// Receive inbound messages.
+	// This read loop flushes stray reports quickly.
+	while (true) {
+
+		OBJLOG(DEBUG) << "polling SACCH for inbound messages";
+		bool nothing = true;
+
+		// Process SAP0 -- RR Measurement reports
+		L3Frame *rrFrame = LogicalChannel::recv(0,0);
+		if (rrFrame) nothing=false;
+		L3Message* rrMessage = processSACCHMessage(rrFrame);
+		delete rrFrame;
+		if (rrMessage) {
+			L3MeasurementReport* measurement = dynamic_cast<L3MeasurementReport*>(rrMessage);
+			if (measurement) {
+				mMeasurementResults = measurement->results();
+				
+				// ATTENTION: 1 means "invalid"
+				// FIXME: it might be useful to change decoding
+				if(mMeasurementResults.MEAS_VALID()){
+					LOG(ERR) << "invalid measurement report" << mMeasurementResults;
+					delete rrMessage;
+					continue;
+				}
+				OBJLOG(DEBUG) << "SACCH measurement report " << mMeasurementResults;
+				// Add the measurement results to the table
+				// Note that the typeAndOffset of a SACCH match the host channel.
+				
+				if(this){
+					const GSM::LogicalChannel * chan = this;
 					
-					if(this){
-						const GSM::LogicalChannel * chan = this;
-						
-//						OBJLOG(ERR) << "SACCH measurement report: looking 4 transaction ";
-						Control::TransactionEntry *transaction = gTransactionTable.find(chan);
-//						OBJLOG(ERR) << "SACCH measurement report: transaction found";
-						if(transaction) {
-							gBTS.handover().BTSDecision(transaction, mMeasurementResults);							
-						}
+//					OBJLOG(ERR) << "SACCH measurement report: looking 4 transaction ";
+					Control::TransactionEntry *transaction = gTransactionTable.find(chan);
+//					OBJLOG(ERR) << "SACCH measurement report: transaction found";
+					if(transaction) {
+						gBTS.handover().BTSDecision(transaction, mMeasurementResults);							
 					}
-					gPhysStatus.setPhysical(this, mMeasurementResults);
-				} else {
-					OBJLOG(NOTICE) << "SACCH SAP0 sent unaticipated message " << rrMessage;
 				}
-				delete rrMessage;
+				gPhysStatus.setPhysical(this, mMeasurementResults);
+			} else {
+				OBJLOG(NOTICE) << "SACCH SAP0 sent unaticipated message " << rrMessage;
 			}
+			delete rrMessage;
+		}
 
-			// Process SAP3 -- SMS
-			L3Frame *smsFrame = LogicalChannel::recv(0,3);
-			if (smsFrame) nothing=false;
-			L3Message* smsMessage = processSACCHMessage(smsFrame);
-			delete smsFrame;
-			if (smsMessage) {
-				const SMS::CPData* cpData = dynamic_cast<const SMS::CPData*>(smsMessage);
-				if (cpData) {
-					OBJLOG(INFO) << "SMS CPDU " << *cpData;
-					Control::TransactionEntry *transaction = gTransactionTable.find(this);
-					try {
-						if (transaction) {
-							Control::InCallMOSMSController(cpData,transaction,this);
-						} else {
-							OBJLOG(WARNING) << "in-call MOSMS CP-DATA with no corresponding transaction";
-						}
-					} catch (Control::ControlLayerException e) {
-						//LogicalChannel::send(RELEASE,3);
-						gTransactionTable.remove(e.transactionID());
-					}
-				} else {
-					OBJLOG(NOTICE) << "SACCH SAP3 sent unaticipated message " << rrMessage;
-				}
-				delete smsMessage;
+		// Process SAP3 -- SMS
+		L3Frame *smsFrame = LogicalChannel::recv(0,3);
+		if (smsFrame) nothing=false;
+		L3Message* smsMessage = processSACCHMessage(smsFrame);
+		delete smsFrame;
+		if (smsMessage) {
+			const SMS::CPData* cpData = dynamic_cast<const SMS::CPData*>(smsMessage);
+			if (cpData) {
+				OBJLOG(INFO) << "SMS CPDU " << *cpData;
+				// The controller blocks, so it gets its own thread.
+				mPendingSMS = smsMessage;
+				startSMS();
+				return false;
+			} else {
+				OBJLOG(NOTICE) << "SACCH SAP3 sent unaticipated message " << rrMessage;
 			}
+			delete smsMessage;
+		}
+
+		// Anything from the SIP side?
+		// MTSMS (delivery from SIP to the MS)
+		Control::TransactionEntry *sipTransaction = mTransactionFIFO.readNoBlock();
+		if (sipTransaction) {
+			OBJLOG(INFO) << "SIP-side transaction: " << sipTransaction;
+			assert(sipTransaction->service() == L3CMServiceType::MobileTerminatedShortMessage);
+			mPendingTransaction = sipTransaction;
+			startSMS();
+			return false;
+		}
+
+		// Nothing happened?
+		if (nothing) break;
+	}
+
+	// Come back when the clock reaches this SI5/6.
+	if (encoder->readyToSend(next)) next = gBTS.time();
+	return true;
+}
 
-			// Anything from the SIP side?
-			// MTSMS (delivery from SIP to the MS)
-			Control::TransactionEntry *sipTransaction = mTransactionFIFO.readNoBlock();
-			if (sipTransaction) {
-				OBJLOG(INFO) << "SIP-side transaction: " << sipTransaction;
-				assert(sipTransaction->service() == L3CMServiceType::MobileTerminatedShortMessage);
-				try {
-					Control::MTSMSController(sipTransaction,this);
-				} catch (Control::ControlLayerException e) {
-					//LogicalChannel::send(RELEASE,3);
-					gTransactionTable.remove(e.transactionID());
-				}
-			}
 
-			// Nothing happened?
-			if (nothing) break;
+void SACCHLogicalChannel::startSMS()
+{
+	// The task is suspended until serviceSMS posts it again,
+	// so the previous helper was detached here and its Thread can go.
+	delete mSMSThread;
+	mSMSThread = new Thread;
+	mSMSThread->start((void*(*)(void*))SACCHLogicalChannelSMSAdapter,this);
+	mSMSThread->detach();
+}
+
+
+void SACCHLogicalChannel::serviceSMS()
+{
+	if (mPendingSMS) {
+		const SMS::CPData* cpData = dynamic_cast<const SMS::CPData*>(mPendingSMS);
+		Control::TransactionEntry *transaction = gTransactionTable.find(this);
+		try {
+			if (transaction) {
+				Control::InCallMOSMSController(cpData,transaction,this);
+			} else {
+				OBJLOG(WARNING) << "in-call MOSMS CP-DATA with no corresponding transaction";
+			}
+		} catch (Control::ControlLayerException e) {
+			//LogicalChannel::send(RELEASE,3);
+			gTransactionTable.remove(e.transactionID());
 		}
+		delete mPendingSMS;
+		mPendingSMS = NULL;
+	}
 
+	if (mPendingTransaction) {
+		try {
+			Control::MTSMSController(mPendingTransaction,this);
+		} catch (Control::ControlLayerException e) {
+			//LogicalChannel::send(RELEASE,3);
+			gTransactionTable.remove(e.transactionID());
+		}
+		mPendingTransaction = NULL;
 	}
+
+	gBTS.executor().post(this);
 }
 
 
-void *GSM::SACCHLogicalChannelServiceLoopAdapter(SACCHLogicalChannel* chan)
+void *GSM::SACCHLogicalChannelSMSAdapter(SACCHLogicalChannel* chan)
 {
-	chan->serviceLoop();
+	chan->serviceSMS();
 	return NULL;
 }
 
@@ -40,6 +40,7 @@
 #include "GSMSAPMux.h"
 #include "GSML2LAPDm.h"
 #include "GSML3RRElements.h"
+#include "PhysicalHistory.h"
 #include "GSMTDMA.h"
 #include <TransactionTable.h>
 
@@ -83,6 +84,8 @@ protected:
 
 	SACCHLogicalChannel *mSACCH;	///< The associated SACCH, if any.
 
+	bool mInService;		///< false while the timeslot carries another combination; protected by the gBTS lock
+
 	/**
 		A FIFO of inbound transactions intiated in the SIP layers on an already-active channel.
 		Unlike most interthread FIFOs, do *NOT* delete the pointers that come out of it.
@@ -96,7 +99,7 @@ public:
 		Specific sub-class initializers allocate new components as needed.
 	*/
 	LogicalChannel()
-		:mL1(NULL),mSACCH(NULL)
+		:mL1(NULL),mSACCH(NULL),mInService(true)
 	{
 		for (int i=0; i<4; i++) mL2[i]=NULL;
 	}
@@ -135,12 +138,12 @@ public:
 		@param SAPI The service access point indicator from which to read.
 		@return A pointer to an L3Frame, to be deleted by the caller, or NULL on timeout.
 	*/
-	virtual L3Frame * recv(unsigned timeout_ms = 15000, unsigned SAPI=0)
-		{ assert(mL2[SAPI]); return mL2[SAPI]->readHighSide(timeout_ms); }
+	virtual L3Frame * recv(unsigned timeout_ms = 15000, unsigned SAPI=0);
 
 	/**
 		Send an L3Frame on downlink.
-		This method will block until the message is transferred to the transceiver.
+		On a DCCH, DATA is queued in L2 and this returns without waiting for the peer;
+		the release primitives block until the link is released.
 		@param frame The L3Frame to be sent.
 		@param SAPI The service access point indicator.
 	*/
@@ -151,6 +154,16 @@ public:
 		mL2[SAPI]->writeHighSide(frame);
 	}
 
+	/**
+		Send a DATA L3Frame on downlink, with notice of its delivery.
+		@param frame The L3Frame to be sent.
+		@param callback Run from L2 when the peer acknowledges the frame or L2 discards it.
+		@param context Passed to the callback.
+		@param SAPI The service access point indicator.
+	*/
+	void sendData(const L3Frame& frame, L2Completion callback, void* context, unsigned SAPI=0)
+		{ assert(mL2[SAPI]); mL2[SAPI]->writeData(frame,callback,context); }
+
 	/**
 		Send "naked" primitive down the channel.
 		@param prim The primitive to send.
@@ -205,6 +218,16 @@ public:
 	/** Return true if the channel is active. */
 	bool active() const { assert(mL1); return mL1->active(); }
 
+	/**@name Frames queued in this channel's L2, including its SACCH, for metrics. */
+	//@{
+	unsigned uplinkBacklog() const;
+	unsigned downlinkBacklog() const;
+	//@}
+
+	/** Return true if the channel can be allocated; see GSMConfig. */
+	bool inService() const { return mInService; }
+	void inService(bool val) { mInService = val; }
+
 	/** The TDMA parameters for the transmit side. */
 	const TDMAMapping& txMapping() const { assert(mL1); return mL1->txMapping(); }
 
@@ -251,6 +274,12 @@ public:
 	/** Connect an ARFCN manager to link L1FEC to the radio. */
 	void downstream(ARFCNManager* radio);
 
+	/**@name Take the channel's uplinks off and back onto its radio, for timeslot reconfiguration. */
+	//@{
+	void detach(ARFCNManager* radio);
+	void reattach(ARFCNManager* radio);
+	//@}
+
 	/** Return the channel type. */
 	virtual ChannelType type() const =0;
 
@@ -346,18 +375,27 @@ class NDCCHLogicalChannel : public LogicalChannel {
 	The main role of the SACCH, for now, will be to send SI5 and SI6 messages and
 	to accept uplink mesaurement reports.
 */
-class SACCHLogicalChannel : public LogicalChannel {
+class SACCHLogicalChannel : public LogicalChannel, public ChannelTask {
 
 	protected:
 
 	SACCHL1FEC *mSACCHL1;
-	Thread mServiceThread;	///< a thread for the service loop
-	bool mRunning;			///< true is the service loop is started
+	bool mRunning;			///< true is the service task is started
+	unsigned mSICount;		///< alternates SI5 and SI6
+
+	/**@name Blocking SMS work handed from the service task to a helper thread. */
+	//@{
+	L3Message* mPendingSMS;							///< in-call MO-SMS CP-DATA
+	Control::TransactionEntry* mPendingTransaction;	///< MT-SMS from the SIP side
+	Thread* mSMSThread;								///< the last helper thread, detached
+	//@}
 
 	/** MeasurementResults from the MS. They are caught in serviceLoop, accessed
 	 for recording along with GPS and other data in MobilityManagement.cpp */
 	L3MeasurementResults mMeasurementResults;
 
+	PhysicalHistory mPhysical;	///< recent reports, for readers on other threads
+
 	public:
 
 	SACCHLogicalChannel(
@@ -369,7 +407,7 @@ class SACCHLogicalChannel : public LogicalChannel {
 
 	void open();
 
-	friend void *SACCHLogicalChannelServiceLoopAdapter(SACCHLogicalChannel*);
+	friend void *SACCHLogicalChannelSMSAdapter(SACCHLogicalChannel*);
 
 	/**@name Pass-through accoessors to L1. */
 	//@{
@@ -386,18 +424,30 @@ class SACCHLogicalChannel : public LogicalChannel {
 	const L3MeasurementResults& measurementResults() const { return mMeasurementResults; }
 	//@}
 
+	/**@name Recent measurement reports with uplink figures; readable from any thread. */
+	//@{
+	const PhysicalHistory& physical() const { return mPhysical; }
+	PhysicalHistory& physical() { return mPhysical; }
+	//@}
+
 	protected:
 
 	/** Read and process a measurement report, called from the service loop. */
 	void getReport();
 
-	/** This is a loop in its own thread that sends SI5 and SI6. */
-	void serviceLoop();
+	/** The executor step that sends SI5 and SI6 and reads the uplink. */
+	bool step(Time& next);
+
+	/** Run the pending SMS controller, which blocks, then resume the service task. */
+	void serviceSMS();
+
+	/** Hand the pending SMS work to a helper thread. */
+	void startSMS();
 
 };
 
-/** A C interface for the SACCHLogicalChannel embedded loop. */
-void *SACCHLogicalChannelServiceLoopAdapter(SACCHLogicalChannel*);
+/** A C interface for the SACCHLogicalChannel SMS helper thread. */
+void *SACCHLogicalChannelSMSAdapter(SACCHLogicalChannel*);
 
 
 
@@ -411,19 +461,18 @@ void *SACCHLogicalChannelServiceLoopAdapter(SACCHLogicalChannel*);
 	sub-divided into the common control channel (CCCH), the packet common control
 	channel (PCCCH), and the Compact packet common control channel (CPCCCH)."
 */
-class CCCHLogicalChannel : public NDCCHLogicalChannel {
+class CCCHLogicalChannel : public NDCCHLogicalChannel, public ChannelTask {
 
 	protected:
 
 	/*
 		Because the CCCH is written by multiple threads,
 		we funnel all of the outgoing messages into a FIFO
-		and empty that FIFO with a service loop.
+		and empty that FIFO with a service task.
 	*/
 
-	Thread mServiceThread;	///< a thread for the service loop
 	L3FrameFIFO mQ;			///< because the CCCH is written by multiple threads
-	bool mRunning;			///< a flag to indication that the service loop is running
+	bool mRunning;			///< a flag to indication that the service task is running
 
 	public:
 
@@ -436,21 +485,16 @@ class CCCHLogicalChannel : public NDCCHLogicalChannel {
 
 	void send(const L3Message&) { assert(0); }
 
-	/** This is a loop in its own thread that empties mQ. */
-	void serviceLoop();
+	/** The executor step that empties mQ, one frame per block. */
+	bool step(Time& next);
 
 	/** Return the number of messages waiting for transmission. */
 	unsigned load() const { return mQ.size(); }
 
 	ChannelType type() const { return CCCHType; }
 
-	friend void *CCCHLogicalChannelServiceLoopAdapter(CCCHLogicalChannel*);
-
 };
 
-/** A C interface for the CCCHLogicalChannel embedded loop. */
-void *CCCHLogicalChannelServiceLoopAdapter(CCCHLogicalChannel*);
-
 
 
 class TCHFACCHLogicalChannel : public LogicalChannel {
@@ -486,6 +530,10 @@ class TCHFACCHLogicalChannel : public LogicalChannel {
 	unsigned queueSize() const
 		{ assert(mTCHL1); return mTCHL1->queueSize(); }
 
+	/** Return count of L2 frames waiting for FACCH. */
+	unsigned FACCHBacklog() const
+		{ assert(mTCHL1); return mTCHL1->FACCHBacklog(); }
+
 	bool radioFailure() const
 		{ assert(mTCHL1); return mTCHL1->radioFailure(); }
 };
@@ -65,6 +65,23 @@ void SAPMux::writeLowSide(const L2Frame& frame)
 }
 
 
+void SAPMux::writeLowSide(L2Frame&& frame)
+{
+	// Only a DATA frame goes to a single SAP; primitives are copied to each.
+	if (frame.primitive()!=DATA) {
+		writeLowSide((const L2Frame&)frame);
+		return;
+	}
+	OBJLOG(DEBUG) << frame.SAPI() << " " << frame;
+	unsigned SAPI = frame.SAPI();	
+	if (!mUpstream[SAPI]) {
+		LOG(WARNING) << "received DATA for unsupported SAP " << SAPI;
+		return;
+	}
+	mUpstream[SAPI]->writeLowSide(std::move(frame));
+}
+
+
 
 void LoopbackSAPMux::writeHighSide(const L2Frame& frame)
 {
@@ -65,6 +65,9 @@ class SAPMux  {
 
 	virtual void writeHighSide(const L2Frame& frame); 
 	virtual void writeLowSide(const L2Frame& frame); 
+
+	/** Pass up a frame L1 no longer needs, handing its buffer to the L2. */
+	virtual void writeLowSide(L2Frame&& frame);
 	
 	void upstream( L2DL * wUpstream, unsigned wSAPI=0 )
 		{ assert(mUpstream[wSAPI]==NULL); mUpstream[wSAPI]=wUpstream; }
@@ -89,6 +92,7 @@ class LoopbackSAPMux : public SAPMux {
 
 	void writeHighSide(const L2Frame& frame);
 	void writeLowSide(const L2Frame& frame);
+	void writeLowSide(L2Frame&& frame) { writeLowSide((const L2Frame&)frame); }
 
 };
 
@@ -122,6 +126,8 @@ class L1TestPointSAPMux : public SAPMux {
 		LOG(DEBUG) << "SAPMux::writeLowSide frame=" << frame;
 	}
 
+	void writeLowSide(L2Frame&& frame) { writeLowSide((const L2Frame&)frame); }
+
 };
 
 
@@ -26,27 +26,254 @@
 #include "GSMTAPDump.h"
 #include "GSMTransfer.h"
 #include <Sockets.h>
+#include <Logger.h>
 #include <Globals.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+// These are read for every frame, so use precompiled handles.
+static ConfigKey<std::string> gGSMTAPTargetIP(gConfig,"Control.GSMTAP.TargetIP","");
+static ConfigKey<long> gGSMTAPTargetPort(gConfig,"Control.GSMTAP.TargetPort",GSMTAP_UDP_PORT);
+static ConfigKey<std::string> gGSMTAPPcapFile(gConfig,"Control.GSMTAP.PcapFile","");
+static ConfigKey<long> gGSMTAPPcapMaxSize(gConfig,"Control.GSMTAP.PcapMaxSize",100);
+static ConfigKey<long> gGSMTAPRadioBand(gConfig,"GSM.Radio.Band",0);
+
+
+
+void* GSMTAPPacket::operator new(size_t size)
+{
+	static ObjectPool* sPool = new ObjectPool("GSMTAP",sizeof(GSMTAPPacket),4096);
+	return sPool->allocate(size);
+}
+
+
+
+/**@name The libpcap file format, as written on this host; readers accept either byte order. */
+//@{
+struct PcapGlobalHeader {
+	uint32_t magic;
+	uint16_t versionMajor;
+	uint16_t versionMinor;
+	int32_t thisZone;
+	uint32_t sigFigs;
+	uint32_t snapLength;
+	uint32_t linkType;
+};
+
+struct PcapRecordHeader {
+	uint32_t seconds;
+	uint32_t microseconds;
+	uint32_t includedLength;
+	uint32_t originalLength;
+};
+
+static const uint32_t sPcapLinkTypeRaw = 101;		///< records start with an IP header
+//@}
+
+/** IPv4 and UDP headers, loopback to loopback on the GSMTAP port. */
+static const unsigned sIPUDPLength = 20+8;
+
+static void buildIPUDP(unsigned char* hdr, unsigned payloadLength)
+{
+	unsigned ipLength = sIPUDPLength + payloadLength;
+	memset(hdr,0,sIPUDPLength);
+	hdr[0] = 0x45;				// version 4, 5 words
+	hdr[2] = ipLength>>8;
+	hdr[3] = ipLength;
+	hdr[6] = 0x40;				// don't fragment
+	hdr[8] = 64;				// TTL
+	hdr[9] = 17;				// UDP
+	hdr[12] = 127; hdr[15] = 1;	// source 127.0.0.1
+	hdr[16] = 127; hdr[19] = 1;	// destination 127.0.0.1
+	uint32_t sum = 0;
+	for (unsigned i=0; i<20; i+=2) sum += (hdr[i]<<8) | hdr[i+1];
+	while (sum>>16) sum = (sum&0xffff) + (sum>>16);
+	sum = ~sum & 0xffff;
+	hdr[10] = sum>>8;
+	hdr[11] = sum;
+	// UDP, with no checksum.
+	unsigned udpLength = 8 + payloadLength;
+	hdr[20] = hdr[22] = GSMTAP_UDP_PORT>>8;
+	hdr[21] = hdr[23] = GSMTAP_UDP_PORT&0xff;
+	hdr[24] = udpLength>>8;
+	hdr[25] = udpLength;
+}
+
+
+
+bool GSMTAPPcapFile::create()
+{
+	mFile = fopen(mPath.c_str(),"w");
+	if (!mFile) {
+		LOG(ALERT) << "cannot open GSMTAP capture file " << mPath << ": " << strerror(errno);
+		return false;
+	}
+	static const size_t bufferSize = 1024*1024;
+	if (!mBuffer) mBuffer = new char[bufferSize];
+	setvbuf(mFile,mBuffer,_IOFBF,bufferSize);
+	PcapGlobalHeader header = { 0xa1b2c3d4, 2, 4, 0, 0, 65535, sPcapLinkTypeRaw };
+	fwrite(&header,sizeof(header),1,mFile);
+	mBytes = sizeof(header);
+	return true;
+}
+
+
+bool GSMTAPPcapFile::open(const std::string& path)
+{
+	close();
+	mPath = path;
+	if (!create()) return false;
+	LOG(NOTICE) << "GSMTAP capture to " << mPath;
+	return true;
+}
+
+
+void GSMTAPPcapFile::close()
+{
+	if (mFile) fclose(mFile);
+	mFile = NULL;
+	// The buffer belonged to the stream, so it can go only after fclose().
+	delete[] mBuffer;
+	mBuffer = NULL;
+}
+
+
+void GSMTAPPcapFile::write(const GSMTAPPacket& packet, size_t maxBytes)
+{
+	if (!mFile) return;
+	if (maxBytes && mBytes>=maxBytes) {
+		fclose(mFile);
+		mFile = NULL;
+		std::string old = mPath + ".1";
+		if (rename(mPath.c_str(),old.c_str())!=0) {
+			LOG(ERR) << "cannot rename GSMTAP capture file " << mPath << ": " << strerror(errno);
+		}
+		if (!create()) return;
+	}
+	unsigned length = sIPUDPLength + packet.mLength;
+	PcapRecordHeader record = { (uint32_t)packet.mTime.tv_sec, (uint32_t)packet.mTime.tv_usec, length, length };
+	unsigned char ipudp[sIPUDPLength];
+	buildIPUDP(ipudp,packet.mLength);
+	fwrite(&record,sizeof(record),1,mFile);
+	fwrite(ipudp,sizeof(ipudp),1,mFile);
+	fwrite(packet.mData,packet.mLength,1,mFile);
+	mBytes += sizeof(record) + length;
+}
+
+
+
+GSMTAPWriter::GSMTAPWriter()
+	:mIPVersion(0),mPortVersion(0),mPcapVersion(0),mQueued(0),mDropped(0)
+{ }
+
+
+GSMTAPWriter& GSMTAPWriter::writer()
+{
+	// Never destroyed, since L1 threads may still be capturing during static destruction.
+	static GSMTAPWriter* sWriter = NULL;
+	static Mutex sLock;
+	GSMTAPWriter* writer = __atomic_load_n(&sWriter,__ATOMIC_ACQUIRE);
+	if (writer) return *writer;
+	ScopedLock lock(sLock);
+	if (!sWriter) {
+		writer = new GSMTAPWriter;
+		writer->mThread.start((void*(*)(void*))GSMTAPWriterServiceLoopAdapter,writer);
+		__atomic_store_n(&sWriter,writer,__ATOMIC_RELEASE);
+	}
+	return *sWriter;
+}
+
+
+bool GSMTAPWriter::enabled()
+{
+	return gGSMTAPTargetIP.defined() || gGSMTAPPcapFile.defined();
+}
+
+
+void GSMTAPWriter::write(GSMTAPPacket* packet)
+{
+	// Reserve a place before queueing, so the count never falls behind the queue.
+	if (__atomic_add_fetch(&mQueued,1,__ATOMIC_RELAXED)>sMaxQueued) {
+		__atomic_sub_fetch(&mQueued,1,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&mDropped,1,__ATOMIC_RELAXED);
+		delete packet;
+		return;
+	}
+	mQ.write(packet);
+}
+
+
+void GSMTAPWriter::send(GSMTAPPacket* const batch[], unsigned count)
+{
+	// Set socket destination, resolving it again only when the configuration changes.
+	// Port defaults to GSMTAP_UDP_PORT.
+	if (gGSMTAPTargetIP.defined()) {
+		// The IP is defined here, so its version is past the initial 0 on the first call.
+		bool newIP = gGSMTAPTargetIP.changed(mIPVersion);
+		bool newPort = gGSMTAPTargetPort.changed(mPortVersion);
+		if (newIP || newPort)
+			mSocket.destination(gGSMTAPTargetPort.value(),gGSMTAPTargetIP.value().c_str());
+		const char* buffers[MAX_UDP_BATCH];
+		size_t lengths[MAX_UDP_BATCH];
+		for (unsigned i=0; i<count; i++) {
+			buffers[i] = batch[i]->mData;
+			lengths[i] = batch[i]->mLength;
+		}
+		mSocket.writeBatch(buffers,lengths,count);
+	}
+
+	// A new path, or the same path defined again, starts a new capture.
+	bool newPath = gGSMTAPPcapFile.changed(mPcapVersion);
+	if (!gGSMTAPPcapFile.defined()) {
+		mPcap.close();
+		return;
+	}
+	if (newPath) mPcap.open(gGSMTAPPcapFile.value());
+	size_t maxBytes = 1024*1024*gGSMTAPPcapMaxSize.value();
+	for (unsigned i=0; i<count; i++) mPcap.write(*batch[i],maxBytes);
+}
+
+
+void GSMTAPWriter::serviceLoop()
+{
+	GSMTAPPacket* batch[MAX_UDP_BATCH];
+	while (true) {
+		// When the queue goes quiet, get the capture file up to date.
+		GSMTAPPacket* packet = mQ.read(1000);
+		if (!packet) {
+			mPcap.flush();
+			continue;
+		}
+		unsigned count = 0;
+		batch[count++] = packet;
+		while (count<MAX_UDP_BATCH && (packet=mQ.readNoBlock())) batch[count++] = packet;
+		send(batch,count);
+		for (unsigned i=0; i<count; i++) delete batch[i];
+		__atomic_sub_fetch(&mQueued,count,__ATOMIC_RELAXED);
+
+		unsigned dropped = __atomic_exchange_n(&mDropped,0,__ATOMIC_RELAXED);
+		if (dropped) LOG(NOTICE) << dropped << " GSMTAP packets dropped in capture overrun";
+	}
+}
+
+
+void* GSMTAPWriterServiceLoopAdapter(GSMTAPWriter* writer)
+{
+	writer->serviceLoop();
+	return NULL;
+}
+
 
-UDPSocket GSMTAPSocket;
 
 void gWriteGSMTAP(unsigned ARFCN, unsigned TS, unsigned FN,
                   GSM::TypeAndOffset to, bool is_saach, bool ul_dln,
                   const BitVector& frame)
 {
-	char buffer[MAX_UDP_LENGTH];
-	int ofs = 0;
-
 	// Check if GSMTap is enabled
-	if (!gConfig.defines("Control.GSMTAP.TargetIP")) return;
+	if (!GSMTAPWriter::enabled()) return;
 
-	// Port configuration
-	unsigned port = GSMTAP_UDP_PORT;	// default port for GSM-TAP
-	if (gConfig.defines("Control.GSMTAP.TargetPort"))
-		port = gConfig.getNum("Control.GSMTAP.TargetPort");
-
-	// Set socket destination
-	GSMTAPSocket.destination(port,gConfig.getStr("Control.GSMTAP.TargetIP").c_str());
+	size_t frameBytes = (frame.size() + 7) >> 3;
+	if (frameBytes>GSMTAPPacket::sMaxPayload) return;
 
 	// Decode TypeAndOffset
 	uint8_t stype, scn;
@@ -102,14 +329,16 @@ void gWriteGSMTAP(unsigned ARFCN, unsigned TS, unsigned FN,
 		stype |= GSMTAP_CHANNEL_ACCH;
 
 	// Flags in ARFCN
-	if (gConfig.getNum("GSM.Radio.Band") == 1900)
+	if (gGSMTAPRadioBand.value() == 1900)
 		ARFCN |= GSMTAP_ARFCN_F_PCS;
 
 	if (ul_dln)
 		ARFCN |= GSMTAP_ARFCN_F_UPLINK;
 
 	// Build header
-	struct gsmtap_hdr *header = (struct gsmtap_hdr *)buffer;
+	GSMTAPPacket* packet = new GSMTAPPacket;
+	gettimeofday(&packet->mTime,NULL);
+	struct gsmtap_hdr *header = (struct gsmtap_hdr *)packet->mData;
 	header->version			= GSMTAP_VERSION;
 	header->hdr_len			= sizeof(struct gsmtap_hdr) >> 2;
 	header->type			= GSMTAP_TYPE_UM;
@@ -123,14 +352,12 @@ void gWriteGSMTAP(unsigned ARFCN, unsigned TS, unsigned FN,
 	header->sub_slot		= scn;
 	header->res				= 0;
 
-	ofs += sizeof(*header);
-
 	// Add frame data
-	frame.pack((unsigned char*)&buffer[ofs]);
-	ofs += (frame.size() + 7) >> 3;
+	frame.pack((unsigned char*)&packet->mData[sizeof(*header)]);
+	packet->mLength = sizeof(*header) + frameBytes;
 
-	// Write the GSMTAP packet
-	GSMTAPSocket.write(buffer, ofs);
+	// Hand the GSMTAP packet to the capture thread
+	GSMTAPWriter::writer().write(packet);
 }
 
 
@@ -27,13 +27,141 @@
 #include "gsmtap.h"
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include <Interthread.h>
+#include <ObjectPool.h>
+#include <Sockets.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <string>
 
 
+/**
+	Copy a frame into a GSMTAP packet and queue it for the capture thread.
+	This is called from the L1 threads for every frame, so it never blocks:
+	it does nothing unless a capture is configured, and drops the packet if the capture falls behind.
+*/
 void gWriteGSMTAP(unsigned ARFCN, unsigned TS, unsigned FN,
                   GSM::TypeAndOffset to, bool is_sacch, bool ul_dln,
                   const BitVector& frame);
 
 
+
+/** A GSMTAP header and payload, stamped with its capture time. */
+class GSMTAPPacket {
+
+	public:
+
+	static const unsigned sMaxPayload = 64;		///< bytes, enough for any L1 block
+
+	struct timeval mTime;
+	unsigned mLength;							///< bytes in mData, header included
+	char mData[sizeof(struct gsmtap_hdr)+sMaxPayload];
+
+	/**@name Allocation from the packet pool. */
+	//@{
+	static void* operator new(size_t size);
+	static void operator delete(void* block) { ObjectPool::release(block); }
+	//@}
+};
+
+
+
+/**
+	A capture file in libpcap format, rotated when it reaches a size limit.
+	Each GSMTAP packet is wrapped in IPv4 and UDP headers for the GSMTAP port,
+	so that Wireshark dissects the file as it would live traffic.
+*/
+class GSMTAPPcapFile {
+
+	private:
+
+	std::string mPath;
+	FILE* mFile;
+	char* mBuffer;			///< stdio buffer, so records go to disk in large writes
+	size_t mBytes;			///< bytes written to the current file
+
+	/** Create the file and write the pcap global header. */
+	bool create();
+
+	public:
+
+	GSMTAPPcapFile():mFile(NULL),mBuffer(NULL),mBytes(0) {}
+
+	~GSMTAPPcapFile() { close(); }
+
+	/** Start a capture at a path, closing any previous one; return false on failure. */
+	bool open(const std::string& path);
+
+	void close();
+
+	bool isOpen() const { return mFile!=NULL; }
+
+	/**
+		Add a packet record.
+		If the file has grown past maxBytes, it is first renamed to path.1,
+		replacing the previous one, and a new file is started.
+	*/
+	void write(const GSMTAPPacket& packet, size_t maxBytes);
+
+	/** Push buffered records to the file. */
+	void flush() { if (mFile) fflush(mFile); }
+};
+
+
+
+/**
+	The GSMTAP capture thread.
+	L1 threads queue packets on a lock-free queue; this thread sends them to the configured
+	UDP target in batches, one system call per batch, and writes them to the pcap file, if any.
+	Configuration is checked here, per batch, rather than per frame on the real-time threads.
+*/
+class GSMTAPWriter {
+
+	private:
+
+	MPSCInterthreadQueue<GSMTAPPacket> mQ;
+	UDPSocket mSocket;
+	GSMTAPPcapFile mPcap;
+	Thread mThread;
+
+	/**@name Configuration versions last acted on, owned by the capture thread. */
+	//@{
+	unsigned mIPVersion;
+	unsigned mPortVersion;
+	unsigned mPcapVersion;
+	//@}
+
+	volatile unsigned mQueued;		///< packets written and not yet sent, counted here rather than by mQ
+	volatile unsigned mDropped;		///< packets discarded because the queue was full
+
+	/** Most packets queued; past this, new packets are dropped. */
+	static const unsigned sMaxQueued = 4096;
+
+	/** Deliver one batch to every configured sink. */
+	void send(GSMTAPPacket* const batch[], unsigned count);
+
+	void serviceLoop();
+
+	friend void* GSMTAPWriterServiceLoopAdapter(GSMTAPWriter*);
+
+	public:
+
+	GSMTAPWriter();
+
+	/** The writer, created and started on first use. */
+	static GSMTAPWriter& writer();
+
+	/** True if any capture sink is configured. */
+	static bool enabled();
+
+	/** Queue a packet; takes ownership.  Never blocks. */
+	void write(GSMTAPPacket* packet);
+};
+
+
+void* GSMTAPWriterServiceLoopAdapter(GSMTAPWriter*);
+
+
 #endif
 
 // vim: ts=4 sw=4
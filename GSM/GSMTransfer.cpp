@@ -55,6 +55,19 @@ ostream& GSM::operator<<(ostream& os, const L3Frame& frame)
 }
 
 
+void VocoderFrame::mapPayload(const unsigned *map, size_t mapSize, BitVector& dest) const
+{
+	// The payload follows the 4-bit signature.
+	for (unsigned i=0; i<mapSize; i++) dest[i] = bit(4+map[i]);
+}
+
+
+void VocoderFrame::unmapPayload(const BitVector& source, const unsigned *map, size_t mapSize)
+{
+	for (unsigned i=0; i<mapSize; i++) setBit(4+map[i],source.bit(i));
+}
+
+
 ostream& GSM::operator<<(ostream& os, const L2Header::FrameFormat val)
 {
 	switch (val) {
@@ -219,7 +232,7 @@ void L2Frame::idleFill()
 
 
 L2Frame::L2Frame(const BitVector& bits, Primitive prim)
-	:BitVector(23*8),mPrimitive(prim)
+	:BitVector(23*8),mPrimitive(prim),mReceiveTime(0)
 {
 	idleFill();
 	assert(bits.size()<=this->size());
@@ -228,7 +241,7 @@ L2Frame::L2Frame(const BitVector& bits, Primitive prim)
 
 
 L2Frame::L2Frame(const L2Header& header, const BitVector& l3)
-	:BitVector(23*8),mPrimitive(DATA)
+	:BitVector(23*8),mPrimitive(DATA),mReceiveTime(0)
 {
 	idleFill();
 	assert((header.bitsNeeded()+l3.size())<=this->size());
@@ -238,7 +251,7 @@ L2Frame::L2Frame(const L2Header& header, const BitVector& l3)
 
 
 L2Frame::L2Frame(const L2Header& header)
-	:BitVector(23*8),mPrimitive(DATA)
+	:BitVector(23*8),mPrimitive(DATA),mReceiveTime(0)
 {
 	idleFill();
 	header.write(*this);
@@ -339,6 +352,30 @@ RxBurst::RxBurst(const TxBurst& source, float wTimingError, int wRSSI)
 
 
 
+// Pools for the frame classes that cross thread boundaries at the signalling rate.
+// Each is created on first use and never destroyed, since frames can outlive static destruction.
+// Uplink bursts are bounded by the per-slot decoding backlog; frames by the L2 and L3 queues.
+
+void* RxBurst::operator new(size_t size)
+{
+	static ObjectPool* sPool = new ObjectPool("RxBurst",sizeof(RxBurst),4096);
+	return sPool->allocate(size);
+}
+
+void* L2Frame::operator new(size_t size)
+{
+	static ObjectPool* sPool = new ObjectPool("L2Frame",sizeof(L2Frame),8192);
+	return sPool->allocate(size);
+}
+
+void* L3Frame::operator new(size_t size)
+{
+	static ObjectPool* sPool = new ObjectPool("L3Frame",sizeof(L3Frame),8192);
+	return sPool->allocate(size);
+}
+
+
+
 // Methods for the L2 address field.
 
 void L2Address::write(L2Frame& frame, size_t& wp) const
@@ -452,7 +489,7 @@ ostream& GSM::operator<<(ostream& os, Primitive prim)
 
 L3Frame::L3Frame(const L3Message& msg, Primitive wPrimitive)
 	:BitVector(msg.bitsNeeded()),mPrimitive(wPrimitive),
-	mL2Length(msg.L2Length())
+	mL2Length(msg.L2Length()),mReceiveTime(0)
 {
 	msg.write(*this);
 }
@@ -460,7 +497,7 @@ L3Frame::L3Frame(const L3Message& msg, Primitive wPrimitive)
 
 
 L3Frame::L3Frame(const char* hexString)
-	:mPrimitive(DATA)
+	:mPrimitive(DATA),mReceiveTime(0)
 {
 	size_t len = strlen(hexString);
 	mL2Length = len/2;
@@ -476,7 +513,7 @@ L3Frame::L3Frame(const char* hexString)
 
 
 L3Frame::L3Frame(const char* binary, size_t len)
-	:mPrimitive(DATA)
+	:mPrimitive(DATA),mReceiveTime(0)
 {
 	mL2Length = len;
 	resize(len*8);
@@ -29,6 +29,7 @@
 
 #include "Interthread.h"
 #include "BitVector.h"
+#include "ObjectPool.h"
 #include "GSMCommon.h"
 
 
@@ -155,6 +156,7 @@ class RxBurst : public SoftVector {
 	Time mTime;				///< timeslot and frame on which this was received
 	float mTimingError;		///< Timing error in symbol steps, <0 means early.
 	float mRSSI;			///< RSSI estimate associated with the slot, dB wrt full scale.
+	float mSamples[gSlotLen];	///< storage for a burst that carries its own soft bits
 
 
 	public:
@@ -168,6 +170,21 @@ class RxBurst : public SoftVector {
 		mTimingError(wTimingError),mRSSI(wRSSI)
 	{ }
 
+	/**
+		Make an RxBurst with its own storage, for the caller to fill through begin().
+		The soft bits live in the object itself, so a pooled burst needs no other allocation.
+	*/
+	RxBurst(const Time &wTime, float wTimingError, int wRSSI)
+		:SoftVector(mSamples,gSlotLen),mTime(wTime),
+		mTimingError(wTimingError),mRSSI(wRSSI)
+	{ }
+
+	/**@name Allocation from the RxBurst pool. */
+	//@{
+	static void* operator new(size_t size);
+	static void operator delete(void* block) { ObjectPool::release(block); }
+	//@}
+
 
 	Time time() const { return mTime; }
 
@@ -469,6 +486,7 @@ class L2Frame : public BitVector {
 	private:
 
 	GSM::Primitive mPrimitive;
+	uint64_t mReceiveTime;		///< metricsClock() when L1 decoded the frame, 0 if not from L1
 
 	public:
 
@@ -478,15 +496,37 @@ class L2Frame : public BitVector {
 	/** Build an empty frame with a given primitive. */
 	L2Frame(GSM::Primitive wPrimitive=UNIT_DATA)
 		:BitVector(23*8),
-		mPrimitive(wPrimitive)
+		mPrimitive(wPrimitive),mReceiveTime(0)
 	{ idleFill(); }
 
 	/** Make a new L2 frame by copying an existing one. */
 	L2Frame(const L2Frame& other)
 		:BitVector((const BitVector&)other),
-		mPrimitive(other.mPrimitive)
+		mPrimitive(other.mPrimitive),mReceiveTime(other.mReceiveTime)
+	{ }
+
+	/** Make a new L2 frame by taking the bits of a temporary. */
+	L2Frame(L2Frame&& other)
+		:BitVector(std::move((BitVector&)other)),
+		mPrimitive(other.mPrimitive),mReceiveTime(other.mReceiveTime)
 	{ }
 
+	L2Frame& operator=(const L2Frame& other)
+	{
+		BitVector::operator=((const BitVector&)other);
+		mPrimitive = other.mPrimitive;
+		mReceiveTime = other.mReceiveTime;
+		return *this;
+	}
+
+	L2Frame& operator=(L2Frame&& other)
+	{
+		BitVector::operator=(std::move((BitVector&)other));
+		mPrimitive = other.mPrimitive;
+		mReceiveTime = other.mReceiveTime;
+		return *this;
+	}
+
 	/**
 		Make an L2Frame from a block of bits.
 		BitVector must fit in the L2Frame.
@@ -506,6 +546,12 @@ class L2Frame : public BitVector {
 	*/
 	L2Frame(const L2Header&);
 
+	/**@name Uplink receive time, for latency metrics. */
+	//@{
+	uint64_t receiveTime() const { return mReceiveTime; }
+	void receiveTime(uint64_t wReceiveTime) { mReceiveTime=wReceiveTime; }
+	//@}
+
 	/** Get the LPD from the L2 header.  Assumes address byte is first. */
 	unsigned LPD() const;
 
@@ -565,6 +611,11 @@ class L2Frame : public BitVector {
 	/** This is used only for testing. */
 	void primitive(Primitive wPrimitive) { mPrimitive=wPrimitive; }
 
+	/**@name Allocation from the L2Frame pool. */
+	//@{
+	static void* operator new(size_t size);
+	static void operator delete(void* block) { ObjectPool::release(block); }
+	//@}
 };
 
 std::ostream& operator<<(std::ostream& os, const L2Frame& msg);
@@ -585,31 +636,51 @@ class L3Frame : public BitVector {
 
 	Primitive mPrimitive;
 	size_t mL2Length;		///< length, or L2 pseudo-length, as appropriate
+	uint64_t mReceiveTime;	///< receive time of the L2 frame that completed this one, 0 if none
 
 	public:
 
 	/** Empty frame with a primitive. */
 	L3Frame(Primitive wPrimitive=DATA, size_t len=0)
-		:BitVector(len),mPrimitive(wPrimitive),mL2Length(len)
+		:BitVector(len),mPrimitive(wPrimitive),mL2Length(len),mReceiveTime(0)
 	{ }
 
 	/** Put raw bits into the frame. */
 	L3Frame(const BitVector& source, Primitive wPrimitive=DATA)
-		:BitVector(source),mPrimitive(wPrimitive),mL2Length(source.size()/8)
+		:BitVector(source),mPrimitive(wPrimitive),mL2Length(source.size()/8),mReceiveTime(0)
 	{ if (source.size()%8) mL2Length++; }
 
+	/** Put raw bits into the frame, taking the buffer of a temporary. */
+	L3Frame(BitVector&& source, Primitive wPrimitive=DATA)
+		:BitVector(std::move(source)),mPrimitive(wPrimitive),mL2Length(size()/8),mReceiveTime(0)
+	{ if (size()%8) mL2Length++; }
+
 	/** Concatenate 2 L3Frames */
 	L3Frame(const L3Frame& f1, const L3Frame& f2)
 		:BitVector(f1,f2),mPrimitive(DATA),
-		mL2Length(f1.mL2Length + f2.mL2Length)
+		mL2Length(f1.mL2Length + f2.mL2Length),
+		mReceiveTime(f2.mReceiveTime)
 	{}
 
 	/** Build from an L2Frame. */
 	L3Frame(const L2Frame& source)
 		:BitVector(source.L3Part()),mPrimitive(DATA),
-		mL2Length(source.L())
+		mL2Length(source.L()),mReceiveTime(source.receiveTime())
 	{ }
 
+	/**
+		Build from a temporary L2Frame, taking its buffer.
+		The L3 part is an in-place segment of the block, so nothing is copied.
+	*/
+	L3Frame(L2Frame&& source)
+		:BitVector(std::move((BitVector&)source)),mPrimitive(DATA),
+		mL2Length(0),mReceiveTime(source.receiveTime())
+	{
+		// The L2 header is still at the front of the block; see L2Frame::L() and L3Part().
+		mL2Length = peekField(8*2,6);
+		narrow(8*3,8*mL2Length);
+	}
+
 	/** Serialize a message into the frame. */
 	L3Frame(const L3Message& msg, Primitive wPrimitive=DATA);
 
@@ -631,6 +702,12 @@ class L3Frame : public BitVector {
 	/** Return the associated primitive. */
 	GSM::Primitive primitive() const { return mPrimitive; }
 
+	/**@name Uplink receive time, for latency metrics. */
+	//@{
+	uint64_t receiveTime() const { return mReceiveTime; }
+	void receiveTime(uint64_t wReceiveTime) { mReceiveTime=wReceiveTime; }
+	//@}
+
 	/** Return frame length in BYTES. */
 	size_t length() const { return size()/8; }
 
@@ -642,6 +719,12 @@ class L3Frame : public BitVector {
 	// Methods for writing H/L bits into rest octets.
 	void writeH(size_t& wp);
 	void writeL(size_t& wp);
+
+	/**@name Allocation from the L3Frame pool. */
+	//@{
+	static void* operator new(size_t size);
+	static void operator delete(void* block) { ObjectPool::release(block); }
+	//@}
 };
 
 
@@ -652,27 +735,34 @@ typedef InterthreadQueue<L3Frame> L3FrameFIFO;
 
 
 
-/** A vocoder frame for use in GSM/SIP contexts. */
-class VocoderFrame : public BitVector {
+/**
+	A vocoder frame for use in GSM/SIP contexts.
+	These are queued at the speech rate on every active TCH, so they are kept packed.
+*/
+class VocoderFrame : public PackedBitVector {
 
 	public:
 
 	VocoderFrame()
-		:BitVector(264)
+		:PackedBitVector(264)
 	{ fillField(0,0x0d,4); }
 
 	/** Construct by unpacking a char[33]. */
 	VocoderFrame(const unsigned char *src)
-		:BitVector(264)
+		:PackedBitVector(264)
 	{ unpack(src); }
 
-	BitVector payload() { return tail(4); }
-	const BitVector payload() const { return tail(4); }
+	/** Reorder the payload into a BitVector, dest[i] = payload[map[i]]. */
+	void mapPayload(const unsigned *map, size_t mapSize, BitVector& dest) const;
+
+	/** Reorder a BitVector into the payload, payload[map[i]] = source[i]. */
+	void unmapPayload(const BitVector& source, const unsigned *map, size_t mapSize);
 
 };
 
 
-typedef InterthreadQueue<VocoderFrame> VocoderFrameFIFO;
+/** Speech frames have one writer thread and one reader thread. */
+typedef SPSCInterthreadQueue<VocoderFrame> VocoderFrameFIFO;
 
 };	// namespace GSM
 
@@ -0,0 +1,165 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "GSMInterleave.h"
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+using namespace GSM;
+
+
+// The per-bit loops the tables replaced, GSM 05.03 3.1.3 and 4.1.4, as references.
+
+static void referenceInterleaveXCCH(const BitVector& c, BitVector i[4])
+{
+	for (int k=0; k<456; k++) {
+		int B = k%4;
+		int j = 2*((49*k) % 57) + ((k%8)/4);
+		i[B][j] = c[k];
+	}
+}
+
+static void referenceDeinterleaveXCCH(SoftVector i[4], SoftVector& c)
+{
+	for (int k=0; k<456; k++) {
+		int B = k%4;
+		int j = 2*((49*k) % 57) + ((k%8)/4);
+		c[k] = i[B][j];
+		i[B][j] = 0.5F;
+	}
+}
+
+static void referenceInterleaveTCH(const BitVector& c, BitVector i[8], int blockOffset)
+{
+	for (int k=0; k<456; k++) {
+		int B = ( k + blockOffset ) % 8;
+		int j = 2*((49*k) % 57) + ((k%8)/4);
+		i[B][j] = c[k];
+	}
+}
+
+static void referenceDeinterleaveTCH(SoftVector i[8], SoftVector& c, int blockOffset)
+{
+	for (int k=0; k<456; k++) {
+		int B = ( k + blockOffset ) % 8;
+		int j = 2*((49*k) % 57) + ((k%8)/4);
+		c[k] = i[B][j];
+		i[B][j] = 0.5F;
+	}
+}
+
+
+static bool same(const BitVector* a, const BitVector* b, unsigned n)
+{
+	for (unsigned B=0; B<n; B++) {
+		for (unsigned j=0; j<a[B].size(); j++) if (a[B][j]!=b[B][j]) return false;
+	}
+	return true;
+}
+
+static bool same(const SoftVector* a, const SoftVector* b, unsigned n)
+{
+	for (unsigned B=0; B<n; B++) {
+		for (unsigned j=0; j<a[B].size(); j++) if (a[B][j]!=b[B][j]) return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+	BitVector c(456);
+	SoftVector sc(456), rc(456);
+
+	// xCCH: SDCCH, SACCH, BCCH, CCCH.
+	BitVector xi[4], xr[4];
+	SoftVector xsi[4], xsr[4];
+	for (int B=0; B<4; B++) {
+		xi[B] = BitVector(114); xi[B].zero();
+		xr[B] = BitVector(114); xr[B].zero();
+		xsi[B] = SoftVector(114);
+		xsr[B] = SoftVector(114);
+	}
+	for (int trial=0; trial<100; trial++) {
+		for (unsigned k=0; k<456; k++) c[k] = random() & 0x01;
+		interleaveXCCH(c,xi);
+		referenceInterleaveXCCH(c,xr);
+		if (!same(xi,xr,4)) failures++;
+		// Soft values that are distinct, to catch any misplaced bit.
+		for (int B=0; B<4; B++) {
+			for (int j=0; j<114; j++) xsi[B][j] = xsr[B][j] = (random() % 1000) / 1000.0F;
+		}
+		deinterleaveXCCH(xsi,sc);
+		referenceDeinterleaveXCCH(xsr,rc);
+		if (!same(&sc,&rc,1) || !same(xsi,xsr,4)) failures++;
+		// Round trip.
+		for (int B=0; B<4; B++) {
+			for (int j=0; j<114; j++) xsi[B][j] = xi[B][j];
+		}
+		deinterleaveXCCH(xsi,sc);
+		for (unsigned k=0; k<456; k++) if (sc[k]!=c[k]) { failures++; break; }
+	}
+	cout << "xCCH failures " << failures << endl;
+
+	// TCH/F and FACCH/F, both block offsets, with history in the other half of each burst.
+	BitVector ti[8], tr[8];
+	SoftVector tsi[8], tsr[8];
+	for (int B=0; B<8; B++) {
+		ti[B] = BitVector(114);
+		tr[B] = BitVector(114);
+		tsi[B] = SoftVector(114);
+		tsr[B] = SoftVector(114);
+	}
+	for (int trial=0; trial<100; trial++) {
+		int blockOffset = (trial%2) ? 4 : 0;
+		for (int B=0; B<8; B++) {
+			for (int j=0; j<114; j++) ti[B][j] = tr[B][j] = random() & 0x01;
+		}
+		for (unsigned k=0; k<456; k++) c[k] = random() & 0x01;
+		interleaveTCH(c,ti,blockOffset);
+		referenceInterleaveTCH(c,tr,blockOffset);
+		if (!same(ti,tr,8)) failures++;
+		for (int B=0; B<8; B++) {
+			for (int j=0; j<114; j++) tsi[B][j] = tsr[B][j] = (random() % 1000) / 1000.0F;
+		}
+		deinterleaveTCH(tsi,sc,blockOffset);
+		referenceDeinterleaveTCH(tsr,rc,blockOffset);
+		if (!same(&sc,&rc,1) || !same(tsi,tsr,8)) failures++;
+		// Round trip.
+		for (int B=0; B<8; B++) {
+			for (int j=0; j<114; j++) tsi[B][j] = ti[B][j];
+		}
+		deinterleaveTCH(tsi,sc,blockOffset);
+		for (unsigned k=0; k<456; k++) if (sc[k]!=c[k]) { failures++; break; }
+	}
+	cout << "total failures " << failures << endl;
+
+	return failures ? 1 : 0;
+}
+
+// vim: ts=4 sw=4
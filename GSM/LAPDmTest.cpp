@@ -0,0 +1,304 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+
+#include "GSML2LAPDm.h"
+#include "GSMSAPMux.h"
+#include <Configuration.h>
+#include <Logger.h>
+#include <Threads.h>
+#include <Timeval.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace GSM;
+
+// The window size is a configuration key.
+ConfigurationTable gConfig;
+
+
+static unsigned failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	cout << (ok ? "ok   " : "FAIL ") << what << endl;
+	if (!ok) failures++;
+}
+
+
+/**
+	A loopback in place of L1: frames written down by one L2 are handed
+	straight up to its peer, except those the test holds back or drops.
+*/
+class Wire : public SAPMux {
+
+	private:
+
+	mutable Mutex mWireLock;
+	L2DL* mPeer;
+	bool mHold;						///< keep frames instead of delivering them
+	unsigned mDropI;				///< I-frames still to be discarded
+	vector<L2Frame> mHeld;
+	unsigned mIFrames;				///< I-frames written, including retransmissions
+	unsigned mREJFrames;			///< REJ frames written
+	unsigned mSentNS;				///< bit mask of N(S) values written
+
+	public:
+
+	Wire()
+		:mPeer(NULL),mHold(false),mDropI(0),
+		mIFrames(0),mREJFrames(0),mSentNS(0)
+	{ }
+
+	void peer(L2DL* wPeer) { mPeer = wPeer; }
+
+	void writeHighSide(const L2Frame& frame)
+	{
+		if (frame.primitive()!=DATA || frame.DCCHIdle()) return;
+		ScopedLock lock(mWireLock);
+		L2Control::ControlFormat format = frame.controlFormat();
+		if (format==L2Control::IFormat) {
+			mIFrames++;
+			mSentNS |= 1<<frame.NS();
+			if (mDropI) {
+				mDropI--;
+				return;
+			}
+		}
+		if (format==L2Control::SFormat && frame.SFrameType()==L2Control::REJFrame) mREJFrames++;
+		if (mHold) mHeld.push_back(frame);
+		else mPeer->writeLowSide(frame);
+	}
+
+	void hold() { ScopedLock lock(mWireLock); mHold = true; }
+
+	/** Stop holding and deliver what was held. */
+	void release()
+	{
+		ScopedLock lock(mWireLock);
+		mHold = false;
+		for (unsigned i=0; i<mHeld.size(); i++) mPeer->writeLowSide(mHeld[i]);
+		mHeld.clear();
+	}
+
+	void dropIFrames(unsigned count) { ScopedLock lock(mWireLock); mDropI = count; }
+
+	unsigned IFrames() const { ScopedLock lock(mWireLock); return mIFrames; }
+	unsigned REJFrames() const { ScopedLock lock(mWireLock); return mREJFrames; }
+
+	/** Count of different N(S) values written. */
+	unsigned distinctNS() const
+	{
+		ScopedLock lock(mWireLock);
+		unsigned count = 0;
+		for (unsigned NS=0; NS<8; NS++) if (mSentNS & (1<<NS)) count++;
+		return count;
+	}
+};
+
+
+/** The BTS side, with a short N200 so that T200 expiry is quick to test. */
+class TestL2 : public SDCCHL2 {
+
+	unsigned mN200;
+
+	public:
+
+	TestL2(unsigned wC, unsigned wN200=23)
+		:SDCCHL2(wC,0),mN200(wN200)
+	{ }
+
+	unsigned N200() const { return mN200; }
+};
+
+
+/** The completion report for one L3 frame. */
+class Delivery {
+
+	private:
+
+	Mutex mLock;
+	Signal mSignal;
+	bool mDone;
+	bool mDelivered;
+
+	public:
+
+	Delivery():mDone(false),mDelivered(false) {}
+
+	static void complete(void* context, bool delivered)
+	{
+		Delivery* delivery = (Delivery*)context;
+		ScopedLock lock(delivery->mLock);
+		delivery->mDone = true;
+		delivery->mDelivered = delivered;
+		delivery->mSignal.signal();
+	}
+
+	/** Wait for the report; return true if it came and said delivered. */
+	bool wait(unsigned timeout_ms, bool& done)
+	{
+		Timeval deadline(timeout_ms);
+		ScopedLock lock(mLock);
+		while (!mDone && !deadline.passed()) mSignal.wait(mLock,deadline.remaining());
+		done = mDone;
+		return mDelivered;
+	}
+};
+
+
+/**
+	A BTS and an MS data link joined by a pair of wires.
+	Like the logical channels, these are never destroyed, since the L2 service threads never exit.
+*/
+class Link {
+
+	public:
+
+	TestL2 mBTS;
+	TestL2 mMS;
+	Wire mDownlink;
+	Wire mUplink;
+
+	Link(unsigned N200=23)
+		:mBTS(1,N200),mMS(0)
+	{
+		mDownlink.peer(&mMS);
+		mUplink.peer(&mBTS);
+		mBTS.downstream(&mDownlink);
+		mMS.downstream(&mUplink);
+		mBTS.open();
+		mMS.open();
+	}
+
+	/** The MS establishes multiframe mode, as after an SDCCH assignment. */
+	bool establish()
+	{
+		mMS.writeHighSide(L3Frame(ESTABLISH));
+		L3Frame* bts = mBTS.readHighSide(2000);
+		L3Frame* ms = mMS.readHighSide(2000);
+		bool ok = bts && ms && bts->primitive()==ESTABLISH && ms->primitive()==ESTABLISH;
+		delete bts;
+		delete ms;
+		return ok;
+	}
+};
+
+
+/** An L3 frame of the given length in octets, which segments into I-frames of 20 octets. */
+static L3Frame testFrame(unsigned octets)
+{
+	BitVector payload(octets*8);
+	for (unsigned i=0; i<octets; i++) payload.fillField(i*8,i,8);
+	return L3Frame(payload,DATA);
+}
+
+
+/** Check that the MS receives the frame intact. */
+static bool received(Link& link, const L3Frame& sent)
+{
+	L3Frame* frame = link.mMS.readHighSide(10000);
+	bool ok = frame && frame->primitive()==DATA && frame->size()==sent.size();
+	for (size_t i=0; ok && i<sent.size(); i++) ok = frame->bit(i)==sent.bit(i);
+	delete frame;
+	return ok;
+}
+
+
+/** Only K I-frames go out ahead of an acknowledgment. */
+static void testWindow()
+{
+	gConfig.set("GSM.LAPDm.WindowSize",3);
+	Link& link = *new Link;
+	check(link.establish(),"window: link established");
+	L3Frame sent = testFrame(100);
+	Delivery delivery;
+	link.mDownlink.hold();
+	link.mBTS.writeData(sent,Delivery::complete,&delivery);
+	// Well inside T200, so there are no retransmissions yet.
+	usleep(T200ms*1000/3);
+	check(link.mDownlink.IFrames()==3,"window: 3 I-frames outstanding");
+	link.mDownlink.release();
+	check(received(link,sent),"window: frame reassembled");
+	bool done;
+	bool delivered = delivery.wait(10000,done);
+	check(done && delivered,"window: completion reports delivery");
+	check(link.mDownlink.distinctNS()==5,"window: 5 segments sent");
+}
+
+
+/** A lost I-frame draws one REJ and is resent from N(R) without waiting for T200. */
+static void testREJ()
+{
+	gConfig.set("GSM.LAPDm.WindowSize",3);
+	Link& link = *new Link;
+	check(link.establish(),"REJ: link established");
+	L3Frame sent = testFrame(100);
+	Delivery delivery;
+	link.mDownlink.dropIFrames(1);
+	Timeval start;
+	link.mBTS.writeData(sent,Delivery::complete,&delivery);
+	check(received(link,sent),"REJ: frame reassembled");
+	bool done;
+	bool delivered = delivery.wait(10000,done);
+	check(done && delivered,"REJ: completion reports delivery");
+	check(start.elapsed()<(long)T200ms,"REJ: recovered before T200");
+	check(link.mUplink.REJFrames()==1,"REJ: one REJ sent");
+}
+
+
+/** With no answer, T200 retransmits N200 times, then the link fails and the frame is discarded. */
+static void testT200()
+{
+	gConfig.set("GSM.LAPDm.WindowSize",1);
+	const unsigned N200 = 2;
+	Link& link = *new Link(N200);
+	check(link.establish(),"T200: link established");
+	Delivery delivery;
+	link.mDownlink.hold();
+	link.mBTS.writeData(testFrame(10),Delivery::complete,&delivery);
+	bool done;
+	bool delivered = delivery.wait((N200+3)*T200ms,done);
+	check(done && !delivered,"T200: completion reports discard");
+	check(link.mDownlink.IFrames()>=N200+1,"T200: N200 retransmissions");
+	L3Frame* frame = link.mBTS.readHighSide(1000);
+	check(frame && frame->primitive()==ERROR,"T200: L3 told of the failure");
+	delete frame;
+	check(!link.mBTS.multiframeMode(),"T200: link released");
+}
+
+
+int main(int argc, char *argv[])
+{
+	gLogInit("LAPDmTest","WARNING",LOG_LOCAL7);
+	testWindow();
+	testREJ();
+	testT200();
+	cout << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
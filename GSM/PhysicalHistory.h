@@ -0,0 +1,117 @@
+/**@file Per-channel ring of recent measurement reports and link figures. */
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef PHYSICALHISTORY_H
+#define PHYSICALHISTORY_H
+
+#include <time.h>
+#include "GSML3RRElements.h"
+
+
+namespace GSM {
+
+
+/** One SACCH measurement report with the uplink figures L1 had at the time. */
+class PhysicalRecord {
+
+	public:
+
+	time_t mTime;						///< Unix time of the report
+	unsigned mARFCN;
+	L3MeasurementResults mResults;		///< downlink, as reported by the MS
+	float mRSSI;						///< uplink RSSI, dB wrt full scale
+	float mTimingError;					///< uplink timing error, symbol periods
+	float mFER;							///< uplink frame erasure rate
+	int mMSPower;						///< handset tx power, dBm
+	int mMSTiming;						///< handset timing advance, symbol periods
+};
+
+
+/**
+	The most recent PhysicalRecords of one channel.
+	There is one writer, the channel's SACCH service; readers on any thread
+	take consistent copies without locks, retrying if a record changes under them.
+*/
+class PhysicalHistory {
+
+	public:
+
+	static const unsigned sDepth = 8;		///< records kept, about 4 seconds of reports
+
+	private:
+
+	PhysicalRecord mRecords[sDepth];
+	volatile unsigned mSequence[sDepth];	///< per record, odd while it is being written
+	volatile unsigned mWritten;				///< records written in the channel's life
+	bool mListed;							///< known to PhysicalStatus; writer side only
+
+	friend class PhysicalStatus;
+
+	public:
+
+	PhysicalHistory():mWritten(0),mListed(false)
+	{ for (unsigned i=0; i<sDepth; i++) mSequence[i]=0; }
+
+	/** Add a record, replacing the oldest; writer only. */
+	void write(const PhysicalRecord& record)
+	{
+		unsigned slot = mWritten % sDepth;
+		__atomic_store_n(&mSequence[slot],mSequence[slot]+1,__ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		mRecords[slot] = record;
+		__atomic_store_n(&mSequence[slot],mSequence[slot]+1,__ATOMIC_RELEASE);
+		__atomic_store_n(&mWritten,mWritten+1,__ATOMIC_RELEASE);
+	}
+
+	/** Number of records written so far, including those since overwritten. */
+	unsigned written() const { return __atomic_load_n(&mWritten,__ATOMIC_ACQUIRE); }
+
+	/**
+		Copy a record.
+		@param age 0 for the latest, up to sDepth-1.
+		@return false if there is no such record yet.
+	*/
+	bool read(PhysicalRecord& record, unsigned age=0) const
+	{
+		while (true) {
+			unsigned written = __atomic_load_n(&mWritten,__ATOMIC_ACQUIRE);
+			if (age>=sDepth || age>=written) return false;
+			unsigned slot = (written-1-age) % sDepth;
+			unsigned before = __atomic_load_n(&mSequence[slot],__ATOMIC_ACQUIRE);
+			if (before & 1) continue;
+			record = mRecords[slot];
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&mSequence[slot],__ATOMIC_RELAXED)==before) return true;
+		}
+	}
+};
+
+
+}
+
+#endif
+
+// vim: ts=4 sw=4
@@ -0,0 +1,135 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "PhysicalHistory.h"
+#include <Configuration.h>
+#include <Threads.h>
+#include <iostream>
+
+using namespace std;
+using namespace GSM;
+
+// L3MeasurementResults brings in code that reads the configuration.
+ConfigurationTable gConfig;
+
+
+static const unsigned sWrites = 2000000;
+static const unsigned sReaders = 3;
+
+static PhysicalHistory sHistory;
+static volatile bool sDone = false;
+
+
+/** Every field of record n carries n, so a torn copy has fields that disagree. */
+static PhysicalRecord makeRecord(unsigned n)
+{
+	PhysicalRecord record;
+	record.mTime = n;
+	record.mARFCN = n;
+	record.mRSSI = n;
+	record.mTimingError = n;
+	record.mFER = n;
+	record.mMSPower = n;
+	record.mMSTiming = n;
+	return record;
+}
+
+static bool intact(const PhysicalRecord& record)
+{
+	unsigned n = record.mARFCN;
+	return (unsigned)record.mTime==n && record.mRSSI==(float)n && record.mTimingError==(float)n
+		&& record.mFER==(float)n && (unsigned)record.mMSPower==n && (unsigned)record.mMSTiming==n;
+}
+
+
+static void* writer(void*)
+{
+	for (unsigned i=0; i<sWrites; i++) sHistory.write(makeRecord(i));
+	__atomic_store_n(&sDone,true,__ATOMIC_RELEASE);
+	return NULL;
+}
+
+
+struct ReaderResult {
+	unsigned mReads;
+	unsigned mTorn;
+	unsigned mBackwards;	///< latest record older than one seen before
+};
+
+static void* reader(void* arg)
+{
+	ReaderResult* result = (ReaderResult*)arg;
+	unsigned latest = 0;
+	while (!__atomic_load_n(&sDone,__ATOMIC_ACQUIRE)) {
+		PhysicalRecord record;
+		unsigned age = result->mReads % PhysicalHistory::sDepth;
+		if (!sHistory.read(record,age)) continue;
+		result->mReads++;
+		if (!intact(record)) result->mTorn++;
+		if (age==0) {
+			if (record.mARFCN<latest) result->mBackwards++;
+			latest = record.mARFCN;
+		}
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+
+	// Empty history.
+	PhysicalRecord record;
+	if (sHistory.read(record)) failures++;
+
+	// Readers copy records while the writer replaces them.
+	ReaderResult results[sReaders] = {};
+	Thread readers[sReaders];
+	for (unsigned i=0; i<sReaders; i++) readers[i].start(reader,&results[i]);
+	Thread writerThread;
+	writerThread.start(writer,NULL);
+	writerThread.join();
+	for (unsigned i=0; i<sReaders; i++) {
+		readers[i].join();
+		cout << "reader " << i << ": " << results[i].mReads << " reads, "
+			<< results[i].mTorn << " torn, " << results[i].mBackwards << " backwards" << endl;
+		if (results[i].mTorn || results[i].mBackwards) failures++;
+	}
+
+	// Afterwards, the last sDepth records in order, and nothing older.
+	if (sHistory.written()!=sWrites) failures++;
+	for (unsigned age=0; age<PhysicalHistory::sDepth; age++) {
+		if (!sHistory.read(record,age) || !intact(record) || record.mARFCN!=sWrites-1-age) failures++;
+	}
+	if (sHistory.read(record,PhysicalHistory::sDepth)) failures++;
+
+	cout << "total failures " << failures << endl;
+	return failures ? 1 : 0;
+}
+
+// vim: ts=4 sw=4
@@ -35,11 +35,13 @@
 
 #include <GSML3RRElements.h>
 #include <GSMLogicalChannel.h>
+#include "PhysicalHistory.h"
 
 #include <iostream>
 #include <iomanip>
 #include <math.h>
 #include <string>
+#include <unistd.h>
 
 using namespace std;
 using namespace GSM;
@@ -75,79 +77,123 @@ int PhysicalStatus::open(const char* wPath)
 		LOG(EMERG) << "Cannot create TMSI table";
 		return 1;
 	}
+	mThread.start((void*(*)(void*))PhysicalStatusServiceLoopAdapter,this);
 	return 0;
 }
 
 PhysicalStatus::~PhysicalStatus()
 {
-	if (mDB) sqlite3_close(mDB);
+	ScopedLock lock(mLock);
+	if (!mDB) return;
+	sqlite3_finalize_cached(mDB);
+	sqlite3_close(mDB);
+	mDB = NULL;
 }
 
-bool PhysicalStatus::createEntry(const LogicalChannel* chan)
+void PhysicalStatus::setPhysical(SACCHLogicalChannel* chan,
+								const L3MeasurementResults& measResults)
 {
-	assert(mDB);
 	assert(chan);
 
-	ScopedLock lock(mLock);
-
-	const char* chanString = chan->descriptiveString();
-	LOG(DEBUG) << chan->descriptiveString();
-
-	/* Check to see if the key exists. */
-	if (!sqlite3_exists(mDB, "PHYSTATUS", "CN_TN_TYPE_AND_OFFSET", chanString)) {
-		/* No? Ok, it should now. */
-		char query[500];
-		sprintf(query, "INSERT INTO PHYSTATUS (CN_TN_TYPE_AND_OFFSET, ACCESSED) VALUES "
-					   "(\"%s\", %u)",
-				chanString, (unsigned)time(NULL));
-		return sqlite3_command(mDB, query);
+	PhysicalRecord record;
+	record.mTime = time(NULL);
+	record.mARFCN = chan->ARFCN();
+	record.mResults = measResults;
+	record.mRSSI = chan->RSSI();
+	record.mTimingError = chan->timingError();
+	record.mFER = chan->FER();
+	record.mMSPower = chan->actualMSPower();
+	record.mMSTiming = chan->actualMSTiming();
+
+	PhysicalHistory& history = chan->physical();
+	history.write(record);
+
+	// The first report from a channel hands it to the snapshot thread, for good.
+	// mLock may be held across a whole database transaction, so it is not taken here.
+	if (!history.mListed) {
+		history.mListed = true;
+		ScopedLock lock(mNewLock);
+		Entry entry = { chan, 0 };
+		mNewChannels.push_back(entry);
 	}
-
-	return false;
 }
 
-bool PhysicalStatus::setPhysical(const LogicalChannel* chan,
-								const L3MeasurementResults& measResults)
+void PhysicalStatus::snapshot()
 {
-	// TODO -- It would be better if the argument what just the channel
-	// and the key was just the descriptiveString.
-
-	assert(mDB);
-	assert(chan);
-
 	ScopedLock lock(mLock);
+	if (!mDB) return;
+
+	// Pick up channels that reported for the first time.
+	mNewLock.lock();
+	mChannels.insert(mChannels.end(),mNewChannels.begin(),mNewChannels.end());
+	mNewChannels.clear();
+	mNewLock.unlock();
+
+	// One transaction per snapshot, so the filesystem sees one write however many channels reported.
+	unsigned count = 0;
+	for (unsigned i=0; i<mChannels.size(); i++) {
+		Entry& entry = mChannels[i];
+		const PhysicalHistory& history = entry.mChannel->physical();
+		unsigned written = history.written();
+		if (written==entry.mWritten) continue;
+		PhysicalRecord record;
+		if (!history.read(record)) continue;
+		if (count++==0) sqlite3_command(mDB,"BEGIN TRANSACTION");
+		entry.mWritten = written;
+
+		SQLiteQuery update(mDB,
+			"INSERT OR REPLACE INTO PHYSTATUS ("
+			"RXLEV_FULL_SERVING_CELL, "
+			"RXLEV_SUB_SERVING_CELL, "
+			"RXQUAL_FULL_SERVING_CELL_BER, "
+			"RXQUAL_SUB_SERVING_CELL_BER, "
+			"RSSI, "
+			"TIME_ERR, "
+			"TRANS_PWR, "
+			"TIME_ADVC, "
+			"FER, "
+			"ACCESSED, "
+			"ARFCN, "
+			"CN_TN_TYPE_AND_OFFSET"
+			") VALUES (?,?,?,?,?,?,?,?,?,?,?,?)");
+		const L3MeasurementResults& measResults = record.mResults;
+		update.bind(1,measResults.RXLEV_FULL_SERVING_CELL_dBm());
+		update.bind(2,measResults.RXLEV_SUB_SERVING_CELL_dBm());
+		update.bind(3,(double)measResults.RXQUAL_FULL_SERVING_CELL_BER());
+		update.bind(4,(double)measResults.RXQUAL_SUB_SERVING_CELL_BER());
+		update.bind(5,(double)record.mRSSI);
+		update.bind(6,(double)record.mTimingError);
+		update.bind(7,(unsigned)record.mMSPower);
+		update.bind(8,(unsigned)record.mMSTiming);
+		update.bind(9,(double)record.mFER);
+		update.bind(10,(unsigned)record.mTime);
+		update.bind(11,record.mARFCN);
+		update.bind(12,entry.mChannel->descriptiveString());
+		if (!update.run()) LOG(ERR) << "cannot update physical status for " << entry.mChannel->descriptiveString();
+	}
+	if (count) sqlite3_command(mDB,"COMMIT");
+	LOG(DEBUG) << "physical status snapshot of " << count << " channels";
+}
+
+void PhysicalStatus::serviceLoop()
+{
+	static ConfigKey<long> sPeriod(gConfig,"Control.Reporting.PhysStatusPeriod",10);
+	while (true) {
+		long period = sPeriod.value();
+		// 0 turns the table off; look again for a change now and then.
+		if (period<=0) {
+			sleep(10);
+			continue;
+		}
+		sleep(period);
+		snapshot();
+	}
+}
 
-	createEntry(chan);
-
-	char query[500];
-	sprintf(query,
-		"UPDATE PHYSTATUS SET "
-		"RXLEV_FULL_SERVING_CELL=%d, "
-		"RXLEV_SUB_SERVING_CELL=%d, "
-		"RXQUAL_FULL_SERVING_CELL_BER=%f, "
-		"RXQUAL_SUB_SERVING_CELL_BER=%f, "
-		"RSSI=%f, "
-		"TIME_ERR=%f, "
-		"TRANS_PWR=%u, "
-		"TIME_ADVC=%u, "
-		"FER=%f, "
-		"ACCESSED=%u, "
-		"ARFCN=%u "
-		"WHERE CN_TN_TYPE_AND_OFFSET==\"%s\"",
-		measResults.RXLEV_FULL_SERVING_CELL_dBm(),
-		measResults.RXLEV_SUB_SERVING_CELL_dBm(),
-		measResults.RXQUAL_FULL_SERVING_CELL_BER(),
-		measResults.RXQUAL_SUB_SERVING_CELL_BER(),
-		chan->RSSI(), chan->timingError(),
-		chan->actualMSPower(), chan->actualMSTiming(),
-		chan->FER(),
-		(unsigned)time(NULL),
-		chan->ARFCN(),
-		chan->descriptiveString());
-
-	LOG(DEBUG) << "Query: " << query;
-
-	return sqlite3_command(mDB, query);
+void* GSM::PhysicalStatusServiceLoopAdapter(PhysicalStatus* status)
+{
+	status->serviceLoop();
+	return NULL;
 }
 
 #if 0
@@ -30,6 +30,7 @@
 #define PHYSICALSTATUS_H
 
 #include <map>
+#include <vector>
 
 #include <Timeval.h>
 #include <Threads.h>
@@ -42,19 +43,43 @@ namespace GSM {
 
 class L3MeasurementResults;
 class LogicalChannel;
+class SACCHLogicalChannel;
 
 /**
 	A table for tracking the state of channels.
+	Measurement reports are kept in memory, in each SACCH's PhysicalHistory,
+	and copied to the sqlite table periodically by a background thread,
+	so the SACCH service never waits on the database.
 */
 class PhysicalStatus {
 
 private:
 
-	Mutex mLock;		///< to reduce the load on the filesystem locking
+	Mutex mLock;		///< protects the database and mChannels
+	Mutex mNewLock;		///< protects mNewChannels only, never held across a database call
 	sqlite3 *mDB;		///< database connection
 
+	/** A channel that has reported, and how far its history has been copied to the table. */
+	struct Entry {
+		const SACCHLogicalChannel* mChannel;
+		unsigned mWritten;		///< history record count at the last snapshot
+	};
+
+	std::vector<Entry> mChannels;		///< channels being snapshotted, owned by the snapshot thread
+	std::vector<Entry> mNewChannels;	///< channels that first reported since the last snapshot
+	Thread mThread;
+
+	/** Write the latest record of every channel that reported since the last snapshot. */
+	void snapshot();
+
+	void serviceLoop();
+
+	friend void* PhysicalStatusServiceLoopAdapter(PhysicalStatus*);
+
 public:
 
+	PhysicalStatus():mDB(NULL) {}
+
 	/**
 		Initialize a physical status reporting table.
 		@param path Path fto sqlite3 database file.
@@ -65,12 +90,12 @@ public:
 	~PhysicalStatus();
 
 	/** 
-		Add reporting information associated with a channel to the table.
+		Add a measurement report, with the channel's current uplink figures, to the channel's history.
+		Called only from the channel's SACCH service; never touches the database.
 		@param chan The channel to report.
 		@param measResults The measurement report.
-		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
 	*/
-	bool setPhysical(const LogicalChannel* chan, const L3MeasurementResults& measResults);
+	void setPhysical(SACCHLogicalChannel* chan, const L3MeasurementResults& measResults);
 
 	/**
 		Dump the physical status table to the output stream.
@@ -78,17 +103,10 @@ public:
 	*/
 //	void dump(std::ostream& os) const;
 
-	private:
-
-	/** 
-		Create entry in table. This is for the initial creation.
-		@param chan The channel to create an entry for.
-		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
-	*/
-	bool createEntry(const LogicalChannel* chan);
+};
 
 
-};
+void* PhysicalStatusServiceLoopAdapter(PhysicalStatus*);
 
 
 }
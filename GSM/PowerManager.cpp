@@ -37,8 +37,8 @@ using namespace GSM;
 
 void PowerManager::increasePower()
 {
-	int maxAtten = gConfig.getNum("GSM.Radio.PowerManager.MaxAttenDB");
-	int minAtten = gConfig.getNum("GSM.Radio.PowerManager.MinAttenDB");
+	int maxAtten = mMaxAtten.value();
+	int minAtten = mMinAtten.value();
 	if (mAtten==minAtten) {
 		LOG(DEBUG) << "power already at maximum";
 		return;
@@ -52,8 +52,8 @@ void PowerManager::increasePower()
 
 void PowerManager::reducePower()
 {
-	int maxAtten = gConfig.getNum("GSM.Radio.PowerManager.MaxAttenDB");
-	int minAtten = gConfig.getNum("GSM.Radio.PowerManager.MinAttenDB");
+	int maxAtten = mMaxAtten.value();
+	int minAtten = mMinAtten.value();
 	if (mAtten==maxAtten) {
 		LOG(DEBUG) << "power already at minimum";
 		return;
@@ -69,7 +69,7 @@ void PowerManager::reducePower()
 // internal method, does the control step
 void PowerManager::internalControlStep()
 {
-	unsigned target = gConfig.getNum("GSM.Radio.PowerManager.TargetT3122");
+	unsigned target = mTargetT3122.value();
 	LOG(DEBUG) << "Avg T3122 " << mAveragedT3122 << ", target " << target;
 	// Adapt the power.
 	if (mAveragedT3122 > target) reducePower();
@@ -81,7 +81,7 @@ void PowerManager::sampleT3122()
 {
 	// Tweak it down a little just in case there's no activity.
 	mSamples[mNextSampleIndex] = gBTS.shrinkT3122();
-	unsigned numSamples = gConfig.getNum("GSM.Radio.PowerManager.NumSamples");
+	unsigned numSamples = this->numSamples();
 	mNextSampleIndex = (mNextSampleIndex + 1) % numSamples;
 	long sum = 0;
 	for (unsigned i=0; i<numSamples; i++) sum += mSamples[i];
@@ -89,13 +89,32 @@ void PowerManager::sampleT3122()
 }
 
 
+unsigned PowerManager::numSamples()
+{
+	long numSamples = mNumSamples.value();
+	// Complain once per configuration change, not once per sample.
+	bool changed = mNumSamples.changed(mNumSamplesVersion);
+	if (numSamples<1 || numSamples>=100) {
+		if (changed) LOG(ALERT) << "GSM.Radio.PowerManager.NumSamples=" << numSamples << " is out of range, using 10";
+		numSamples = 10;
+	}
+	return numSamples;
+}
+
+
 PowerManager::PowerManager()
-	: mAveragedT3122(gConfig.getNum("GSM.Radio.PowerManager.TargetT3122"))
-	, mAtten(gConfig.getNum("GSM.Radio.PowerManager.MaxAttenDB"))
-	, mNextSampleIndex(0)
+	: mNextSampleIndex(0),
+	mNumSamplesVersion(0),
+	mMaxAtten(gConfig,"GSM.Radio.PowerManager.MaxAttenDB",10),
+	mMinAtten(gConfig,"GSM.Radio.PowerManager.MinAttenDB",0),
+	mTargetT3122(gConfig,"GSM.Radio.PowerManager.TargetT3122",5000),
+	mNumSamples(gConfig,"GSM.Radio.PowerManager.NumSamples",10),
+	mSamplePeriod(gConfig,"GSM.Radio.PowerManager.SamplePeriod",2000),
+	mPeriod(gConfig,"GSM.Radio.PowerManager.Period",6000)
 {
+	mAveragedT3122 = mTargetT3122.value();
+	mAtten = mMaxAtten.value();
 	// We don't actually set any power here, since the radio may not exist yet.
-	assert(gConfig.getNum("GSM.Radio.PowerManager.NumSamples")<100);
 	bzero(mSamples,sizeof(mSamples));
 	LOG(INFO) << "setting initial power to -" << mAtten << " dB";
 }
@@ -106,9 +125,9 @@ PowerManager::PowerManager()
 void PowerManager::serviceLoop()
 {
 	while (1) {
-		usleep(1000*gConfig.getNum("GSM.Radio.PowerManager.SamplePeriod"));
+		usleep(1000*mSamplePeriod.value());
 		sampleT3122();
-		if (mLast.elapsed() < gConfig.getNum("GSM.Radio.PowerManager.Period")) continue;
+		if (mLast.elapsed() < mPeriod.value()) continue;
 		internalControlStep();
 		mLast.now();
 	}
@@ -29,6 +29,7 @@
 
 #include <Timeval.h>
 #include <Threads.h>
+#include <Configuration.h>
 
 // forward declaration
 //class Timeval;
@@ -53,6 +54,19 @@ private:
 	unsigned mSamples[100];
 	unsigned  mNextSampleIndex;
 
+	/**@name GSM.Radio.PowerManager.* parameters. */
+	//@{
+	ConfigKey<long> mMaxAtten;
+	ConfigKey<long> mMinAtten;
+	ConfigKey<long> mTargetT3122;
+	ConfigKey<long> mNumSamples;
+	ConfigKey<long> mSamplePeriod;
+	ConfigKey<long> mPeriod;
+	//@}
+	unsigned mNumSamplesVersion;	///< last mNumSamples version checked by numSamples()
+
+	/** NumSamples, clamped to the size of mSamples. */
+	unsigned numSamples();
 
 
 	void increasePower();
@@ -0,0 +1,173 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TimeslotManager.h"
+#include "GSMConfig.h"
+#include "GSMLogicalChannel.h"
+#include <TRXManager.h>
+#include <Logger.h>
+#include <Reporting.h>
+#include <Globals.h>
+
+
+using namespace GSM;
+
+
+
+bool TimeslotManager::enabled()
+{
+	return gConfig.getNum("GSM.Channels.Dynamic",0)!=0;
+}
+
+
+void TimeslotManager::addSlot(ARFCNManager* radio, unsigned CN, unsigned TN, unsigned combination)
+{
+	LOG_ASSERT(combination==1 || combination==7);
+	LOG(NOTICE) << "Configuring dynamic combination " << combination << " on C" << CN << "T" << TN;
+	Slot* slot = new Slot;
+	slot->mRadio = radio;
+	slot->mCN = CN;
+	slot->mTN = TN;
+	slot->mCombination = combination;
+
+	// Build the parked set first, so that its decoders are off the radio
+	// before the set in service installs its own on the same frames.
+	bool tchInService = (combination==1);
+	if (!tchInService) {
+		slot->mTCH = gBTS.createTCHF(radio,CN,TN);
+		slot->mTCH->inService(false);
+		slot->mTCH->detach(radio);
+	} else {
+		for (unsigned i=0; i<8; i++) {
+			slot->mSDCCH[i] = gBTS.createSDCCH8(radio,CN,TN,i);
+			slot->mSDCCH[i]->inService(false);
+			slot->mSDCCH[i]->detach(radio);
+		}
+	}
+	radio->setSlot(TN,combination);
+	if (tchInService) slot->mTCH = gBTS.createTCHF(radio,CN,TN);
+	else for (unsigned i=0; i<8; i++) slot->mSDCCH[i] = gBTS.createSDCCH8(radio,CN,TN,i);
+
+	gBTS.addTCH(slot->mTCH);
+	for (unsigned i=0; i<8; i++) gBTS.addSDCCH(slot->mSDCCH[i]);
+	mSlots.push_back(slot);
+}
+
+
+bool TimeslotManager::convert(Slot& slot)
+{
+	LogicalChannel* tch[1] = { slot.mTCH };
+	LogicalChannel* sdcch[8];
+	for (unsigned i=0; i<8; i++) sdcch[i] = slot.mSDCCH[i];
+
+	unsigned newCombination = (slot.mCombination==1) ? 7 : 1;
+	LogicalChannel** from = (slot.mCombination==1) ? tch : sdcch;
+	LogicalChannel** to = (slot.mCombination==1) ? sdcch : tch;
+	unsigned fromCount = (slot.mCombination==1) ? 1 : 8;
+	unsigned toCount = (slot.mCombination==1) ? 8 : 1;
+
+	// This fails, and changes nothing, if any channel was allocated since the last look.
+	if (!gBTS.removeFromService(from,fromCount)) return false;
+
+	ARFCNManager* radio = slot.mRadio;
+	for (unsigned i=0; i<fromCount; i++) from[i]->detach(radio);
+	radio->setSlot(slot.mTN,newCombination);
+	for (unsigned i=0; i<toCount; i++) to[i]->reattach(radio);
+	gBTS.returnToService(to,toCount);
+
+	LOG(NOTICE) << "C" << slot.mCN << "T" << slot.mTN << " changed from combination "
+		<< slot.mCombination << " to " << newCombination;
+	gReports.incr("OpenBTS.GSM.RR.TimeslotReconfigured");
+	slot.mCombination = newCombination;
+	slot.mLastChange.now();
+	return true;
+}
+
+
+bool TimeslotManager::convertOne(unsigned fromCombination)
+{
+	static ConfigKey<long> sHoldTime(gConfig,"GSM.Channels.Dynamic.HoldTime",30);
+	long holdMs = 1000*sHoldTime.value();
+	for (unsigned i=0; i<mSlots.size(); i++) {
+		Slot& slot = *mSlots[i];
+		if (slot.mCombination!=fromCombination) continue;
+		if (slot.mLastChange.elapsed()<holdMs) continue;
+		if (convert(slot)) return true;
+	}
+	return false;
+}
+
+
+void TimeslotManager::controlStep()
+{
+	static ConfigKey<long> sSDCCHLow(gConfig,"GSM.Channels.Dynamic.SDCCHLow",2);
+	static ConfigKey<long> sTCHLow(gConfig,"GSM.Channels.Dynamic.TCHLow",1);
+	long SDCCHLow = sSDCCHLow.value();
+	long TCHLow = sTCHLow.value();
+
+	long SDCCHFree = gBTS.SDCCHAvailable();
+	long TCHFree = gBTS.TCHAvailable();
+	long backlog = gBTS.channelRequestBacklog();
+	LOG(DEBUG) << "SDCCH free " << SDCCHFree << ", TCH free " << TCHFree << ", channel requests waiting " << backlog;
+
+	// Each conversion must leave the other pool above its own threshold,
+	// or the next step would just convert the slot back.
+	bool SDCCHShort = (SDCCHFree<=SDCCHLow) || (backlog>SDCCHFree);
+	bool TCHShort = (TCHFree<=TCHLow);
+	if (SDCCHShort && (TCHFree-1>TCHLow)) {
+		if (convertOne(1)) return;
+	}
+	if (TCHShort && !SDCCHShort && (SDCCHFree-8>SDCCHLow)) {
+		convertOne(7);
+	}
+}
+
+
+void TimeslotManager::serviceLoop()
+{
+	static ConfigKey<long> sPeriod(gConfig,"GSM.Channels.Dynamic.Period",1000);
+	while (true) {
+		usleep(1000*sPeriod.value());
+		controlStep();
+	}
+}
+
+
+void* GSM::TimeslotManagerServiceLoopAdapter(TimeslotManager* manager)
+{
+	manager->serviceLoop();
+	return NULL;
+}
+
+
+void TimeslotManager::start()
+{
+	if (mSlots.size()==0) return;
+	LOG(INFO) << "managing " << mSlots.size() << " dynamic timeslots";
+	mThread.start((void*(*)(void*))TimeslotManagerServiceLoopAdapter,this);
+}
+
+
+// vim: ts=4 sw=4
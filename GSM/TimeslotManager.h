@@ -0,0 +1,108 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef TIMESLOTMANAGER_H
+#define TIMESLOTMANAGER_H
+
+#include <vector>
+#include <Timeval.h>
+#include <Threads.h>
+
+
+class ARFCNManager;
+
+
+namespace GSM {
+
+
+class LogicalChannel;
+class SDCCHLogicalChannel;
+class TCHFACCHLogicalChannel;
+
+
+/**
+	Moves idle timeslots between combination I (one TCH/F) and combination VII (eight SDCCHs)
+	to follow the load.
+	Each dynamic slot carries both channel sets for its whole life, since logical channels
+	and their dispatcher threads are never destroyed; only one set is in service at a time
+	and only its decoders are installed on the radio.
+*/
+class TimeslotManager {
+
+	private:
+
+	/** One reconfigurable timeslot. */
+	struct Slot {
+		ARFCNManager* mRadio;
+		unsigned mCN;
+		unsigned mTN;
+		unsigned mCombination;				///< 1 or 7, the set in service
+		TCHFACCHLogicalChannel* mTCH;
+		SDCCHLogicalChannel* mSDCCH[8];
+		Timeval mLastChange;
+	};
+
+	std::vector<Slot*> mSlots;				///< fixed after start()
+	Thread mThread;
+
+	/** Convert an idle slot to the other combination; return false if any of its channels is busy. */
+	bool convert(Slot& slot);
+
+	/** Convert one slot with the given combination, if one has been idle long enough. */
+	bool convertOne(unsigned fromCombination);
+
+	/** Compare channel availability to the thresholds and convert at most one slot. */
+	void controlStep();
+
+	void serviceLoop();
+
+	public:
+
+	/** True if GSMConfig should hand C-I and C-VII slots to this manager.  Static. */
+	static bool enabled();
+
+	/**
+		Create both channel sets for a slot and put one in service.
+		Call only during startup, before start().
+		@param combination 1 or 7, the initial channel combination.
+	*/
+	void addSlot(ARFCNManager* radio, unsigned CN, unsigned TN, unsigned combination);
+
+	/** Start the control loop, if there are any dynamic slots. */
+	void start();
+
+	friend void* TimeslotManagerServiceLoopAdapter(TimeslotManager*);
+};
+
+
+void* TimeslotManagerServiceLoopAdapter(TimeslotManager*);
+
+
+}	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
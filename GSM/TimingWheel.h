@@ -0,0 +1,283 @@
+/**@file Frame-number timing wheel for burst scheduling. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include "GSMCommon.h"
+#include <LinkedLists.h>
+#include <queue>
+#include <vector>
+
+
+namespace GSM {
+
+
+/**
+	A time-ordered interthread queue of bursts, a drop-in for InterthreadPriorityQueue.
+	Bursts within FRAMES frames of the wheel's base time go into a slot indexed by (FN mod FRAMES, TN),
+	so writes and deadline-driven reads are O(1).
+	Bursts outside the window, behind it or too far ahead, go into a heap; that is the rare path.
+	TimeOf is a functor returning the Time of a T*.
+	FRAMES should divide gHyperframe.
+*/
+template <class T, class TimeOf, unsigned FRAMES=64> class TimingWheel {
+
+	protected:
+
+	/** Heap ordering for the out-of-window bursts, earliest on top. */
+	class Later {
+		public:
+		bool operator()(const T* v1, const T* v2) const
+			{ return TimeOf()(v1) > TimeOf()(v2); }
+	};
+
+	PointerFIFO mSlots[FRAMES*8];		///< the wheel, indexed by slot()
+	std::priority_queue<T*,std::vector<T*>,Later> mOutside;	///< bursts outside the wheel's window
+	Time mBase;					///< earliest time the wheel can hold
+	bool mBaseValid;			///< false until the first write or deadline
+	unsigned mInWheel;			///< number of bursts in mSlots
+	Time mDeadline;				///< most recent deadline given by the reader
+	bool mDeadlineValid;
+	unsigned mLateCount;		///< bursts written after their deadline had passed
+	unsigned mStaleCount;		///< bursts returned by getStaleBurst
+
+	mutable Mutex mLock;
+	mutable Signal mWriteSignal;
+
+	/** Offset of a time from the base, in timeslots. */
+	int slotDelta(const Time& t) const
+		{ return FNDelta(t.FN(),mBase.FN())*8 + (int)t.TN() - (int)mBase.TN(); }
+
+	bool inWindow(const Time& t) const
+	{
+		int delta = slotDelta(t);
+		return (delta>=0) && (delta<(int)(FRAMES*8));
+	}
+
+	PointerFIFO& slot(const Time& t)
+		{ return mSlots[(t.FN() % FRAMES)*8 + t.TN()]; }
+
+	/** Add a burst; caller holds mLock. */
+	void insert(T* val)
+	{
+		Time when = TimeOf()(val);
+		if (mDeadlineValid && (when<mDeadline)) mLateCount++;
+		// An empty wheel can be re-based anywhere.
+		if (!mBaseValid || (mInWheel==0 && mOutside.size()==0)) {
+			mBase = when;
+			mBaseValid = true;
+		}
+		if (inWindow(when)) {
+			slot(when).put(val);
+			mInWheel++;
+		} else {
+			mOutside.push(val);
+		}
+	}
+
+	/** Move heap entries that now fall in the window into the wheel; caller holds mLock. */
+	void migrate()
+	{
+		while (mOutside.size()>0) {
+			T* val = mOutside.top();
+			Time when = TimeOf()(val);
+			if (!inWindow(when)) break;
+			mOutside.pop();
+			slot(when).put(val);
+			mInWheel++;
+		}
+	}
+
+	/** Remove and return the earliest burst, or NULL; caller holds mLock. */
+	T* popEarliest()
+	{
+		// Skip the base over empty slots; nothing can be written behind it into the wheel.
+		while (mInWheel>0) {
+			PointerFIFO& s = slot(mBase);
+			if (s.size()>0) break;
+			mBase.incTN();
+		}
+		if (mOutside.size()>0) {
+			T* top = mOutside.top();
+			if ((mInWheel==0) || (TimeOf()(top) < mBase)) {
+				mOutside.pop();
+				return top;
+			}
+		}
+		if (mInWheel==0) return NULL;
+		mInWheel--;
+		return (T*)slot(mBase).get();
+	}
+
+	public:
+
+	TimingWheel()
+		:mBaseValid(false),mInWheel(0),
+		mDeadlineValid(false),
+		mLateCount(0),mStaleCount(0)
+	{ }
+
+	/** Clear the queue. */
+	void clear()
+	{
+		ScopedLock lock(mLock);
+		while (T* val = popEarliest()) delete val;
+	}
+
+	~TimingWheel()
+	{
+		clear();
+	}
+
+	size_t size() const
+	{
+		ScopedLock lock(mLock);
+		return mInWheel + mOutside.size();
+	}
+
+	/** Number of bursts written after the reader's deadline had already passed them. */
+	unsigned lateCount() const
+	{
+		ScopedLock lock(mLock);
+		return mLateCount;
+	}
+
+	/** Number of bursts dumped as stale by the reader. */
+	unsigned staleCount() const
+	{
+		ScopedLock lock(mLock);
+		return mStaleCount;
+	}
+
+	/** Non-blocking read of the earliest burst. */
+	T* readNoBlock()
+	{
+		ScopedLock lock(mLock);
+		return popEarliest();
+	}
+
+	/** Blocking read of the earliest burst. */
+	T* read()
+	{
+		ScopedLock lock(mLock);
+		while ((mInWheel+mOutside.size())==0) mWriteSignal.wait(mLock);
+		return popEarliest();
+	}
+
+	/** Non-blocking write. */
+	void write(T* val)
+	{
+		ScopedLock lock(mLock);
+		insert(val);
+		mWriteSignal.signal();
+	}
+
+	/** Get the time of the earliest burst.  Blocks if the queue is empty. */
+	Time nextTime() const
+	{
+		ScopedLock lock(mLock);
+		while ((mInWheel+mOutside.size())==0) mWriteSignal.wait(mLock);
+		Time retVal;
+		bool found = false;
+		if (mInWheel>0) {
+			Time when = mBase;
+			for (unsigned i=0; i<FRAMES*8; i++) {
+				if (mSlots[(when.FN() % FRAMES)*8 + when.TN()].size()>0) {
+					retVal = when;
+					found = true;
+					break;
+				}
+				when.incTN();
+			}
+		}
+		if (mOutside.size()>0) {
+			Time top = TimeOf()(mOutside.top());
+			if (!found || (top<retVal)) retVal = top;
+		}
+		return retVal;
+	}
+
+	/**
+		Remove and return a burst whose time is before the deadline, if any.
+		Also advances the wheel to the deadline.
+	*/
+	T* getStaleBurst(const Time& targTime)
+	{
+		ScopedLock lock(mLock);
+		mDeadline = targTime;
+		mDeadlineValid = true;
+		// Skip the base over empty slots, up to the deadline.
+		while ((mInWheel>0) && (mBase<targTime) && (slot(mBase).size()==0)) mBase.incTN();
+		const bool wheelStale = (mInWheel>0) && (mBase<targTime);
+		// Return the earlier of the wheel's and the heap's stale bursts.
+		if (mOutside.size()>0) {
+			Time top = TimeOf()(mOutside.top());
+			if ((top<targTime) && (!wheelStale || (top<mBase))) {
+				T* retVal = mOutside.top();
+				mOutside.pop();
+				mStaleCount++;
+				return retVal;
+			}
+		}
+		if (wheelStale) {
+			mInWheel--;
+			mStaleCount++;
+			return (T*)slot(mBase).get();
+		}
+		if ((mInWheel==0) && (!mBaseValid || (mBase<targTime))) {
+			mBase = targTime;
+			mBaseValid = true;
+		}
+		migrate();
+		return NULL;
+	}
+
+	/** Remove and return a burst scheduled exactly at the given time, if any. */
+	T* getCurrentBurst(const Time& targTime)
+	{
+		ScopedLock lock(mLock);
+		if (mOutside.size()>0 && (TimeOf()(mOutside.top()) == targTime)) {
+			T* retVal = mOutside.top();
+			mOutside.pop();
+			return retVal;
+		}
+		if ((mInWheel==0) || !inWindow(targTime)) return NULL;
+		T* retVal = (T*)slot(targTime).get();
+		if (retVal!=NULL) mInWheel--;
+		return retVal;
+	}
+
+};
+
+
+};		// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
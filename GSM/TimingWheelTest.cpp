@@ -0,0 +1,205 @@
+/*
+* Copyright 2012 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "TimingWheel.h"
+#include <Interthread.h>
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+using namespace GSM;
+
+
+/** A stand-in for a burst, just a time and a serial number. */
+class Burst {
+
+	public:
+
+	Time mTime;
+	unsigned mSerial;
+
+	Burst(const Time& wTime, unsigned wSerial)
+		:mTime(wTime),mSerial(wSerial)
+	{ }
+
+	bool operator>(const Burst& other) const
+		{ return mTime > other.mTime; }
+};
+
+class BurstTime {
+	public:
+	Time operator()(const Burst* burst) const { return burst->mTime; }
+};
+
+typedef TimingWheel<Burst,BurstTime> Wheel;
+
+
+/** The heap-based queue the wheel replaced, as a reference. */
+class ReferenceQueue : public InterthreadPriorityQueue<Burst> {
+
+	public:
+
+	Time nextTime() const
+	{
+		ScopedLock lock(mLock);
+		while (mQ.size()==0) mWriteSignal.wait(mLock);
+		return mQ.top()->mTime;
+	}
+
+	Burst* getStaleBurst(const Time& targTime)
+	{
+		ScopedLock lock(mLock);
+		if (mQ.size()==0) return NULL;
+		if (!(mQ.top()->mTime < targTime)) return NULL;
+		Burst* retVal = mQ.top();
+		mQ.pop();
+		return retVal;
+	}
+
+	Burst* getCurrentBurst(const Time& targTime)
+	{
+		ScopedLock lock(mLock);
+		if (mQ.size()==0) return NULL;
+		if (!(mQ.top()->mTime == targTime)) return NULL;
+		Burst* retVal = mQ.top();
+		mQ.pop();
+		return retVal;
+	}
+};
+
+
+static unsigned failures = 0;
+
+/** Both queues must return bursts with the same time, or both none; the bursts are deleted. */
+static void compare(const char* what, Burst* w, Burst* r)
+{
+	bool same = (w==NULL) ? (r==NULL) : ((r!=NULL) && (w->mTime==r->mTime));
+	if (!same) {
+		failures++;
+		if (failures<10) {
+			cout << what << " mismatch: wheel ";
+			if (w) cout << w->mTime; else cout << "none";
+			cout << ", reference ";
+			if (r) cout << r->mTime; else cout << "none";
+			cout << endl;
+		}
+	}
+	delete w;
+	delete r;
+}
+
+/** Write the same burst to both queues. */
+static void writeBoth(Wheel& wheel, ReferenceQueue& ref, const Time& when, unsigned serial)
+{
+	wheel.write(new Burst(when,serial));
+	ref.write(new Burst(when,serial));
+}
+
+/** Dump everything before the deadline from both queues, as the transceiver does. */
+static unsigned dumpStale(Wheel& wheel, ReferenceQueue& ref, const Time& now)
+{
+	unsigned count = 0;
+	while (true) {
+		Burst* w = wheel.getStaleBurst(now);
+		Burst* r = ref.getStaleBurst(now);
+		bool done = (w==NULL) && (r==NULL);
+		if (!done) count++;
+		compare("stale",w,r);
+		if (done) return count;
+	}
+}
+
+
+/**
+	Drive both queues like the transceiver: each timeslot dump stale bursts
+	and take the current one, with the writer running ahead.
+	@param start The initial time.
+	@param slots Timeslots to run.
+	@param ahead Largest lead of a write, in frames; over 64 spills out of the wheel's window.
+	@param behind Largest lag of a write, in frames, for bursts that arrive already stale.
+*/
+static void run(const char* name, const Time& start, unsigned slots, int ahead, int behind)
+{
+	Wheel wheel;
+	ReferenceQueue ref;
+	Time now = start;
+	unsigned serial = 0;
+	unsigned stale = 0;
+	unsigned current = 0;
+	for (unsigned i=0; i<slots; i++) {
+		// Zero to two writes per timeslot.
+		unsigned writes = random() % 3;
+		for (unsigned j=0; j<writes; j++) {
+			int lead = (int)(random() % (ahead+behind+1)) - behind;
+			Time when = now + lead;
+			when.TN(random() % 8);
+			writeBoth(wheel,ref,when,serial++);
+		}
+		// Now and then the reader falls behind and jumps its deadline.
+		if ((random() % 5000)==0) {
+			int jump = random() % 200;
+			now = now + jump;
+		}
+		if (wheel.size()!=ref.size()) failures++;
+		if (wheel.size()>0 && !(wheel.nextTime()==ref.nextTime())) failures++;
+		stale += dumpStale(wheel,ref,now);
+		Burst* w = wheel.getCurrentBurst(now);
+		if (w) current++;
+		compare("current",w,ref.getCurrentBurst(now));
+		now.incTN();
+	}
+	// Drain what is left, in order.
+	unsigned left = ref.size();
+	for (unsigned i=0; i<left; i++) compare("drain",wheel.readNoBlock(),ref.readNoBlock());
+	if (wheel.size()!=0) failures++;
+	cout << name << ": " << serial << " written, " << current << " current, "
+		<< stale << " stale, " << wheel.staleCount() << " stale in wheel, "
+		<< wheel.lateCount() << " late" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+	srandom(1);
+
+	// Writes inside the window.
+	run("in window",Time(1000,0),100000,40,0);
+
+	// Writes far ahead go to the heap and migrate into the wheel.
+	run("overflow",Time(1000,0),100000,300,0);
+
+	// Writes behind the deadline are dumped as stale.
+	run("stale",Time(1000,0),100000,40,10);
+
+	// All of it, across the hyperframe wrap.
+	run("wrap",Time(gHyperframe-2000,0),100000,300,10);
+
+	cout << "failures " << failures << endl;
+	return failures ? 1 : 0;
+}
+
+// vim: ts=4 sw=4
@@ -43,6 +43,7 @@
 #include <GSMCommon.h>
 #include <GSMLogicalChannel.h>
 #include <Reporting.h>
+#include <Metrics.h>
 #include <Globals.h>
 
 #include "SIPInterface.h"
@@ -57,6 +58,15 @@ using namespace std;
 using namespace SIP;
 using namespace Control;
 
+
+/**@name SIP transaction latency, from first transmission to final response. */
+//@{
+static MetricHistogram gREGISTERLatency("openbts_sip_transaction_latency_microseconds","method=\"REGISTER\"",
+	"Time from sending a SIP request to its final response.");
+static MetricHistogram gINVITELatency("openbts_sip_transaction_latency_microseconds","method=\"INVITE\"",
+	"Time from sending a SIP request to its final response.");
+//@}
+
 int get_rtp_tev_type(char dtmf){
         switch (dtmf){
                 case '1': return TEV_DTMF_1;
@@ -133,7 +143,7 @@ SIPEngine::SIPEngine(const char* proxy, const char* IMSI)
 	mSIPPort(gConfig.getNum("SIP.Local.Port")),
 	mSIPIP(gConfig.getStr("SIP.Local.IP")),
 	mINVITE(NULL), mLastResponse(NULL), mBYE(NULL),
-	mCANCEL(NULL), mERROR(NULL), mSession(NULL), 
+	mCANCEL(NULL), mERROR(NULL), mINVITETime(0), mSession(NULL), 
 	mTxTime(0), mRxTime(0), mState(NullState), mInstigator(false),
 	mDTMF('\0'),mDTMFDuration(0)
 {
@@ -366,6 +376,8 @@ bool SIPEngine::Register( Method wMethod )
 	gReports.incr("OpenBTS.SIP.REGISTER.Out");
  
 	LOG(DEBUG) << "writing registration " << reg;
+	// Latency is measured from the first transmission, so retransmissions count against it.
+	uint64_t sent = metricsClock();
 	gSIPInterface.write(&mProxyAddr,reg);	
 
 	bool success = false;
@@ -386,6 +398,7 @@ bool SIPEngine::Register( Method wMethod )
 		assert(msg);
 		int status = msg->status_code;
 		LOG(INFO) << "received status " << msg->status_code << " " << msg->reason_phrase;
+		if (status>=200) gREGISTERLatency.record(metricsClock()-sent);
 		// specific status
 		if (status==200) {
 			LOG(INFO) << "REGISTER success";
@@ -497,6 +510,7 @@ SIPState SIPEngine::SOSSendINVITE(short wRtp_port, unsigned  wCodec, const GSM::
 	}
 	
 	// Send Invite to Asterisk.
+	mINVITETime = metricsClock();
 	gSIPInterface.write(&mProxyAddr,invite);
 	saveINVITE(invite,true);
 	osip_message_free(invite);
@@ -538,6 +552,7 @@ SIPState SIPEngine::MOCSendINVITE( const char * wCalledUsername,
 	writePrivateHeaders(invite,chan);
 	
 	// Send Invite.
+	mINVITETime = metricsClock();
 	gSIPInterface.write(&mProxyAddr,invite);
 	saveINVITE(invite,true);
 	osip_message_free(invite);
@@ -581,6 +596,10 @@ SIPState  SIPEngine::MOCCheckForOK(Mutex *lock)
 	int status = msg->status_code;
 	LOG(DEBUG) << "received status " << status;
 	saveResponse(msg);
+	if (status>=200 && mINVITETime) {
+		gINVITELatency.record(metricsClock()-mINVITETime);
+		mINVITETime = 0;
+	}
 	switch (status) {
 		// class 1XX: Provisional messages
 		case 100:	// Trying
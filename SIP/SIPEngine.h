@@ -124,6 +124,7 @@ private:
 	osip_message_t * mBYE;		///< the BYE message for this transaction
 	osip_message_t * mCANCEL;	///< the CANCEL message for this transaction
 	osip_message_t * mERROR;	///< the ERROR message for this transaction
+	uint64_t mINVITETime;		///< metricsClock() when our INVITE was sent, 0 once answered
 	//@}
 
 	/**@name RTP state and parameters. */
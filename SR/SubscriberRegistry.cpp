@@ -30,6 +30,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include "sqlite3.h"
+#include <sqlite3util.h>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -181,7 +182,9 @@ int SubscriberRegistry::init()
 
 SubscriberRegistry::~SubscriberRegistry()
 {
-	if (mDB) sqlite3_close(mDB);
+	if (!mDB) return;
+	sqlite3_finalize_cached(mDB);
+	sqlite3_close(mDB);
 }
 
 
@@ -222,16 +225,13 @@ SubscriberRegistry::Status SubscriberRegistry::sqlLocal(const char* query, char
 string SubscriberRegistry::sqlQuery(string unknownColumn, string table, string knownColumn, string knownValue)
 {
 	char *result = NULL;
-	SubscriberRegistry::Status st;
-	ostringstream os;
-	os << "select " << unknownColumn << " from " << table << " where " << knownColumn << " = \"" << knownValue << "\"";
-	st = sqlLocal(os.str().c_str(), &result);
-	if ((st == SUCCESS) && result) {
-		LOG(INFO) << "result = " << result;
-		return result;
-	} else {
-		return "";
-	}
+	LOG(INFO) << "select " << unknownColumn << " from " << table << " where " << knownColumn << " = " << knownValue;
+	if (!sqlite3_single_lookup(db(),table.c_str(),knownColumn.c_str(),knownValue.c_str(),unknownColumn.c_str(),result)) return "";
+	if (!result) return "";
+	LOG(INFO) << "result = " << result;
+	string retVal(result);
+	free(result);
+	return retVal;
 }
 
 
@@ -251,9 +251,14 @@ string SubscriberRegistry::imsiGet(string imsi, string key)
 SubscriberRegistry::Status SubscriberRegistry::imsiSet(string imsi, string key, string value)
 {
 	string name = imsi.substr(0,4) == "IMSI" ? imsi : "IMSI" + imsi;
-	ostringstream os;
-	os << "update sip_buddies set " << key << " = \"" << value << "\" where name = \"" << name << "\"";
-	return sqlUpdate(os.str());
+	// The column name is part of the template; the values are bound.
+	string query = "update sip_buddies set " + key + " = ? where name = ?";
+	LOG(INFO) << query << " " << value << " " << name;
+	SQLiteQuery update(db(),query.c_str());
+	if (!update.valid()) return FAILURE;
+	update.bind(1,value.c_str());
+	update.bind(2,name.c_str());
+	return update.run() ? SUCCESS : FAILURE;
 }
 
 string SubscriberRegistry::getIMSI(string ISDN)
@@ -310,10 +315,10 @@ SubscriberRegistry::Status SubscriberRegistry::setRegTime(string IMSI)
 		LOG(WARNING) << "SubscriberRegistry::setRegTime attempting set for NULL IMSI";
 		return FAILURE;
 	}
-	unsigned now = (unsigned)time(NULL);
-	ostringstream os;
-	os << "update sip_buddies set regTime = " << now  << " where name = " << '"' << IMSI << '"';
-	return sqlUpdate(os.str());
+	SQLiteQuery update(db(),"update sip_buddies set regTime = ? where name = ?");
+	update.bind(1,(unsigned)time(NULL));
+	update.bind(2,IMSI.c_str());
+	return update.run() ? SUCCESS : FAILURE;
 }
 
 
@@ -334,37 +339,16 @@ SubscriberRegistry::Status SubscriberRegistry::addUser(string IMSI, string CLID)
 		return SUCCESS;
 	}
 	LOG(INFO) << "addUser(" << IMSI << "," << CLID << ")";
-	ostringstream os;
-	os << "insert into sip_buddies (name, username, type, context, host, callerid, canreinvite, allow, dtmfmode, ipaddr) values (";
-	os << "\"" << IMSI << "\"";
-	os << ",";
-	os << "\"" << IMSI << "\"";
-	os << ",";
-	os << "\"" << "friend" << "\"";
-	os << ",";
-	os << "\"" << "phones" << "\"";
-	os << ",";
-	os << "\"" << "dynamic" << "\"";
-	os << ",";
-	os << "\"" << CLID << "\"";
-	os << ",";
-	os << "\"" << "no" << "\"";
-	os << ",";
-	os << "\"" << "gsm" << "\"";
-	os << ",";
-	os << "\"" << "info" << "\"";
-	os << ",";
-	os << "\"" << "127.0.0.1" << "\"";
-	os << ")";
-	os << ";";
-	SubscriberRegistry::Status st = sqlUpdate(os.str());
-	ostringstream os2;
-	os2 << "insert into dialdata_table (exten, dial) values (";
-	os2 << "\"" << CLID << "\"";
-	os2 << ",";
-	os2 << "\"" << IMSI << "\"";
-	os2 << ")";
-	SubscriberRegistry::Status st2 = sqlUpdate(os2.str());
+	SQLiteQuery buddy(db(),
+		"insert into sip_buddies (name, username, type, context, host, callerid, canreinvite, allow, dtmfmode, ipaddr) "
+		"values (?1,?1,'friend','phones','dynamic',?2,'no','gsm','info','127.0.0.1')");
+	buddy.bind(1,IMSI.c_str());
+	buddy.bind(2,CLID.c_str());
+	SubscriberRegistry::Status st = buddy.run() ? SUCCESS : FAILURE;
+	SQLiteQuery dial(db(),"insert into dialdata_table (exten, dial) values (?,?)");
+	dial.bind(1,CLID.c_str());
+	dial.bind(2,IMSI.c_str());
+	SubscriberRegistry::Status st2 = dial.run() ? SUCCESS : FAILURE;
 	return st == SUCCESS && st2 == SUCCESS ? SUCCESS : FAILURE;
 }
 
@@ -383,16 +367,13 @@ string SubscriberRegistry::mapCLIDGlobal(string local)
 }
 
 SubscriberRegistry::Status SubscriberRegistry::RRLPUpdate(string name, string lat, string lon, string err){
-	ostringstream os;
-	os << "insert into RRLP (name, latitude, longitude, error, time) values (" <<
-	  '"' << name << '"' << "," <<
-	  lat << "," <<
-	  lon << "," <<
-	  err << "," <<
-	  "datetime('now')"
-	  ")";
-	LOG(INFO) << os.str();
-	return sqlUpdate(os.str());
+	LOG(INFO) << "RRLP " << name << " " << lat << " " << lon << " " << err;
+	SQLiteQuery insert(db(),"insert into RRLP (name, latitude, longitude, error, time) values (?,?,?,?,datetime('now'))");
+	insert.bind(1,name.c_str());
+	insert.bind(2,lat.c_str());
+	insert.bind(3,lon.c_str());
+	insert.bind(4,err.c_str());
+	return insert.run() ? SUCCESS : FAILURE;
 }
 
 bool SubscriberRegistry::useGateway(string ISDN)
@@ -37,6 +37,8 @@
 
 #include <string>
 #include <string.h>
+#include <sched.h>
+#include <unistd.h>
 #include <stdlib.h>
 
 #undef WARNING
@@ -49,7 +51,11 @@ using namespace std;
 TransceiverManager::TransceiverManager(int numARFCNs,
 		const char* wTRXAddress, int wBasePort)
 	:mHaveClock(false),
-	mClockSocket(wBasePort+100)
+	mClockSocket(wBasePort+100),
+	mDownlinkLead(gConfig.getNum("TRX.DownlinkLead",1)),
+	mNextDownlinkFN(-1),
+	mSlotDecoderDepth("openbts_queue_depth","queue=\"slot_decoder\"",
+		"Entries waiting in an interthread queue.",sampleSlotDecoderDepth,this)
 {
 	// set up the ARFCN managers
 	for (int i=0; i<numARFCNs; i++) {
@@ -60,12 +66,25 @@ TransceiverManager::TransceiverManager(int numARFCNs,
 
 
 
+long TransceiverManager::sampleSlotDecoderDepth(void* trx)
+{
+	TransceiverManager* manager = (TransceiverManager*)trx;
+	long count = 0;
+	for (unsigned i=0; i<manager->mARFCNs.size(); i++) count += manager->mARFCNs[i]->decoderBacklog();
+	return count;
+}
+
+
+
 void TransceiverManager::start()
 {
 	mClockThread.start((void*(*)(void*))ClockLoopAdapter,this);
+	// The uplink threads are shared by all ARFCNs, so they don't grow with the ARFCN count.
+	mReactor.start(gConfig.getNum("TRX.IOThreads",2));
 	for (unsigned i=0; i<mARFCNs.size(); i++) {
 		mARFCNs[i]->start();
 	}
+	mDownlinkThread.start((void*(*)(void*))DownlinkLoopAdapter,this);
 }
 
 
@@ -83,6 +102,46 @@ void* ClockLoopAdapter(TransceiverManager *transceiver)
 
 
 
+void* DownlinkLoopAdapter(TransceiverManager *transceiver)
+{
+	while (1) {
+		transceiver->downlinkHandler();
+	}
+	return NULL;
+}
+
+
+
+void TransceiverManager::downlinkHandler()
+{
+	// Nothing to pace against until the transceiver sets the clock.
+	if (!mHaveClock) {
+		usleep(gFrameMicroseconds);
+		return;
+	}
+
+	// Send every frame up to the lead ahead of the clock.
+	int32_t last = (gBTS.clock().FN() + mDownlinkLead) % gHyperframe;
+	// Start over after a clock jump or a stall; late frames are useless.
+	if (mNextDownlinkFN<0) mNextDownlinkFN = last;
+	int32_t behind = FNDelta(last,mNextDownlinkFN);
+	if (behind<-1 || behind>26) {
+		LOG(NOTICE) << "downlink scheduler resync from frame " << mNextDownlinkFN << " to " << last;
+		mNextDownlinkFN = last;
+	}
+	while (FNDelta(last,mNextDownlinkFN)>=0) {
+		for (unsigned i=0; i<mARFCNs.size(); i++) {
+			mARFCNs[i]->sendFrame(mNextDownlinkFN);
+		}
+		mNextDownlinkFN = (mNextDownlinkFN+1) % gHyperframe;
+	}
+
+	// Sleep until the next frame comes within the lead.
+	gBTS.clock().wait(Time(mNextDownlinkFN) - mDownlinkLead);
+}
+
+
+
 void TransceiverManager::clockHandler()
 {
 	char buffer[MAX_UDP_LENGTH];
@@ -92,6 +151,7 @@ void TransceiverManager::clockHandler()
 	if (msgLen<0) {
 		LOG(ALERT) << "TRX clock interface timed out, assuming TRX is dead.";
 		gReports.incr("OpenBTS.Exit.Error.TransceiverHeartbeat");
+		gReports.flush();
 		abort();
 	}
 
@@ -130,15 +190,25 @@ unsigned TransceiverManager::C0() const
 ::ARFCNManager::ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTransceiver)
 	:mTransceiver(wTransceiver),
 	mDataSocket(wBasePort+100+1,wTRXAddress,wBasePort+1),
-	mControlSocket(wBasePort+100,wTRXAddress,wBasePort)
+	mControlSocket(wBasePort+100,wTRXAddress,wBasePort),
+	mTableEpoch(0)
 {
 	// The default demux table is full of NULL pointers.
+	mDemuxTable = new DemuxTable;
 	for (int i=0; i<8; i++) {
 		for (unsigned j=0; j<maxModulus; j++) {
-			mDemuxTable[i][j] = NULL;
+			mDemuxTable->mDecoders[i][j] = NULL;
 		}
 		handoverStatus[i] = false;
 	}
+	mTableReaders[0] = 0;
+	mTableReaders[1] = 0;
+	// The downlink frame buffer starts empty.
+	for (unsigned i=0; i<sTxFrames; i++) {
+		for (int j=0; j<8; j++) mTxFN[i][j] = -1;
+	}
+	mTxSentFN = -1;
+	mHasFill = false;
 }
 
 
@@ -146,7 +216,20 @@ unsigned TransceiverManager::C0() const
 
 void ::ARFCNManager::start()
 {
-	mRxThread.start((void*(*)(void*))ReceiveLoopAdapter,this);
+	// C0 sends dummy bursts in idle slots, GSM 05.02 5.2.6.
+	// Format them here, rather than in the constructor, since gDummyBurst is in another module.
+	if (this==mTransceiver.ARFCN(0)) {
+		TxBurst fill(gDummyBurst);
+		for (unsigned TN=0; TN<8; TN++) {
+			fill.time(Time(0,TN));
+			formatBurst(fill,mTxFill[TN]);
+		}
+		mHasFill = true;
+	}
+	for (unsigned TN=0; TN<8; TN++) {
+		gBTS.executor().add(&mSlotDecoders[TN],gBTS.time());
+	}
+	mTransceiver.reactor().add(mDataSocket,ReceiveHandler,this);
 }
 
 
@@ -161,28 +244,59 @@ void ::ARFCNManager::installDecoder(GSM::L1Decoder *wL1d)
 
 	LOG(DEBUG) << "ARFCNManager::installDecoder TN: " << TN << " repeatLength: " << mapping.repeatLength();
 
-	mTableLock.lock();
+	ScopedLock lock(mTableLock);
+	DemuxTable* oldTable = mDemuxTable;
+	DemuxTable* newTable = new DemuxTable(*oldTable);
 	for (unsigned i=0; i<mapping.numFrames(); i++) {
 		unsigned FN = mapping.frameMapping(i);
 		while (FN<maxModulus) {
 			// Don't overwrite existing entries.
-			assert(mDemuxTable[TN][FN]==NULL);
-			mDemuxTable[TN][FN] = wL1d;
+			assert(newTable->mDecoders[TN][FN]==NULL);
+			newTable->mDecoders[TN][FN] = wL1d;
 			FN += mapping.repeatLength();
 		}
 	}
-	mTableLock.unlock();
+	__atomic_store_n(&mDemuxTable,newTable,__ATOMIC_SEQ_CST);
+	synchronizeTable();
+	delete oldTable;
 }
 
 
+void ::ARFCNManager::removeDecoder(GSM::L1Decoder *wL1d)
+{
+	unsigned TN = wL1d->TN();
 
+	LOG(DEBUG) << "ARFCNManager::removeDecoder TN: " << TN;
 
-void ::ARFCNManager::writeHighSide(const GSM::TxBurst& burst)
+	ScopedLock lock(mTableLock);
+	DemuxTable* oldTable = mDemuxTable;
+	DemuxTable* newTable = new DemuxTable(*oldTable);
+	for (unsigned FN=0; FN<maxModulus; FN++) {
+		if (newTable->mDecoders[TN][FN]==wL1d) newTable->mDecoders[TN][FN] = NULL;
+	}
+	__atomic_store_n(&mDemuxTable,newTable,__ATOMIC_SEQ_CST);
+	synchronizeTable();
+	delete oldTable;
+}
+
+
+void ::ARFCNManager::synchronizeTable()
+{
+	// Two flips, as in userspace RCU: a reader that sampled the epoch
+	// before the first flip may have counted itself under either parity.
+	for (unsigned phase=0; phase<2; phase++) {
+		unsigned parity = __atomic_fetch_add(&mTableEpoch,1,__ATOMIC_SEQ_CST) & 1;
+		while (__atomic_load_n(&mTableReaders[parity],__ATOMIC_SEQ_CST)!=0) {
+			sched_yield();
+		}
+	}
+}
+
+
+
+
+void ::ARFCNManager::formatBurst(const GSM::TxBurst& burst, char* buffer)
 {
-	LOG(DEBUG) << "transmit at time " << gBTS.clock().get() << ": " << burst;
-	// format the transmission request message
-	static const int bufferSize = gSlotLen+1+4+1;
-	char buffer[bufferSize];
 	unsigned char *wp = (unsigned char*)buffer;
 	// slot
 	*wp++ = burst.time().TN();
@@ -200,23 +314,88 @@ void ::ARFCNManager::writeHighSide(const GSM::TxBurst& burst)
 	for (unsigned i=0; i<gSlotLen; i++) {
 		*wp++ = (unsigned char)((*dp++) & 0x01);
 	}
-	// write to the socket
-	mDataSocketLock.lock();
-	mDataSocket.write(buffer,bufferSize);
-	mDataSocketLock.unlock();
 }
 
 
 
+void ::ARFCNManager::writeHighSide(const GSM::TxBurst& burst)
+{
+	LOG(DEBUG) << "transmit at time " << gBTS.clock().get() << ": " << burst;
+	int32_t FN = burst.time().FN();
+	unsigned TN = burst.time().TN();
+	ScopedLock lock(mTxLock);
+	if (mTxSentFN>=0) {
+		int32_t ahead = FNDelta(FN,mTxSentFN);
+		if (ahead<=0) {
+			LOG(DEBUG) << "dropping late burst for frame " << FN << ", last frame sent " << mTxSentFN;
+			return;
+		}
+		if (ahead>=(int32_t)sTxFrames) {
+			// Beyond the buffer; send it now and let the transceiver hold it, as before.
+			LOG(INFO) << "burst for frame " << FN << " is " << ahead << " frames ahead, sending directly";
+			char buffer[sTxMessageLen];
+			formatBurst(burst,buffer);
+			ScopedLock socketLock(mDataSocketLock);
+			mDataSocket.write(buffer,sTxMessageLen);
+			return;
+		}
+	}
+	unsigned slot = FN % sTxFrames;
+	formatBurst(burst,mTxMessages[slot][TN]);
+	mTxFN[slot][TN] = FN;
+}
+
 
-void ::ARFCNManager::driveRx()
+
+void ::ARFCNManager::sendFrame(int32_t FN)
 {
-	// read the message
-	char buffer[MAX_UDP_LENGTH];
-	int msgLen = mDataSocket.read(buffer);
-	if (msgLen<=0) SOCKET_ERROR;
+	const char* messages[8];
+	size_t lengths[8];
+	unsigned count = 0;
+	unsigned slot = FN % sTxFrames;
+
+	mTxLock.lock();
+	for (unsigned TN=0; TN<8; TN++) {
+		char* message;
+		if (mTxFN[slot][TN]==FN) {
+			message = mTxMessages[slot][TN];
+		} else if (mHasFill) {
+			// Only this thread touches the fill, so just patch in the frame number.
+			message = mTxFill[TN];
+			message[1] = (FN>>24) & 0x0ff;
+			message[2] = (FN>>16) & 0x0ff;
+			message[3] = (FN>>8) & 0x0ff;
+			message[4] = (FN) & 0x0ff;
+		} else {
+			continue;
+		}
+		mTxFN[slot][TN] = -1;
+		messages[count] = message;
+		lengths[count] = sTxMessageLen;
+		count++;
+	}
+	// From here on, writeHighSide() refuses bursts for this frame,
+	// and bursts for the next use of the slot go out directly, so the messages are stable.
+	mTxSentFN = FN;
+	mTxLock.unlock();
+
+	if (count==0) return;
+	ScopedLock lock(mDataSocketLock);
+	mDataSocket.writeBatch(messages,lengths,count);
+}
+
+
+
+
+void ::ARFCNManager::driveRx(const char* buffer, int msgLen)
+{
+	// slot, frame number, RSSI, timing error, soft symbols
+	if (msgLen<(int)(1+4+1+2+gSlotLen)) {
+		LOG(ALERT) << "short burst message, length " << msgLen << " on ARFCN " << mARFCN;
+		return;
+	}
 	// decode
-	unsigned char *rp = (unsigned char*)buffer;
+	const unsigned char *rp = (const unsigned char*)buffer;
 	// timeslot number
 	unsigned TN = *rp++;
 	// frame number
@@ -225,28 +404,26 @@ void ::ARFCNManager::driveRx()
 	FN = (FN<<8) + (*rp++);
 	FN = (FN<<8) + (*rp++);
 	// physcial header data
-	signed char* srp = (signed char*)rp++;
+	const signed char* srp = (const signed char*)rp++;
 	// reported RSSI is negated dB wrt full scale
 	int RSSI = *srp;
-	srp = (signed char*)rp++;
+	srp = (const signed char*)rp++;
 	// timing error comes in 1/256 symbol steps
 	// because that fits nicely in 2 bytes
 	int timingError = *srp;
 	timingError = (timingError<<8) | (*rp++);
-	// soft symbols
-	float data[gSlotLen];
+	// soft symbols, straight into the burst, which is decoded after this buffer is reused
+	RxBurst* burst = new RxBurst(GSM::Time(FN,TN),timingError/256.0F,-RSSI);
+	float* data = burst->begin();
 	for (unsigned i=0; i<gSlotLen; i++) data[i] = (*rp++) / 256.0F;
 	// demux
-	receiveBurst(RxBurst(data,GSM::Time(FN,TN),timingError/256.0F,-RSSI));
+	receiveBurst(burst);
 }
 
 
-void* ReceiveLoopAdapter(::ARFCNManager* manager){
-	while (true) {
-		manager->driveRx();
-		pthread_testcancel();
-	}
-	return NULL;
+void ReceiveHandler(DatagramSocket&, char* buffer, int length, void* manager)
+{
+	((::ARFCNManager*)manager)->driveRx(buffer,length);
 }
 
 
@@ -538,21 +715,77 @@ signed ::ARFCNManager::getNoiseLevel(void)
         return noiselevel;
 }
 
-void ::ARFCNManager::receiveBurst(const RxBurst& inBurst)
+void ::ARFCNManager::receiveBurst(RxBurst* inBurst)
 {
-	LOG(DEBUG) << "receiveBurst: " << inBurst;
-	uint32_t FN = inBurst.time().FN() % maxModulus;
-	unsigned TN = inBurst.time().TN();
+	LOG(DEBUG) << "receiveBurst: " << *inBurst;
+	uint32_t FN = inBurst->time().FN() % maxModulus;
+	unsigned TN = inBurst->time().TN();
+
+	// Read-side critical section: just the table lookup.
+	unsigned parity = __atomic_load_n(&mTableEpoch,__ATOMIC_SEQ_CST) & 1;
+	__atomic_add_fetch(&mTableReaders[parity],1,__ATOMIC_SEQ_CST);
+	const DemuxTable* table = __atomic_load_n(&mDemuxTable,__ATOMIC_SEQ_CST);
+	L1Decoder *proc = table->mDecoders[TN][FN];
+	__atomic_sub_fetch(&mTableReaders[parity],1,__ATOMIC_SEQ_CST);
 
-	mTableLock.lock();
-	L1Decoder *proc = mDemuxTable[TN][FN];
 	if (proc==NULL) {
 		LOG(DEBUG) << "ARFNManager::receiveBurst in unconfigured TDMA position TN: " << TN << " FN: " << FN << ".";
-		mTableLock.unlock();
+		delete inBurst;
 		return;
 	}
-	proc->writeLowSide(inBurst);
-	mTableLock.unlock();
+	mSlotDecoders[TN].add(proc,inBurst);
+	gBTS.executor().post(&mSlotDecoders[TN]);
+}
+
+
+
+void ::ARFCNManager::SlotDecoder::add(L1Decoder* decoder, RxBurst* burst)
+{
+	ScopedLock lock(mLock);
+	if (mQueue.size()>=sMaxQueued) {
+		// The decoder has fallen behind; old bursts are useless to it anyway.
+		delete mQueue.front().mBurst;
+		mQueue.pop_front();
+		if (mDropped++==0) LOG(WARNING) << "uplink decoding overrun on TN " << burst->time().TN();
+	}
+	mQueue.push_back(Entry(decoder,burst));
+}
+
+
+unsigned ::ARFCNManager::SlotDecoder::backlog() const
+{
+	ScopedLock lock(mLock);
+	return mQueue.size();
+}
+
+
+unsigned ::ARFCNManager::decoderBacklog() const
+{
+	unsigned count = 0;
+	for (unsigned TN=0; TN<8; TN++) count += mSlotDecoders[TN].backlog();
+	return count;
+}
+
+
+bool ::ARFCNManager::SlotDecoder::step(Time&)
+{
+	std::deque<Entry> work;
+	unsigned dropped;
+	mLock.lock();
+	work.swap(mQueue);
+	dropped = mDropped;
+	mDropped = 0;
+	mLock.unlock();
+	if (dropped>1) LOG(NOTICE) << dropped << " uplink bursts discarded in decoding overrun";
+
+	while (work.size()) {
+		Entry& entry = work.front();
+		entry.mDecoder->writeLowSide(*entry.mBurst);
+		delete entry.mBurst;
+		work.pop_front();
+	}
+	// Wait for the next post().
+	return false;
 }
 
 
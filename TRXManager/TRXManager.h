@@ -36,7 +36,10 @@
 #include "Interthread.h"
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include "ChannelExecutor.h"
+#include "Metrics.h"
 #include <list>
+#include <deque>
 
 
 /* Forward refs into the GSM namespace. */
@@ -67,6 +70,17 @@ class TransceiverManager {
 	UDPSocket mClockSocket;		
 	/// a thread to monitor the global clock socket
 	Thread mClockThread;	
+	/// threads servicing the uplink data sockets of all ARFCNs
+	SocketReactor mReactor;
+	/// the central downlink scheduler, sending a whole TDMA frame on every ARFCN per clock tick
+	Thread mDownlinkThread;
+	/// frames ahead of the clock that the downlink scheduler sends
+	unsigned mDownlinkLead;
+	/// next frame for the downlink scheduler to send, or -1 before the first
+	int32_t mNextDownlinkFN;
+	/// uplink bursts waiting for decoding, summed over the ARFCNs
+	MetricGauge mSlotDecoderDepth;
+	static long sampleSlotDecoderDepth(void*);
 
 
 	public:
@@ -83,26 +97,36 @@ class TransceiverManager {
 	/**@name Accessors. */
 	//@{
 	ARFCNManager* ARFCN(unsigned i) { assert(i<mARFCNs.size()); return mARFCNs.at(i); }
+	SocketReactor& reactor() { return mReactor; }
 	//@}
 
 	bool haveClock() const { return mHaveClock; }
 
+	/** Frames ahead of the BTS clock that downlink bursts are sent to the transceiver. */
+	unsigned downlinkLead() const { return mDownlinkLead; }
+
 	unsigned C0() const;
 	unsigned numARFCNs() const { return mARFCNs.size(); }
 
 	/** Block until the clock is set over the UDP link. */
 	//void waitForClockInit() const;
 
-	/** Start the clock management thread and all ARFCN managers. */
+	/** Start the clock management thread, the uplink reactor, the downlink scheduler and all ARFCN managers. */
 	void start();
 
 	/** Clock service loop. */
 	friend void* ClockLoopAdapter(TransceiverManager*);
 
+	/** Downlink scheduler loop. */
+	friend void* DownlinkLoopAdapter(TransceiverManager*);
+
 	private:
 
 	/** Handler for messages on the clock interface. */
 	void clockHandler();
+
+	/** Send the frames that have come within the lead of the clock, then sleep until the next one does. */
+	void downlinkHandler();
 };
 
 
@@ -110,6 +134,8 @@ class TransceiverManager {
 
 void* ClockLoopAdapter(TransceiverManager *TRXm);
 
+void* DownlinkLoopAdapter(TransceiverManager *TRXm);
+
 
 
 
@@ -128,13 +154,81 @@ class ARFCNManager {
 	Mutex mControlLock;				///< lock to prevent overlapping transactions
 	UDPSocket mControlSocket;		///< socket for radio control
 
-	Thread mRxThread;				///< thread to receive data from rx
+	static const unsigned maxModulus=51*26*4;	///< maximum unified repeat period
 
-	/**@name The demux table. */
+	/** The demultiplexing table for received bursts. */
+	class DemuxTable {
+		public:
+		GSM::L1Decoder* mDecoders[8][maxModulus];
+	};
+
+	/**@name
+		The demux table, published read-copy-update.
+		Readers take no lock; a writer copies the table, changes the copy,
+		swaps it in and frees the old one once no reader can still hold it.
+	*/
 	//@{
-	Mutex mTableLock;
-	static const unsigned maxModulus=51*26*4;	///< maximum unified repeat period
-	GSM::L1Decoder* mDemuxTable[8][maxModulus];		///< the demultiplexing table for received bursts
+	DemuxTable* volatile mDemuxTable;	///< the current table, never modified in place
+	Mutex mTableLock;					///< serializes writers
+	volatile unsigned mTableEpoch;		///< advanced by writers to wait out readers
+	volatile unsigned mTableReaders[2];	///< readers in progress, by epoch parity
+	//@}
+
+	/**
+		The uplink decoding for one timeslot, run on the shared channel executor
+		so that decoding never holds up burst intake.
+		Bursts of a timeslot are decoded in order, one at a time.
+	*/
+	class SlotDecoder : public GSM::ChannelTask {
+
+		private:
+
+		/** A received burst and the decoder it was demultiplexed to. */
+		class Entry {
+			public:
+			GSM::L1Decoder* mDecoder;
+			GSM::RxBurst* mBurst;
+			Entry(GSM::L1Decoder* wDecoder, GSM::RxBurst* wBurst)
+				:mDecoder(wDecoder),mBurst(wBurst)
+			{ }
+		};
+
+		mutable Mutex mLock;
+		std::deque<Entry> mQueue;
+		unsigned mDropped;				///< bursts discarded since the last report
+
+		/** Longest backlog kept; older bursts are discarded past this. */
+		static const unsigned sMaxQueued = 104;
+
+		public:
+
+		SlotDecoder():mDropped(0) {}
+
+		/** Queue a burst for decoding; takes ownership of the burst. */
+		void add(GSM::L1Decoder* decoder, GSM::RxBurst* burst);
+
+		/** Bursts queued and not yet taken for decoding. */
+		unsigned backlog() const;
+
+		bool step(GSM::Time& next);
+	};
+
+	SlotDecoder mSlotDecoders[8];
+
+	/**@name
+		The downlink frame buffer.
+		Encoders put formatted bursts in it, by TDMA position, as far ahead as they run;
+		the TransceiverManager's downlink scheduler sends each frame whole, filling the gaps.
+	*/
+	//@{
+	static const unsigned sTxFrames = 256;			///< buffered frames, more than a TCH SACCH block spans
+	static const unsigned sTxMessageLen = 1+4+1+GSM::gSlotLen;	///< TN, FN, power, bits
+	Mutex mTxLock;
+	char mTxMessages[sTxFrames][8][sTxMessageLen];
+	int32_t mTxFN[sTxFrames][8];					///< frame number of each buffered burst, -1 if empty
+	int32_t mTxSentFN;								///< last frame sent, -1 before the first
+	char mTxFill[8][sTxMessageLen];					///< idle fill for each slot, if mHasFill
+	bool mHasFill;									///< true on C0, which must transmit continuously
 	//@}
 
 	unsigned mARFCN;						///< the current ARFCN
@@ -146,13 +240,26 @@ class ARFCNManager {
 
 	ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTRX);
 
-	/** Start the uplink thread. */
+	/** Register the uplink data socket with the transceiver's reactor. */
 	void start();
 
 	unsigned ARFCN() const { return mARFCN; }
 
+	/** Uplink bursts waiting for decoding, over all timeslots. */
+	unsigned decoderBacklog() const;
+
+	/** Frames ahead of the BTS clock that downlink bursts are sent. */
+	unsigned downlinkLead() const { return mTransceiver.downlinkLead(); }
+
+	/**
+		Buffer a burst for the downlink scheduler.
+		A burst for a frame already sent is dropped.
+	*/
 	void writeHighSide(const GSM::TxBurst& burst);
 
+	/** Send one frame: every buffered burst for it, with idle fill on C0. */
+	void sendFrame(int32_t FN);
+
 
 	/**@name Transceiver controls. */
 	//@{
@@ -245,18 +352,27 @@ class ARFCNManager {
 	/** Install a decoder on this ARFCN. */
 	void installDecoder(GSM::L1Decoder* wL1);
 
+	/** Remove a decoder from this ARFCN; bursts already queued for it are still delivered. */
+	void removeDecoder(GSM::L1Decoder* wL1);
+
 
 
 	private:
 
-	/** Action for reception. */
-	void driveRx();
+	/** Format a burst as a transceiver data message of sTxMessageLen bytes. */
+	static void formatBurst(const GSM::TxBurst& burst, char* buffer);
+
+	/** Parse and process an uplink burst message. */
+	void driveRx(const char* buffer, int msgLen);
+
+	/** Demultiplex a received burst and queue it for decoding; takes ownership of the burst. */
+	void receiveBurst(GSM::RxBurst*);
 
-	/** Demultiplex and process a received burst. */
-	void receiveBurst(const GSM::RxBurst&);
+	/** Wait until no reader can hold a table older than the current one; caller holds mTableLock. */
+	void synchronizeTable();
 
-	/** Receiver loop. */
-	friend void* ReceiveLoopAdapter(ARFCNManager*);
+	/** Reactor handler for the data socket. */
+	friend void ReceiveHandler(DatagramSocket&, char*, int, void*);
 
 	/**
 		Send a command packet and get the response packet.
@@ -295,8 +411,8 @@ class ARFCNManager {
 };
 
 
-/** C interface for ARFCNManager threads. */
-void* ReceiveLoopAdapter(ARFCNManager*);
+/** C interface for the ARFCNManager data socket; the context is the ARFCNManager. */
+void ReceiveHandler(DatagramSocket& socket, char* buffer, int length, void* manager);
 
 
 #endif
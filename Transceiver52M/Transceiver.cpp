@@ -165,7 +165,9 @@ void Transceiver::pushRadioVector(GSM::Time &nowTime)
     // Even if the burst is stale, put it in the fillter table.
     // (It might be an idle pattern.)
     // Now we do it only for BEACON channels.
-    LOG(NOTICE) << "dumping STALE burst in TRX->USRP interface";
+    LOG(NOTICE) << "dumping STALE burst in TRX->USRP interface, "
+                << mTransmitPriorityQueue.staleCount() << " stale, "
+                << mTransmitPriorityQueue.lateCount() << " late on arrival";
     const GSM::Time& nextTime = staleBurst->getTime();
     int TN = nextTime.TN();
     int modFN = nextTime.FN() % fillerModulus[TN];
@@ -55,55 +55,3 @@ radioVector *VectorFIFO::get()
 {
 	return (radioVector*) mQ.get();
 }
-
-GSM::Time VectorQueue::nextTime() const
-{
-	GSM::Time retVal;
-	mLock.lock();
-
-	while (mQ.size()==0)
-		mWriteSignal.wait(mLock);
-
-	retVal = mQ.top()->getTime();
-	mLock.unlock();
-
-	return retVal;
-}
-
-radioVector* VectorQueue::getStaleBurst(const GSM::Time& targTime)
-{
-	mLock.lock();
-	if ((mQ.size()==0)) {
-		mLock.unlock();
-		return NULL;
-	}
-
-	if (mQ.top()->getTime() < targTime) {
-		radioVector* retVal = mQ.top();
-		mQ.pop();
-		mLock.unlock();
-		return retVal;
-	}
-	mLock.unlock();
-
-	return NULL;
-}
-
-radioVector* VectorQueue::getCurrentBurst(const GSM::Time& targTime)
-{
-	mLock.lock();
-	if ((mQ.size()==0)) {
-		mLock.unlock();
-		return NULL;
-	}
-
-	if (mQ.top()->getTime() == targTime) {
-		radioVector* retVal = mQ.top();
-		mQ.pop();
-		mLock.unlock();
-		return retVal;
-	}
-	mLock.unlock();
-
-	return NULL;
-}
@@ -24,6 +24,7 @@
 
 #include "sigProcLib.h"
 #include "GSMCommon.h"
+#include "TimingWheel.h"
 
 class radioVector : public signalVector {
 public:
@@ -46,11 +47,12 @@ private:
 	PointerFIFO mQ;
 };
 
-class VectorQueue : public InterthreadPriorityQueue<radioVector> {
+class RadioVectorTime {
 public:
-	GSM::Time nextTime() const;
-	radioVector* getStaleBurst(const GSM::Time& targTime);
-	radioVector* getCurrentBurst(const GSM::Time& targTime);
+	GSM::Time operator()(const radioVector *ptr) const { return ptr->getTime(); }
+};
+
+class VectorQueue : public GSM::TimingWheel<radioVector, RadioVectorTime> {
 };
 
 #endif /* RADIOVECTOR_H */
@@ -35,6 +35,9 @@ ConfigurationTable gConfig("OpenBTS.db");
 #include <Reporting.h>
 ReportingTable gReports(gConfig.getStr("Control.Reporting.StatsTable","OpenBTSStats.db").c_str());
 
+#include <Metrics.h>
+MetricsServer gMetricsServer;
+
 #include <TRXManager.h>
 #include <GSML1FEC.h>
 #include <GSMConfig.h>
@@ -250,6 +253,8 @@ void createStats()
 	//gReports.create("OpenBTS.GSM.RR.ChannelRelease");
 	// count of number of times the beacon was regenerated
 	gReports.create("OpenBTS.GSM.RR.BeaconRegenerated");
+	// count of dynamic timeslot conversions between C-I and C-VII
+	gReports.create("OpenBTS.GSM.RR.TimeslotReconfigured");
 	// count of successful channel assignments
 	gReports.create("OpenBTS.GSM.RR.ChannelSiezed");
 	//gReports.create("OpenBTS.GSM.RR.LinkFailure");
@@ -316,6 +321,10 @@ int main(int argc, char *argv[])
 	gBTS.init();
 	gSubscriberRegistry.init();
 	gParser.addCommands();
+	if (gConfig.defines("Control.Metrics.Port")) {
+		gMetricsServer.start(gConfig.getStr("Control.Metrics.IP","127.0.0.1").c_str(),
+			gConfig.getNum("Control.Metrics.Port"));
+	}
 
 	COUT("\nStarting the system...");
 
@@ -2,11 +2,16 @@ PRAGMA foreign_keys=OFF;
 BEGIN TRANSACTION;
 CREATE TABLE CONFIG ( KEYSTRING TEXT UNIQUE NOT NULL, VALUESTRING TEXT, STATIC INTEGER DEFAULT 0, OPTIONAL INTEGER DEFAULT 0, COMMENTS TEXT DEFAULT '');
 INSERT INTO "CONFIG" VALUES('CLI.SocketPath','/var/run/command',0,0,'Path for Unix domain datagram socket used for the OpenBTS console interface.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.PhysStatusPeriod',10,0,0,'Seconds between copies of the latest channel measurements to the physical status table.  Measurements are kept in memory in between.  0 stops updating the table.');
 INSERT INTO "CONFIG" VALUES('Control.Reporting.PhysStatusTable','/var/run/OpenBTSChannelTable.db',1,0,'File path for channel status reporting database.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.Reporting.TransactionTable','/var/run/TransactionTable.db',1,0,'File path for transaction table database.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.Reporting.TMSITable','/var/run/OpenBTSTMSITable.db',1,0,'File path for TMSITable database.  Static.');
+INSERT INTO "CONFIG" VALUES('Control.Metrics.IP','127.0.0.1',1,1,'Local IP address for the Prometheus metrics HTTP endpoint.  Static.');
+INSERT INTO "CONFIG" VALUES('Control.Metrics.Port',NULL,1,1,'TCP port for the Prometheus metrics HTTP endpoint.  If not defined, the endpoint is disabled.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.Call.QueryRRLP.Early',NULL,0,1,'If not NULL, query every MS for its location via RRLP during the setup of a call.');
 INSERT INTO "CONFIG" VALUES('Control.Call.QueryRRLP.Late',NULL,0,1,'If not NULL, query every MS for its location via RRLP during the teardown of a call.');
+INSERT INTO "CONFIG" VALUES('Control.GSMTAP.PcapFile',NULL,0,1,'If defined, write GSMTAP packets to this file in pcap format, for Wireshark.  The file is rotated to the same name with .1 appended when it reaches Control.GSMTAP.PcapMaxSize.  This works alongside or instead of Control.GSMTAP.TargetIP.');
+INSERT INTO "CONFIG" VALUES('Control.GSMTAP.PcapMaxSize',100,0,0,'Size in megabytes at which the GSMTAP pcap file is rotated.  0 means no limit.');
 INSERT INTO "CONFIG" VALUES('Control.GSMTAP.TargetIP',NULL,0,1,'Target IP address for GSMTAP packets; the IP address of Wireshark, if you use it for GSM.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.AttachDetach',1,0,0,'Attach/detach flag.  Set to 1 to use attach/detach procedure, 0 otherwise.  This will make initial LUR more prompt.  It will also cause an un-regstration if the handset powers off and really heavy LUR loads in areas with spotty coverage.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.FailedRegistration.Message','Your handset is not provisioned for this network. ',0,1,'If defined, send this text message, followed by the IMSI, to unprovisioned handsets that are denied  registration.');
@@ -36,6 +41,11 @@ INSERT INTO "CONFIG" VALUES('GSM.CellSelection.NECI','1',0,0,'NECI, New Establis
 INSERT INTO "CONFIG" VALUES('GSM.CellSelection.Neighbors','39 41 43',0,0,'ARFCNs of neighboring cells.');
 INSERT INTO "CONFIG" VALUES('GSM.CellSelection.RXLEV-ACCESS-MIN','0',0,0,'Cell selection parameters.  See GSM 04.08 10.5.2.4.');
 INSERT INTO "CONFIG" VALUES('GSM.Channels.C1sFirst',NULL,1,0,'If not NULL, allocate C-I slots first, starting at C0T1.  Otherwise, allocate C-VII slots first.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.Dynamic','0',1,0,'If not 0, the C-I and C-VII slots are converted between the two combinations while idle, following the SDCCH and TCH load.  The NumC1s and NumC7s values give the initial plan.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.Dynamic.HoldTime','30',0,0,'Minimum time, in seconds, a dynamic slot keeps its combination before it can be converted again.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.Dynamic.Period','1000',0,0,'Interval, in milliseconds, between checks of the channel load for dynamic slot conversion.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.Dynamic.SDCCHLow','2',0,0,'A C-I slot is converted to C-VII when no more than this many SDCCHs are free, or when more channel requests are waiting than SDCCHs are free.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.Dynamic.TCHLow','1',0,0,'A C-VII slot is converted to C-I when no more than this many TCHs are free.  A C-I slot is never converted if that would leave this many TCHs free or fewer.');
 INSERT INTO "CONFIG" VALUES('GSM.Channels.NumC1s','7',1,0,'Number of Combination-I timeslots to configure.  The C-I slot carries a single full-rate TCH, used for speech calling.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Channels.NumC7s','0',1,0,'Number of Combination-VII timeslots to configure.  The C-VII slot carries 8 SDCCHs, useful to handle high registration loads or SMS.  If C0T0 is C-IV, you must have at least one C-VII also.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Control.GPRSMaxIgnore','5',0,1,'The maximum number of suspension requests to ignore before aborting a transaction.');
@@ -47,6 +57,7 @@ INSERT INTO "CONFIG" VALUES('GSM.Identity.MCC','001',0,0,'Mobile country code, 2
 INSERT INTO "CONFIG" VALUES('GSM.Identity.MNC','01',0,0,'Mobile network code; Must be 3 dgits.  Assigned by your national regulator.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.ShortName','Range',0,1,'Network short name, displayed on some phones.  Optional but must be defined if you also want the network to send time-of-day.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.ShowCountry',1,0,0,'If not NULL, tell the phone to show the country name based on the MCC.');
+INSERT INTO "CONFIG" VALUES('GSM.LAPDm.WindowSize','1',0,0,'Maximum number of unacknowledged LAPDm I-frames on the SDCCH and FACCH, k in GSM 04.06 5.8.4.  The standard value is 1.  Larger values, up to 7, shorten segmented messages but need handsets that accept them.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Damping','50',0,0,'Damping value for MS power control loop.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Max','33',0,0,'Maximum commanded MS power level in dBm.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Min','5',0,0,'Minimum commanded MS power level in dBm.');
@@ -75,6 +86,7 @@ INSERT INTO "CONFIG" VALUES('GSM.RRLP.ALMANAC.ASSIST.PRESENT','0',0,0,'1=send al
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.EPHEMERIS.ASSIST.COUNT','9',0,0,'number of satellites to include in navigation model');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.Band','900',1,0,'The GSM operating band.  Valid values are 850 (GSM850), 900 (PGSM900), 1800 (DCS1800) and 1900 (PCS1900).  For most Range models, this value is dictated by the hardware and should not be changed.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.C0','51 ',1,0,'The C0 ARFCN.  Also the base ARFCN for a multi-ARFCN configuration.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.Radio.FireCorrection',NULL,0,1,'If not NULL, use the Fire code on control channels to correct single error bursts of up to 12 bits instead of discarding the frame.  This recovers some frames at the cost of a higher undetected error rate.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.MaxExpectedDelaySpread','1 ',0,0,'Expected worst-case delay spread in symbol periods, roughly 3.7 us or 1.1 km per unit.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.PowerManager.MaxAttenDB','10',0,0,'Maximum transmitter attenuation level, in dB wrt full scale on the D/A output.  This sets the minimum power output level in the output power control loop.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.PowerManager.MinAttenDB','0',0,0,'Minimum transmitter attenuation level, in dB wrt full scale on the D/A output.  This sets the maximum power output level in the output power control loop.');
@@ -90,6 +102,9 @@ INSERT INTO "CONFIG" VALUES('GSM.Timer.T3122Max','255000',0,0,'Maximum allowed v
 INSERT INTO "CONFIG" VALUES('GSM.Timer.T3122Min','2000',0,0,'Minimum allowed value for T3122, the RACH holdoff timer, in milliseconds.');
 INSERT INTO "CONFIG" VALUES('GSM.Timer.T3212','30',0,0,'Registration timer T3212 period in minutes.  Should be a factor of 6.  Set to 0 to disable periodic registration.  Should be smaller than SIP registration period.');
 INSERT INTO "CONFIG" VALUES('Log.Alarms.Max','20',0,0,'Maximum number of alarms to remember inside the application.');
+INSERT INTO "CONFIG" VALUES('Log.Async',NULL,0,1,'If not NULL, log records are queued on per-thread rings and written by a background thread, so logging never blocks the radio and L1 threads.  Records are dropped, and counted, when a ring is full.  Records still queued at exit are lost.');
+INSERT INTO "CONFIG" VALUES('Log.File',NULL,0,1,'If not NULL and Log.Async is set, write log records to this file instead of syslog.');
+INSERT INTO "CONFIG" VALUES('Log.File.MaxSize','10000000',0,1,'Size in bytes at which Log.File is rotated to Log.File.1.');
 INSERT INTO "CONFIG" VALUES('Log.Level','WARNING',0,0,'Default logging level when no other level is defined for a file.');
 INSERT INTO "CONFIG" VALUES('Log.Level.CallControl.cpp','INFO',0,1,'Default configuration logs a trace at L3.');
 INSERT INTO "CONFIG" VALUES('Log.Level.MobilityManagement.cpp','INFO',0,1,'Default configuration logs a trace at L3.');
@@ -125,7 +140,9 @@ INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.Url','http://127.0.0.1/c
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.VisibleColumns','name username type context host',0,0,'Field names in subscriber registry visible in the database manager.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.db','/var/lib/asterisk/sqlite3dir/sqlite3.db',0,0,'The location of the sqlite3 database holding the subscriber registry.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Port','5064',0,0,'Port used by the SIP Authentication Server. NOTE: In some older releases (pre-2.8.1) this is called SIP.myPort.');
+INSERT INTO "CONFIG" VALUES('TRX.DownlinkLead','1',1,1,'Number of frames ahead of the transceiver clock that the downlink scheduler sends each TDMA frame.  Encoders run this far ahead to fill the frame in time.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.IP','127.0.0.1',1,0,'IP address of the transceiver application.  Static.');
+INSERT INTO "CONFIG" VALUES('TRX.IOThreads','2',1,1,'Number of threads servicing the uplink data sockets of all ARFCNs.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.Port','5700',1,0,'IP port of the transceiver application.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.RadioFrequencyOffset','128',1,0,'Fine-tuning adjustment for the transceiver master clock.  Roughly 170 Hz/step.  Set at the factory.  Do not adjust without proper calibration.  Static.');
 INSERT INTO "CONFIG" VALUES('TRX.Timeout.Clock','10',0,1,'How long to wait during a read operation from the transceiver before giving up.');